@@ -0,0 +1,417 @@
+//
+// AssetArchive.cpp
+//
+
+#include "AssetArchive.h"
+
+#include "Lz4.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace AssetArchive;
+
+namespace
+{
+	[[noreturn]] void Fail(const char* what)
+	{
+		throw std::runtime_error(std::string("Invalid asset archive: ") + what);
+	}
+
+	bool IsBefore(uint64_t hash, const char* name, uint64_t otherHash, const char* otherName) noexcept
+	{
+		return hash != otherHash ? hash < otherHash : std::strcmp(name, otherName) < 0;
+	}
+}
+
+std::string AssetArchive::NormalizeName(std::string_view name)
+{
+	std::string normalized;
+	normalized.reserve(name.size());
+
+	size_t start = 0;
+	while (start <= name.size())
+	{
+		size_t end = name.find_first_of("/\\", start);
+		if (end == std::string_view::npos)
+			end = name.size();
+
+		const std::string_view component = name.substr(start, end - start);
+		if (!component.empty() && component != ".")
+		{
+			if (!normalized.empty())
+				normalized += '/';
+			for (const char c : component)
+			{
+				normalized += (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+			}
+		}
+		start = end + 1;
+	}
+	return normalized;
+}
+
+uint64_t AssetArchive::HashName(std::string_view normalized) noexcept
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (const char c : normalized)
+	{
+		hash = (hash ^ uint8_t(c)) * 0x100000001B3ull;
+	}
+	return hash;
+}
+
+Reader::Reader(std::filesystem::path const& path, Backend backend) :
+	m_backend(backend),
+	m_path(path.string()),
+	m_header{},
+	m_entries(nullptr),
+	m_blocks(nullptr),
+	m_names(nullptr),
+#ifdef _WIN32
+	m_file(INVALID_HANDLE_VALUE)
+#else
+	m_file(-1)
+#endif
+{
+	if (backend == Backend::Mapped)
+	{
+		m_mapping.emplace(path);
+		if (m_mapping->GetSize() < sizeof(Header))
+			Fail("header");
+		std::memcpy(&m_header, m_mapping->GetData(), sizeof(Header));
+		Validate();
+		return;
+	}
+
+	uint64_t fileSize = 0;
+#ifdef _WIN32
+	m_file = CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open " + m_path);
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(m_file, &size))
+	{
+		Close();
+		throw std::runtime_error("Failed to get the size of " + m_path);
+	}
+	fileSize = uint64_t(size.QuadPart);
+#else
+	m_file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (m_file < 0)
+		throw std::runtime_error("Failed to open " + m_path);
+
+	struct stat status = {};
+	if (fstat(m_file, &status) != 0)
+	{
+		Close();
+		throw std::runtime_error("Failed to get the size of " + m_path);
+	}
+	fileSize = uint64_t(status.st_size);
+#endif
+
+	try
+	{
+		if (fileSize < sizeof(Header))
+			Fail("header");
+		ReadAt(0, &m_header, sizeof(Header));
+		if (m_header.fileSize != fileSize)
+			Fail("file size");
+
+		// The tables and names are small next to the entries, and every
+		// lookup reads them, so they're read in once.
+		if (m_header.nameOffset > fileSize || m_header.nameSize > fileSize - m_header.nameOffset)
+			Fail("name section");
+		m_toc.resize(size_t(m_header.nameOffset) + m_header.nameSize);
+		ReadAt(0, m_toc.data(), m_toc.size());
+		Validate();
+	}
+	catch (...)
+	{
+		Close();
+		throw;
+	}
+}
+
+Reader::~Reader()
+{
+	Close();
+}
+
+const Entry* Reader::Find(std::string_view name) const
+{
+	const std::string normalized = NormalizeName(name);
+	const uint64_t hash = HashName(normalized);
+
+	const Entry* const end = m_entries + m_header.entryCount;
+	const Entry* entry = std::lower_bound(m_entries, end, hash,
+		[](Entry const& entry, uint64_t hash) { return entry.hash < hash; });
+
+	for (; entry != end && entry->hash == hash; ++entry)
+	{
+		if (normalized == GetName(*entry))
+			return entry;
+	}
+	return nullptr;
+}
+
+uint32_t Reader::GetBlockCount(Entry const& entry) noexcept
+{
+	return IsCompressed(entry) ? uint32_t((entry.size + entry.blockSize - 1) / entry.blockSize) : 0;
+}
+
+const uint8_t* Reader::GetData(Entry const& entry) const
+{
+	if (!m_mapping)
+		throw std::logic_error("Asset archive isn't mapped");
+	if (IsCompressed(entry))
+		throw std::logic_error(std::string(GetName(entry)) + " is compressed");
+	return m_mapping->GetData() + entry.offset;
+}
+
+void Reader::Read(Entry const& entry, uint64_t offset, void* destination, size_t size) const
+{
+	if (IsCompressed(entry))
+		throw std::logic_error(std::string(GetName(entry)) + " is compressed");
+	if (offset > entry.size || size > entry.size - offset)
+		throw std::out_of_range("Read past the end of " + std::string(GetName(entry)));
+
+	if (m_mapping)
+	{
+		std::memcpy(destination, m_mapping->GetData() + entry.offset + offset, size);
+		return;
+	}
+	ReadAt(entry.offset + offset, destination, size);
+}
+
+void Reader::ReadEntry(Entry const& entry, uint8_t* destination, ThreadPool* pool) const
+{
+	if (!IsCompressed(entry))
+	{
+		Read(entry, 0, destination, size_t(entry.size));
+		return;
+	}
+
+	if (m_mapping)
+	{
+		m_mapping->Prefetch(size_t(entry.offset), size_t(entry.storedSize));
+	}
+
+	struct Context
+	{
+		const Reader* reader;
+		const Entry* entry;
+		uint8_t* destination;
+	};
+	Context context = { this, &entry, destination };
+
+	auto const task = [](void* data, uint32_t index)
+	{
+		auto const& context = *static_cast<Context*>(data);
+		context.reader->ReadBlock(*context.entry, index, context.destination);
+	};
+
+	const uint32_t blockCount = GetBlockCount(entry);
+	if (pool)
+	{
+		pool->ParallelFor(blockCount, task, &context);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < blockCount; ++i)
+		{
+			task(&context, i);
+		}
+	}
+}
+
+// Decodes straight from the mapping, or from a read of the block into a
+// buffer kept per thread, as blocks are at most MaxBlockSize. Blocks
+// stored as they are are read or copied straight into place.
+void Reader::ReadBlock(Entry const& entry, uint32_t index, uint8_t* destination) const
+{
+	Block const& block = GetBlock(entry, index);
+	const uint64_t start = uint64_t(index) * entry.blockSize;
+	const size_t size = size_t(std::min<uint64_t>(entry.blockSize, entry.size - start));
+	uint8_t* const out = destination + start;
+	const bool stored = block.storedSize == size;
+
+	const uint8_t* in;
+	thread_local std::vector<uint8_t> buffer;
+	if (m_mapping)
+	{
+		in = m_mapping->GetData() + block.offset;
+	}
+	else if (stored)
+	{
+		ReadAt(block.offset, out, size);
+		return;
+	}
+	else
+	{
+		buffer.resize(block.storedSize);
+		ReadAt(block.offset, buffer.data(), buffer.size());
+		in = buffer.data();
+	}
+
+	if (stored)
+	{
+		std::memcpy(out, in, size);
+	}
+	else if (!Lz4::Decompress(in, block.storedSize, out, size))
+	{
+		throw std::runtime_error("Damaged block in " + std::string(GetName(entry)));
+	}
+}
+
+// Positioned reads leave the file pointer alone, or don't depend on it, so
+// threads can read different entries at once through one handle.
+void Reader::ReadAt(uint64_t offset, void* destination, size_t size) const
+{
+	auto bytes = static_cast<uint8_t*>(destination);
+	while (size > 0)
+	{
+#ifdef _WIN32
+		const DWORD chunk = DWORD(std::min<size_t>(size, 1u << 30));
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = DWORD(offset);
+		overlapped.OffsetHigh = DWORD(offset >> 32);
+
+		DWORD count = 0;
+		if (!ReadFile(m_file, bytes, chunk, &count, &overlapped) || count == 0)
+			throw std::runtime_error("Failed to read " + m_path);
+#else
+		const ssize_t count = pread(m_file, bytes, std::min<size_t>(size, 1u << 30), off_t(offset));
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			throw std::runtime_error("Failed to read " + m_path);
+#endif
+		bytes += count;
+		offset += uint64_t(count);
+		size -= size_t(count);
+	}
+}
+
+// Checks the header and every table record, so lookups and reads of the
+// entries can trust them. The entries' bytes aren't looked at; that's for
+// the parser of each.
+void Reader::Validate()
+{
+	const uint8_t* const toc = m_mapping ? m_mapping->GetData() : m_toc.data();
+	const uint64_t fileSize = m_mapping ? m_mapping->GetSize() : m_header.fileSize;
+
+	if (m_header.magic != Magic)
+		Fail("not an asset archive");
+	if (m_header.version != Version)
+		Fail(("version " + std::to_string(m_header.version) + ", expected " + std::to_string(Version) + "; pack it again").c_str());
+	if (m_header.fileSize != fileSize)
+		Fail("file size");
+
+	if (m_header.entryOffset < sizeof(Header) || m_header.entryOffset % alignof(Entry) != 0
+		|| m_header.entryOffset + uint64_t(m_header.entryCount) * sizeof(Entry) > m_header.blockOffset)
+		Fail("entry table");
+	if (m_header.blockOffset % alignof(Block) != 0
+		|| m_header.blockOffset + uint64_t(m_header.blockCount) * sizeof(Block) > m_header.nameOffset)
+		Fail("block table");
+	if (uint64_t(m_header.nameOffset) + m_header.nameSize > fileSize)
+		Fail("name section");
+
+	// Ending on a NUL means every offset inside the section reaches one.
+	if (m_header.nameSize > 0 && toc[m_header.nameOffset + m_header.nameSize - 1] != 0)
+		Fail("name section");
+
+	m_entries = reinterpret_cast<const Entry*>(toc + m_header.entryOffset);
+	m_blocks = reinterpret_cast<const Block*>(toc + m_header.blockOffset);
+	m_names = reinterpret_cast<const char*>(toc + m_header.nameOffset);
+
+	const uint64_t dataStart = uint64_t(m_header.nameOffset) + m_header.nameSize;
+	for (uint32_t i = 0; i < m_header.entryCount; ++i)
+	{
+		Entry const& entry = m_entries[i];
+		if (entry.name >= m_header.nameSize)
+			Fail("entry name");
+
+		const char* const name = GetName(entry);
+		if (entry.hash != HashName(name))
+			Fail("entry hash");
+		if (i > 0 && !IsBefore(m_entries[i - 1].hash, GetName(m_entries[i - 1]), entry.hash, name))
+			Fail("entry order");
+
+		if (entry.offset % EntryAlignment != 0 || entry.offset < dataStart
+			|| entry.offset > fileSize || entry.storedSize > fileSize - entry.offset)
+			Fail("entry bounds");
+
+		ValidateBlocks(entry);
+	}
+}
+
+// An entry's blocks must cover it and its stored bytes exactly, in order,
+// each no bigger stored than decompressed.
+void Reader::ValidateBlocks(Entry const& entry) const
+{
+	if (entry.compression == Compression::None)
+	{
+		if (entry.storedSize != entry.size || entry.blockSize != 0 || entry.firstBlock != 0)
+			Fail("uncompressed entry");
+		return;
+	}
+
+	if (entry.compression != Compression::Lz4)
+		Fail("entry compression");
+	if (entry.blockSize < MinBlockSize || entry.blockSize > MaxBlockSize || (entry.blockSize & (entry.blockSize - 1)) != 0)
+		Fail("entry block size");
+
+	// Checked before counting, which would overflow on a damaged size.
+	if (entry.size == 0 || (entry.size - 1) / entry.blockSize >= m_header.blockCount)
+		Fail("entry blocks");
+	const uint32_t blockCount = GetBlockCount(entry);
+	if (uint64_t(entry.firstBlock) + blockCount > m_header.blockCount)
+		Fail("entry blocks");
+
+	uint64_t offset = entry.offset;
+	for (uint32_t i = 0; i < blockCount; ++i)
+	{
+		Block const& block = GetBlock(entry, i);
+		const uint64_t size = std::min<uint64_t>(entry.blockSize, entry.size - uint64_t(i) * entry.blockSize);
+		if (block.offset != offset || block.storedSize == 0 || block.storedSize > size || block.reserved != 0)
+			Fail("block");
+		offset += block.storedSize;
+	}
+
+	if (offset != entry.offset + entry.storedSize)
+		Fail("entry stored size");
+}
+
+void Reader::Close() noexcept
+{
+#ifdef _WIN32
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+	}
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_file >= 0)
+	{
+		close(m_file);
+	}
+	m_file = -1;
+#endif
+}
@@ -0,0 +1,182 @@
+//
+// AssetArchive.h - Packed asset archives, read in place from a mapping or with positioned reads
+//
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ThreadPool;
+
+// An archive packs many asset files into one, so loading opens one file
+// instead of one per asset, and a mapping of it hands parsers and upload
+// staging each asset's bytes where they lie.
+//
+// The header and table of contents come first. The table holds one
+// fixed-size little-endian record per entry, sorted by the hash of the
+// entry's name and then by the name, so a lookup is a binary search that
+// compares strings only on a hash match. Names are UTF-8, NUL-terminated,
+// in a section after the tables. Each entry's bytes start on an
+// EntryAlignment boundary, which is a page, so every entry in a mapping is
+// as aligned as a mapping of its own loose file would be, and reading one
+// entry never touches another's pages.
+//
+// An entry can be compressed in blocks of its blockSize bytes (the last
+// one shorter), each compressed on its own so blocks decode in parallel, and
+// each stored as it is where compressing didn't shrink it. A table after
+// the entries gives every block's place, and an entry's blocks are a run
+// of it. Compressed entries have to be decoded into memory of their own;
+// uncompressed ones can still be used in place.
+//
+// Names are paths relative to the directory that was packed, normalized
+// by NormalizeName. As with cooked meshes, the version is bumped whenever
+// the layout changes, and older archives are rejected.
+namespace AssetArchive
+{
+	constexpr uint32_t Magic = 0x4B415053;		// "SPAK"
+	constexpr uint32_t Version = 2;
+	constexpr uint32_t EntryAlignment = 4096;
+
+	// Compressed entries' block sizes are powers of two in this range.
+	constexpr uint32_t MinBlockSize = 64 * 1024;
+	constexpr uint32_t MaxBlockSize = 256 * 1024;
+
+	enum class Compression : uint32_t
+	{
+		None = 0,
+		Lz4 = 1,		// Blocks in the LZ4 block format, see Lz4.h
+	};
+
+	// Offsets are from the start of the file and sizes in bytes.
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t fileSize;
+		uint32_t entryCount;
+		uint32_t entryOffset;
+		uint32_t blockCount;
+		uint32_t blockOffset;
+		uint32_t nameOffset;
+		uint32_t nameSize;
+	};
+
+	struct Entry
+	{
+		uint64_t hash;
+		uint64_t offset;
+		uint64_t size;				// Decompressed
+		uint64_t storedSize;		// In the archive
+		uint32_t name;				// Offset of its first byte from the name section's start
+		Compression compression;
+		uint32_t blockSize;			// 0 uncompressed
+		uint32_t firstBlock;		// 0 uncompressed
+	};
+
+	// A block is stored as it is when its stored size is its full size.
+	struct Block
+	{
+		uint64_t offset;
+		uint32_t storedSize;
+		uint32_t reserved;			// 0
+	};
+
+	static_assert(sizeof(Header) == 40 && sizeof(Entry) == 48 && sizeof(Block) == 16,
+		"Archive records must match the file layout");
+
+	// Forward slashes, no "." components, ASCII letters lowercased, so a
+	// name matches however a path to it was written.
+	std::string NormalizeName(std::string_view name);
+
+	// 64-bit FNV-1a of a normalized name.
+	uint64_t HashName(std::string_view normalized) noexcept;
+
+	class Reader
+	{
+	public:
+		enum class Backend
+		{
+			// Maps the archive; GetData points into it.
+			Mapped,
+
+			// Reads the table into memory and entries with positioned
+			// reads (pread, or ReadFile at an offset), into the caller's
+			// buffer. For address spaces too small to map the archive.
+			Read,
+		};
+
+		// Opens and checks the archive's header and table of contents.
+		// Throws std::runtime_error if it can't be read or isn't an archive
+		// of this version.
+		explicit Reader(std::filesystem::path const& path, Backend backend = Backend::Mapped);
+		~Reader();
+
+		Reader(Reader const&) = delete;
+		Reader& operator= (Reader const&) = delete;
+
+		Backend GetBackend() const noexcept { return m_backend; }
+
+		uint32_t GetEntryCount() const noexcept { return m_header.entryCount; }
+		Entry const& GetEntry(uint32_t index) const noexcept { return m_entries[index]; }
+		const char* GetName(Entry const& entry) const noexcept { return m_names + entry.name; }
+
+		static bool IsCompressed(Entry const& entry) noexcept { return entry.compression != Compression::None; }
+		static uint32_t GetBlockCount(Entry const& entry) noexcept;
+		Block const& GetBlock(Entry const& entry, uint32_t index) const noexcept { return m_blocks[entry.firstBlock + index]; }
+
+		// The entry with this name, normalized first, or nullptr.
+		const Entry* Find(std::string_view name) const;
+
+		// An uncompressed entry's bytes in the mapping, aligned to
+		// EntryAlignment. Throws std::logic_error for the Read backend or a
+		// compressed entry.
+		const uint8_t* GetData(Entry const& entry) const;
+
+		// Copies size bytes from offset into an uncompressed entry, with
+		// either backend. Throws std::logic_error for a compressed entry,
+		// std::out_of_range past the entry's end and std::runtime_error if
+		// the read fails.
+		void Read(Entry const& entry, uint64_t offset, void* destination, size_t size) const;
+
+		// Copies or decompresses the whole entry, entry.size bytes. Blocks
+		// are read and decoded on the pool's threads where there's one, so
+		// while some decode, others' reads (or page faults, for a mapping
+		// asked to read the entry ahead) are in flight. Throws
+		// std::runtime_error if a read fails or a block is damaged.
+		//
+		// Safe to call from several threads at once, as are Read and
+		// GetData; the pool isn't.
+		void ReadEntry(Entry const& entry, uint8_t* destination, ThreadPool* pool = nullptr) const;
+
+	private:
+		void ReadBlock(Entry const& entry, uint32_t index, uint8_t* destination) const;
+		void ReadAt(uint64_t offset, void* destination, size_t size) const;
+		void Validate();
+		void ValidateBlocks(Entry const& entry) const;
+		void Close() noexcept;
+
+		Backend m_backend;
+		std::string m_path;
+		Header m_header;
+
+		std::optional<MappedFile> m_mapping;
+		std::vector<uint8_t> m_toc;
+		const Entry* m_entries;
+		const Block* m_blocks;
+		const char* m_names;
+
+#ifdef _WIN32
+		void* m_file;
+#else
+		int m_file;
+#endif
+	};
+}
@@ -0,0 +1,106 @@
+//
+// AssetCache.cpp
+//
+
+#include "AssetCache.h"
+
+#include <iterator>
+
+AssetCache::AssetCache(uint64_t budget) :
+	m_budget(budget),
+	m_stats{}
+{
+}
+
+std::shared_ptr<IAssetPayload const> AssetCache::Find(uint32_t kind, std::filesystem::path const& path)
+{
+	const std::string key = MakeKey(kind, path);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto const found = m_index.find(key);
+	if (found == m_index.end())
+	{
+		m_stats.misses++;
+		return nullptr;
+	}
+
+	m_items.splice(m_items.begin(), m_items, found->second);
+	m_stats.hits++;
+	return found->second->payload;
+}
+
+void AssetCache::Insert(uint32_t kind, std::filesystem::path const& path, std::shared_ptr<IAssetPayload const> payload)
+{
+	if (!payload)
+		return;
+
+	std::string key = MakeKey(kind, path);
+	const size_t size = payload->GetSize();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto const found = m_index.find(key);
+	if (found != m_index.end())
+	{
+		Erase(found->second);
+	}
+
+	if (size > m_budget)
+		return;
+
+	m_items.push_front({ key, std::move(payload), size });
+	m_index.emplace(std::move(key), m_items.begin());
+	m_stats.bytes += size;
+	m_stats.count++;
+	Trim();
+}
+
+void AssetCache::SetBudget(uint64_t budget)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_budget = budget;
+	Trim();
+}
+
+uint64_t AssetCache::GetBudget() const noexcept
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_budget;
+}
+
+void AssetCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_items.clear();
+	m_index.clear();
+	m_stats.bytes = 0;
+	m_stats.count = 0;
+}
+
+AssetCache::Stats AssetCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+// The loader's key for the same asset.
+std::string AssetCache::MakeKey(uint32_t kind, std::filesystem::path const& path)
+{
+	return std::to_string(kind) + ':' + path.generic_string();
+}
+
+void AssetCache::Trim()
+{
+	while (m_stats.bytes > m_budget)
+	{
+		Erase(std::prev(m_items.end()));
+		m_stats.evictions++;
+	}
+}
+
+void AssetCache::Erase(std::list<Item>::iterator item)
+{
+	m_stats.bytes -= item->size;
+	m_stats.count--;
+	m_index.erase(item->key);
+	m_items.erase(item);
+}
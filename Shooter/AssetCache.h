@@ -0,0 +1,85 @@
+//
+// AssetCache.h - Keeps decoded asset payloads in memory, so recreating assets only uploads them again
+//
+
+#pragma once
+
+#include "AssetLoader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// A loader given a cache looks payloads up in it before decoding, and
+// keeps what it decodes there. Payloads hold CPU bytes and no device
+// objects, so they outlive the loader and device that made them: after
+// device loss, or on another adapter, a new loader finds them here and
+// only has to create its assets again. A cache's payloads must only go to
+// devices of the class that decoded them.
+//
+// The payloads' sizes are kept within a budget by dropping the least
+// recently used; one bigger than the whole budget isn't kept at all. A
+// payload the cache drops lives on while a loader still holds it.
+//
+// Safe to use from several threads at once.
+class AssetCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t bytes;
+		uint32_t count;
+	};
+
+	explicit AssetCache(uint64_t budget);
+
+	AssetCache(AssetCache const&) = delete;
+	AssetCache& operator= (AssetCache const&) = delete;
+
+	// The payload, now the most recently used, or null.
+	std::shared_ptr<IAssetPayload const> Find(uint32_t kind, std::filesystem::path const& path);
+
+	// Keeps the payload, in place of any already kept for the asset, and
+	// drops the least recently used others until the cache is within its
+	// budget again.
+	void Insert(uint32_t kind, std::filesystem::path const& path, std::shared_ptr<IAssetPayload const> payload);
+
+	// Drops payloads until those left fit.
+	void SetBudget(uint64_t budget);
+	uint64_t GetBudget() const noexcept;
+
+	void Clear();
+
+	Stats GetStats() const;
+
+private:
+	struct Item
+	{
+		std::string key;
+		std::shared_ptr<IAssetPayload const> payload;
+		size_t size;
+	};
+
+	static std::string MakeKey(uint32_t kind, std::filesystem::path const& path);
+
+	// With m_mutex held.
+	void Trim();
+	void Erase(std::list<Item>::iterator item);
+
+	uint64_t m_budget;
+
+	// Most recently used first, and each key's item in it
+	std::list<Item> m_items;
+	std::unordered_map<std::string, std::list<Item>::iterator> m_index;
+
+	mutable std::mutex m_mutex;
+	Stats m_stats;
+};
@@ -0,0 +1,326 @@
+//
+// AssetLoader.cpp
+//
+
+#include "AssetLoader.h"
+
+#include "AssetCache.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <stdexcept>
+
+namespace
+{
+	double Seconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+AssetLoader::AssetLoader(IAssetDevice& device, unsigned workerCount, AssetCache* cache) :
+	m_device(device),
+	m_cache(cache),
+	m_firstPending(0),
+	m_decodeCount(0),
+	m_stopping(false),
+	m_stats{}
+{
+	m_workers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; ++i)
+	{
+		m_workers.emplace_back([this]() { WorkerMain(); });
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t AssetLoader::Load(uint32_t kind, std::filesystem::path const& path, std::initializer_list<uint32_t> dependencies)
+{
+	const std::string key = std::to_string(kind) + ':' + path.generic_string();
+
+	uint32_t handle;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto const found = m_handles.find(key);
+		if (found != m_handles.end())
+			return found->second;
+
+		for (auto const dependency : dependencies)
+		{
+			if (dependency >= m_entries.size())
+				throw std::invalid_argument("Asset dependency isn't a handle from this loader");
+		}
+
+		handle = uint32_t(m_entries.size());
+		m_entries.push_back(std::make_unique<Entry>(Entry{ kind, path, dependencies, State::Queued, nullptr, nullptr, {} }));
+		m_handles.emplace(key, handle);
+		m_queue.push_back(handle);
+		m_stats.requested++;
+	}
+	m_wake.notify_one();
+	return handle;
+}
+
+void AssetLoader::SetPlaceholder(uint32_t kind, std::unique_ptr<IAsset> placeholder)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_placeholders[kind] = std::move(placeholder);
+}
+
+uint32_t AssetLoader::Update(uint32_t maxCreates)
+{
+	PROFILE_SCOPE("Asset loader update");
+
+	if (m_workers.empty())
+	{
+		for (;;)
+		{
+			uint32_t handle;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_queue.empty())
+					break;
+
+				handle = m_queue.front();
+				m_queue.pop_front();
+			}
+			Decode(handle);
+		}
+	}
+
+	// In request order, so an asset's dependencies have had their turn,
+	// and this frame's creations count for the assets after them.
+	uint32_t created = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (uint32_t handle = m_firstPending; handle < m_entries.size(); ++handle)
+	{
+		if (maxCreates != 0 && created == maxCreates)
+			break;
+
+		Entry& entry = *m_entries[handle];
+		if (entry.state != State::Decoded)
+			continue;
+
+		bool waiting = false;
+		const Entry* failed = nullptr;
+		for (auto const dependency : entry.dependencies)
+		{
+			auto const& other = *m_entries[dependency];
+			waiting = waiting || other.state != State::Ready;
+			failed = other.state == State::Failed ? &other : failed;
+		}
+
+		if (failed)
+		{
+			Fail(entry, "Depends on " + failed->path.string() + ", which failed");
+			continue;
+		}
+		if (waiting)
+			continue;
+
+		auto const payload = std::move(entry.payload);
+		lock.unlock();
+
+		std::unique_ptr<IAsset> asset;
+		std::string error;
+		auto const start = std::chrono::steady_clock::now();
+		try
+		{
+			PROFILE_SCOPE("Create asset");
+			asset = m_device.Create(entry.kind, *payload);
+		}
+		catch (std::exception const& e)
+		{
+			error = e.what();
+		}
+		catch (...)
+		{
+			error = "Unknown error";
+		}
+		const double createTime = Seconds(start);
+
+		lock.lock();
+		m_stats.createSeconds += createTime;
+		if (asset)
+		{
+			entry.asset = std::move(asset);
+			entry.state = State::Ready;
+			m_stats.ready++;
+			created++;
+		}
+		else
+		{
+			Fail(entry, error.empty() ? "Device created nothing" : error);
+		}
+	}
+
+	while (m_firstPending < m_entries.size()
+		&& (m_entries[m_firstPending]->state == State::Ready || m_entries[m_firstPending]->state == State::Failed))
+	{
+		m_firstPending++;
+	}
+	return created;
+}
+
+void AssetLoader::Finish()
+{
+	PROFILE_SCOPE("Asset loader finish");
+
+	for (;;)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		const uint64_t seen = m_decodeCount;
+		lock.unlock();
+
+		Update(0);
+
+		// Everything decoded by now has been created or is waiting on one
+		// still with a worker, so wait for the next to finish.
+		lock.lock();
+		if (m_firstPending == m_entries.size())
+			return;
+
+		m_decoded.wait(lock, [this, seen]() { return m_decodeCount != seen; });
+	}
+}
+
+IAsset* AssetLoader::Get(uint32_t handle) const noexcept
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (handle >= m_entries.size())
+		return nullptr;
+
+	auto const& entry = *m_entries[handle];
+	if (entry.state == State::Ready)
+		return entry.asset.get();
+
+	auto const placeholder = m_placeholders.find(entry.kind);
+	return placeholder != m_placeholders.end() ? placeholder->second.get() : nullptr;
+}
+
+AssetLoader::State AssetLoader::GetState(uint32_t handle) const noexcept
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return handle < m_entries.size() ? m_entries[handle]->state : State::Failed;
+}
+
+std::string AssetLoader::GetError(uint32_t handle) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return handle < m_entries.size() ? m_entries[handle]->error : "No such asset";
+}
+
+bool AssetLoader::IsIdle() const noexcept
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_firstPending == m_entries.size();
+}
+
+AssetLoader::Stats AssetLoader::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void AssetLoader::WorkerMain()
+{
+	Profiler::SetThreadName("Asset loader");
+
+	for (;;)
+	{
+		uint32_t handle;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+
+			if (m_stopping)
+				return;
+
+			handle = m_queue.front();
+			m_queue.pop_front();
+		}
+
+		Decode(handle);
+	}
+}
+
+void AssetLoader::Decode(uint32_t handle) noexcept
+{
+	Entry* entry;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		entry = m_entries[handle].get();
+	}
+
+	std::shared_ptr<IAssetPayload const> payload;
+	bool cached = false;
+	std::string error;
+	auto const start = std::chrono::steady_clock::now();
+	try
+	{
+		if (m_cache)
+		{
+			payload = m_cache->Find(entry->kind, entry->path);
+			cached = payload != nullptr;
+		}
+
+		if (!payload)
+		{
+			PROFILE_SCOPE("Decode asset");
+			payload = m_device.Decode(entry->kind, entry->path);
+			if (m_cache && payload)
+			{
+				m_cache->Insert(entry->kind, entry->path, payload);
+			}
+		}
+	}
+	catch (std::exception const& e)
+	{
+		error = e.what();
+	}
+	catch (...)
+	{
+		error = "Unknown error";
+	}
+	const double decodeTime = Seconds(start);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.decodeSeconds += decodeTime;
+		m_stats.cached += cached ? 1 : 0;
+		if (payload)
+		{
+			entry->payload = std::move(payload);
+			entry->state = State::Decoded;
+		}
+		else
+		{
+			Fail(*entry, error.empty() ? "Device decoded nothing" : std::move(error));
+		}
+		m_decodeCount++;
+	}
+	m_decoded.notify_all();
+}
+
+// With m_mutex held.
+void AssetLoader::Fail(Entry& entry, std::string error)
+{
+	entry.payload.reset();
+	entry.state = State::Failed;
+	entry.error = std::move(error);
+	m_stats.failed++;
+}
@@ -0,0 +1,169 @@
+//
+// AssetLoader.h - Decodes assets on worker threads and creates their GPU resources on the device thread
+//
+
+#pragma once
+
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// What a worker made of an asset's file, for the device to create it from.
+// A payload doesn't change once decoded, so an AssetCache can hand it to
+// the device again.
+class IAssetPayload
+{
+public:
+	virtual ~IAssetPayload() = default;
+
+	// The memory it owns, for an AssetCache's budget. Bytes it only points
+	// at, such as a mapped file's, don't count.
+	virtual size_t GetSize() const noexcept = 0;
+};
+
+// A created asset. The loader only owns it; users cast to the device's
+// concrete type to get at its resources.
+class IAsset
+{
+public:
+	virtual ~IAsset() = default;
+};
+
+class AssetCache;
+
+// Reads and creates the kinds of asset it defines; the loader passes the
+// kind through.
+class IAssetDevice
+{
+public:
+	virtual ~IAssetDevice() = default;
+
+	// Reads and decodes the file. Called on worker threads, several at
+	// once, so it mustn't touch the GPU. Throws if the file can't be used.
+	virtual std::unique_ptr<IAssetPayload> Decode(uint32_t kind, std::filesystem::path const& path) = 0;
+
+	// Called on the device thread, once the asset's dependencies have been
+	// created. Throws if the asset can't be created.
+	virtual std::unique_ptr<IAsset> Create(uint32_t kind, IAssetPayload const& payload) = 0;
+};
+
+// Load queues a file and returns a handle straight away. Workers decode
+// queued files in parallel, in the order they were asked for; Update, on
+// the device thread, creates the decoded ones once everything they depend
+// on has been, a few per frame. Until then, or if it fails, a handle
+// stands for its kind's placeholder.
+//
+// An asset can only depend on ones requested before it, so there are no
+// cycles and creating in request order always satisfies dependencies. An
+// asset whose dependency fails fails too.
+class AssetLoader
+{
+public:
+	enum class State : uint8_t
+	{
+		Queued,			// Waiting for or on a worker
+		Decoded,		// Waiting to be created
+		Ready,
+		Failed,
+	};
+
+	struct Stats
+	{
+		uint32_t requested;
+		uint32_t ready;
+		uint32_t failed;
+		uint32_t cached;			// Found in the cache instead of decoded
+		double decodeSeconds;		// Summed over the workers
+		double createSeconds;
+	};
+
+	// With no workers, files are decoded in Update on the device thread.
+	// With a cache, which must outlive the loader, payloads are looked up
+	// in it before they're decoded and kept in it after.
+	AssetLoader(IAssetDevice& device, unsigned workerCount, AssetCache* cache = nullptr);
+
+	// Stops the workers once they finish the files they're on; the rest
+	// are dropped.
+	~AssetLoader();
+
+	AssetLoader(AssetLoader const&) = delete;
+	AssetLoader& operator= (AssetLoader const&) = delete;
+
+	// Asking for the same kind and path again returns the first handle.
+	// Throws std::invalid_argument for a dependency that isn't a handle
+	// this loader returned.
+	uint32_t Load(uint32_t kind, std::filesystem::path const& path, std::initializer_list<uint32_t> dependencies = {});
+
+	// What handles of this kind stand for until their asset is ready; none
+	// by default.
+	void SetPlaceholder(uint32_t kind, std::unique_ptr<IAsset> placeholder);
+
+	// Device thread, once a frame. Creates up to maxCreates decoded assets,
+	// or every one that can be with 0, and returns how many it created.
+	uint32_t Update(uint32_t maxCreates);
+
+	// Device thread. Waits for and creates everything requested so far.
+	void Finish();
+
+	// The asset, or its kind's placeholder until it's ready.
+	IAsset* Get(uint32_t handle) const noexcept;
+
+	State GetState(uint32_t handle) const noexcept;
+	bool IsReady(uint32_t handle) const noexcept { return GetState(handle) == State::Ready; }
+
+	// Why the asset failed, or empty.
+	std::string GetError(uint32_t handle) const;
+
+	// Every asset requested so far is ready or failed.
+	bool IsIdle() const noexcept;
+
+	Stats GetStats() const;
+
+private:
+	struct Entry
+	{
+		uint32_t kind;
+		std::filesystem::path path;
+		std::vector<uint32_t> dependencies;
+		State state;
+		std::shared_ptr<IAssetPayload const> payload;
+		std::unique_ptr<IAsset> asset;
+		std::string error;
+	};
+
+	void WorkerMain();
+	void Decode(uint32_t handle) noexcept;
+	void Fail(Entry& entry, std::string error);
+
+	IAssetDevice& m_device;
+	AssetCache* m_cache;
+
+	// m_mutex guards the entries' states and payloads and the list's
+	// growth. An entry doesn't move once added, and its kind, path and
+	// dependencies don't change, so a worker reads those without the lock.
+	std::vector<std::unique_ptr<Entry>> m_entries;
+	std::unordered_map<std::string, uint32_t> m_handles;
+	std::unordered_map<uint32_t, std::unique_ptr<IAsset>> m_placeholders;
+
+	// Handles to decode, and the oldest handle that may still need creating
+	std::deque<uint32_t> m_queue;
+	uint32_t m_firstPending;
+
+	std::vector<std::thread> m_workers;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_decoded;
+	uint64_t m_decodeCount;
+	bool m_stopping;
+
+	Stats m_stats;
+};
@@ -0,0 +1,223 @@
+//
+// Benchmark.cpp
+//
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+
+using namespace Benchmark;
+
+namespace
+{
+	// Nearest-rank percentile of sorted samples.
+	double Percentile(std::vector<double> const& sorted, double percent) noexcept
+	{
+		const size_t rank = size_t(std::ceil(percent / 100.0 * double(sorted.size())));
+		return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+	}
+
+	// One leg of the scripted path.
+	struct Segment
+	{
+		double duration;
+		float moveX;		// Strafe, -1 right .. 1 left
+		float moveY;		// Forward, -1 back .. 1 forward
+		float turn;			// Right stick X
+		float look;			// Right stick Y
+		bool sprint;
+		bool aim;
+	};
+
+	// Loops around the middle of the room without leaving it.
+	const Segment c_script[] =
+	{
+		{ 2.0,  0.0f,  1.0f,  0.0f,  0.0f, false, false },	// Walk forward
+		{ 2.0,  0.0f,  0.0f,  0.6f,  0.0f, false, false },	// Turn in place
+		{ 2.0,  1.0f,  0.0f,  0.0f,  0.3f, false, false },	// Strafe while looking up
+		{ 2.0,  0.0f,  1.0f,  0.0f,  0.0f, true,  false },	// Sprint
+		{ 2.0,  0.0f,  0.0f, -0.8f, -0.3f, false, false },	// Turn back, look down
+		{ 2.0,  0.0f,  0.0f,  0.0f,  0.0f, false, true  },	// Aim down sights
+		{ 2.0, -1.0f,  0.0f,  0.3f,  0.0f, false, true  },	// Strafe while aiming
+		{ 2.0,  0.0f, -1.0f,  0.0f,  0.0f, false, false },	// Walk backward
+		{ 2.0,  0.0f,  1.0f,  0.5f,  0.0f, true,  false },	// Sprint around a corner
+		{ 2.0,  0.0f,  0.0f, -0.5f,  0.0f, false, false },	// Turn
+		{ 2.0,  0.0f, -1.0f,  0.0f,  0.0f, true,  false },	// Sprint back
+		{ 2.0,  0.0f,  0.0f,  0.2f,  0.0f, false, false },	// Settle
+	};
+
+	void WriteSummaryCsv(std::ostream& out, const char* name, Summary const& summary)
+	{
+		out << name << ',' << summary.average << ',' << summary.p50 << ',' << summary.p95
+			<< ',' << summary.p99 << ',' << summary.max << '\n';
+	}
+
+	void WriteSummaryJson(std::ostream& out, const char* name, Summary const& summary, bool last)
+	{
+		out << "    \"" << name << "\": { \"average\": " << summary.average
+			<< ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95
+			<< ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max
+			<< (last ? " }\n" : " },\n");
+	}
+}
+
+Summary Benchmark::Summarize(std::vector<double> samples)
+{
+	if (samples.empty())
+		return {};
+
+	std::sort(samples.begin(), samples.end());
+
+	Summary summary;
+	summary.average = std::accumulate(samples.begin(), samples.end(), 0.0) / double(samples.size());
+	summary.p50 = Percentile(samples, 50.0);
+	summary.p95 = Percentile(samples, 95.0);
+	summary.p99 = Percentile(samples, 99.0);
+	summary.max = samples.back();
+	return summary;
+}
+
+PlayerInput Benchmark::ScriptedInput(double time) noexcept
+{
+	double t = std::fmod(std::max(time, 0.0), ScriptLength);
+
+	const Segment* segment = &c_script[0];
+	for (auto const& s : c_script)
+	{
+		segment = &s;
+		if (t < s.duration)
+			break;
+		t -= s.duration;
+	}
+
+	// Drive the player through the gamepad path, it takes analog values.
+	PlayerInput input;
+	input.padConnected = true;
+	input.leftStickX = -segment->moveX;
+	input.leftStickY = segment->moveY;
+	input.rightStickX = segment->turn;
+	input.rightStickY = segment->look;
+	input.leftStickPressed = segment->sprint;
+	input.leftTrigger = segment->aim ? 1.0f : 0.0f;
+	return input;
+}
+
+void FrameTimings::Reserve(size_t frames)
+{
+	m_frame.reserve(frames);
+	m_update.reserve(frames);
+	m_render.reserve(frames);
+}
+
+void FrameTimings::AddFrame(double frameMs, double updateMs, double renderMs)
+{
+	m_frame.push_back(frameMs);
+	m_update.push_back(updateMs);
+	m_render.push_back(renderMs);
+}
+
+void FrameTimings::AddPassTime(const char* pass, double milliseconds)
+{
+	auto it = std::find_if(m_passes.begin(), m_passes.end(),
+		[pass](auto const& entry) { return entry.first == pass; });
+
+	if (it == m_passes.end())
+	{
+		m_passes.emplace_back(pass, std::vector<double>());
+		it = m_passes.end() - 1;
+		it->second.reserve(m_frame.capacity());
+	}
+
+	it->second.push_back(milliseconds);
+}
+
+void FrameTimings::WriteCsv(std::ostream& out) const
+{
+	out << "metric,average_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+	WriteSummaryCsv(out, "frame", GetFrameSummary());
+	WriteSummaryCsv(out, "update", GetUpdateSummary());
+	WriteSummaryCsv(out, "render", GetRenderSummary());
+
+	for (auto const& pass : m_passes)
+	{
+		WriteSummaryCsv(out, ("gpu_" + pass.first).c_str(), Summarize(pass.second));
+	}
+}
+
+void FrameTimings::WriteJson(std::ostream& out, double durationSeconds) const
+{
+	out << "{\n";
+	out << "  \"frames\": " << GetFrameCount() << ",\n";
+	out << "  \"duration_s\": " << durationSeconds << ",\n";
+	out << "  \"timings_ms\": {\n";
+	WriteSummaryJson(out, "frame", GetFrameSummary(), false);
+	WriteSummaryJson(out, "update", GetUpdateSummary(), false);
+	WriteSummaryJson(out, "render", GetRenderSummary(), true);
+	out << (m_passes.empty() ? "  }\n" : "  },\n");
+
+	if (!m_passes.empty())
+	{
+		out << "  \"gpu_passes_ms\": {\n";
+		for (size_t i = 0; i < m_passes.size(); ++i)
+		{
+			WriteSummaryJson(out, m_passes[i].first.c_str(), Summarize(m_passes[i].second), i + 1 == m_passes.size());
+		}
+		out << "  }\n";
+	}
+
+	out << "}\n";
+}
+
+void FrameTimings::WriteReport(std::filesystem::path const& path, double durationSeconds) const
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+	{
+		throw std::runtime_error("Failed to create benchmark report");
+	}
+
+	if (path.extension() == ".json")
+	{
+		WriteJson(file, durationSeconds);
+	}
+	else
+	{
+		WriteCsv(file);
+	}
+}
+
+Session::Session(double durationSeconds, std::filesystem::path reportPath) :
+	m_duration(durationSeconds),
+	m_time(0.0),
+	m_reportPath(std::move(reportPath))
+{
+	// Room for a 240 Hz run so recording never allocates mid-benchmark.
+	m_timings.Reserve(size_t(durationSeconds * 240.0) + 1);
+}
+
+PlayerInput Session::NextInput(double elapsedSeconds) noexcept
+{
+	const PlayerInput input = ScriptedInput(m_time);
+	m_time += elapsedSeconds;
+	return input;
+}
+
+void Session::AddFrame(double frameMs, double updateMs, double renderMs)
+{
+	m_timings.AddFrame(frameMs, updateMs, renderMs);
+}
+
+void Session::AddPassTime(const char* pass, double milliseconds)
+{
+	m_timings.AddPassTime(pass, milliseconds);
+}
+
+void Session::WriteReport() const
+{
+	m_timings.WriteReport(m_reportPath, m_time);
+}
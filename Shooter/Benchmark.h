@@ -0,0 +1,91 @@
+//
+// Benchmark.h - Scripted benchmark runs and frame time reports
+//
+
+#pragma once
+
+#include "PlayerSimulation.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Benchmark
+{
+	// Distribution of a set of timings, in milliseconds.
+	struct Summary
+	{
+		double average;
+		double p50;
+		double p95;
+		double p99;
+		double max;
+	};
+
+	Summary Summarize(std::vector<double> samples);
+
+	// Input that walks, turns, sprints and aims through the room on a fixed
+	// loop. Only depends on simulated time, so every run takes the same path.
+	PlayerInput ScriptedInput(double time) noexcept;
+
+	// Length of one loop of the script in seconds.
+	constexpr double ScriptLength = 24.0;
+
+	// Collects per-frame timings and writes them out as a report.
+	class FrameTimings
+	{
+	public:
+		void Reserve(size_t frames);
+		void AddFrame(double frameMs, double updateMs, double renderMs);
+
+		// GPU time of one render pass. Passes are reported in the order first seen.
+		void AddPassTime(const char* pass, double milliseconds);
+
+		size_t GetFrameCount() const noexcept { return m_frame.size(); }
+
+		Summary GetFrameSummary() const { return Summarize(m_frame); }
+		Summary GetUpdateSummary() const { return Summarize(m_update); }
+		Summary GetRenderSummary() const { return Summarize(m_render); }
+
+		void WriteCsv(std::ostream& out) const;
+		void WriteJson(std::ostream& out, double durationSeconds) const;
+
+		// Writes JSON for a .json path and CSV otherwise.
+		void WriteReport(std::filesystem::path const& path, double durationSeconds) const;
+
+	private:
+		std::vector<double> m_frame;
+		std::vector<double> m_update;
+		std::vector<double> m_render;
+		std::vector<std::pair<std::string, std::vector<double>>> m_passes;
+	};
+
+	// A benchmark in progress: drives the script and records every frame
+	// until the requested amount of simulated time has passed.
+	class Session
+	{
+	public:
+		Session(double durationSeconds, std::filesystem::path reportPath);
+
+		// Input for the next simulation step of the given length.
+		PlayerInput NextInput(double elapsedSeconds) noexcept;
+
+		void AddFrame(double frameMs, double updateMs, double renderMs);
+		void AddPassTime(const char* pass, double milliseconds);
+
+		bool IsComplete() const noexcept { return m_time >= m_duration; }
+
+		void WriteReport() const;
+
+		FrameTimings const& GetTimings() const noexcept { return m_timings; }
+
+	private:
+		double m_duration;
+		double m_time;
+		std::filesystem::path m_reportPath;
+		FrameTimings m_timings;
+	};
+}
@@ -0,0 +1,304 @@
+//
+// CmoReader.cpp
+//
+
+#include "CmoReader.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace Cmo;
+
+namespace
+{
+	// Walks the file front to back; every read checks it fits first.
+	class Cursor
+	{
+	public:
+		Cursor(const uint8_t* data, size_t size) noexcept : m_data(data), m_size(size), m_offset(0) {}
+
+		[[noreturn]] void Fail(const char* what) const
+		{
+			throw std::runtime_error(std::string("Invalid CMO file: ") + what + " at offset " + std::to_string(m_offset));
+		}
+
+		const uint8_t* Take(uint64_t bytes, const char* what)
+		{
+			if (bytes > m_size - m_offset)
+				Fail(what);
+
+			const uint8_t* data = m_data + m_offset;
+			m_offset += size_t(bytes);
+			return data;
+		}
+
+		uint32_t ReadUInt32(const char* what)
+		{
+			const uint8_t* bytes = Take(4, what);
+			return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+		}
+
+		template<typename T>
+		T Read(const char* what)
+		{
+			T value;
+			std::memcpy(&value, Take(sizeof(T), what), sizeof(T));
+			return value;
+		}
+
+		template<typename T>
+		ArrayView<T> ReadArray(uint64_t count, const char* what)
+		{
+			// Counts are 32-bit and records small, so this can't overflow.
+			return ArrayView<T>(Take(count * sizeof(T), what), size_t(count));
+		}
+
+		template<typename T>
+		ArrayView<T> ReadCountedArray(const char* what)
+		{
+			const uint32_t count = ReadUInt32(what);
+			return ReadArray<T>(count, what);
+		}
+
+		StringView ReadString(const char* what)
+		{
+			const uint32_t length = ReadUInt32(what);
+			const uint8_t* data = Take(uint64_t(length) * 2, what);
+
+			// The exporter counts the terminator; leave it out of the view.
+			size_t visible = length;
+			if (visible > 0 && data[visible * 2 - 2] == 0 && data[visible * 2 - 1] == 0)
+			{
+				visible--;
+			}
+			return StringView(data, visible);
+		}
+
+		// A count of records that each take at least minBytes, checked
+		// before anything is reserved for them.
+		uint32_t ReadCount(size_t minBytes, const char* what)
+		{
+			const uint32_t count = ReadUInt32(what);
+			if (uint64_t(count) * minBytes > m_size - m_offset)
+				Fail(what);
+			return count;
+		}
+
+		bool AtEnd() const noexcept { return m_offset == m_size; }
+
+	private:
+		const uint8_t* m_data;
+		size_t m_size;
+		size_t m_offset;
+	};
+}
+
+std::u16string StringView::ToUtf16() const
+{
+	std::u16string text(m_length, u'\0');
+	for (size_t i = 0; i < m_length; ++i)
+	{
+		text[i] = (*this)[i];
+	}
+	return text;
+}
+
+std::string StringView::ToUtf8() const
+{
+	std::string text;
+	text.reserve(m_length);
+
+	for (size_t i = 0; i < m_length; ++i)
+	{
+		uint32_t code = (*this)[i];
+
+		// Pair up surrogates; a lone one becomes U+FFFD.
+		if (code >= 0xD800 && code < 0xDC00 && i + 1 < m_length && (*this)[i + 1] >= 0xDC00 && (*this)[i + 1] < 0xE000)
+		{
+			code = 0x10000 + ((code - 0xD800) << 10) + ((*this)[++i] - 0xDC00);
+		}
+		else if (code >= 0xD800 && code < 0xE000)
+		{
+			code = 0xFFFD;
+		}
+
+		if (code < 0x80)
+		{
+			text += char(code);
+		}
+		else if (code < 0x800)
+		{
+			text += char(0xC0 | (code >> 6));
+			text += char(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			text += char(0xE0 | (code >> 12));
+			text += char(0x80 | ((code >> 6) & 0x3F));
+			text += char(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			text += char(0xF0 | (code >> 18));
+			text += char(0x80 | ((code >> 12) & 0x3F));
+			text += char(0x80 | ((code >> 6) & 0x3F));
+			text += char(0x80 | (code & 0x3F));
+		}
+	}
+	return text;
+}
+
+bool StringView::Equals(const char* ascii) const noexcept
+{
+	size_t i = 0;
+	for (; i < m_length; ++i)
+	{
+		if (ascii[i] == '\0' || (*this)[i] != char16_t(static_cast<unsigned char>(ascii[i])))
+			return false;
+	}
+	return ascii[i] == '\0';
+}
+
+File::File(std::filesystem::path const& path) :
+	m_file(std::in_place, path),
+	m_data(m_file->GetData()),
+	m_size(m_file->GetSize())
+{
+	Parse();
+}
+
+File::File(const uint8_t* data, size_t size) :
+	m_data(data),
+	m_size(size)
+{
+	Parse();
+}
+
+void File::Parse()
+{
+	Cursor cursor(m_data, m_size);
+
+	// Smallest possible mesh: empty name, no materials, the skeleton flag,
+	// four empty counts and the extents.
+	constexpr size_t MinMeshBytes = 4 + 4 + 1 + 4 * 4 + sizeof(MeshExtents);
+
+	const uint32_t meshCount = cursor.ReadCount(MinMeshBytes, "mesh count");
+	if (meshCount == 0)
+		cursor.Fail("no meshes");
+
+	m_meshes.resize(meshCount);
+	for (auto& mesh : m_meshes)
+	{
+		mesh.name = cursor.ReadString("mesh name");
+
+		// Each material has at least its name, constants, shader and texture names.
+		mesh.materials.resize(cursor.ReadCount(4 + sizeof(MaterialConstants) + 4 + 4 * MaxTextures, "material count"));
+		for (auto& material : mesh.materials)
+		{
+			material.name = cursor.ReadString("material name");
+			material.constants = cursor.ReadArray<MaterialConstants>(1, "material");
+			material.pixelShader = cursor.ReadString("pixel shader name");
+			for (auto& texture : material.textures)
+			{
+				texture = cursor.ReadString("texture name");
+			}
+		}
+
+		const uint8_t skeleton = cursor.Read<uint8_t>("skeleton flag");
+		if (skeleton > 1)
+			cursor.Fail("skeleton flag");
+		mesh.hasSkeleton = skeleton != 0;
+
+		mesh.submeshes = cursor.ReadCountedArray<SubMesh>("submeshes");
+
+		mesh.indexBuffers.resize(cursor.ReadCount(4, "index buffer count"));
+		for (auto& indices : mesh.indexBuffers)
+		{
+			indices = cursor.ReadCountedArray<uint16_t>("index buffer");
+		}
+
+		mesh.vertexBuffers.resize(cursor.ReadCount(4, "vertex buffer count"));
+		for (auto& vertices : mesh.vertexBuffers)
+		{
+			vertices = cursor.ReadCountedArray<Vertex>("vertex buffer");
+		}
+
+		mesh.skinningVertexBuffers.resize(cursor.ReadCount(4, "skinning vertex buffer count"));
+		for (auto& vertices : mesh.skinningVertexBuffers)
+		{
+			vertices = cursor.ReadCountedArray<SkinningVertex>("skinning vertex buffer");
+		}
+
+		// Skinning streams run alongside the vertex buffers.
+		if (!mesh.skinningVertexBuffers.empty())
+		{
+			if (mesh.skinningVertexBuffers.size() != mesh.vertexBuffers.size())
+				cursor.Fail("skinning vertex buffer count");
+
+			for (size_t i = 0; i < mesh.vertexBuffers.size(); ++i)
+			{
+				if (mesh.skinningVertexBuffers[i].GetCount() != mesh.vertexBuffers[i].GetCount())
+					cursor.Fail("skinning vertex buffer size");
+			}
+		}
+
+		mesh.extents = cursor.Read<MeshExtents>("extents");
+
+		if (mesh.hasSkeleton)
+		{
+			mesh.bones.resize(cursor.ReadCount(4 + sizeof(BoneTransforms), "bone count"));
+			for (auto& bone : mesh.bones)
+			{
+				bone.name = cursor.ReadString("bone name");
+				bone.transforms = cursor.ReadArray<BoneTransforms>(1, "bone");
+
+				const int32_t parent = bone.transforms[0].parentIndex;
+				if (parent < -1 || parent >= int64_t(mesh.bones.size()))
+					cursor.Fail("bone parent");
+			}
+
+			mesh.clips.resize(cursor.ReadCount(4 + 12, "clip count"));
+			for (auto& clip : mesh.clips)
+			{
+				clip.name = cursor.ReadString("clip name");
+				clip.startTime = cursor.Read<float>("clip start");
+				clip.endTime = cursor.Read<float>("clip end");
+				clip.keyframes = cursor.ReadCountedArray<Keyframe>("keyframes");
+
+				for (size_t i = 0; i < clip.keyframes.GetCount(); ++i)
+				{
+					if (clip.keyframes[i].boneIndex >= mesh.bones.size())
+						cursor.Fail("keyframe bone");
+				}
+			}
+		}
+
+		// Submeshes last, once everything they point at is known. A mesh
+		// without materials is drawn with a default one, as DirectXTK does.
+		const size_t materialCount = std::max<size_t>(mesh.materials.size(), 1);
+		for (size_t i = 0; i < mesh.submeshes.GetCount(); ++i)
+		{
+			const SubMesh submesh = mesh.submeshes[i];
+			if (submesh.materialIndex >= materialCount)
+				cursor.Fail("submesh material");
+
+			if (submesh.indexBufferIndex >= mesh.indexBuffers.size() || submesh.vertexBufferIndex >= mesh.vertexBuffers.size())
+				cursor.Fail("submesh buffer");
+
+			auto const& indices = mesh.indexBuffers[submesh.indexBufferIndex];
+			if (uint64_t(submesh.startIndex) + uint64_t(submesh.primCount) * 3 > indices.GetCount())
+				cursor.Fail("submesh index range");
+
+			const size_t vertexCount = mesh.vertexBuffers[submesh.vertexBufferIndex].GetCount();
+			const size_t end = size_t(submesh.startIndex) + size_t(submesh.primCount) * 3;
+			for (size_t index = submesh.startIndex; index < end; ++index)
+			{
+				if (indices[index] >= vertexCount)
+					cursor.Fail("submesh index");
+			}
+		}
+	}
+
+	if (!cursor.AtEnd())
+		cursor.Fail("trailing data");
+}
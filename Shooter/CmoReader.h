@@ -0,0 +1,223 @@
+//
+// CmoReader.h - Validated, zero-copy views over Visual Studio CMO model files
+//
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// CMO files are what the Visual Studio model exporter writes and what
+// DirectXTK's Model::CreateFromCMO reads: a mesh count, then per mesh its
+// name, materials, submeshes, 16-bit index buffers, vertex buffers,
+// skinning streams, extents and optionally a skeleton with animation clips.
+// Everything is little-endian and tightly packed; strings are UTF-16 with
+// a length prefix that counts their terminator.
+//
+// The reader checks every count against the bytes left, every submesh and
+// keyframe against what it refers to and every index against its vertex
+// buffer, then hands out views into the file's bytes. Only a few scalars
+// are copied out, so vertex and index views can go straight to an upload.
+// The records sit at whatever offset the strings before them leave, so
+// views read elements with memcpy rather than through typed pointers.
+namespace Cmo
+{
+	constexpr uint32_t MaxTextures = 8;
+
+	// VertexPositionNormalTangentColorTexture
+	struct Vertex
+	{
+		float position[3];
+		float normal[3];
+		float tangent[4];
+		uint32_t color;
+		float textureCoordinate[2];
+	};
+
+	struct SkinningVertex
+	{
+		uint32_t boneIndex[4];
+		float boneWeight[4];
+	};
+
+	struct SubMesh
+	{
+		uint32_t materialIndex;
+		uint32_t indexBufferIndex;
+		uint32_t vertexBufferIndex;
+		uint32_t startIndex;
+		uint32_t primCount;			// Triangles
+	};
+
+	struct MaterialConstants
+	{
+		float ambient[4];
+		float diffuse[4];
+		float specular[4];
+		float specularPower;
+		float emissive[4];
+		float uvTransform[16];
+	};
+
+	struct MeshExtents
+	{
+		float center[3];
+		float radius;
+		float min[3];
+		float max[3];
+	};
+
+	struct BoneTransforms
+	{
+		int32_t parentIndex;		// -1 for a root
+		float invBindPos[16];
+		float bindPos[16];
+		float localTransform[16];
+	};
+
+	struct Keyframe
+	{
+		uint32_t boneIndex;
+		float time;
+		float transform[16];
+	};
+
+	static_assert(sizeof(Vertex) == 52 && sizeof(SkinningVertex) == 32 && sizeof(SubMesh) == 20
+		&& sizeof(MaterialConstants) == 132 && sizeof(MeshExtents) == 40 && sizeof(BoneTransforms) == 196
+		&& sizeof(Keyframe) == 72, "CMO records must match the file layout");
+
+	// A run of records of type T, read in place.
+	template<typename T>
+	class ArrayView
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Views read records bytewise");
+
+	public:
+		ArrayView() noexcept : m_data(nullptr), m_count(0) {}
+		ArrayView(const uint8_t* data, size_t count) noexcept : m_data(data), m_count(count) {}
+
+		size_t GetCount() const noexcept { return m_count; }
+		bool IsEmpty() const noexcept { return m_count == 0; }
+
+		T operator[] (size_t index) const noexcept
+		{
+			T value;
+			std::memcpy(&value, m_data + index * sizeof(T), sizeof(T));
+			return value;
+		}
+
+		const uint8_t* GetBytes() const noexcept { return m_data; }
+		size_t GetByteSize() const noexcept { return m_count * sizeof(T); }
+
+	private:
+		const uint8_t* m_data;
+		size_t m_count;
+	};
+
+	// UTF-16LE code units, without the terminator.
+	class StringView
+	{
+	public:
+		StringView() noexcept : m_data(nullptr), m_length(0) {}
+		StringView(const uint8_t* data, size_t length) noexcept : m_data(data), m_length(length) {}
+
+		size_t GetLength() const noexcept { return m_length; }
+		bool IsEmpty() const noexcept { return m_length == 0; }
+
+		char16_t operator[] (size_t index) const noexcept
+		{
+			return char16_t(m_data[index * 2] | (m_data[index * 2 + 1] << 8));
+		}
+
+		std::u16string ToUtf16() const;
+		std::string ToUtf8() const;
+
+		// Compares with an ASCII string.
+		bool Equals(const char* ascii) const noexcept;
+
+	private:
+		const uint8_t* m_data;
+		size_t m_length;
+	};
+
+	struct Material
+	{
+		StringView name;
+		ArrayView<MaterialConstants> constants;		// One record
+		StringView pixelShader;
+		StringView textures[MaxTextures];
+	};
+
+	struct Bone
+	{
+		StringView name;
+		ArrayView<BoneTransforms> transforms;		// One record
+	};
+
+	struct Clip
+	{
+		StringView name;
+		float startTime;
+		float endTime;
+		ArrayView<Keyframe> keyframes;
+	};
+
+	struct Mesh
+	{
+		StringView name;
+		std::vector<Material> materials;
+		ArrayView<SubMesh> submeshes;
+		std::vector<ArrayView<uint16_t>> indexBuffers;
+		std::vector<ArrayView<Vertex>> vertexBuffers;
+
+		// Empty, or one per vertex buffer with as many vertices
+		std::vector<ArrayView<SkinningVertex>> skinningVertexBuffers;
+
+		MeshExtents extents;
+
+		bool hasSkeleton;
+		std::vector<Bone> bones;
+		std::vector<Clip> clips;
+	};
+
+	// The views point into the file's bytes, so they're valid as long as
+	// the File is, or the caller's buffer for a File made from memory.
+	class File
+	{
+	public:
+		// Maps and parses the file. Throws std::runtime_error if it can't be
+		// read or isn't a valid CMO file.
+		explicit File(std::filesystem::path const& path);
+
+		// Parses bytes the caller keeps alive. Throws std::runtime_error if
+		// they aren't a valid CMO file.
+		File(const uint8_t* data, size_t size);
+
+		File(File&&) = default;
+		File& operator= (File&&) = default;
+
+		File(File const&) = delete;
+		File& operator= (File const&) = delete;
+
+		std::vector<Mesh> const& GetMeshes() const noexcept { return m_meshes; }
+
+		const uint8_t* GetData() const noexcept { return m_data; }
+		size_t GetSize() const noexcept { return m_size; }
+
+	private:
+		void Parse();
+
+		std::optional<MappedFile> m_file;
+		const uint8_t* m_data;
+		size_t m_size;
+		std::vector<Mesh> m_meshes;
+	};
+}
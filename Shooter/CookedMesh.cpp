@@ -0,0 +1,159 @@
+//
+// CookedMesh.cpp
+//
+
+#include "CookedMesh.h"
+
+#include <stdexcept>
+#include <string>
+
+using namespace CookedMesh;
+
+namespace
+{
+	[[noreturn]] void Fail(const char* what)
+	{
+		throw std::runtime_error(std::string("Invalid cooked mesh: ") + what);
+	}
+
+	// Sections come in file order, so each must start past the end of the
+	// one before it.
+	class SectionChecker
+	{
+	public:
+		explicit SectionChecker(size_t size) noexcept : m_size(size), m_end(sizeof(Header)) {}
+
+		void Check(uint32_t offset, uint64_t bytes, const char* what)
+		{
+			if (offset % SectionAlignment != 0 || offset < m_end || bytes > m_size - offset)
+				Fail(what);
+			m_end = offset + bytes;
+		}
+
+	private:
+		size_t m_size;
+		uint64_t m_end;
+	};
+}
+
+uint32_t CookedMesh::GetVertexStride(VertexFormat format) noexcept
+{
+	switch (format)
+	{
+	case VertexFormat::PositionNormalTangentColorTexture:
+		return 52;
+	case VertexFormat::Quantized:
+		return sizeof(QuantizedVertex);
+	default:
+		return 0;
+	}
+}
+
+File::File(std::filesystem::path const& path) :
+	m_file(std::in_place, path),
+	m_data(m_file->GetData()),
+	m_size(m_file->GetSize())
+{
+	Validate();
+}
+
+File::File(const uint8_t* data, size_t size) :
+	m_data(data),
+	m_size(size)
+{
+	Validate();
+}
+
+const char* File::GetString(String string) const noexcept
+{
+	return string == NoString ? nullptr : m_strings + string;
+}
+
+// Checks the header and the tables, which are small. The streams aren't
+// looked at: the cooker checked every index when it wrote them, and
+// reading them here would be the per-vertex pass cooking is there to
+// remove. A damaged index can only reach another vertex in the same
+// buffer, as Direct3D bounds vertex fetches.
+void File::Validate()
+{
+	if (m_size < sizeof(Header))
+		Fail("header");
+
+	if (reinterpret_cast<uintptr_t>(m_data) % SectionAlignment != 0)
+		Fail("misaligned data");
+
+	m_header = reinterpret_cast<const Header*>(m_data);
+	Header const& header = *m_header;
+
+	if (header.magic != Magic)
+		Fail("not a cooked mesh");
+	if (header.version != Version)
+		Fail(("version " + std::to_string(header.version) + ", expected " + std::to_string(Version) + "; cook it again").c_str());
+	if (header.fileSize != m_size)
+		Fail("file size");
+
+	const uint32_t stride = GetVertexStride(header.vertexFormat);
+	if (stride == 0 || header.vertexStride != stride)
+		Fail("vertex format");
+
+	SectionChecker sections(m_size);
+	sections.Check(header.meshOffset, uint64_t(header.meshCount) * sizeof(Mesh), "mesh table");
+	sections.Check(header.partOffset, uint64_t(header.partCount) * sizeof(Part), "part table");
+	sections.Check(header.materialOffset, uint64_t(header.materialCount) * sizeof(Material), "material table");
+
+	// The strings run up to the vertices, padding included. Ending on a NUL
+	// means every offset inside the section reaches a terminator.
+	if (header.stringOffset > header.vertexOffset)
+		Fail("string section");
+	const uint32_t stringSize = header.vertexOffset - header.stringOffset;
+	sections.Check(header.stringOffset, stringSize, "string section");
+	if (stringSize > 0 && m_data[header.vertexOffset - 1] != 0)
+		Fail("string section");
+
+	sections.Check(header.vertexOffset, uint64_t(header.vertexCount) * stride, "vertex stream");
+	sections.Check(header.indexOffset, uint64_t(header.indexCount) * sizeof(uint16_t), "index stream");
+
+	m_meshes = reinterpret_cast<const Mesh*>(m_data + header.meshOffset);
+	m_parts = reinterpret_cast<const Part*>(m_data + header.partOffset);
+	m_materials = reinterpret_cast<const Material*>(m_data + header.materialOffset);
+	m_strings = reinterpret_cast<const char*>(m_data + header.stringOffset);
+	m_indices = reinterpret_cast<const uint16_t*>(m_data + header.indexOffset);
+
+	auto const checkString = [&](String string, const char* what)
+	{
+		if (string != NoString && string >= stringSize)
+			Fail(what);
+	};
+
+	if (header.meshCount == 0)
+		Fail("no meshes");
+
+	for (uint32_t i = 0; i < header.meshCount; ++i)
+	{
+		Mesh const& mesh = m_meshes[i];
+		checkString(mesh.name, "mesh name");
+		if (uint64_t(mesh.firstPart) + mesh.partCount > header.partCount)
+			Fail("mesh parts");
+	}
+
+	for (uint32_t i = 0; i < header.partCount; ++i)
+	{
+		Part const& part = m_parts[i];
+		if (part.material >= header.materialCount)
+			Fail("part material");
+		if (part.indexCount % 3 != 0 || uint64_t(part.startIndex) + part.indexCount > header.indexCount)
+			Fail("part index range");
+		if (part.indexCount > 0 && part.baseVertex >= header.vertexCount)
+			Fail("part base vertex");
+	}
+
+	for (uint32_t i = 0; i < header.materialCount; ++i)
+	{
+		Material const& material = m_materials[i];
+		checkString(material.name, "material name");
+		for (String texture : material.textures)
+		{
+			checkString(texture, "texture name");
+		}
+	}
+}
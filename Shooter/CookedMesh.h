@@ -0,0 +1,191 @@
+//
+// CookedMesh.h - GPU-ready mesh files written by the offline cooker
+//
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+// A cooked mesh file holds everything the game needs to draw a model, laid
+// out the way it's uploaded: one vertex stream, one stream of 16-bit
+// indices, and small tables of meshes, parts and materials describing the
+// draws. The cooker does all the per-vertex work a model loader would, so
+// loading is mapping or reading the file in one go and pointing the upload
+// at the two streams.
+//
+// Every section starts on a SectionAlignment boundary and the tables are
+// arrays of fixed-size little-endian records, so a file in memory aligned
+// to that boundary (a mapping always is) can be read through typed
+// pointers. Strings are UTF-8 and NUL-terminated, in one section at the end
+// of the tables.
+//
+// The version is bumped whenever the layout changes; older files are
+// rejected rather than converted, and have to be cooked again.
+namespace CookedMesh
+{
+	constexpr uint32_t Magic = 0x48534D43;		// "CMSH"
+	constexpr uint32_t Version = 2;
+	constexpr uint32_t SectionAlignment = 16;
+	constexpr uint32_t NoString = ~0u;
+
+	enum class VertexFormat : uint32_t
+	{
+		// VertexPositionNormalTangentColorTexture, what CMO models use
+		PositionNormalTangentColorTexture = 1,
+
+		// QuantizedVertex
+		Quantized = 2,
+	};
+
+	// 24 bytes instead of 52, in formats feature level 9_3 can fetch:
+	// - position: SNORM16 within the mesh's bounds, decoded as
+	//   positionOffset + position * positionScale; w is the sign of the
+	//   tangent's handedness
+	// - normal and tangent: SNORM16 octahedral encodings of unit vectors
+	// - color: RGBA8 as before
+	// - texture coordinate: half floats
+	struct QuantizedVertex
+	{
+		int16_t position[4];
+		int16_t normal[2];
+		int16_t tangent[2];
+		uint32_t color;
+		uint16_t textureCoordinate[2];
+	};
+
+	// Bytes per vertex of a format, or 0 for one this build doesn't know.
+	uint32_t GetVertexStride(VertexFormat format) noexcept;
+
+	// Offsets are from the start of the file and sizes in bytes.
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t fileSize;
+		VertexFormat vertexFormat;
+		uint32_t vertexStride;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t meshCount;
+		uint32_t partCount;
+		uint32_t materialCount;
+		uint32_t meshOffset;
+		uint32_t partOffset;
+		uint32_t materialOffset;
+		uint32_t stringOffset;
+		uint32_t vertexOffset;
+		uint32_t indexOffset;
+	};
+
+	// A name in the string section: the offset of its first byte from the
+	// section's start, or NoString.
+	using String = uint32_t;
+
+	// Parts [firstPart, firstPart + partCount) of the part table. Positions
+	// stored as floats have an offset of 0 and a scale of 1.
+	struct Mesh
+	{
+		String name;
+		uint32_t firstPart;
+		uint32_t partCount;
+		float center[3];
+		float radius;
+		float min[3];
+		float max[3];
+		float positionOffset[3];
+		float positionScale[3];
+	};
+
+	// One draw: indexCount indices from startIndex, relative to baseVertex.
+	struct Part
+	{
+		uint32_t material;
+		uint32_t startIndex;
+		uint32_t indexCount;
+		uint32_t baseVertex;
+	};
+
+	enum TextureSlot : uint32_t
+	{
+		TextureDiffuse,
+		TextureSpecular,
+		TextureNormal,
+		TextureEmissive,
+		TextureSlotCount
+	};
+
+	struct Material
+	{
+		String name;
+		float ambient[3];
+		float diffuse[3];
+		float specular[3];
+		float emissive[3];
+		float alpha;
+		float specularPower;
+		String textures[TextureSlotCount];
+	};
+
+	static_assert(sizeof(Header) == 64 && sizeof(Mesh) == 76 && sizeof(Part) == 16 && sizeof(Material) == 76
+		&& sizeof(QuantizedVertex) == 24,
+		"Cooked mesh records must match the file layout");
+
+	// The views point into the file's bytes, so they're valid as long as
+	// the File is, or the caller's buffer for a File made from memory.
+	class File
+	{
+	public:
+		// Maps and checks the file. Throws std::runtime_error if it can't be
+		// read or isn't a cooked mesh of this version.
+		explicit File(std::filesystem::path const& path);
+
+		// Checks bytes the caller keeps alive, which must start on a
+		// SectionAlignment boundary. Throws std::runtime_error if they
+		// aren't a cooked mesh of this version.
+		File(const uint8_t* data, size_t size);
+
+		File(File&&) = default;
+		File& operator= (File&&) = default;
+
+		File(File const&) = delete;
+		File& operator= (File const&) = delete;
+
+		Header const& GetHeader() const noexcept { return *m_header; }
+
+		uint32_t GetMeshCount() const noexcept { return m_header->meshCount; }
+		uint32_t GetPartCount() const noexcept { return m_header->partCount; }
+		uint32_t GetMaterialCount() const noexcept { return m_header->materialCount; }
+
+		Mesh const& GetMesh(uint32_t index) const noexcept { return m_meshes[index]; }
+		Part const& GetPart(uint32_t index) const noexcept { return m_parts[index]; }
+		Material const& GetMaterial(uint32_t index) const noexcept { return m_materials[index]; }
+
+		// The string, or nullptr for NoString.
+		const char* GetString(String string) const noexcept;
+
+		const uint8_t* GetVertices() const noexcept { return m_data + m_header->vertexOffset; }
+		const uint16_t* GetIndices() const noexcept { return m_indices; }
+
+		const uint8_t* GetData() const noexcept { return m_data; }
+		size_t GetSize() const noexcept { return m_size; }
+
+	private:
+		void Validate();
+
+		std::optional<MappedFile> m_file;
+		const uint8_t* m_data;
+		size_t m_size;
+
+		const Header* m_header;
+		const Mesh* m_meshes;
+		const Part* m_parts;
+		const Material* m_materials;
+		const char* m_strings;
+		const uint16_t* m_indices;
+	};
+}
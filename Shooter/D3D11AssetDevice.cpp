@@ -0,0 +1,213 @@
+//
+// D3D11AssetDevice.cpp
+//
+
+#include "pch.h"
+#include "D3D11AssetDevice.h"
+#include "D3D11CookedModel.h"
+#include "CookedMesh.h"
+#include "MappedFile.h"
+
+using namespace DirectX;
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // An asset file's bytes: its uncompressed entry in the archive, its loose
+    // file mapped, or a compressed entry decoded into a buffer. Buffers come
+    // from operator new, which aligns them enough for a cooked mesh.
+    struct AssetBytes
+    {
+        static_assert(__STDCPP_DEFAULT_NEW_ALIGNMENT__ >= CookedMesh::SectionAlignment,
+            "Decoded cooked meshes must be aligned for parsing in place");
+
+        std::optional<MappedFile> file;
+        std::vector<uint8_t> buffer;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        // Only a decoded buffer is memory of the payload's own. Mapped bytes
+        // are the file's pages, which the system can drop and read again.
+        size_t GetOwnedSize() const noexcept { return buffer.size(); }
+    };
+
+    class TexturePayload final : public IAssetPayload
+    {
+    public:
+        explicit TexturePayload(AssetBytes&& bytes) noexcept : bytes(std::move(bytes)) {}
+
+        size_t GetSize() const noexcept override { return bytes.GetOwnedSize(); }
+
+        AssetBytes bytes;
+    };
+
+    // The mesh's views point into the bytes, so they're declared first.
+    class ModelPayload final : public IAssetPayload
+    {
+    public:
+        explicit ModelPayload(AssetBytes&& bytes) :
+            bytes(std::move(bytes)),
+            file(this->bytes.data, this->bytes.size)
+        {
+        }
+
+        size_t GetSize() const noexcept override { return bytes.GetOwnedSize(); }
+
+        AssetBytes bytes;
+        CookedMesh::File file;
+    };
+
+    // Reads a byte of every page, so the worker takes the page faults rather
+    // than the device thread while it uploads.
+    void TouchPages(const uint8_t* data, size_t size) noexcept
+    {
+        uint8_t sum = 0;
+        for (size_t offset = 0; offset < size; offset += 4096)
+        {
+            sum ^= data[offset];
+        }
+
+        volatile uint8_t sink = sum;
+        (void)sink;
+    }
+}
+
+D3D11TextureAsset::D3D11TextureAsset(ComPtr<ID3D11Resource> resource, ComPtr<ID3D11ShaderResourceView> view) noexcept :
+    m_resource(std::move(resource)),
+    m_view(std::move(view))
+{
+}
+
+D3D11ModelAsset::D3D11ModelAsset(std::unique_ptr<Model> model, D3D11MeshArena& arena, uint32_t mesh) noexcept :
+    m_model(std::move(model)),
+    m_arena(arena),
+    m_mesh(mesh),
+    m_range(arena.GetArena().GetRange(mesh))
+{
+}
+
+D3D11ModelAsset::~D3D11ModelAsset()
+{
+    m_arena.Remove(m_mesh);
+}
+
+Model* D3D11ModelAsset::GetModel() noexcept
+{
+    auto const range = m_arena.GetArena().GetRange(m_mesh);
+    if (range.baseVertex != m_range.baseVertex || range.firstIndex != m_range.firstIndex)
+    {
+        MoveModelParts(*m_model, m_range, range);
+        m_range = range;
+    }
+
+    return m_model.get();
+}
+
+D3D11AssetDevice::D3D11AssetDevice(ID3D11Device* device, ID3D11DeviceContext* context,
+    D3D11MeshArena& modelArena, IEffectFactory& fxFactory, D3D11FrameRing* constantRing,
+    AssetArchive::Reader const* archive, std::filesystem::path const& archiveDirectory, unsigned blockWorkers) :
+    m_device(device),
+    m_context(context),
+    m_modelArena(modelArena),
+    m_fxFactory(fxFactory),
+    m_constantRing(constantRing),
+    m_archive(archive),
+    m_archiveDirectory(archiveDirectory)
+{
+    if (archive && blockWorkers > 0)
+    {
+        m_blockPool = std::make_unique<ThreadPool>(blockWorkers);
+    }
+}
+
+std::unique_ptr<IAssetPayload> D3D11AssetDevice::Decode(uint32_t kind, std::filesystem::path const& path)
+{
+    if (kind != ASSET_TEXTURE && kind != ASSET_MODEL)
+        throw std::invalid_argument("Unknown asset kind");
+
+    AssetBytes bytes;
+    auto const entry = FindInArchive(path);
+    if (entry && AssetArchive::Reader::IsCompressed(*entry))
+    {
+        // The pool takes one caller at a time, so a worker that finds it
+        // busy decodes on its own; the loader's other workers are busy with
+        // other assets then anyway.
+        bytes.buffer.resize(size_t(entry->size));
+        bytes.data = bytes.buffer.data();
+        bytes.size = bytes.buffer.size();
+
+        std::unique_lock<std::mutex> lock(m_blockPoolMutex, std::try_to_lock);
+        m_archive->ReadEntry(*entry, bytes.buffer.data(), lock.owns_lock() ? m_blockPool.get() : nullptr);
+    }
+    else
+    {
+        if (entry)
+        {
+            bytes.data = m_archive->GetData(*entry);
+            bytes.size = size_t(entry->size);
+        }
+        else
+        {
+            bytes.file.emplace(path);
+            bytes.data = bytes.file->GetData();
+            bytes.size = bytes.file->GetSize();
+        }
+        TouchPages(bytes.data, bytes.size);
+    }
+
+    if (kind == ASSET_TEXTURE)
+        return std::make_unique<TexturePayload>(std::move(bytes));
+
+    return std::make_unique<ModelPayload>(std::move(bytes));
+}
+
+std::unique_ptr<IAsset> D3D11AssetDevice::Create(uint32_t kind, IAssetPayload const& payload)
+{
+    if (kind == ASSET_TEXTURE)
+    {
+        auto const& texture = static_cast<TexturePayload const&>(payload);
+
+        ComPtr<ID3D11Resource> resource;
+        ComPtr<ID3D11ShaderResourceView> view;
+        ThrowIfFailed(CreateDDSTextureFromMemory(m_device.Get(), texture.bytes.data, texture.bytes.size,
+            resource.GetAddressOf(), view.GetAddressOf()));
+
+        return std::make_unique<D3D11TextureAsset>(std::move(resource), std::move(view));
+    }
+
+    auto const& file = static_cast<ModelPayload const&>(payload).file;
+    uint32_t mesh;
+    auto model = CreateModelFromCookedMesh(m_device.Get(), m_context.Get(), file, m_modelArena, m_fxFactory, m_constantRing, &mesh);
+    return std::make_unique<D3D11ModelAsset>(std::move(model), m_modelArena, mesh);
+}
+
+std::unique_ptr<IAsset> D3D11AssetDevice::CreateSolidTexture(uint32_t color)
+{
+    const D3D11_SUBRESOURCE_DATA initialData = { &color, sizeof(color), 0 };
+    const CD3D11_TEXTURE2D_DESC desc(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1);
+
+    ComPtr<ID3D11Texture2D> texture;
+    ThrowIfFailed(m_device->CreateTexture2D(&desc, &initialData, texture.GetAddressOf()));
+
+    ComPtr<ID3D11ShaderResourceView> view;
+    ThrowIfFailed(m_device->CreateShaderResourceView(texture.Get(), nullptr, view.GetAddressOf()));
+
+    return std::make_unique<D3D11TextureAsset>(std::move(texture), std::move(view));
+}
+
+// Archive names are relative to the directory that was packed, so a path
+// outside it can't be in the archive.
+AssetArchive::Entry const* D3D11AssetDevice::FindInArchive(std::filesystem::path const& path) const
+{
+    if (!m_archive)
+        return nullptr;
+
+    const std::filesystem::path name = path.lexically_relative(m_archiveDirectory);
+    if (name.empty() || *name.begin() == "..")
+        return nullptr;
+
+    return m_archive->Find(name.generic_string());
+}
+
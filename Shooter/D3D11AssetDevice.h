@@ -0,0 +1,108 @@
+//
+// D3D11AssetDevice.h - Decodes and creates the game's textures and cooked models for the asset loader
+//
+
+#pragma once
+
+#include "AssetArchive.h"
+#include "AssetLoader.h"
+#include "D3D11FrameRing.h"
+#include "D3D11MeshArena.h"
+#include "ThreadPool.h"
+
+#include <wrl/client.h>
+
+namespace DX
+{
+    enum D3D11AssetKind : uint32_t
+    {
+        ASSET_TEXTURE,      // A DDS file, as ShooterTools cook-textures writes them
+        ASSET_MODEL,        // A cooked mesh file, see CreateModelFromCookedMesh
+    };
+
+    class D3D11TextureAsset final : public IAsset
+    {
+    public:
+        D3D11TextureAsset(Microsoft::WRL::ComPtr<ID3D11Resource> resource,
+            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view) noexcept;
+
+        ID3D11Resource* GetResource() const noexcept { return m_resource.Get(); }
+        ID3D11ShaderResourceView* GetView() const noexcept { return m_view.Get(); }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D11Resource>              m_resource;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_view;
+    };
+
+    // Owns the arena mesh its model's parts draw from, and removes it with
+    // the model.
+    class D3D11ModelAsset final : public IAsset
+    {
+    public:
+        D3D11ModelAsset(std::unique_ptr<DirectX::Model> model, D3D11MeshArena& arena, uint32_t mesh) noexcept;
+        ~D3D11ModelAsset() override;
+
+        D3D11ModelAsset(D3D11ModelAsset const&) = delete;
+        D3D11ModelAsset& operator= (D3D11ModelAsset const&) = delete;
+
+        // With its parts where the mesh lies now, which changes whenever a
+        // mesh added to the arena since made it defragment.
+        DirectX::Model* GetModel() noexcept;
+
+    private:
+        std::unique_ptr<DirectX::Model> m_model;
+        D3D11MeshArena&                 m_arena;
+        uint32_t                        m_mesh;
+        MeshArena::Range                m_range;
+    };
+
+    // Workers map the file, check it and read its pages in, so all the
+    // device thread does is copy it to the GPU. Models go into the arena
+    // and take their materials' textures from the effect factory, which
+    // reads those itself. Their quantized mesh effects write constants to
+    // constantRing, or without one to buffers of their own.
+    //
+    // With a mapped archive, a path under the archive's directory is looked
+    // up in it first and used where it lies; paths it doesn't hold are read
+    // as loose files. Compressed entries are decoded into memory, their
+    // blocks in parallel on a pool of blockWorkers threads the device owns,
+    // or with none, on the loader's worker alone.
+    class D3D11AssetDevice final : public IAssetDevice
+    {
+    public:
+        D3D11AssetDevice(_In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context,
+            D3D11MeshArena& modelArena, DirectX::IEffectFactory& fxFactory, _In_opt_ D3D11FrameRing* constantRing,
+            _In_opt_ AssetArchive::Reader const* archive = nullptr, std::filesystem::path const& archiveDirectory = {},
+            unsigned blockWorkers = 0);
+
+        std::unique_ptr<IAssetPayload> Decode(uint32_t kind, std::filesystem::path const& path) override;
+        std::unique_ptr<IAsset> Create(uint32_t kind, IAssetPayload const& payload) override;
+
+        // A 1x1 texture of one color, R in the low byte, for a placeholder.
+        std::unique_ptr<IAsset> CreateSolidTexture(uint32_t color);
+
+        // Narrow an asset or placeholder of each kind; null for null.
+        static ID3D11ShaderResourceView* GetTexture(IAsset* asset) noexcept
+        {
+            return asset ? static_cast<D3D11TextureAsset*>(asset)->GetView() : nullptr;
+        }
+
+        static DirectX::Model* GetModel(IAsset* asset) noexcept
+        {
+            return asset ? static_cast<D3D11ModelAsset*>(asset)->GetModel() : nullptr;
+        }
+
+    private:
+        AssetArchive::Entry const* FindInArchive(std::filesystem::path const& path) const;
+
+        Microsoft::WRL::ComPtr<ID3D11Device>        m_device;
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+        D3D11MeshArena&                             m_modelArena;
+        DirectX::IEffectFactory&                    m_fxFactory;
+        D3D11FrameRing*                             m_constantRing;
+        AssetArchive::Reader const*                 m_archive;
+        std::filesystem::path                       m_archiveDirectory;
+        std::unique_ptr<ThreadPool>                 m_blockPool;
+        std::mutex                                  m_blockPoolMutex;
+    };
+}
@@ -0,0 +1,206 @@
+//
+// D3D11CookedModel.cpp
+//
+
+#include "pch.h"
+#include "D3D11CookedModel.h"
+#include "D3D11QuantizedMeshEffect.h"
+
+using namespace DirectX;
+
+namespace
+{
+    std::wstring ToWide(const char* utf8)
+    {
+        return utf8 ? std::filesystem::u8path(utf8).wstring() : std::wstring();
+    }
+
+    std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> GetInputElements(CookedMesh::VertexFormat format)
+    {
+        switch (format)
+        {
+        case CookedMesh::VertexFormat::PositionNormalTangentColorTexture:
+            return std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>(
+                std::begin(VertexPositionNormalTangentColorTexture::InputElements),
+                std::end(VertexPositionNormalTangentColorTexture::InputElements));
+
+        case CookedMesh::VertexFormat::Quantized:
+            return std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>(
+                std::begin(DX::D3D11QuantizedMeshEffect::InputElements),
+                std::end(DX::D3D11QuantizedMeshEffect::InputElements));
+
+        default:
+            throw std::invalid_argument("Unknown cooked vertex format");
+        }
+    }
+
+    struct PartEffect
+    {
+        std::shared_ptr<IEffect> effect;
+        Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+    };
+
+    // What Model::CreateFromCMO would make for the material.
+    PartEffect CreateEffect(_In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context, CookedMesh::File const& file,
+        CookedMesh::Material const& material, std::vector<D3D11_INPUT_ELEMENT_DESC> const& inputElements, IEffectFactory& fxFactory)
+    {
+        const std::wstring name = ToWide(file.GetString(material.name));
+        std::wstring textures[CookedMesh::TextureSlotCount];
+        for (uint32_t slot = 0; slot < CookedMesh::TextureSlotCount; ++slot)
+        {
+            textures[slot] = ToWide(file.GetString(material.textures[slot]));
+        }
+
+        EffectFactory::EffectInfo info;
+        info.name = name.c_str();
+        info.perVertexColor = true;
+        info.specularPower = material.specularPower;
+        info.alpha = material.alpha;
+        info.ambientColor = XMFLOAT3(material.ambient);
+        info.diffuseColor = XMFLOAT3(material.diffuse);
+        info.specularColor = XMFLOAT3(material.specular);
+        info.emissiveColor = XMFLOAT3(material.emissive);
+        info.diffuseTexture = textures[CookedMesh::TextureDiffuse].empty() ? nullptr : textures[CookedMesh::TextureDiffuse].c_str();
+        info.specularTexture = textures[CookedMesh::TextureSpecular].empty() ? nullptr : textures[CookedMesh::TextureSpecular].c_str();
+        info.normalTexture = textures[CookedMesh::TextureNormal].empty() ? nullptr : textures[CookedMesh::TextureNormal].c_str();
+        info.emissiveTexture = textures[CookedMesh::TextureEmissive].empty() ? nullptr : textures[CookedMesh::TextureEmissive].c_str();
+
+        PartEffect result;
+        result.effect = fxFactory.CreateEffect(info, context);
+
+        DX::ThrowIfFailed(CreateInputLayoutFromEffect(device, result.effect.get(),
+            inputElements.data(), inputElements.size(), result.inputLayout.ReleaseAndGetAddressOf()));
+
+        return result;
+    }
+
+    // Quantized positions decode with their mesh's offset and scale, so each
+    // mesh gets its own effect per material. The input layout only depends
+    // on the shader, and is shared.
+    PartEffect CreateQuantizedEffect(_In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context, CookedMesh::File const& file,
+        CookedMesh::Mesh const& mesh, CookedMesh::Material const& material, std::shared_ptr<DX::D3D11QuantizedMeshEffect::Shaders const> const& shaders,
+        ID3D11InputLayout* inputLayout, DX::D3D11FrameRing* constantRing, IEffectFactory& fxFactory)
+    {
+        auto effect = std::make_shared<DX::D3D11QuantizedMeshEffect>(device, shaders, constantRing);
+        effect->SetMaterial(material);
+        effect->SetPositionDecode(mesh.positionOffset, mesh.positionScale);
+
+        const std::wstring texture = ToWide(file.GetString(material.textures[CookedMesh::TextureDiffuse]));
+        if (!texture.empty())
+        {
+            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureView;
+            fxFactory.CreateTexture(texture.c_str(), context, textureView.GetAddressOf());
+            effect->SetTexture(textureView.Get());
+        }
+
+        return { std::move(effect), inputLayout };
+    }
+}
+
+std::unique_ptr<Model> DX::CreateModelFromCookedMesh(_In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context,
+    CookedMesh::File const& file, D3D11MeshArena& arena, IEffectFactory& fxFactory, _In_opt_ D3D11FrameRing* constantRing,
+    _Out_ uint32_t* mesh)
+{
+    auto const& header = file.GetHeader();
+    if (header.vertexStride != arena.GetVertexStride())
+        throw std::invalid_argument("Cooked mesh vertex format doesn't match the arena");
+
+    auto const inputElements = GetInputElements(header.vertexFormat);
+
+    const bool quantized = header.vertexFormat == CookedMesh::VertexFormat::Quantized;
+
+    // One effect and input layout per material, shared by its parts, or for
+    // quantized vertices per mesh and material, made as parts need them.
+    std::vector<PartEffect> materialEffects;
+    std::shared_ptr<D3D11QuantizedMeshEffect::Shaders const> quantizedShaders;
+    Microsoft::WRL::ComPtr<ID3D11InputLayout> quantizedInputLayout;
+    if (quantized)
+    {
+        quantizedShaders = D3D11QuantizedMeshEffect::CreateShaders(device);
+
+        D3D11QuantizedMeshEffect effect(device, quantizedShaders, constantRing);
+        ThrowIfFailed(CreateInputLayoutFromEffect(device, &effect,
+            inputElements->data(), inputElements->size(), quantizedInputLayout.ReleaseAndGetAddressOf()));
+    }
+    else
+    {
+        for (uint32_t i = 0; i < file.GetMaterialCount(); ++i)
+        {
+            materialEffects.push_back(CreateEffect(device, context, file, file.GetMaterial(i), *inputElements, fxFactory));
+        }
+    }
+
+    auto model = std::make_unique<Model>();
+
+    uint32_t partIndex = 0;
+    for (uint32_t i = 0; i < file.GetMeshCount(); ++i)
+    {
+        auto const& cooked = file.GetMesh(i);
+
+        auto modelMesh = std::make_shared<ModelMesh>();
+        modelMesh->name = ToWide(file.GetString(cooked.name));
+        modelMesh->ccw = true;
+        modelMesh->pmalpha = false;
+        modelMesh->boundingSphere = BoundingSphere(XMFLOAT3(cooked.center), cooked.radius);
+        BoundingBox::CreateFromPoints(modelMesh->boundingBox, XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(cooked.min)),
+            XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(cooked.max)));
+
+        std::vector<PartEffect> meshEffects(quantized ? file.GetMaterialCount() : 0);
+
+        for (uint32_t j = cooked.firstPart; j < cooked.firstPart + cooked.partCount; ++j)
+        {
+            auto const& cookedPart = file.GetPart(j);
+
+            PartEffect* partEffect = nullptr;
+            if (quantized)
+            {
+                partEffect = &meshEffects[cookedPart.material];
+                if (!partEffect->effect)
+                {
+                    *partEffect = CreateQuantizedEffect(device, context, file, cooked, file.GetMaterial(cookedPart.material),
+                        quantizedShaders, quantizedInputLayout.Get(), constantRing, fxFactory);
+                }
+            }
+            else
+            {
+                partEffect = &materialEffects[cookedPart.material];
+            }
+
+            auto part = std::make_unique<ModelMeshPart>(partIndex++);
+            part->indexCount = cookedPart.indexCount;
+            part->startIndex = cookedPart.startIndex;
+            part->vertexOffset = INT(cookedPart.baseVertex);
+            part->vertexStride = header.vertexStride;
+            part->primitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+            part->indexFormat = DXGI_FORMAT_R16_UINT;
+            part->vertexBuffer = arena.GetVertexBuffer();
+            part->indexBuffer = arena.GetIndexBuffer();
+            part->inputLayout = partEffect->inputLayout;
+            part->effect = partEffect->effect;
+            part->vbDecl = inputElements;
+            part->isAlpha = file.GetMaterial(cookedPart.material).alpha < 1.0f;
+            modelMesh->meshParts.push_back(std::move(part));
+        }
+
+        model->meshes.push_back(std::move(modelMesh));
+    }
+
+    // The parts were made relative to the mesh; now that nothing else can
+    // throw, it goes into the arena and they move to where it landed.
+    *mesh = arena.Add(context, file.GetVertices(), header.vertexCount, file.GetIndices(), header.indexCount);
+    MoveModelParts(*model, {}, arena.GetArena().GetRange(*mesh));
+
+    return model;
+}
+
+void DX::MoveModelParts(Model& model, MeshArena::Range const& from, MeshArena::Range const& to) noexcept
+{
+    for (auto const& mesh : model.meshes)
+    {
+        for (auto const& part : mesh->meshParts)
+        {
+            part->startIndex += to.firstIndex - from.firstIndex;
+            part->vertexOffset += INT(to.baseVertex) - INT(from.baseVertex);
+        }
+    }
+}
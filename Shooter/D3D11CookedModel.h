@@ -0,0 +1,35 @@
+//
+// D3D11CookedModel.h - DirectXTK models drawn from cooked mesh files
+//
+
+#pragma once
+
+#include "CookedMesh.h"
+#include "D3D11FrameRing.h"
+#include "D3D11MeshArena.h"
+
+namespace DX
+{
+    // Uploads the file's vertex and index streams into the arena as one
+    // mesh, returned in mesh, and builds a Model whose parts draw from the
+    // arena's buffers at the offsets they landed at. For float vertices, effects and input
+    // layouts are made per material the way Model::CreateFromCMO makes
+    // them, so the model draws as it would have from the CMO file. Quantized
+    // vertices get a D3D11QuantizedMeshEffect per mesh and material, which
+    // decodes them and lights them the same way, with its constants in
+    // constantRing where there's one.
+    //
+    // The caller removes the mesh from the arena along with the model. The
+    // parts keep its offsets, so once the arena has defragmented they have
+    // to be moved to where it lies with MoveModelParts before drawing.
+    // Throws std::invalid_argument if the arena's vertex stride isn't the
+    // file's, and std::length_error if the arena is full; either way, or
+    // if making the effects fails, nothing is left in the arena.
+    std::unique_ptr<DirectX::Model> CreateModelFromCookedMesh(_In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context,
+        CookedMesh::File const& file, D3D11MeshArena& arena, DirectX::IEffectFactory& fxFactory,
+        _In_opt_ D3D11FrameRing* constantRing, _Out_ uint32_t* mesh);
+
+    // Moves a cooked model's parts from where its mesh lay in the arena to
+    // where it lies now.
+    void MoveModelParts(DirectX::Model& model, MeshArena::Range const& from, MeshArena::Range const& to) noexcept;
+}
@@ -0,0 +1,143 @@
+//
+// D3D11FrameRing.cpp
+//
+
+#include "pch.h"
+#include "D3D11FrameRing.h"
+
+using namespace DX;
+
+D3D11FrameRing::D3D11FrameRing(_In_ ID3D11Device* device, UINT bindFlags, size_t capacity, uint32_t framesInFlight) :
+    m_allocator((capacity + 15) & ~size_t(15), framesInFlight),
+    m_mapped(nullptr),
+    m_nextFence(1),
+    m_stalls(0),
+    m_discard(true),
+    m_inFrame(false)
+{
+    if ((bindFlags & D3D11_BIND_CONSTANT_BUFFER) && !SupportsConstantOffsets(device))
+        throw std::runtime_error("Constant buffer offsets are not supported");
+
+    const CD3D11_BUFFER_DESC desc(static_cast<UINT>(m_allocator.GetCapacity()), bindFlags,
+        D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+    ThrowIfFailed(device->CreateBuffer(&desc, nullptr, m_buffer.ReleaseAndGetAddressOf()));
+
+    const CD3D11_QUERY_DESC fenceDesc(D3D11_QUERY_EVENT);
+    m_fences.resize(framesInFlight);
+    for (auto& fence : m_fences)
+    {
+        ThrowIfFailed(device->CreateQuery(&fenceDesc, fence.ReleaseAndGetAddressOf()));
+    }
+}
+
+bool D3D11FrameRing::SupportsConstantOffsets(_In_ ID3D11Device* device)
+{
+    // A Direct3D 11.0 runtime doesn't know the query, and fails it.
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+        return false;
+
+    return options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+}
+
+void D3D11FrameRing::BeginFrame(_In_ ID3D11DeviceContext* context)
+{
+    // Retire whatever the GPU has finished, oldest first, without flushing.
+    while (m_allocator.GetPendingFrameCount() > 0)
+    {
+        const uint64_t fence = m_allocator.GetOldestPendingFence();
+        if (context->GetData(m_fences[fence % m_fences.size()].Get(), nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            break;
+
+        m_allocator.Retire(fence);
+    }
+
+    if (m_allocator.GetPendingFrameCount() == m_allocator.GetMaxFramesInFlight())
+    {
+        WaitForOldestFrame(context);
+    }
+
+    Map(context);
+    m_inFrame = true;
+}
+
+D3D11FrameRing::Allocation D3D11FrameRing::Allocate(_In_ ID3D11DeviceContext* context, size_t size, size_t alignment)
+{
+    if (!m_inFrame)
+        throw std::logic_error("Frame ring allocations must come between BeginFrame and EndFrame");
+
+    if (!m_mapped)
+    {
+        Map(context);
+    }
+
+    for (;;)
+    {
+        const uint64_t offset = m_allocator.Allocate(size, alignment);
+        if (offset != FrameRingAllocator::InvalidOffset)
+            return { m_mapped + offset, static_cast<UINT>(offset) };
+
+        if (m_allocator.GetPendingFrameCount() == 0)
+            throw std::length_error("Frame ring is too small for one frame's data");
+
+        WaitForOldestFrame(context);
+    }
+}
+
+void D3D11FrameRing::Unmap(_In_ ID3D11DeviceContext* context)
+{
+    if (m_mapped)
+    {
+        context->Unmap(m_buffer.Get(), 0);
+        m_mapped = nullptr;
+    }
+}
+
+void D3D11FrameRing::EndFrame(_In_ ID3D11DeviceContext* context)
+{
+    Unmap(context);
+    m_inFrame = false;
+
+    const uint64_t fence = m_nextFence++;
+    context->End(m_fences[fence % m_fences.size()].Get());
+    m_allocator.EndFrame(fence);
+}
+
+void D3D11FrameRing::BindConstants(_In_ ID3D11DeviceContext1* context, UINT slot, UINT offset, size_t size) const
+{
+    // Offsets and sizes are in 16 byte constants, in multiples of 16.
+    ID3D11Buffer* buffer = m_buffer.Get();
+    const UINT firstConstant = offset / 16;
+    const UINT constantCount = static_cast<UINT>((size + ConstantAlignment - 1) / ConstantAlignment) * 16;
+
+    context->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+    context->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &constantCount);
+}
+
+void D3D11FrameRing::Map(_In_ ID3D11DeviceContext* context)
+{
+    // The first map has to discard; after that the fences keep every range
+    // the GPU may read out of reach, so nothing needs renaming, however
+    // often a frame maps.
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    ThrowIfFailed(context->Map(m_buffer.Get(), 0,
+        m_discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped));
+
+    m_mapped = static_cast<uint8_t*>(mapped.pData);
+    m_discard = false;
+}
+
+void D3D11FrameRing::WaitForOldestFrame(_In_ ID3D11DeviceContext* context)
+{
+    const uint64_t fence = m_allocator.GetOldestPendingFence();
+    ID3D11Query* query = m_fences[fence % m_fences.size()].Get();
+
+    HRESULT hr;
+    while ((hr = context->GetData(query, nullptr, 0, 0)) == S_FALSE)
+    {
+    }
+    ThrowIfFailed(hr);
+
+    m_allocator.Retire(fence);
+    m_stalls++;
+}
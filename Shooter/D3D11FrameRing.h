@@ -0,0 +1,87 @@
+//
+// D3D11FrameRing.h - A large dynamic buffer suballocated per frame through FrameRingAllocator
+//
+
+#pragma once
+
+#include "FrameRingAllocator.h"
+
+#include <wrl/client.h>
+
+namespace DX
+{
+    // The buffer is mapped with WRITE_NO_OVERWRITE, which never renames it:
+    // an event query at the end of each frame tells the allocator which
+    // ranges the GPU is done with. A frame's data is allocated between
+    // BeginFrame and EndFrame, and Unmap must come before the draws that
+    // read it. Allocating after Unmap maps the buffer again, so data known
+    // only as draws are issued, such as an effect's constants, is written
+    // and unmapped draw by draw.
+    //
+    // Constant rings use Direct3D 11.1 constant buffer offsets, so one
+    // buffer serves every draw's constants; allocations for them must be
+    // ConstantAlignment aligned.
+    class D3D11FrameRing
+    {
+    public:
+        // VSSetConstantBuffers1 offsets come in multiples of 16 constants.
+        static constexpr size_t ConstantAlignment = 256;
+
+        struct Allocation
+        {
+            void*   data;       // Write-only, valid until Unmap
+            UINT    offset;     // In bytes from the start of the buffer
+        };
+
+        // bindFlags is D3D11_BIND_VERTEX_BUFFER, D3D11_BIND_INDEX_BUFFER or
+        // D3D11_BIND_CONSTANT_BUFFER. Throws std::runtime_error for a constant
+        // ring on a device without constant buffer offsets.
+        D3D11FrameRing(_In_ ID3D11Device* device, UINT bindFlags, size_t capacity, uint32_t framesInFlight);
+
+        // Whether the device can bind constant buffer ranges and map them
+        // with WRITE_NO_OVERWRITE, which constant rings need.
+        static bool SupportsConstantOffsets(_In_ ID3D11Device* device);
+
+        D3D11FrameRing(D3D11FrameRing const&) = delete;
+        D3D11FrameRing& operator= (D3D11FrameRing const&) = delete;
+
+        // Frees the ranges of finished frames and maps the buffer. Waits on
+        // the GPU only when framesInFlight frames are still pending.
+        void BeginFrame(_In_ ID3D11DeviceContext* context);
+
+        // Maps the buffer if the frame unmapped it, and waits on pending frames
+        // if the ring is full. Throws std::length_error if the frame's own
+        // allocations leave no room.
+        Allocation Allocate(_In_ ID3D11DeviceContext* context, size_t size, size_t alignment);
+
+        // Ends writing; must come before draws read what was allocated.
+        void Unmap(_In_ ID3D11DeviceContext* context);
+
+        // Marks the end of the frame's draws.
+        void EndFrame(_In_ ID3D11DeviceContext* context);
+
+        // Binds size bytes of constants at offset to a slot of the vertex and
+        // pixel shaders.
+        void BindConstants(_In_ ID3D11DeviceContext1* context, UINT slot, UINT offset, size_t size) const;
+
+        ID3D11Buffer* GetBuffer() const noexcept { return m_buffer.Get(); }
+        FrameRingAllocator const& GetAllocator() const noexcept { return m_allocator; }
+
+        // Times BeginFrame or Allocate had to wait on the GPU.
+        uint64_t GetStalls() const noexcept { return m_stalls; }
+
+    private:
+        void Map(_In_ ID3D11DeviceContext* context);
+        void WaitForOldestFrame(_In_ ID3D11DeviceContext* context);
+
+        Microsoft::WRL::ComPtr<ID3D11Buffer>                m_buffer;
+        std::vector<Microsoft::WRL::ComPtr<ID3D11Query>>    m_fences;
+
+        FrameRingAllocator                                  m_allocator;
+        uint8_t*                                            m_mapped;
+        uint64_t                                            m_nextFence;
+        uint64_t                                            m_stalls;
+        bool                                                m_discard;
+        bool                                                m_inFrame;
+    };
+}
@@ -0,0 +1,139 @@
+//
+// D3D11GpuProfiler.cpp
+//
+
+#include "pch.h"
+#include "D3D11GpuProfiler.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+D3D11GpuProfiler::D3D11GpuProfiler(_In_ ID3D11Device* device) :
+    m_frames{},
+    m_current(nullptr),
+    m_frameNumber(0),
+    m_resolvedFrame(0),
+    m_skippedFrames(0)
+{
+    device->GetImmediateContext(m_context.GetAddressOf());
+
+    const CD3D11_QUERY_DESC disjointDesc(D3D11_QUERY_TIMESTAMP_DISJOINT);
+    const CD3D11_QUERY_DESC timestampDesc(D3D11_QUERY_TIMESTAMP);
+
+    for (auto& frame : m_frames)
+    {
+        ThrowIfFailed(device->CreateQuery(&disjointDesc, frame.disjoint.ReleaseAndGetAddressOf()));
+
+        for (auto& timestamp : frame.timestamps)
+        {
+            ThrowIfFailed(device->CreateQuery(&timestampDesc, timestamp.ReleaseAndGetAddressOf()));
+        }
+    }
+}
+
+void D3D11GpuProfiler::BeginFrame()
+{
+    m_recorder.BeginFrame();
+
+    // Frees the slot this frame is about to reuse if the GPU has finished it.
+    Resolve();
+
+    Frame& frame = m_frames[m_frameNumber % FrameLatency];
+    if (frame.pending)
+    {
+        m_current = nullptr;
+        m_skippedFrames++;
+        return;
+    }
+
+    m_current = &frame;
+    m_context->Begin(frame.disjoint.Get());
+}
+
+void D3D11GpuProfiler::EndFrame()
+{
+    m_recorder.EndFrame();
+
+    if (m_current)
+    {
+        m_context->End(m_current->disjoint.Get());
+
+        m_current->passCount = m_recorder.GetPassCount();
+        for (size_t i = 0; i < m_current->passCount; ++i)
+        {
+            m_current->names[i] = m_recorder.GetPassName(i);
+        }
+
+        m_current->number = m_frameNumber + 1;
+        m_current->pending = true;
+        m_current = nullptr;
+    }
+
+    m_frameNumber++;
+}
+
+void D3D11GpuProfiler::BeginPass(const char* name)
+{
+    const size_t pass = m_recorder.BeginPass(name);
+
+    if (m_current)
+    {
+        m_context->End(m_current->timestamps[pass * 2].Get());
+    }
+}
+
+void D3D11GpuProfiler::EndPass()
+{
+    const size_t pass = m_recorder.EndPass();
+
+    if (m_current)
+    {
+        m_context->End(m_current->timestamps[pass * 2 + 1].Get());
+    }
+}
+
+void D3D11GpuProfiler::Resolve()
+{
+    // Oldest first; once one frame isn't ready the newer ones won't be either.
+    for (size_t i = 0; i < FrameLatency; ++i)
+    {
+        Frame& frame = m_frames[(m_frameNumber + i) % FrameLatency];
+        if (frame.pending && !TryResolve(frame))
+            break;
+    }
+}
+
+bool D3D11GpuProfiler::TryResolve(Frame& frame)
+{
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = {};
+    if (m_context->GetData(frame.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+        return false;
+
+    // The timestamps can't be trusted if the clock changed mid-frame; drop them.
+    if (disjoint.Disjoint || disjoint.Frequency == 0)
+    {
+        frame.pending = false;
+        return true;
+    }
+
+    UINT64 ticks[GpuPassRecorder::MaxPasses * 2] = {};
+    for (size_t i = 0; i < frame.passCount * 2; ++i)
+    {
+        if (m_context->GetData(frame.timestamps[i].Get(), &ticks[i], sizeof(UINT64), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            return false;
+    }
+
+    m_timings.clear();
+    for (size_t i = 0; i < frame.passCount; ++i)
+    {
+        const UINT64 begin = ticks[i * 2];
+        const UINT64 end = ticks[i * 2 + 1];
+        const double milliseconds = end > begin ? double(end - begin) * 1000.0 / double(disjoint.Frequency) : 0.0;
+        m_timings.push_back({ frame.names[i], milliseconds });
+    }
+
+    m_resolvedFrame = frame.number;
+    frame.pending = false;
+    return true;
+}
@@ -0,0 +1,66 @@
+//
+// D3D11GpuProfiler.h - Per-pass GPU timings from Direct3D 11 timestamp queries
+//
+
+#pragma once
+
+#include "GpuProfiler.h"
+
+#include <wrl/client.h>
+
+namespace DX
+{
+    // Each frame writes a disjoint query and a begin/end timestamp pair per
+    // pass into one slot of a small ring. Results are polled without flushing
+    // a few frames later, so reading them never waits on the GPU. If the GPU
+    // falls so far behind that the ring is full, the frame is skipped rather
+    // than stalled on.
+    class D3D11GpuProfiler final : public IGpuProfiler
+    {
+    public:
+        static constexpr size_t FrameLatency = 4;
+
+        explicit D3D11GpuProfiler(_In_ ID3D11Device* device);
+
+        D3D11GpuProfiler(D3D11GpuProfiler const&) = delete;
+        D3D11GpuProfiler& operator= (D3D11GpuProfiler const&) = delete;
+
+        void BeginFrame() override;
+        void EndFrame() override;
+
+        void BeginPass(const char* name) override;
+        void EndPass() override;
+
+        std::vector<GpuPassTiming> const& GetPassTimings() const noexcept override { return m_timings; }
+        uint64_t GetResolvedFrame() const noexcept override { return m_resolvedFrame; }
+
+        // Frames left untimed because every slot was still waiting on the GPU.
+        uint64_t GetSkippedFrames() const noexcept { return m_skippedFrames; }
+
+    private:
+        struct Frame
+        {
+            Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+            Microsoft::WRL::ComPtr<ID3D11Query> timestamps[GpuPassRecorder::MaxPasses * 2];
+            const char*                         names[GpuPassRecorder::MaxPasses];
+            size_t                              passCount;
+            uint64_t                            number;
+            bool                                pending;
+        };
+
+        void Resolve();
+        bool TryResolve(Frame& frame);
+
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+
+        Frame                                       m_frames[FrameLatency];
+        Frame*                                      m_current;
+        GpuPassRecorder                             m_recorder;
+
+        uint64_t                                    m_frameNumber;
+        uint64_t                                    m_resolvedFrame;
+        uint64_t                                    m_skippedFrames;
+
+        std::vector<GpuPassTiming>                  m_timings;
+    };
+}
@@ -0,0 +1,44 @@
+//
+// D3D11InstanceBuffer.cpp
+//
+
+#include "pch.h"
+#include "D3D11InstanceBuffer.h"
+
+using namespace DirectX;
+using namespace DX;
+
+const D3D11_INPUT_ELEMENT_DESC D3D11InstanceBuffer::InputElements[6] =
+{
+    { "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "InstMatrix", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D11InstanceBuffer::Slot, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "InstMatrix", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D11InstanceBuffer::Slot, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "InstMatrix", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D11InstanceBuffer::Slot, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+};
+
+D3D11InstanceBuffer::D3D11InstanceBuffer() noexcept :
+    m_buffer(nullptr),
+    m_offset(0)
+{
+}
+
+void D3D11InstanceBuffer::Update(_In_ ID3D11DeviceContext* context, D3D11FrameRing& ring, InstanceBatcher const& batcher)
+{
+    const size_t count = batcher.GetInstanceCount();
+    if (count == 0)
+        return;
+
+    auto const allocation = ring.Allocate(context, count * sizeof(XMFLOAT3X4), 16);
+    batcher.Pack(static_cast<XMFLOAT3X4*>(allocation.data));
+
+    m_buffer = ring.GetBuffer();
+    m_offset = allocation.offset;
+}
+
+void D3D11InstanceBuffer::Bind(_In_ ID3D11DeviceContext* context) const
+{
+    const UINT stride = sizeof(XMFLOAT3X4);
+    context->IASetVertexBuffers(Slot, 1, &m_buffer, &stride, &m_offset);
+}
@@ -0,0 +1,37 @@
+//
+// D3D11InstanceBuffer.h - An InstanceBatcher's transforms streamed through a frame ring
+//
+
+#pragma once
+
+#include "InstanceBatcher.h"
+#include "D3D11FrameRing.h"
+
+namespace DX
+{
+    // Each frame's transforms are suballocated from a vertex buffer ring
+    // rather than a buffer of their own, so they share its single map.
+    class D3D11InstanceBuffer
+    {
+    public:
+        // Stream the transforms are bound to; slot 0 is the mesh's vertices.
+        static constexpr UINT Slot = 1;
+
+        D3D11InstanceBuffer() noexcept;
+
+        // Packs the batcher's transforms into the ring, which must be mapped.
+        void Update(_In_ ID3D11DeviceContext* context, D3D11FrameRing& ring, InstanceBatcher const& batcher);
+
+        // Binds the transforms to Slot. Draws through DirectXTK only set
+        // slot 0, so they stay bound across them.
+        void Bind(_In_ ID3D11DeviceContext* context) const;
+
+        // VertexPositionNormalTexture from slot 0 followed by the transform rows
+        // DirectXTK's instanced effects read as InstMatrix.
+        static const D3D11_INPUT_ELEMENT_DESC InputElements[6];
+
+    private:
+        ID3D11Buffer*   m_buffer;
+        UINT            m_offset;
+    };
+}
@@ -0,0 +1,111 @@
+//
+// D3D11MeshArena.cpp
+//
+
+#include "pch.h"
+#include "D3D11MeshArena.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+D3D11MeshArena::D3D11MeshArena(_In_ ID3D11Device* device, UINT vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity) :
+    m_scratchSize(0),
+    m_arena(vertexCapacity, indexCapacity),
+    m_vertexStride(vertexStride)
+{
+    const CD3D11_BUFFER_DESC vertexDesc(vertexCapacity * vertexStride, D3D11_BIND_VERTEX_BUFFER);
+    ThrowIfFailed(device->CreateBuffer(&vertexDesc, nullptr, m_vertexBuffer.ReleaseAndGetAddressOf()));
+
+    const CD3D11_BUFFER_DESC indexDesc(indexCapacity * sizeof(uint16_t), D3D11_BIND_INDEX_BUFFER);
+    ThrowIfFailed(device->CreateBuffer(&indexDesc, nullptr, m_indexBuffer.ReleaseAndGetAddressOf()));
+}
+
+uint32_t D3D11MeshArena::Add(_In_ ID3D11DeviceContext* context,
+    _In_reads_bytes_(vertexCount * vertexStride) const void* vertices, uint32_t vertexCount,
+    _In_reads_(indexCount) const uint16_t* indices, uint32_t indexCount)
+{
+    uint32_t mesh = m_arena.Add(vertexCount, indexCount);
+    if (mesh == MeshArena::InvalidMesh && m_arena.WouldFitDefragmented(vertexCount, indexCount))
+    {
+        Defragment(context);
+        mesh = m_arena.Add(vertexCount, indexCount);
+    }
+
+    if (mesh == MeshArena::InvalidMesh)
+        throw std::length_error("Mesh arena is full");
+
+    auto const range = m_arena.GetRange(mesh);
+
+    const D3D11_BOX vertexBox = { range.baseVertex * m_vertexStride, 0, 0, (range.baseVertex + vertexCount) * m_vertexStride, 1, 1 };
+    context->UpdateSubresource(m_vertexBuffer.Get(), 0, &vertexBox, vertices, 0, 0);
+
+    const D3D11_BOX indexBox = { UINT(range.firstIndex * sizeof(uint16_t)), 0, 0, UINT((range.firstIndex + indexCount) * sizeof(uint16_t)), 1, 1 };
+    context->UpdateSubresource(m_indexBuffer.Get(), 0, &indexBox, indices, 0, 0);
+
+    return mesh;
+}
+
+void D3D11MeshArena::Defragment(_In_ ID3D11DeviceContext* context)
+{
+    m_arena.Defragment(m_vertexMoves, m_indexMoves);
+
+    ApplyMoves(context, m_vertexBuffer.Get(), m_vertexStride, m_vertexMoves);
+    ApplyMoves(context, m_indexBuffer.Get(), sizeof(uint16_t), m_indexMoves);
+}
+
+void D3D11MeshArena::Bind(_In_ ID3D11DeviceContext* context) const
+{
+    ID3D11Buffer* vertexBuffer = m_vertexBuffer.Get();
+    const UINT stride = m_vertexStride;
+    const UINT offset = 0;
+    context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+    context->IASetIndexBuffer(m_indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void D3D11MeshArena::Draw(_In_ ID3D11DeviceContext* context, uint32_t mesh) const
+{
+    auto const range = m_arena.GetRange(mesh);
+    context->DrawIndexed(range.indexCount, range.firstIndex, INT(range.baseVertex));
+}
+
+void D3D11MeshArena::DrawInstanced(_In_ ID3D11DeviceContext* context, uint32_t mesh, uint32_t instanceCount, uint32_t startInstance) const
+{
+    auto const range = m_arena.GetRange(mesh);
+    context->DrawIndexedInstanced(range.indexCount, instanceCount, range.firstIndex, INT(range.baseVertex), startInstance);
+}
+
+// Ranges only ever slide towards the front, in order, so no move reads what
+// an earlier one wrote. Direct3D only allows copies within a buffer that
+// don't overlap; a range sliding by less than its size is copied out to the
+// scratch buffer and back instead.
+void D3D11MeshArena::ApplyMoves(_In_ ID3D11DeviceContext* context, _In_ ID3D11Buffer* buffer, UINT stride,
+    std::vector<OffsetAllocator::Move> const& moves)
+{
+    for (auto const& move : moves)
+    {
+        const UINT bytes = move.size * stride;
+        const D3D11_BOX source = { move.from * stride, 0, 0, move.from * stride + bytes, 1, 1 };
+
+        if (move.from - move.to >= move.size)
+        {
+            context->CopySubresourceRegion(buffer, 0, move.to * stride, 0, 0, buffer, 0, &source);
+            continue;
+        }
+
+        if (bytes > m_scratchSize)
+        {
+            ComPtr<ID3D11Device> device;
+            context->GetDevice(device.GetAddressOf());
+
+            const CD3D11_BUFFER_DESC scratchDesc(bytes, 0);
+            ThrowIfFailed(device->CreateBuffer(&scratchDesc, nullptr, m_scratchBuffer.ReleaseAndGetAddressOf()));
+            m_scratchSize = bytes;
+        }
+
+        const D3D11_BOX scratch = { 0, 0, 0, bytes, 1, 1 };
+        context->CopySubresourceRegion(m_scratchBuffer.Get(), 0, 0, 0, 0, buffer, 0, &source);
+        context->CopySubresourceRegion(buffer, 0, move.to * stride, 0, 0, m_scratchBuffer.Get(), 0, &scratch);
+    }
+}
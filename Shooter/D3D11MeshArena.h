@@ -0,0 +1,70 @@
+//
+// D3D11MeshArena.h - Static meshes of one vertex format in a single vertex and index buffer pair
+//
+
+#pragma once
+
+#include "MeshArena.h"
+
+#include <wrl/client.h>
+
+namespace DX
+{
+    // Meshes are uploaded into default usage buffers at offsets a MeshArena
+    // picks, so drawing one mesh after another only changes the draw's
+    // base vertex and first index; the buffers stay bound. Indices are
+    // 16-bit and relative to the mesh's first vertex.
+    //
+    // When a mesh doesn't fit in one piece but would after packing, the
+    // arena defragments itself, copying ranges within each buffer on the GPU.
+    // A range that slides over itself goes through a scratch buffer, kept
+    // as large as the largest such range so far.
+    class D3D11MeshArena
+    {
+    public:
+        D3D11MeshArena(_In_ ID3D11Device* device, UINT vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity);
+
+        D3D11MeshArena(D3D11MeshArena const&) = delete;
+        D3D11MeshArena& operator= (D3D11MeshArena const&) = delete;
+
+        // Copies the mesh in and returns its id. Throws std::length_error if
+        // the arena can't hold it even packed.
+        uint32_t Add(_In_ ID3D11DeviceContext* context,
+            _In_reads_bytes_(vertexCount * vertexStride) const void* vertices, uint32_t vertexCount,
+            _In_reads_(indexCount) const uint16_t* indices, uint32_t indexCount);
+
+        void Remove(uint32_t mesh) { m_arena.Remove(mesh); }
+
+        // Packs the meshes towards the front of both buffers.
+        void Defragment(_In_ ID3D11DeviceContext* context);
+
+        // Binds the vertex buffer to slot 0 and the index buffer.
+        void Bind(_In_ ID3D11DeviceContext* context) const;
+
+        // Draw calls for a mesh, with the arena bound.
+        void Draw(_In_ ID3D11DeviceContext* context, uint32_t mesh) const;
+        void DrawInstanced(_In_ ID3D11DeviceContext* context, uint32_t mesh, uint32_t instanceCount, uint32_t startInstance) const;
+
+        MeshArena const& GetArena() const noexcept { return m_arena; }
+
+        // For draws that bind the buffers themselves, such as DirectXTK model parts.
+        ID3D11Buffer* GetVertexBuffer() const noexcept { return m_vertexBuffer.Get(); }
+        ID3D11Buffer* GetIndexBuffer() const noexcept { return m_indexBuffer.Get(); }
+        UINT GetVertexStride() const noexcept { return m_vertexStride; }
+
+    private:
+        void ApplyMoves(_In_ ID3D11DeviceContext* context, _In_ ID3D11Buffer* buffer, UINT stride,
+            std::vector<OffsetAllocator::Move> const& moves);
+
+        Microsoft::WRL::ComPtr<ID3D11Buffer>    m_vertexBuffer;
+        Microsoft::WRL::ComPtr<ID3D11Buffer>    m_indexBuffer;
+        Microsoft::WRL::ComPtr<ID3D11Buffer>    m_scratchBuffer;
+        UINT                                    m_scratchSize;
+
+        MeshArena                               m_arena;
+        UINT                                    m_vertexStride;
+
+        std::vector<OffsetAllocator::Move>      m_vertexMoves;
+        std::vector<OffsetAllocator::Move>      m_indexMoves;
+    };
+}
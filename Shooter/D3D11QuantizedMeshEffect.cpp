@@ -0,0 +1,221 @@
+//
+// D3D11QuantizedMeshEffect.cpp
+//
+
+#include "pch.h"
+#include "D3D11QuantizedMeshEffect.h"
+
+using namespace DirectX;
+using namespace DX;
+
+namespace
+{
+#include "QuantizedMeshEffect_VS.inc"
+#include "QuantizedMeshEffect_PS.inc"
+
+    // EffectLights::EnableDefaultLighting's lights.
+    const XMVECTORF32 DefaultDirections[3] =
+    {
+        { { { -0.5265408f, -0.5735765f, -0.6275069f, 0 } } },
+        { { {  0.7198464f,  0.3420201f,  0.6040227f, 0 } } },
+        { { {  0.4545195f, -0.7660444f,  0.4545195f, 0 } } },
+    };
+
+    const XMVECTORF32 DefaultDiffuse[3] =
+    {
+        { { { 1.0000000f, 0.9607844f, 0.8078432f, 0 } } },
+        { { { 0.9647059f, 0.7607844f, 0.4078432f, 0 } } },
+        { { { 0.3231373f, 0.3607844f, 0.3937255f, 0 } } },
+    };
+
+    const XMVECTORF32 DefaultSpecular[3] =
+    {
+        { { { 1.0000000f, 0.9607844f, 0.8078432f, 0 } } },
+        { { { 0.0000000f, 0.0000000f, 0.0000000f, 0 } } },
+        { { { 0.3231373f, 0.3607844f, 0.3937255f, 0 } } },
+    };
+
+    const XMVECTORF32 DefaultAmbient = { { { 0.05333332f, 0.09882354f, 0.1819608f, 0 } } };
+
+    XMVECTOR LoadFloat3(float const (&value)[3]) noexcept
+    {
+        return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(value));
+    }
+}
+
+const D3D11_INPUT_ELEMENT_DESC D3D11QuantizedMeshEffect::InputElements[5] =
+{
+    { "SV_Position", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, offsetof(CookedMesh::QuantizedVertex, position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(CookedMesh::QuantizedVertex, normal), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, offsetof(CookedMesh::QuantizedVertex, tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(CookedMesh::QuantizedVertex, color), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, offsetof(CookedMesh::QuantizedVertex, textureCoordinate), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+std::shared_ptr<D3D11QuantizedMeshEffect::Shaders const> D3D11QuantizedMeshEffect::CreateShaders(_In_ ID3D11Device* device)
+{
+    // All of these are in the feature level 9_3 vertex formats, but a
+    // device missing one would draw garbage rather than fail.
+    for (auto const& element : InputElements)
+    {
+        UINT support = 0;
+        if (FAILED(device->CheckFormatSupport(element.Format, &support)) || !(support & D3D11_FORMAT_SUPPORT_IA_VERTEX_BUFFER))
+            throw std::runtime_error("Quantized vertex format not supported");
+    }
+
+    auto shaders = std::make_shared<Shaders>();
+
+    ThrowIfFailed(device->CreateVertexShader(g_QuantizedMeshEffect_VS, sizeof(g_QuantizedMeshEffect_VS), nullptr,
+        shaders->vertexShader.ReleaseAndGetAddressOf()));
+    ThrowIfFailed(device->CreatePixelShader(g_QuantizedMeshEffect_PS, sizeof(g_QuantizedMeshEffect_PS), nullptr,
+        shaders->pixelShader.ReleaseAndGetAddressOf()));
+
+    static const uint32_t white = 0xFFFFFFFF;
+    const D3D11_SUBRESOURCE_DATA initialData = { &white, sizeof(white), 0 };
+    const CD3D11_TEXTURE2D_DESC desc(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+
+    Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+    ThrowIfFailed(device->CreateTexture2D(&desc, &initialData, texture.GetAddressOf()));
+    ThrowIfFailed(device->CreateShaderResourceView(texture.Get(), nullptr, shaders->whiteTexture.ReleaseAndGetAddressOf()));
+
+    return shaders;
+}
+
+D3D11QuantizedMeshEffect::D3D11QuantizedMeshEffect(_In_ ID3D11Device* device, std::shared_ptr<Shaders const> shaders,
+    _In_opt_ D3D11FrameRing* constantRing) :
+    m_shaders(std::move(shaders)),
+    m_constantRing(constantRing),
+    m_context(nullptr),
+    m_constants{},
+    m_dirty(true)
+{
+    m_texture = m_shaders->whiteTexture;
+
+    if (!m_constantRing)
+    {
+        m_constantBuffer.Create(device);
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        m_constants.lightDirection[i] = DefaultDirections[i];
+        m_constants.lightDiffuseColor[i] = DefaultDiffuse[i];
+        m_constants.lightSpecularColor[i] = DefaultSpecular[i];
+    }
+
+    m_constants.diffuseColor = g_XMOne;
+    m_constants.emissiveColor = DefaultAmbient;
+    m_constants.specularColorAndPower = g_XMIdentityR3;
+    m_constants.positionScale = g_XMOne;
+
+    XMStoreFloat4x4(&m_world, XMMatrixIdentity());
+    m_view = m_world;
+    m_projection = m_world;
+}
+
+void D3D11QuantizedMeshEffect::Apply(_In_ ID3D11DeviceContext* context)
+{
+    const bool changed = m_dirty;
+    if (m_dirty)
+    {
+        const XMMATRIX world = XMLoadFloat4x4(&m_world);
+        const XMMATRIX view = XMLoadFloat4x4(&m_view);
+        const XMMATRIX worldInverse = XMMatrixInverse(nullptr, world);
+
+        m_constants.world = XMMatrixTranspose(world);
+        m_constants.worldInverseTranspose[0] = worldInverse.r[0];
+        m_constants.worldInverseTranspose[1] = worldInverse.r[1];
+        m_constants.worldInverseTranspose[2] = worldInverse.r[2];
+        m_constants.worldViewProj = XMMatrixTranspose(world * view * XMLoadFloat4x4(&m_projection));
+        m_constants.eyePosition = XMMatrixInverse(nullptr, view).r[3];
+
+        m_dirty = false;
+    }
+
+    if (m_constantRing)
+    {
+        if (context != m_context)
+        {
+            ThrowIfFailed(context->QueryInterface(IID_PPV_ARGS(m_context1.ReleaseAndGetAddressOf())));
+            m_context = context;
+        }
+
+        // A range of this frame's ring every time, as last frame's may still
+        // be in use; the draw after this reads it, so it's unmapped right away.
+        auto const allocation = m_constantRing->Allocate(context, sizeof(Constants), D3D11FrameRing::ConstantAlignment);
+        *static_cast<Constants*>(allocation.data) = m_constants;
+        m_constantRing->Unmap(context);
+        m_constantRing->BindConstants(m_context1.Get(), 0, allocation.offset, sizeof(Constants));
+    }
+    else
+    {
+        if (changed)
+        {
+            m_constantBuffer.SetData(context, m_constants);
+        }
+
+        ID3D11Buffer* buffer = m_constantBuffer.GetBuffer();
+        context->VSSetConstantBuffers(0, 1, &buffer);
+        context->PSSetConstantBuffers(0, 1, &buffer);
+    }
+
+    context->PSSetShaderResources(0, 1, m_texture.GetAddressOf());
+
+    context->VSSetShader(m_shaders->vertexShader.Get(), nullptr, 0);
+    context->PSSetShader(m_shaders->pixelShader.Get(), nullptr, 0);
+}
+
+void D3D11QuantizedMeshEffect::GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength)
+{
+    *pShaderByteCode = g_QuantizedMeshEffect_VS;
+    *pByteCodeLength = sizeof(g_QuantizedMeshEffect_VS);
+}
+
+void XM_CALLCONV D3D11QuantizedMeshEffect::SetWorld(FXMMATRIX value)
+{
+    XMStoreFloat4x4(&m_world, value);
+    m_dirty = true;
+}
+
+void XM_CALLCONV D3D11QuantizedMeshEffect::SetView(FXMMATRIX value)
+{
+    XMStoreFloat4x4(&m_view, value);
+    m_dirty = true;
+}
+
+void XM_CALLCONV D3D11QuantizedMeshEffect::SetProjection(FXMMATRIX value)
+{
+    XMStoreFloat4x4(&m_projection, value);
+    m_dirty = true;
+}
+
+// As EffectFactory sets up a BasicEffect from the same material: colors
+// premultiplied by alpha, the ambient light folded into the emissive color,
+// and no specular highlight for a black specular color.
+void D3D11QuantizedMeshEffect::SetMaterial(CookedMesh::Material const& material)
+{
+    const XMVECTOR alpha = XMVectorReplicate(material.alpha);
+    const XMVECTOR diffuse = LoadFloat3(material.diffuse);
+
+    m_constants.diffuseColor = XMVectorSetW(XMVectorMultiply(diffuse, alpha), material.alpha);
+    m_constants.emissiveColor = XMVectorMultiply(XMVectorMultiplyAdd(DefaultAmbient, diffuse, LoadFloat3(material.emissive)), alpha);
+
+    const XMVECTOR specular = LoadFloat3(material.specular);
+    m_constants.specularColorAndPower = XMVector3Equal(specular, g_XMZero)
+        ? g_XMIdentityR3.v
+        : XMVectorSetW(specular, material.specularPower);
+
+    m_dirty = true;
+}
+
+void D3D11QuantizedMeshEffect::SetPositionDecode(float const (&offset)[3], float const (&scale)[3])
+{
+    m_constants.positionOffset = LoadFloat3(offset);
+    m_constants.positionScale = LoadFloat3(scale);
+    m_dirty = true;
+}
+
+void D3D11QuantizedMeshEffect::SetTexture(_In_opt_ ID3D11ShaderResourceView* value)
+{
+    m_texture = value ? value : m_shaders->whiteTexture.Get();
+}
@@ -0,0 +1,102 @@
+//
+// D3D11QuantizedMeshEffect.h - Lit, textured drawing of cooked meshes with quantized vertices
+//
+
+#pragma once
+
+#include "CookedMesh.h"
+#include "D3D11FrameRing.h"
+
+#include <wrl/client.h>
+
+namespace DX
+{
+    // Draws CookedMesh::QuantizedVertex streams the way BasicEffect draws a
+    // CMO model's vertices with the default lights, per-pixel lighting and
+    // per-vertex color: the vertex shader decodes the positions with the
+    // mesh's offset and scale and the normals from their octahedral
+    // encoding, and the rest is BasicEffect's lighting. Materials without a
+    // texture sample a white one.
+    //
+    // Given a constant ring, each Apply writes the constants to a range of
+    // it and binds that with an offset, instead of renaming a buffer of the
+    // effect's own, so it has to come between the ring's BeginFrame and
+    // EndFrame. Without one, on devices without constant buffer offsets,
+    // the effect maps a dynamic constant buffer of its own as BasicEffect
+    // does.
+    // Effects for one device share a Shaders, made once up front.
+    class D3D11QuantizedMeshEffect : public DirectX::IEffect, public DirectX::IEffectMatrices
+    {
+    public:
+        struct Shaders
+        {
+            Microsoft::WRL::ComPtr<ID3D11VertexShader>          vertexShader;
+            Microsoft::WRL::ComPtr<ID3D11PixelShader>           pixelShader;
+            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    whiteTexture;
+        };
+
+        // Throws std::runtime_error if the device can't fetch the vertex
+        // formats.
+        static std::shared_ptr<Shaders const> CreateShaders(_In_ ID3D11Device* device);
+
+        // constantRing, if any, is a D3D11_BIND_CONSTANT_BUFFER ring, which
+        // must outlive the effect.
+        D3D11QuantizedMeshEffect(_In_ ID3D11Device* device, std::shared_ptr<Shaders const> shaders,
+            _In_opt_ D3D11FrameRing* constantRing = nullptr);
+
+        D3D11QuantizedMeshEffect(D3D11QuantizedMeshEffect const&) = delete;
+        D3D11QuantizedMeshEffect& operator= (D3D11QuantizedMeshEffect const&) = delete;
+
+        // IEffect
+        void Apply(_In_ ID3D11DeviceContext* context) override;
+        void GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength) override;
+
+        // IEffectMatrices
+        void XM_CALLCONV SetWorld(DirectX::FXMMATRIX value) override;
+        void XM_CALLCONV SetView(DirectX::FXMMATRIX value) override;
+        void XM_CALLCONV SetProjection(DirectX::FXMMATRIX value) override;
+
+        void SetMaterial(CookedMesh::Material const& material);
+        void SetPositionDecode(float const (&offset)[3], float const (&scale)[3]);
+
+        // nullptr for the white texture.
+        void SetTexture(_In_opt_ ID3D11ShaderResourceView* value);
+
+        // The layout of CookedMesh::QuantizedVertex.
+        static const D3D11_INPUT_ELEMENT_DESC InputElements[5];
+
+    private:
+        XM_ALIGNED_STRUCT(16) Constants
+        {
+            DirectX::XMVECTOR diffuseColor;
+            DirectX::XMVECTOR emissiveColor;
+            DirectX::XMVECTOR specularColorAndPower;
+            DirectX::XMVECTOR lightDirection[3];
+            DirectX::XMVECTOR lightDiffuseColor[3];
+            DirectX::XMVECTOR lightSpecularColor[3];
+            DirectX::XMVECTOR eyePosition;
+            DirectX::XMVECTOR positionOffset;
+            DirectX::XMVECTOR positionScale;
+            DirectX::XMMATRIX world;
+            DirectX::XMVECTOR worldInverseTranspose[3];
+            DirectX::XMMATRIX worldViewProj;
+        };
+
+        static_assert(sizeof(Constants) == 26 * 16, "Constants must match QuantizedMeshEffect.hlsli");
+
+        std::shared_ptr<Shaders const>                      m_shaders;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_texture;
+        D3D11FrameRing*                                     m_constantRing;
+        DirectX::ConstantBuffer<Constants>                  m_constantBuffer;
+
+        // The 11.1 interface of the context last applied to.
+        ID3D11DeviceContext*                                m_context;
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext1>        m_context1;
+
+        Constants                                           m_constants;
+        DirectX::XMFLOAT4X4                                 m_world;
+        DirectX::XMFLOAT4X4                                 m_view;
+        DirectX::XMFLOAT4X4                                 m_projection;
+        bool                                                m_dirty;
+    };
+}
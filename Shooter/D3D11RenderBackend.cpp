@@ -0,0 +1,81 @@
+//
+// D3D11RenderBackend.cpp
+//
+
+#include "pch.h"
+#include "D3D11RenderBackend.h"
+
+using namespace DX;
+
+D3D11RenderBackend::D3D11RenderBackend(_In_ ID3D11DeviceContext* context) :
+    m_context(context),
+    m_gpuProfiler(nullptr),
+    m_timingPass(false)
+{
+}
+
+void D3D11RenderBackend::SetTarget(uint32_t target, _In_opt_ ID3D11RenderTargetView* renderTarget,
+    _In_opt_ ID3D11DepthStencilView* depthStencil, D3D11_VIEWPORT const& viewport)
+{
+    if (target >= m_targets.size())
+    {
+        m_targets.resize(target + 1, Target{});
+    }
+
+    m_targets[target] = { renderTarget, depthStencil, viewport };
+}
+
+void D3D11RenderBackend::SetPassName(uint32_t pass, const char* name)
+{
+    if (pass >= m_passNames.size())
+    {
+        m_passNames.resize(pass + 1, nullptr);
+    }
+
+    m_passNames[pass] = name;
+}
+
+void D3D11RenderBackend::BeginPass(uint32_t pass)
+{
+    const char* name = pass < m_passNames.size() ? m_passNames[pass] : nullptr;
+
+    m_timingPass = m_gpuProfiler && name;
+    if (m_timingPass)
+    {
+        m_gpuProfiler->BeginPass(name);
+    }
+}
+
+void D3D11RenderBackend::EndPass(uint32_t)
+{
+    if (m_timingPass)
+    {
+        m_gpuProfiler->EndPass();
+        m_timingPass = false;
+    }
+}
+
+void D3D11RenderBackend::SetRenderTarget(uint32_t target)
+{
+    if (target >= m_targets.size())
+    {
+        throw std::out_of_range("Render target was never registered");
+    }
+
+    auto const& desc = m_targets[target];
+    m_context->OMSetRenderTargets(1, &desc.renderTarget, desc.depthStencil);
+    m_context->RSSetViewports(1, &desc.viewport);
+}
+
+void D3D11RenderBackend::SetShader(uint32_t)
+{
+}
+
+void D3D11RenderBackend::SetMaterial(uint32_t)
+{
+}
+
+void D3D11RenderBackend::Draw(RenderPacket const& packet)
+{
+    packet.draw(packet.context, packet.param);
+}
@@ -0,0 +1,58 @@
+//
+// D3D11RenderBackend.h - Submits render queue packets to a Direct3D 11 context
+//
+
+#pragma once
+
+#include "RenderQueue.h"
+#include "GpuProfiler.h"
+
+#include <wrl/client.h>
+
+namespace DX
+{
+    // Render targets and passes are referred to by the small ids packed into
+    // sort keys, and registered here each frame. Shader and material ids only
+    // group packets: the DirectXTK effects a packet draws with bind their own
+    // shaders and constants.
+    class D3D11RenderBackend final : public IRenderBackend
+    {
+    public:
+        explicit D3D11RenderBackend(_In_ ID3D11DeviceContext* context);
+
+        D3D11RenderBackend(D3D11RenderBackend const&) = delete;
+        D3D11RenderBackend& operator= (D3D11RenderBackend const&) = delete;
+
+        void SetTarget(uint32_t target, _In_opt_ ID3D11RenderTargetView* renderTarget,
+            _In_opt_ ID3D11DepthStencilView* depthStencil, D3D11_VIEWPORT const& viewport);
+
+        // Passes with a name are timed when a GPU profiler is attached.
+        void SetPassName(uint32_t pass, const char* name);
+        void SetGpuProfiler(_In_opt_ IGpuProfiler* profiler) noexcept { m_gpuProfiler = profiler; }
+
+        void BeginPass(uint32_t pass) override;
+        void EndPass(uint32_t pass) override;
+
+        void SetRenderTarget(uint32_t target) override;
+        void SetShader(uint32_t shader) override;
+        void SetMaterial(uint32_t material) override;
+
+        void Draw(RenderPacket const& packet) override;
+
+    private:
+        struct Target
+        {
+            ID3D11RenderTargetView*     renderTarget;
+            ID3D11DepthStencilView*     depthStencil;
+            D3D11_VIEWPORT              viewport;
+        };
+
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+
+        std::vector<Target>                         m_targets;
+        std::vector<const char*>                    m_passNames;
+
+        IGpuProfiler*                               m_gpuProfiler;
+        bool                                        m_timingPass;
+    };
+}
@@ -0,0 +1,100 @@
+//
+// D3D11RenderTargetDevice.cpp
+//
+
+#include "pch.h"
+#include "D3D11RenderTargetDevice.h"
+
+using namespace DX;
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    // Render target formats the game can ask for. Anything else is counted
+    // as 32 bits, which only affects the pool's memory figures.
+    uint32_t BitsPerPixel(DXGI_FORMAT format) noexcept
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R32G32B32A32_UINT:
+            return 128;
+
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R32G32_FLOAT:
+            return 64;
+
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_R16_UNORM:
+            return 16;
+
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_A8_UNORM:
+            return 8;
+
+        default:
+            return 32;
+        }
+    }
+}
+
+D3D11RenderTarget::D3D11RenderTarget(ComPtr<ID3D11Texture2D> texture,
+    ComPtr<ID3D11RenderTargetView> renderTargetView,
+    ComPtr<ID3D11ShaderResourceView> shaderResourceView) noexcept :
+    m_texture(std::move(texture)),
+    m_renderTargetView(std::move(renderTargetView)),
+    m_shaderResourceView(std::move(shaderResourceView))
+{
+}
+
+D3D11RenderTargetDevice::D3D11RenderTargetDevice(_In_ ID3D11Device* device) noexcept :
+    m_device(device)
+{
+}
+
+std::unique_ptr<IRenderTarget> D3D11RenderTargetDevice::CreateTarget(RenderTargetDesc const& desc)
+{
+    const auto format = static_cast<DXGI_FORMAT>(desc.format);
+    const UINT sampleCount = std::max(desc.sampleCount, 1u);
+
+    CD3D11_TEXTURE2D_DESC textureDesc(
+        format,
+        desc.width,
+        desc.height,
+        1,
+        1,
+        D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE,
+        D3D11_USAGE_DEFAULT,
+        0,
+        sampleCount,
+        0
+    );
+
+    ComPtr<ID3D11Texture2D> texture;
+    ThrowIfFailed(m_device->CreateTexture2D(&textureDesc, nullptr, texture.GetAddressOf()));
+
+    const auto dimension = sampleCount > 1 ? D3D11_RTV_DIMENSION_TEXTURE2DMS : D3D11_RTV_DIMENSION_TEXTURE2D;
+    CD3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc(dimension, format);
+
+    ComPtr<ID3D11RenderTargetView> renderTargetView;
+    ThrowIfFailed(m_device->CreateRenderTargetView(texture.Get(), &renderTargetViewDesc, renderTargetView.GetAddressOf()));
+
+    const auto srvDimension = sampleCount > 1 ? D3D11_SRV_DIMENSION_TEXTURE2DMS : D3D11_SRV_DIMENSION_TEXTURE2D;
+    CD3D11_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc(srvDimension, format);
+
+    ComPtr<ID3D11ShaderResourceView> shaderResourceView;
+    ThrowIfFailed(m_device->CreateShaderResourceView(texture.Get(), &shaderResourceViewDesc, shaderResourceView.GetAddressOf()));
+
+    return std::make_unique<D3D11RenderTarget>(std::move(texture), std::move(renderTargetView), std::move(shaderResourceView));
+}
+
+uint64_t D3D11RenderTargetDevice::GetTargetBytes(RenderTargetDesc const& desc) const noexcept
+{
+    const uint64_t bits = uint64_t(desc.width) * desc.height * std::max(desc.sampleCount, 1u)
+        * BitsPerPixel(static_cast<DXGI_FORMAT>(desc.format));
+    return bits / 8;
+}
@@ -0,0 +1,45 @@
+//
+// D3D11RenderTargetDevice.h - Creates pooled Direct3D 11 render targets
+//
+
+#pragma once
+
+#include "RenderTargetPool.h"
+
+#include <wrl/client.h>
+
+namespace DX
+{
+    // A 2D texture bound as both render target and shader resource.
+    class D3D11RenderTarget final : public IRenderTarget
+    {
+    public:
+        D3D11RenderTarget(Microsoft::WRL::ComPtr<ID3D11Texture2D> texture,
+            Microsoft::WRL::ComPtr<ID3D11RenderTargetView> renderTargetView,
+            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shaderResourceView) noexcept;
+
+        ID3D11Texture2D* GetTexture() const noexcept { return m_texture.Get(); }
+        ID3D11RenderTargetView* GetRenderTargetView() const noexcept { return m_renderTargetView.Get(); }
+        ID3D11ShaderResourceView* GetShaderResourceView() const noexcept { return m_shaderResourceView.Get(); }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D11Texture2D>             m_texture;
+        Microsoft::WRL::ComPtr<ID3D11RenderTargetView>      m_renderTargetView;
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>    m_shaderResourceView;
+    };
+
+    class D3D11RenderTargetDevice final : public IRenderTargetDevice
+    {
+    public:
+        explicit D3D11RenderTargetDevice(_In_ ID3D11Device* device) noexcept;
+
+        std::unique_ptr<IRenderTarget> CreateTarget(RenderTargetDesc const& desc) override;
+        uint64_t GetTargetBytes(RenderTargetDesc const& desc) const noexcept override;
+
+        // Narrows a target handed out by a pool over this device.
+        static D3D11RenderTarget* Get(IRenderTarget* target) noexcept { return static_cast<D3D11RenderTarget*>(target); }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+    };
+}
@@ -6,6 +6,7 @@
 
 #include "pch.h"
 #include "DeviceResources.h"
+#include "Profiler.h"
 
 using namespace DirectX;
 using namespace DX;
@@ -577,6 +578,8 @@ void DeviceResources::Trim() noexcept
 // Present the contents of the swap chain to the screen.
 void DeviceResources::Present()
 {
+    PROFILE_SCOPE("Present");
+
     HRESULT hr = E_FAIL;
     if (m_options & c_AllowTearing)
     {
@@ -0,0 +1,142 @@
+//
+// DynamicResolution.cpp
+//
+
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::Settings DynamicResolution::GetDefaultSettings(double budgetMs) noexcept
+{
+	Settings settings;
+	settings.budgetMs = budgetMs;
+	settings.minScale = 0.5f;
+	settings.maxScale = 1.0f;
+	settings.scaleStep = 0.05f;
+	settings.decreaseTarget = 0.9;
+	settings.increaseThreshold = 0.85;
+	settings.decreaseFrames = 2;
+	settings.increaseFrames = 30;
+	settings.latencyFrames = 4;
+	return settings;
+}
+
+DynamicResolution::DynamicResolution(Settings const& settings) noexcept :
+	m_settings(settings),
+	m_minLevel(0),
+	m_maxLevel(0),
+	m_level(0),
+	m_overStreak(0),
+	m_underStreak(0),
+	m_overStreakMaxMs(0.0),
+	m_settleFrames(0),
+	m_stats{}
+{
+	// Work in whole steps; a small bias keeps 1.0 / 0.05 from landing on 19.
+	const float step = std::max(m_settings.scaleStep, 0.001f);
+	m_settings.scaleStep = step;
+	m_maxLevel = std::max(uint32_t(m_settings.maxScale / step + 0.001f), 1u);
+	m_minLevel = std::min(std::max(uint32_t(std::ceil(m_settings.minScale / step - 0.001f)), 1u), m_maxLevel);
+	m_level = m_maxLevel;
+}
+
+void DynamicResolution::AddFrame(double cpuMs, double gpuMs) noexcept
+{
+	m_stats.frames++;
+
+	const bool cpuOverBudget = cpuMs > m_settings.budgetMs;
+	if (cpuOverBudget)
+	{
+		m_stats.cpuBoundFrames++;
+	}
+
+	if (gpuMs < 0.0)
+		return;
+
+	m_stats.gpuFrames++;
+
+	const bool gpuOverBudget = gpuMs > m_settings.budgetMs;
+	if (gpuOverBudget)
+	{
+		m_stats.overBudgetFrames++;
+	}
+
+	// The first GPU times after a change were rendered at the old scale.
+	if (m_settleFrames > 0)
+	{
+		m_settleFrames--;
+		return;
+	}
+
+	if (gpuOverBudget)
+	{
+		m_underStreak = 0;
+		m_overStreak++;
+		m_overStreakMaxMs = std::max(m_overStreakMaxMs, gpuMs);
+
+		if (m_overStreak >= m_settings.decreaseFrames && m_level > m_minLevel)
+		{
+			// Jump straight to the scale the worst frame of the streak would
+			// have fit at, rather than stepping down one frame at a time.
+			const double scale = GetScale() * std::sqrt(m_settings.budgetMs * m_settings.decreaseTarget / m_overStreakMaxMs);
+			const uint32_t level = uint32_t(std::max(std::floor(scale / m_settings.scaleStep + 0.001), 0.0));
+
+			SetLevel(std::max(std::min(level, m_level - 1), m_minLevel));
+			m_stats.decreases++;
+		}
+		return;
+	}
+
+	m_overStreak = 0;
+	m_overStreakMaxMs = 0.0;
+
+	if (m_level >= m_maxLevel)
+	{
+		m_underStreak = 0;
+		return;
+	}
+
+	// Raise only when the frame would still have headroom one step up, and
+	// the CPU isn't already making the frame late.
+	const double current = GetScale();
+	const double next = double(m_level + 1) * m_settings.scaleStep;
+	const double predictedMs = gpuMs * (next * next) / (current * current);
+
+	if (predictedMs <= m_settings.budgetMs * m_settings.increaseThreshold && !cpuOverBudget)
+	{
+		if (++m_underStreak >= m_settings.increaseFrames)
+		{
+			SetLevel(m_level + 1);
+			m_stats.increases++;
+		}
+	}
+	else
+	{
+		m_underStreak = 0;
+	}
+}
+
+void DynamicResolution::Reset() noexcept
+{
+	m_level = m_maxLevel;
+	m_overStreak = 0;
+	m_underStreak = 0;
+	m_overStreakMaxMs = 0.0;
+	m_settleFrames = 0;
+	m_stats = {};
+}
+
+uint32_t DynamicResolution::ScaleSize(uint32_t size, float scale) noexcept
+{
+	return std::max(uint32_t(std::lround(double(size) * scale)), 1u);
+}
+
+void DynamicResolution::SetLevel(uint32_t level) noexcept
+{
+	m_level = level;
+	m_overStreak = 0;
+	m_underStreak = 0;
+	m_overStreakMaxMs = 0.0;
+	m_settleFrames = m_settings.latencyFrames;
+}
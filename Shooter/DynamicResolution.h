@@ -0,0 +1,76 @@
+//
+// DynamicResolution.h - Picks a render scale that keeps GPU frame time within a budget
+//
+
+#pragma once
+
+#include <cstdint>
+
+// Fed one frame's CPU and GPU times at a time. The scale drops quickly when
+// the GPU goes over budget and climbs back one step at a time once there has
+// been headroom for a while; the gap between the two thresholds keeps a scene
+// near the budget from bouncing. GPU cost is assumed to follow the pixel
+// count, the square of the scale. Scales are whole multiples of the step, so
+// the scene target only ever takes a handful of sizes.
+//
+// Deterministic: the same sequence of frame times always gives the same scales.
+class DynamicResolution
+{
+public:
+	struct Settings
+	{
+		double budgetMs;			// GPU and CPU time a frame may take
+		float minScale;
+		float maxScale;
+		float scaleStep;
+		double decreaseTarget;		// Share of the budget a decrease aims for
+		double increaseThreshold;	// Share of the budget a frame must stay under, predicted at the next step up
+		uint32_t decreaseFrames;	// Consecutive over-budget GPU frames before lowering the scale
+		uint32_t increaseFrames;	// Consecutive GPU frames with headroom before raising it
+		uint32_t latencyFrames;		// GPU times ignored after a change, as they describe older frames
+	};
+
+	struct Stats
+	{
+		uint64_t frames;
+		uint64_t gpuFrames;			// Frames that came with a GPU time
+		uint64_t overBudgetFrames;	// GPU over budget
+		uint64_t cpuBoundFrames;	// CPU over budget
+		uint64_t decreases;
+		uint64_t increases;
+	};
+
+	static Settings GetDefaultSettings(double budgetMs) noexcept;
+
+	explicit DynamicResolution(Settings const& settings) noexcept;
+
+	// gpuMs is negative for frames without a newly resolved GPU time.
+	void AddFrame(double cpuMs, double gpuMs) noexcept;
+
+	// Back to the highest scale with fresh counters.
+	void Reset() noexcept;
+
+	float GetScale() const noexcept { return float(m_level) * m_settings.scaleStep; }
+	bool IsScaled() const noexcept { return m_level < m_maxLevel; }
+
+	Settings const& GetSettings() const noexcept { return m_settings; }
+	Stats const& GetStats() const noexcept { return m_stats; }
+
+	// A size at the given scale, rounded, never below one pixel.
+	static uint32_t ScaleSize(uint32_t size, float scale) noexcept;
+
+private:
+	void SetLevel(uint32_t level) noexcept;
+
+	Settings m_settings;
+	uint32_t m_minLevel;
+	uint32_t m_maxLevel;
+	uint32_t m_level;
+
+	uint32_t m_overStreak;
+	uint32_t m_underStreak;
+	double m_overStreakMaxMs;
+	uint32_t m_settleFrames;
+
+	Stats m_stats;
+};
@@ -0,0 +1,424 @@
+//
+// FrameGraph.cpp
+//
+
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace
+{
+	// Groups accesses by one of their handles, keeping declaration order
+	// within each group. offsets[i] is where group i starts.
+	template<typename Access, typename Key>
+	void GroupBy(std::vector<Access> const& accesses, size_t groupCount, Key key,
+		std::vector<Access>& grouped, std::vector<uint32_t>& offsets)
+	{
+		offsets.assign(groupCount + 1, 0);
+		for (auto const& access : accesses)
+		{
+			offsets[key(access) + 1]++;
+		}
+
+		for (size_t i = 0; i < groupCount; ++i)
+		{
+			offsets[i + 1] += offsets[i];
+		}
+
+		// Fill using the offsets as cursors, which leaves each one at the start
+		// of the next group; shift them back afterwards.
+		grouped.resize(accesses.size());
+		for (auto const& access : accesses)
+		{
+			grouped[offsets[key(access)]++] = access;
+		}
+
+		for (size_t i = groupCount; i > 0; --i)
+		{
+			offsets[i] = offsets[i - 1];
+		}
+		offsets[0] = 0;
+	}
+}
+
+FrameGraph::FrameGraph() noexcept :
+	m_compiled(false)
+{
+}
+
+void FrameGraph::Reset() noexcept
+{
+	m_passes.clear();
+	m_resources.clear();
+	m_accesses.clear();
+	m_order.clear();
+	m_physical.clear();
+	m_compiled = false;
+}
+
+FrameGraph::Handle FrameGraph::CreateTransient(const char* name, RenderTargetDesc const& desc)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.desc = desc;
+	resource.transient = true;
+	m_resources.push_back(resource);
+
+	m_compiled = false;
+	return Handle(m_resources.size() - 1);
+}
+
+FrameGraph::Handle FrameGraph::Import(const char* name, bool output)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.output = output;
+	m_resources.push_back(resource);
+
+	m_compiled = false;
+	return Handle(m_resources.size() - 1);
+}
+
+FrameGraph::Handle FrameGraph::AddPass(const char* name, uint32_t id, PassFunction execute, void* context)
+{
+	Pass pass = {};
+	pass.name = name;
+	pass.id = id;
+	pass.execute = execute;
+	pass.context = context;
+	m_passes.push_back(pass);
+
+	m_compiled = false;
+	return Handle(m_passes.size() - 1);
+}
+
+void FrameGraph::Read(Handle pass, Handle resource)
+{
+	AddAccess(pass, resource, false);
+}
+
+void FrameGraph::Write(Handle pass, Handle resource)
+{
+	AddAccess(pass, resource, true);
+}
+
+void FrameGraph::AddAccess(Handle pass, Handle resource, bool write)
+{
+	if (pass >= m_passes.size() || resource >= m_resources.size())
+	{
+		throw std::logic_error("Frame graph handle out of range");
+	}
+
+	m_accesses.push_back({ pass, resource, write });
+	m_compiled = false;
+}
+
+void FrameGraph::Compile()
+{
+	m_compiled = false;
+
+	for (auto& pass : m_passes)
+	{
+		pass.needed = false;
+	}
+
+	for (auto& resource : m_resources)
+	{
+		resource.needed = resource.output;
+		resource.lifetime = { InvalidHandle, InvalidHandle };
+		resource.physical = InvalidHandle;
+	}
+
+	Cull();
+	Order();
+	AssignLifetimes();
+	Alias();
+
+	m_compiled = true;
+}
+
+// Walks back from the outputs: a needed resource needs every pass writing
+// it, and a needed pass needs every resource it reads.
+void FrameGraph::Cull()
+{
+	GroupBy(m_accesses, m_resources.size(), [](Access const& a) { return a.resource; }, m_byResource, m_resourceOffsets);
+	GroupBy(m_accesses, m_passes.size(), [](Access const& a) { return a.pass; }, m_byPass, m_passOffsets);
+
+	m_worklist.clear();
+	for (Handle i = 0; i < m_resources.size(); ++i)
+	{
+		if (m_resources[i].needed)
+		{
+			m_worklist.push_back(i);
+		}
+	}
+
+	while (!m_worklist.empty())
+	{
+		const Handle resource = m_worklist.back();
+		m_worklist.pop_back();
+
+		for (uint32_t i = m_resourceOffsets[resource]; i < m_resourceOffsets[resource + 1]; ++i)
+		{
+			auto const& access = m_byResource[i];
+			auto& pass = m_passes[access.pass];
+			if (!access.write || pass.needed)
+				continue;
+
+			pass.needed = true;
+
+			for (uint32_t j = m_passOffsets[access.pass]; j < m_passOffsets[access.pass + 1]; ++j)
+			{
+				auto const& read = m_byPass[j];
+				if (!read.write && !m_resources[read.resource].needed)
+				{
+					m_resources[read.resource].needed = true;
+					m_worklist.push_back(read.resource);
+				}
+			}
+		}
+	}
+}
+
+// A resource's writers run in declaration order, and passes that only read
+// it run after all of them. A pass reading and writing the same resource
+// counts as a writer: it sees what the writers declared before it left.
+// Passes free to run are taken in declaration order.
+void FrameGraph::Order()
+{
+	m_edges.clear();
+
+	for (Handle resource = 0; resource < m_resources.size(); ++resource)
+	{
+		const uint32_t begin = m_resourceOffsets[resource];
+		const uint32_t end = m_resourceOffsets[resource + 1];
+
+		auto const writes = [this, begin](Handle pass, uint32_t until)
+		{
+			for (uint32_t i = begin; i < until; ++i)
+			{
+				if (m_byResource[i].write && m_byResource[i].pass == pass)
+					return true;
+			}
+			return false;
+		};
+
+		Handle previousWriter = InvalidHandle;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			auto const& access = m_byResource[i];
+			if (!m_passes[access.pass].needed)
+				continue;
+
+			if (access.write)
+			{
+				// Chain each writer after the previous one, once.
+				if (writes(access.pass, i))
+					continue;
+
+				if (previousWriter != InvalidHandle)
+				{
+					m_edges.emplace_back(previousWriter, access.pass);
+				}
+				previousWriter = access.pass;
+			}
+			else if (!writes(access.pass, end))
+			{
+				for (uint32_t j = begin; j < end; ++j)
+				{
+					auto const& writer = m_byResource[j];
+					if (writer.write && m_passes[writer.pass].needed)
+					{
+						m_edges.emplace_back(writer.pass, access.pass);
+					}
+				}
+			}
+		}
+	}
+
+	std::sort(m_edges.begin(), m_edges.end());
+	m_edges.erase(std::unique(m_edges.begin(), m_edges.end()), m_edges.end());
+
+	m_edgeOffsets.assign(m_passes.size() + 1, 0);
+	m_inDegree.assign(m_passes.size(), 0);
+	for (auto const& edge : m_edges)
+	{
+		m_edgeOffsets[edge.first + 1]++;
+		m_inDegree[edge.second]++;
+	}
+
+	for (size_t i = 0; i < m_passes.size(); ++i)
+	{
+		m_edgeOffsets[i + 1] += m_edgeOffsets[i];
+	}
+
+	m_order.clear();
+	m_ready.clear();
+
+	size_t neededCount = 0;
+	for (Handle pass = 0; pass < m_passes.size(); ++pass)
+	{
+		if (!m_passes[pass].needed)
+			continue;
+
+		neededCount++;
+		if (m_inDegree[pass] == 0)
+		{
+			m_ready.push_back(pass);
+		}
+	}
+
+	// m_edges is sorted by source, so each pass's successors are contiguous.
+	auto const earliest = std::greater<Handle>();
+	std::make_heap(m_ready.begin(), m_ready.end(), earliest);
+
+	while (!m_ready.empty())
+	{
+		std::pop_heap(m_ready.begin(), m_ready.end(), earliest);
+		const Handle pass = m_ready.back();
+		m_ready.pop_back();
+
+		m_order.push_back(pass);
+
+		for (uint32_t i = m_edgeOffsets[pass]; i < m_edgeOffsets[pass + 1]; ++i)
+		{
+			const Handle next = m_edges[i].second;
+			if (--m_inDegree[next] == 0)
+			{
+				m_ready.push_back(next);
+				std::push_heap(m_ready.begin(), m_ready.end(), earliest);
+			}
+		}
+	}
+
+	if (m_order.size() != neededCount)
+	{
+		throw std::logic_error("Frame graph passes depend on each other in a cycle");
+	}
+}
+
+void FrameGraph::AssignLifetimes()
+{
+	for (uint32_t index = 0; index < m_order.size(); ++index)
+	{
+		const Handle pass = m_order[index];
+		for (uint32_t i = m_passOffsets[pass]; i < m_passOffsets[pass + 1]; ++i)
+		{
+			auto& lifetime = m_resources[m_byPass[i].resource].lifetime;
+			if (lifetime.first == InvalidHandle)
+			{
+				lifetime.first = index;
+			}
+			lifetime.last = index;
+		}
+	}
+}
+
+// Interval assignment: transient resources in order of first use each take
+// the compatible physical target that was freed most recently, or a new one.
+void FrameGraph::Alias()
+{
+	m_physical.clear();
+	m_byFirstUse.clear();
+
+	for (Handle i = 0; i < m_resources.size(); ++i)
+	{
+		auto const& resource = m_resources[i];
+		if (resource.transient && resource.lifetime.first != InvalidHandle)
+		{
+			m_byFirstUse.push_back(i);
+		}
+	}
+
+	std::sort(m_byFirstUse.begin(), m_byFirstUse.end(), [this](Handle a, Handle b)
+	{
+		const uint32_t firstA = m_resources[a].lifetime.first;
+		const uint32_t firstB = m_resources[b].lifetime.first;
+		return firstA != firstB ? firstA < firstB : a < b;
+	});
+
+	for (const Handle handle : m_byFirstUse)
+	{
+		auto& resource = m_resources[handle];
+
+		uint32_t best = InvalidHandle;
+		for (uint32_t i = 0; i < m_physical.size(); ++i)
+		{
+			auto const& physical = m_physical[i];
+			if (physical.desc == resource.desc && physical.last < resource.lifetime.first
+				&& (best == InvalidHandle || physical.last > m_physical[best].last))
+			{
+				best = i;
+			}
+		}
+
+		if (best == InvalidHandle)
+		{
+			best = uint32_t(m_physical.size());
+			m_physical.push_back({ resource.desc, 0 });
+		}
+
+		m_physical[best].last = resource.lifetime.last;
+		resource.physical = best;
+	}
+}
+
+void FrameGraph::Execute(RenderTargetPool& pool)
+{
+	if (!m_compiled)
+	{
+		throw std::logic_error("Frame graph must be compiled before it executes");
+	}
+
+	m_targets.assign(m_physical.size(), nullptr);
+
+	auto release = [this, &pool]() noexcept
+	{
+		for (auto& target : m_targets)
+		{
+			if (target)
+			{
+				try
+				{
+					pool.Release(target);
+				}
+				catch (...)
+				{
+				}
+			}
+		}
+		m_targets.clear();
+	};
+
+	try
+	{
+		for (size_t i = 0; i < m_physical.size(); ++i)
+		{
+			m_targets[i] = pool.Acquire(m_physical[i].desc);
+		}
+
+		for (const Handle handle : m_order)
+		{
+			auto const& pass = m_passes[handle];
+			if (pass.execute)
+			{
+				pass.execute(pass.context, *this, pass.id);
+			}
+		}
+	}
+	catch (...)
+	{
+		release();
+		throw;
+	}
+
+	release();
+}
+
+IRenderTarget* FrameGraph::GetTarget(Handle resource) const noexcept
+{
+	const uint32_t physical = m_resources[resource].physical;
+	return physical < m_targets.size() ? m_targets[physical] : nullptr;
+}
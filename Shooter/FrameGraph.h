@@ -0,0 +1,155 @@
+//
+// FrameGraph.h - Orders a frame's passes by what they read and write, and shares transient targets between them
+//
+
+#pragma once
+
+#include "RenderTargetPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Passes are declared each frame with the resources they read and write,
+// then the graph is compiled:
+//
+//  - Passes that contribute nothing to an output resource are culled.
+//  - The rest are ordered so a resource's writers run, in the order they
+//    were declared, before any pass reading it.
+//  - Each transient resource gets a lifetime, the span of compiled passes
+//    touching it. Resources with the same description whose lifetimes don't
+//    overlap share one physical target.
+//
+// Compiling is plain CPU work over indices. Executing acquires the physical
+// targets from a RenderTargetPool and calls the passes in order.
+class FrameGraph
+{
+public:
+	using Handle = uint32_t;
+	static constexpr Handle InvalidHandle = UINT32_MAX;
+
+	// Runs a pass that survived culling. id is the value given to AddPass.
+	using PassFunction = void (*)(void* context, FrameGraph const& graph, uint32_t id);
+
+	// Indices into the compiled order, inclusive. Both are InvalidHandle for
+	// resources no compiled pass touches.
+	struct Lifetime
+	{
+		uint32_t first;
+		uint32_t last;
+	};
+
+	FrameGraph() noexcept;
+
+	FrameGraph(FrameGraph&&) = default;
+	FrameGraph& operator= (FrameGraph&&) = default;
+
+	FrameGraph(FrameGraph const&) = delete;
+	FrameGraph& operator= (FrameGraph const&) = delete;
+
+	// Forgets the declared passes and resources but keeps the memory for the next frame.
+	void Reset() noexcept;
+
+	Handle CreateTransient(const char* name, RenderTargetDesc const& desc);
+
+	// A resource owned outside the graph, such as the back buffer. Passes
+	// writing an output resource are never culled.
+	Handle Import(const char* name, bool output);
+
+	Handle AddPass(const char* name, uint32_t id, PassFunction execute, void* context);
+
+	// Throw std::logic_error for handles the graph didn't hand out.
+	void Read(Handle pass, Handle resource);
+	void Write(Handle pass, Handle resource);
+
+	// Throws std::logic_error if the passes depend on each other in a cycle.
+	void Compile();
+
+	// Passes that survived culling, in execution order.
+	std::vector<Handle> const& GetOrder() const noexcept { return m_order; }
+
+	bool IsCulled(Handle pass) const noexcept { return !m_passes[pass].needed; }
+	uint32_t GetPassId(Handle pass) const noexcept { return m_passes[pass].id; }
+	const char* GetPassName(Handle pass) const noexcept { return m_passes[pass].name; }
+
+	const char* GetResourceName(Handle resource) const noexcept { return m_resources[resource].name; }
+	Lifetime GetLifetime(Handle resource) const noexcept { return m_resources[resource].lifetime; }
+
+	// The physical target a transient resource shares, or InvalidHandle for
+	// imported and unused resources.
+	uint32_t GetPhysicalIndex(Handle resource) const noexcept { return m_resources[resource].physical; }
+	size_t GetPhysicalCount() const noexcept { return m_physical.size(); }
+	RenderTargetDesc const& GetPhysicalDesc(uint32_t physical) const noexcept { return m_physical[physical].desc; }
+
+	// Acquires the physical targets, runs the compiled passes and releases
+	// the targets again. Throws std::logic_error if the graph isn't compiled.
+	void Execute(RenderTargetPool& pool);
+
+	// The target behind a transient resource, only while Execute runs.
+	IRenderTarget* GetTarget(Handle resource) const noexcept;
+
+private:
+	struct Pass
+	{
+		const char* name;
+		uint32_t id;
+		PassFunction execute;
+		void* context;
+		bool needed;
+	};
+
+	struct Resource
+	{
+		const char* name;
+		RenderTargetDesc desc;
+		bool transient;
+		bool output;
+		bool needed;
+		Lifetime lifetime;
+		uint32_t physical;
+	};
+
+	struct Access
+	{
+		Handle pass;
+		Handle resource;
+		bool write;
+	};
+
+	struct Physical
+	{
+		RenderTargetDesc desc;
+		uint32_t last;		// Last compiled pass using it so far, while aliasing
+	};
+
+	void AddAccess(Handle pass, Handle resource, bool write);
+
+	void Cull();
+	void Order();
+	void AssignLifetimes();
+	void Alias();
+
+	std::vector<Pass> m_passes;
+	std::vector<Resource> m_resources;
+	std::vector<Access> m_accesses;
+
+	// Compile results
+	std::vector<Handle> m_order;
+	std::vector<Physical> m_physical;
+	bool m_compiled;
+
+	// Scratch, kept between frames
+	std::vector<Access> m_byResource;
+	std::vector<uint32_t> m_resourceOffsets;
+	std::vector<Access> m_byPass;
+	std::vector<uint32_t> m_passOffsets;
+	std::vector<std::pair<Handle, Handle>> m_edges;
+	std::vector<uint32_t> m_edgeOffsets;
+	std::vector<uint32_t> m_inDegree;
+	std::vector<Handle> m_ready;
+	std::vector<Handle> m_worklist;
+	std::vector<Handle> m_byFirstUse;
+
+	// Valid during Execute
+	std::vector<IRenderTarget*> m_targets;
+};
@@ -0,0 +1,110 @@
+//
+// FrameQueue.cpp
+//
+
+#include "FrameQueue.h"
+
+using namespace FrameQueue;
+
+void FrameQueue::Build(RenderQueue& queue, ViewmodelMode mode, bool upscale, uint32_t roomDepth, Draws const& draws)
+{
+	if (mode == ViewmodelMode::RenderTexture)
+	{
+		queue.Add(SortKey::Make(PASS_VIEWMODEL_TEXTURE, TARGET_VIEWMODEL_TEXTURE, SHADER_MODEL, MATERIAL_WEAPON, 0),
+			draws.weapon, draws.context, PACKET_WEAPON);
+
+		queue.Add(SortKey::Make(PASS_SCENE, TARGET_SCENE, SHADER_PRIMITIVE, MATERIAL_ROOM, roomDepth),
+			draws.room, draws.context, PACKET_ROOM);
+	}
+	else
+	{
+		queue.Add(SortKey::Make(PASS_SCENE, TARGET_SCENE, SHADER_PRIMITIVE, MATERIAL_ROOM, roomDepth),
+			draws.room, draws.context, PACKET_ROOM);
+
+		queue.Add(SortKey::Make(PASS_VIEWMODEL, TARGET_VIEWMODEL, SHADER_MODEL, MATERIAL_WEAPON, 0),
+			draws.weapon, draws.context, PACKET_WEAPON);
+	}
+
+	if (upscale)
+	{
+		queue.Add(SortKey::Make(PASS_UPSCALE, TARGET_BACKBUFFER, SHADER_SPRITE, MATERIAL_SCENE_COLOR, 0),
+			draws.upscale, draws.context, PACKET_UPSCALE);
+	}
+
+	queue.Add(SortKey::Make(PASS_COMPOSITE, TARGET_BACKBUFFER, SHADER_SPRITE, MATERIAL_SPRITES, 0),
+		draws.composite, draws.context, PACKET_COMPOSITE);
+}
+
+Resources FrameQueue::DeclarePasses(FrameGraph& graph, ViewmodelMode mode, bool upscale, RenderTargetDesc const& output,
+	FrameGraph::PassFunction execute, void* context)
+{
+	Resources resources;
+	resources.backBuffer = graph.Import("Back buffer", true);
+	resources.depth = graph.Import("Depth", false);
+	resources.viewmodelTexture = FrameGraph::InvalidHandle;
+	resources.scene = upscale ? graph.CreateTransient("Scene", output) : FrameGraph::InvalidHandle;
+
+	// Where the scene and, in DepthPartition mode, the weapon are drawn.
+	const FrameGraph::Handle sceneColor = upscale ? resources.scene : resources.backBuffer;
+
+	if (mode == ViewmodelMode::RenderTexture)
+	{
+		resources.viewmodelTexture = graph.CreateTransient("Viewmodel texture", output);
+
+		auto const weapon = graph.AddPass(GetPassName(PASS_VIEWMODEL_TEXTURE), PASS_VIEWMODEL_TEXTURE, execute, context);
+		graph.Write(weapon, resources.viewmodelTexture);
+		graph.Write(weapon, resources.depth);
+
+		auto const room = graph.AddPass(GetPassName(PASS_SCENE), PASS_SCENE, execute, context);
+		graph.Write(room, sceneColor);
+		graph.Write(room, resources.depth);
+	}
+	else
+	{
+		auto const room = graph.AddPass(GetPassName(PASS_SCENE), PASS_SCENE, execute, context);
+		graph.Write(room, sceneColor);
+		graph.Write(room, resources.depth);
+
+		auto const weapon = graph.AddPass(GetPassName(PASS_VIEWMODEL), PASS_VIEWMODEL, execute, context);
+		graph.Write(weapon, sceneColor);
+		graph.Write(weapon, resources.depth);
+	}
+
+	if (upscale)
+	{
+		auto const pass = graph.AddPass(GetPassName(PASS_UPSCALE), PASS_UPSCALE, execute, context);
+		graph.Read(pass, resources.scene);
+		graph.Write(pass, resources.backBuffer);
+	}
+
+	auto const composite = graph.AddPass(GetPassName(PASS_COMPOSITE), PASS_COMPOSITE, execute, context);
+	if (mode == ViewmodelMode::RenderTexture)
+	{
+		graph.Read(composite, resources.viewmodelTexture);
+	}
+	graph.Write(composite, resources.backBuffer);
+
+	return resources;
+}
+
+const char* FrameQueue::GetPassName(uint32_t pass) noexcept
+{
+	switch (pass)
+	{
+	case PASS_VIEWMODEL_TEXTURE:
+	case PASS_VIEWMODEL:
+		return "Weapon";
+
+	case PASS_SCENE:
+		return "Room";
+
+	case PASS_UPSCALE:
+		return "Upscale";
+
+	case PASS_COMPOSITE:
+		return "Composite";
+
+	default:
+		return nullptr;
+	}
+}
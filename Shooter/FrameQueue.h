@@ -0,0 +1,115 @@
+//
+// FrameQueue.h - The packets Game::Render submits each frame
+//
+
+#pragma once
+
+#include "RenderQueue.h"
+#include "FrameGraph.h"
+
+// How the weapon gets its own projection without being clipped by the world.
+enum class ViewmodelMode
+{
+	// Drawn straight into the back buffer after the scene, through a viewport
+	// whose depth range sits in front of everything the scene can write.
+	DepthPartition,
+
+	// Drawn into a full-screen render texture and composited over the scene
+	// with SpriteBatch. Costs an extra full-screen clear, write and read.
+	RenderTexture,
+};
+
+namespace FrameQueue
+{
+	// Passes run in this order. Only one of the two viewmodel passes is used,
+	// depending on the mode, and the upscale only runs when the scene is
+	// rendered below the output resolution.
+	enum Pass : uint32_t
+	{
+		PASS_VIEWMODEL_TEXTURE,
+		PASS_SCENE,
+		PASS_VIEWMODEL,
+		PASS_UPSCALE,
+		PASS_COMPOSITE,
+		PASS_COUNT,
+	};
+
+	// The renderer registers a render target, depth buffer and viewport for
+	// each. Scene color is the back buffer, or the scene target when upscaling,
+	// and is drawn through the scene viewport.
+	enum Target : uint32_t
+	{
+		TARGET_VIEWMODEL_TEXTURE,	// Render texture with depth, full viewport
+		TARGET_BACKBUFFER,			// Back buffer without depth, full viewport
+		TARGET_SCENE,				// Scene color with depth; depth range [ViewmodelDepthRange, 1] in DepthPartition mode, depth cleared after the weapon in RenderTexture mode
+		TARGET_VIEWMODEL,			// Scene color with depth, depth range [0, ViewmodelDepthRange]
+	};
+
+	enum Shader : uint32_t
+	{
+		SHADER_MODEL,
+		SHADER_PRIMITIVE,
+		SHADER_SPRITE,
+		SHADER_PRIMITIVE_INSTANCED,
+	};
+
+	enum Material : uint32_t
+	{
+		MATERIAL_WEAPON,
+		MATERIAL_ROOM,
+		MATERIAL_SPRITES,
+		MATERIAL_SCENE_COLOR,
+		MATERIAL_PROP,
+	};
+
+	// Meshes drawn instanced, grouped by InstanceBatcher.
+	enum Mesh : uint32_t
+	{
+		MESH_PROP,
+	};
+
+	// Passed as the packet param so backends can tell the packets apart.
+	enum Packet : uint32_t
+	{
+		PACKET_WEAPON,
+		PACKET_ROOM,
+		PACKET_COMPOSITE,
+		PACKET_UPSCALE,
+	};
+
+	// Share of the depth range reserved for the weapon in DepthPartition mode.
+	constexpr float ViewmodelDepthRange = 0.05f;
+
+	struct Draws
+	{
+		RenderPacket::DrawFunction weapon;
+		RenderPacket::DrawFunction room;
+		RenderPacket::DrawFunction composite;	// Crosshair, plus the render texture in RenderTexture mode
+		RenderPacket::DrawFunction upscale;		// Scene target onto the back buffer
+		void* context;
+	};
+
+	// Adds one frame's packets. roomDepth is a SortKey::QuantizeDepth value.
+	// With upscale set the scene is drawn into a scene target and stretched
+	// over the back buffer before the composite.
+	void Build(RenderQueue& queue, ViewmodelMode mode, bool upscale, uint32_t roomDepth, Draws const& draws);
+
+	// What the frame's passes read and write.
+	struct Resources
+	{
+		FrameGraph::Handle backBuffer;
+		FrameGraph::Handle depth;
+		FrameGraph::Handle viewmodelTexture;	// InvalidHandle in DepthPartition mode
+		FrameGraph::Handle scene;				// InvalidHandle unless upscaling
+	};
+
+	// Declares the passes Build fills so a frame graph can order them and
+	// place the render texture and scene target. Each pass's id is its Pass
+	// value. output describes the back buffer; both targets match it, the
+	// scene is scaled through its viewport.
+	Resources DeclarePasses(FrameGraph& graph, ViewmodelMode mode, bool upscale, RenderTargetDesc const& output,
+		FrameGraph::PassFunction execute, void* context);
+
+	// Name used for GPU timings.
+	const char* GetPassName(uint32_t pass) noexcept;
+}
@@ -0,0 +1,95 @@
+//
+// FrameRingAllocator.cpp
+//
+
+#include "FrameRingAllocator.h"
+
+#include <stdexcept>
+
+FrameRingAllocator::FrameRingAllocator(uint64_t capacity, uint32_t maxFramesInFlight) :
+	m_capacity(capacity),
+	m_head(0),
+	m_used(0),
+	m_currentSize(0),
+	m_firstFrame(0),
+	m_frameCount(0),
+	m_lastFence(0),
+	m_stats{}
+{
+	if (capacity == 0)
+		throw std::invalid_argument("Frame ring capacity must not be zero");
+
+	if (maxFramesInFlight == 0)
+		throw std::invalid_argument("Frame ring needs at least one frame in flight");
+
+	m_frames.resize(maxFramesInFlight);
+}
+
+uint64_t FrameRingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+		throw std::invalid_argument("Frame ring alignment must be a power of two");
+
+	// The used bytes are one contiguous run of the ring ending at the head,
+	// so anything taken walking forward from the head, skipped tail
+	// included, comes out of the free run after it.
+	uint64_t offset = (m_head + alignment - 1) & ~(alignment - 1);
+	bool wrapped = false;
+	if (offset > m_capacity || size > m_capacity - offset)
+	{
+		offset = 0;
+		wrapped = true;
+	}
+
+	const uint64_t padding = wrapped ? m_capacity - m_head : offset - m_head;
+	if (size > m_capacity || padding + size > m_capacity - m_used)
+	{
+		m_stats.failures++;
+		return InvalidOffset;
+	}
+
+	m_head = offset + size;
+	m_used += padding + size;
+	m_currentSize += padding + size;
+
+	m_stats.allocations++;
+	m_stats.allocatedBytes += size;
+	m_stats.paddingBytes += padding;
+	if (wrapped)
+	{
+		m_stats.wraps++;
+	}
+
+	return offset;
+}
+
+void FrameRingAllocator::EndFrame(uint64_t fence)
+{
+	if (m_frameCount == m_frames.size())
+		throw std::logic_error("Too many frames in flight for the frame ring");
+
+	if (fence <= m_lastFence)
+		throw std::invalid_argument("Frame ring fences must increase");
+
+	m_frames[(m_firstFrame + m_frameCount) % m_frames.size()] = { fence, m_currentSize };
+	m_frameCount++;
+	m_lastFence = fence;
+	m_currentSize = 0;
+}
+
+void FrameRingAllocator::Retire(uint64_t completedFence) noexcept
+{
+	while (m_frameCount > 0 && m_frames[m_firstFrame].fence <= completedFence)
+	{
+		m_used -= m_frames[m_firstFrame].size;
+		m_firstFrame = uint32_t((m_firstFrame + 1) % m_frames.size());
+		m_frameCount--;
+	}
+
+	// With nothing left in use, start again at the front so the next frame
+	// doesn't have to skip a tail.
+	if (m_used == 0)
+	{
+		m_head = 0;
+	}
+}
@@ -0,0 +1,90 @@
+//
+// FrameRingAllocator.h - Linear suballocation of per-frame GPU data from a fenced ring
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hands out ranges of one large buffer, front to back, to data written once
+// per frame: constants, instance streams, sprite vertices. A frame's ranges
+// are freed together once the GPU has signalled the fence the frame ended
+// with, so nothing the GPU may still read is written over.
+//
+// An allocation never straddles the end of the buffer; if it doesn't fit
+// before the end it starts over at offset 0 and the tail is skipped. The
+// allocator only deals in offsets and knows nothing about the buffer itself.
+class FrameRingAllocator
+{
+public:
+	static constexpr uint64_t InvalidOffset = ~uint64_t(0);
+
+	struct Stats
+	{
+		uint64_t allocations;
+		uint64_t allocatedBytes;		// Requested sizes
+		uint64_t paddingBytes;			// Lost to alignment and to skipped tails
+		uint64_t failures;				// Allocations that didn't fit
+		uint64_t wraps;					// Allocations that started over at offset 0
+	};
+
+	// Throws std::invalid_argument if the capacity or frame count is zero.
+	FrameRingAllocator(uint64_t capacity, uint32_t maxFramesInFlight);
+
+	FrameRingAllocator(FrameRingAllocator&&) = default;
+	FrameRingAllocator& operator= (FrameRingAllocator&&) = default;
+
+	FrameRingAllocator(FrameRingAllocator const&) = delete;
+	FrameRingAllocator& operator= (FrameRingAllocator const&) = delete;
+
+	// Returns the offset of size bytes aligned to alignment, a power of two,
+	// or InvalidOffset when the free space can't hold them until more frames
+	// retire. Throws std::invalid_argument for other alignments.
+	uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+	// Closes the current frame's allocations under the fence the GPU will
+	// signal once it's done with them. Fences start above zero and must
+	// increase from frame to frame, or std::invalid_argument is thrown.
+	// Throws std::logic_error if maxFramesInFlight frames are pending
+	// already; wait for GetOldestPendingFence and Retire first.
+	void EndFrame(uint64_t fence);
+
+	// Frees every ended frame whose fence is at most completedFence.
+	void Retire(uint64_t completedFence) noexcept;
+
+	uint32_t GetPendingFrameCount() const noexcept { return m_frameCount; }
+	uint32_t GetMaxFramesInFlight() const noexcept { return uint32_t(m_frames.size()); }
+
+	// The fence to wait for to free the oldest frame. Only valid while frames are pending.
+	uint64_t GetOldestPendingFence() const noexcept { return m_frames[m_firstFrame].fence; }
+
+	uint64_t GetCapacity() const noexcept { return m_capacity; }
+
+	// Bytes held by pending frames and the current one, padding included.
+	uint64_t GetUsedBytes() const noexcept { return m_used; }
+
+	Stats const& GetStats() const noexcept { return m_stats; }
+	void ResetStats() noexcept { m_stats = {}; }
+
+private:
+	struct Frame
+	{
+		uint64_t fence;
+		uint64_t size;					// Bytes the frame took, padding included
+	};
+
+	uint64_t m_capacity;
+	uint64_t m_head;					// Where the next allocation starts looking
+	uint64_t m_used;
+	uint64_t m_currentSize;				// Taken by the frame not yet ended
+
+	// Ended frames, oldest first, in a ring of maxFramesInFlight slots
+	std::vector<Frame> m_frames;
+	uint32_t m_firstFrame;
+	uint32_t m_frameCount;
+	uint64_t m_lastFence;				// Zero before the first frame ends
+
+	Stats m_stats;
+};
@@ -4,8 +4,12 @@
 
 #include "pch.h"
 #include "Game.h"
-#include <Helpers.h>
+#include "D3D11GpuProfiler.h"
+#include "D3D11RenderBackend.h"
+#include "D3D11RenderTargetDevice.h"
+#include "GameAssets.h"
 #include <SpriteBatch.h>
+#include <random>
 
 extern void ExitGame() noexcept;
 
@@ -14,48 +18,115 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
+using namespace FrameQueue;
+
 namespace
 {
-	// Dumb hardcoded shit
-	const XMVECTORF32 START_POSITION			= { 0.f, 2.0f, 0.f, 0.f };
+	// Rate the player simulation is stepped at, independent of the display rate.
+	const double SIMULATION_RATE = 60.0;
+
+	// The frame ring holds this many frames' vertex data at the least, and
+	// as many frames as the swap chain queues up before waiting.
+	const size_t FRAME_RING_BYTES = 4 * 1024 * 1024;
+	const uint32_t FRAMES_IN_FLIGHT = 3;
+
+	// Our own shaders' constants, a 256 byte aligned range per draw, come
+	// out of a ring of their own: a few hundred draws' worth a frame.
+	const size_t CONSTANT_RING_BYTES = 1024 * 1024;
+
+	// Room for the room, the props and a good few more meshes of their format.
+	const uint32_t MESH_ARENA_VERTICES = 64 * 1024;
+	const uint32_t MESH_ARENA_INDICES = 192 * 1024;
+
+	// Room for the weapon and a few more cooked models with quantized vertices.
+	const uint32_t MODEL_ARENA_VERTICES = 64 * 1024;
+	const uint32_t MODEL_ARENA_INDICES = 192 * 1024;
+
+	// Assets are read on their own workers and created a few a frame, so
+	// uploads spread over frames instead of stalling one.
+	const unsigned ASSET_LOADER_WORKERS = 2;
+	const uint32_t ASSET_CREATES_PER_FRAME = 2;
+
+	// Threads that decode a compressed asset's blocks in parallel.
+	const unsigned ASSET_DECOMPRESS_WORKERS = 2;
+
+	// Only the archive is deployed. Assets it doesn't hold, or all of them
+	// without it, load from their loose files, which is for runs from the
+	// source tree while an asset is being worked on.
+	std::filesystem::path GetAssetPath(const char* name)
+	{
+		return std::filesystem::path(GameAssets::Directory) / name;
+	}
 
-	// Controller
-	const float ROTATION_GAIN					= 3.8f;
-	const float AIMING_ROTATION_GAIN			= 1.8f;
+	// Decoded assets kept for device restore, least recently used dropped
+	// past this.
+	const uint64_t ASSET_CACHE_BUDGET = 64 * 1024 * 1024;
 
-	// Mouse + Keyboard
-	const float MOUSE_ROTATION_GAIN				= 0.35f;
-	const float MOUSE_AIMING_ROTATION_GAIN		= 0.195f;
+	// What the room is textured with until its texture is ready.
+	const uint32_t PLACEHOLDER_TEXTURE_COLOR = 0xFF808080;
 
-	// Both
-	const float MOVEMENT_GAIN					= 3.7f;
-	const float MOVEMENT_SPRINTING_GAIN			= 7.7f;
+	// Gathers the device state read by the player simulation.
+	PlayerInput MakePlayerInput(GamePad::State const& pad, Mouse::State const& mouse, Keyboard::State const& kb) noexcept
+	{
+		PlayerInput input;
+
+		input.padConnected = pad.IsConnected();
+		if (input.padConnected)
+		{
+			input.leftTrigger = pad.triggers.left;
+			input.leftStickX = pad.thumbSticks.leftX;
+			input.leftStickY = pad.thumbSticks.leftY;
+			input.rightStickX = pad.thumbSticks.rightX;
+			input.rightStickY = pad.thumbSticks.rightY;
+			input.leftStickPressed = pad.IsLeftStickPressed();
+		}
+
+		input.mouseLeft = mouse.leftButton;
+		input.mouseMiddle = mouse.middleButton;
+		input.mouseRight = mouse.rightButton;
+		input.mouseRelative = mouse.positionMode == Mouse::MODE_RELATIVE;
+		input.mouseX = mouse.x;
+		input.mouseY = mouse.y;
+
+		input.keyForward = kb.Up || kb.W;
+		input.keyBack = kb.Down || kb.S;
+		input.keyLeft = kb.Left || kb.A;
+		input.keyRight = kb.Right || kb.D;
+		input.keySprint = kb.LeftShift;
+
+		return input;
+	}
 
-	const float CROSSHAIR_SPREAD				= 20;
-	const float CROSSHAIR_SPREAD_SPRINTING		= 45;
+	// The state GeometricPrimitive draws with, for meshes drawn from the arena.
+	void SetOpaqueMeshStates(ID3D11DeviceContext* context, CommonStates const& states)
+	{
+		context->OMSetBlendState(states.Opaque(), nullptr, 0xFFFFFFFF);
+		context->OMSetDepthStencilState(states.DepthDefault(), 0);
+		context->RSSetState(states.CullCounterClockwise());
 
-	// Weapon
-	constexpr Vector3 WEAPON_POSITION			= { 3.0f, -1.0f, -7.0f };
-	constexpr Vector3 WEAPON_POSITION_AIMING	= { 0.0f, 0.0f, -1.2f };
+		ID3D11SamplerState* sampler = states.LinearWrap();
+		context->PSSetSamplers(0, 1, &sampler);
+	}
 }
 
 Game::Game() noexcept(false) :
-	m_pitch(0),
-	m_yaw(0),
-	m_cameraPos(START_POSITION),
+	m_presentTime{},
+	m_reportedGpuFrame(0),
+	m_gpuFrameMs(-1.0),
+	m_weaponAsset(0),
+	m_roomTexAsset(0),
+	m_crosshairAsset(0),
+	m_crosshairHAsset(0),
+	m_roomMesh(MeshArena::InvalidMesh),
+	m_propMesh(MeshArena::InvalidMesh),
+	m_occluderCount(0),
 	m_roomColor(Colors::White),
-	m_weaponOffset(WEAPON_POSITION),
-	m_weaponRotation(Vector3::Zero),
-	m_hipfire_fov(100.0f),
-	m_aiming_fov(70.0f),
-	m_fov(1.0f),
-	m_using_keyboard(false),
+	m_propColor(Colors::SlateGray),
+	m_roomTex(nullptr),
+	m_fov(0.0f),
 	m_near(0.01f),
 	m_far(5000.0f),
-	m_sprinting(false),
-	m_steps(0.0f),
-	m_aiming(false),
-	m_crosshair_spread(CROSSHAIR_SPREAD)
+	m_viewmodelMode(ViewmodelMode::DepthPartition)
 {
 	m_deviceResources = std::make_unique<DX::DeviceResources>();
 	// TODO: Provide parameters for swapchain format, depth/stencil format, and backbuffer count.
@@ -63,8 +134,14 @@ Game::Game() noexcept(false) :
 	//   Add DX::DeviceResources::c_EnableHDR for HDR10 display.
 	m_deviceResources->RegisterDeviceNotify(this);
 
-	m_renderTexture = std::make_unique<DX::RenderTexture>(
-		m_deviceResources->GetBackBufferFormat());
+	m_previousPlayer = m_player.GetState();
+	m_renderPlayer = m_previousPlayer;
+	m_fov = m_previousPlayer.fov;
+}
+
+Game::~Game()
+{
+	WriteTrace();
 }
 
 // Initialize the Direct3D resources required to run.
@@ -72,18 +149,26 @@ void Game::Initialize(::IUnknown* window, int width, int height, DXGI_MODE_ROTAT
 {
 	m_deviceResources->SetWindow(window, width, height, rotation);
 
+	// Neither the archive nor the cache of decoded assets depends on the
+	// device, so they survive device loss: the archive stays mapped, and
+	// restoring the device only uploads the cached assets again.
+	const std::filesystem::path archivePath = GetAssetPath(GameAssets::Archive);
+	if (std::filesystem::exists(archivePath))
+	{
+		PROFILE_SCOPE("Open asset archive");
+		m_assetArchive = std::make_unique<AssetArchive::Reader>(archivePath);
+	}
+	m_assetCache = std::make_unique<AssetCache>(ASSET_CACHE_BUDGET);
+
 	m_deviceResources->CreateDeviceResources();
 	CreateDeviceDependentResources();
 
 	m_deviceResources->CreateWindowSizeDependentResources();
 	CreateWindowSizeDependentResources();
 
-	// TODO: Change the timer settings if you want something other than the default variable timestep mode.
-	// e.g. for 60 FPS fixed timestep update logic, call:
-	/*
+	// Simulate at a fixed rate and interpolate between steps when rendering.
 	m_timer.SetFixedTimeStep(true);
-	m_timer.SetTargetElapsedSeconds(1.0 / 60);
-	*/
+	m_timer.SetTargetElapsedSeconds(1.0 / SIMULATION_RATE);
 
 	m_gamePad = std::make_unique<GamePad>();
 	m_keyboard = std::make_unique<Keyboard>();
@@ -96,33 +181,65 @@ void Game::Initialize(::IUnknown* window, int width, int height, DXGI_MODE_ROTAT
 #pragma region Frame Update
 void Game::Tick()
 {
+	PROFILE_SCOPE("Tick");
+
+	using clock = std::chrono::steady_clock;
+	using milliseconds = std::chrono::duration<double, std::milli>;
+
+	auto const tickStart = clock::now();
+	clock::duration updateTime{};
+
 	m_timer.Tick([&]()
 		{
+			auto const updateStart = clock::now();
 			Update(m_timer);
+			updateTime += clock::now() - updateStart;
 		});
 
+	auto const renderStart = clock::now();
 	Render();
-}
+	auto const renderTime = clock::now() - renderStart;
 
-// Updates the world.
-void Game::Update(DX::StepTimer const& timer)
-{
-	float elapsedTime = float(timer.GetElapsedSeconds());
+	if (m_dynamicResolution)
+	{
+		// CPU time leaves out Present, which waits on the GPU when it's behind.
+		m_dynamicResolution->AddFrame(milliseconds(updateTime + renderTime - m_presentTime).count(), m_gpuFrameMs);
+		m_gpuFrameMs = -1.0;
+	}
 
-	//---------------------------------------------
-	// Update FOV on change
-	// --------------------------------------------
-	if (m_fov != m_fov_previous) {
-		auto size = m_deviceResources->GetOutputSize();
-		m_proj = Matrix::CreatePerspectiveFieldOfView(
-			XMConvertToRadians(m_fov),
-			float(size.right) / float(size.bottom), m_near, m_far);
+	if (m_benchmark)
+	{
+		// Frame time spans tick to tick, so it includes Present and event processing.
+		if (m_lastTickStart != clock::time_point{})
+		{
+			m_benchmark->AddFrame(milliseconds(tickStart - m_lastTickStart).count(),
+				milliseconds(updateTime).count(), milliseconds(renderTime).count());
+		}
 
-		m_fov_previous = m_fov;
+		if (m_benchmark->IsComplete())
+		{
+			try
+			{
+				m_benchmark->WriteReport();
+			}
+			catch (std::exception const& e)
+			{
+				OutputDebugStringA(e.what());
+				OutputDebugStringA("\n");
+			}
+
+			m_benchmark.reset();
+			ExitGame();
+		}
 	}
 
-	// Movement vector
-	Vector3 move = Vector3::Zero;
+	m_lastTickStart = tickStart;
+}
+
+// Updates the world.
+void Game::Update(DX::StepTimer const& timer)
+{
+	PROFILE_SCOPE("Update");
 
 	//---------------------------------------------
 	// Gamepad
@@ -137,50 +254,6 @@ void Game::Update(DX::StepTimer const& timer)
 			// TODO: Replace with pause menu
 			ExitGame();
 		}
-
-		// Aiming
-		if (pad.triggers.left > 0.2f) {
-			m_aiming = true;
-			m_using_keyboard = false;
-		}
-		else {
-			m_aiming = false;
-		}
-
-		// Movement
-		{
-			if (pad.IsLeftThumbStickLeft()) {
-				move.x = -pad.thumbSticks.leftX;
-				m_using_keyboard = false;
-			}
-			if (pad.IsLeftThumbStickRight()) {
-				move.x = -pad.thumbSticks.leftX;
-				m_using_keyboard = false;
-			}
-			if (pad.IsLeftThumbStickUp()) {
-				move.z = pad.thumbSticks.leftY;
-				m_using_keyboard = false;
-			}
-			if (pad.IsLeftThumbStickDown()) {
-				move.z = pad.thumbSticks.leftY;
-				m_using_keyboard = false;
-			}
-
-			if (!pad.IsLeftThumbStickLeft() && !pad.IsLeftThumbStickRight() && !pad.IsLeftThumbStickUp() && !pad.IsLeftThumbStickDown() && m_sprinting && !m_using_keyboard) {
-				m_sprinting = false;
-			}
-
-			if (pad.IsLeftStickPressed()) {
-				m_sprinting = true;
-			}
-		}
-
-		// Rotation
-		{
-			if (pad.IsRightThumbStickDown() || pad.IsRightThumbStickUp() || pad.IsRightThumbStickLeft() || pad.IsRightThumbStickRight()) m_using_keyboard = false;
-			m_yaw += -pad.thumbSticks.rightX * ROTATION_GAIN * elapsedTime;
-			m_pitch += pad.thumbSticks.rightY * ROTATION_GAIN * elapsedTime;
-		}
 	}
 	else {
 		m_buttons.Reset();
@@ -190,24 +263,7 @@ void Game::Update(DX::StepTimer const& timer)
 	// Mouse
 	// --------------------------------------------
 	auto mouse = m_mouse->GetState();
-	if (m_using_keyboard) {
-		m_mouseButtons.Update(mouse);
-		m_aiming = mouse.rightButton;
-	}
-
-	if (mouse.leftButton || mouse.middleButton || mouse.rightButton)  m_using_keyboard = true;
-
-	if (mouse.positionMode == Mouse::MODE_RELATIVE)
-	{
-		Vector3 delta = Vector3(float(mouse.x), float(mouse.y), 0.f)
-			* (m_aiming ? MOUSE_AIMING_ROTATION_GAIN : MOUSE_ROTATION_GAIN) * elapsedTime;
-
-		m_pitch -= delta.y;
-		m_yaw -= delta.x;
-	}
-
-	// TODO: Replace with actual logic
-	m_mouse->SetMode(Mouse::MODE_RELATIVE);
+	m_mouseButtons.Update(mouse);
 
 	//---------------------------------------------
 	// Keyboard
@@ -217,213 +273,446 @@ void Game::Update(DX::StepTimer const& timer)
 	{
 		// TODO: Replace with pause menu
 		ExitGame();
-		m_using_keyboard = true;
 	}
 
 	m_keys.Update(kb);
 
-	if (kb.Up || kb.W) {
-		move.z = 1.0f;
-		m_using_keyboard = true;
+	//---------------------------------------------
+	// Player
+	// --------------------------------------------
+	PlayerInput input;
+	uint64_t elapsedTicks = timer.GetElapsedTicks();
+
+	if (m_benchmark)
+	{
+		// The script follows simulated time so every run takes the same path.
+		input = m_benchmark->NextInput(DX::StepTimer::TicksToSeconds(elapsedTicks));
 	}
+	// A replay substitutes both the input and the tick length of the recorded run.
+	else if (!m_inputReplay || !NextReplayInput(elapsedTicks, input))
+	{
+		if (m_inputReplay)
+		{
+			// Recordings end with a checkpoint when the recording run was suspended last.
+			const uint64_t ticks = m_inputReplay->GetPosition();
+			const uint64_t checksum = PlayerSimulation::Checksum(m_player.GetState());
+			auto const checkpoint = m_inputReplay->GetLastCheckpoint();
+			const char* verdict = "";
+			if (m_inputReplay->GetCheckpointCount() > 0 && checkpoint.position == ticks)
+			{
+				verdict = checkpoint.checksum == checksum ? ", as recorded" : ", DIFFERENT from the recorded run";
+			}
+
+			char buff[160] = {};
+			sprintf_s(buff, "Input replay finished after %llu ticks, state checksum %016llx%s\n", ticks, checksum, verdict);
+			OutputDebugStringA(buff);
+
+			m_inputReplay.reset();
+		}
 
-	if (kb.Down || kb.S) {
-		move.z = -1.0f;
-		m_using_keyboard = true;
+		input = MakePlayerInput(pad, mouse, kb);
 	}
 
-	if (kb.Left || kb.A) {
-		move.x = 1.0f;
-		m_using_keyboard = true;
+	if (m_inputRecorder)
+	{
+		m_inputRecorder->Record(elapsedTicks, input);
 	}
 
-	if (kb.Right || kb.D) {
-		move.x = -1.0f;
-		m_using_keyboard = true;
+	m_previousPlayer = m_player.GetState();
+	m_player.Step(input, float(DX::StepTimer::TicksToSeconds(elapsedTicks)));
+
+	// TODO: Replace with actual logic
+	m_mouse->SetMode(Mouse::MODE_RELATIVE);
+
+	// TODO: Remove
+	if (m_buttons.a == GamePad::ButtonStateTracker::PRESSED || m_keys.pressed.Tab)
+	{
+		if (m_roomColor == Colors::Red.v)
+			m_roomColor = Colors::Green;
+		else if (m_roomColor == Colors::Green.v)
+			m_roomColor = Colors::Blue;
+		else if (m_roomColor == Colors::Blue.v)
+			m_roomColor = Colors::White;
+		else
+			m_roomColor = Colors::Red;
 	}
+}
+#pragma endregion
 
-	if (kb.LeftShift) {
-		if (m_using_keyboard) m_sprinting = true;
-		m_using_keyboard = true;
+#pragma region Frame Render
+// Draws the scene.
+void Game::Render()
+{
+	PROFILE_SCOPE("Render");
+
+	m_presentTime = {};
+
+	// Don't try to render anything before the first Update.
+	if (m_timer.GetFrameCount() == 0)
+	{
+		return;
 	}
-	else {
-		if (m_using_keyboard) m_sprinting = false;
-		m_using_keyboard = true;
+
+	// Blend the last two simulation steps by how far we are into the next one.
+	m_renderPlayer = PlayerSimulation::Interpolate(m_previousPlayer, m_player.GetState(),
+		float(m_timer.GetInterpolationAlpha()));
+	auto const& player = m_renderPlayer;
+
+	// Update FOV on change
+	if (player.fov != m_fov) {
+		m_fov = player.fov;
+
+		auto size = m_deviceResources->GetOutputSize();
+		m_proj = Matrix::CreatePerspectiveFieldOfView(
+			XMConvertToRadians(m_fov),
+			float(size.right) / float(size.bottom), m_near, m_far);
 	}
 
-	//---------------------------------------------
-	// Agnostic control
-	// --------------------------------------------
+	m_view = PlayerSimulation::GetViewMatrix(player);
 
-	if (m_aiming) m_sprinting = false;
+	// Create what the loader's workers finished since the last frame.
+	m_assetLoader->Update(ASSET_CREATES_PER_FRAME);
 
-	// Change FOV based on aiming state
-	m_fov = (m_aiming ?
-		Helpers::Lerp(m_hipfire_fov, m_aiming_fov, m_fov, elapsedTime * 200) :
-		Helpers::Lerp(m_aiming_fov, m_hipfire_fov, m_fov, elapsedTime * 200));
+	auto const roomTex = DX::D3D11AssetDevice::GetTexture(m_assetLoader->Get(m_roomTexAsset));
+	if (roomTex != m_roomTex)
+	{
+		m_roomTex = roomTex;
+		m_roomEffect->SetTexture(m_roomTex);
+		m_propEffect->SetTexture(m_roomTex);
+	}
+
+	{
+		PROFILE_SCOPE("Cull");
+		const Matrix viewProjection = m_view * m_proj;
+		m_props.Cull(Frustum::FromViewProjection(viewProjection), m_visibleProps);
 
-	if (!(m_sprinting && m_walking)) {
-		m_weaponOffset = (m_aiming ?
-			Helpers::LerpVector3(WEAPON_POSITION, WEAPON_POSITION_AIMING, m_weaponOffset, elapsedTime * 35) :
-			Helpers::LerpVector3(WEAPON_POSITION_AIMING, WEAPON_POSITION, m_weaponOffset, elapsedTime * 35));
+		if (m_occlusionCuller)
+		{
+			CullOccludedProps(viewProjection);
+		}
 	}
 
-	m_crosshair_spread = (m_aiming ?
-		Helpers::Lerp(CROSSHAIR_SPREAD_SPRINTING, 15.0f, m_crosshair_spread, elapsedTime * 200) :
-		(m_sprinting && m_walking) ?
-		0 :
-		m_walking ? 
-		Helpers::Lerp(m_crosshair_spread < CROSSHAIR_SPREAD ? 15 : CROSSHAIR_SPREAD, CROSSHAIR_SPREAD + 10, m_crosshair_spread, elapsedTime * 200) :
-		Helpers::Lerp(m_crosshair_spread < CROSSHAIR_SPREAD ? 15 : CROSSHAIR_SPREAD + 10, CROSSHAIR_SPREAD, m_crosshair_spread, elapsedTime * 200));
+	m_gpuProfiler->BeginFrame();
+
+	{
+		GpuPassScope pass(m_gpuProfiler.get(), "Clear");
+		Clear();
+	}
 
-	m_walking = move.x != 0 || move.y != 0 || move.z != 0;
+	auto const viewport = m_deviceResources->GetScreenViewport();
 
-	if (m_sprinting && m_walking) m_steps += elapsedTime * 15;
-	else if (m_walking) m_steps += elapsedTime * 10;
-	else m_steps = 0.0f;
+	// The scene covers the top left of its target at the dynamic resolution
+	// scale, and is stretched over the back buffer when that's below one.
+	const bool upscale = m_dynamicResolution && m_dynamicResolution->IsScaled();
 
-	if (m_sprinting && m_walking) {
-		m_weaponRotation = Helpers::LerpVector3(Vector3::Zero, Vector3(-0.52359885040181208815, 0.872665f, 0.0f), m_weaponRotation, elapsedTime * 10);
-		m_weaponOffset = Helpers::LerpVector3(WEAPON_POSITION, WEAPON_POSITION + Vector3(-1.f, -0.2f, 4.f), m_weaponOffset, elapsedTime * 100);
+	m_sceneViewport = viewport;
+	if (upscale)
+	{
+		const float scale = m_dynamicResolution->GetScale();
+		m_sceneViewport.Width = float(DynamicResolution::ScaleSize(uint32_t(viewport.Width), scale));
+		m_sceneViewport.Height = float(DynamicResolution::ScaleSize(uint32_t(viewport.Height), scale));
 	}
-	else {
-		m_weaponRotation = Helpers::LerpVector3(Vector3(-0.174533f, 0.872665f, 0.0f), Vector3::Zero, m_weaponRotation, elapsedTime * 10);
+
+	// The other targets are registered when their passes run, see ExecutePass.
+	m_renderBackend->SetTarget(TARGET_BACKBUFFER, m_deviceResources->GetRenderTargetView(), nullptr, viewport);
+
+	Draws draws;
+	draws.weapon = [](void* game, uint32_t) { static_cast<Game*>(game)->DrawWeapon(); };
+	draws.room = [](void* game, uint32_t) { static_cast<Game*>(game)->DrawRoom(); };
+	draws.composite = [](void* game, uint32_t) { static_cast<Game*>(game)->DrawComposite(); };
+	draws.upscale = [](void* game, uint32_t) { static_cast<Game*>(game)->DrawUpscale(); };
+	draws.context = this;
+
+	const float roomDistance = Vector3(player.position).Length();
+
+	m_renderQueue.Clear();
+	FrameQueue::Build(m_renderQueue, m_viewmodelMode, upscale, SortKey::QuantizeDepth(roomDistance, m_far), draws);
+
+	// Props share a mesh, so they go out as instanced draws instead of one packet each.
+	{
+		PROFILE_SCOPE("Instancing");
+		auto context = m_deviceResources->GetD3DDeviceContext();
+		m_frameRing->BeginFrame(context);
+
+		m_instances.Clear();
+		for (auto const index : m_visibleProps)
+		{
+			const Matrix world = Matrix::CreateScale(m_props.GetExtents(index) * 2.0f) * Matrix::CreateTranslation(m_props.GetCenter(index));
+			m_instances.Add(MESH_PROP, MATERIAL_PROP, world);
+		}
+		m_instances.Build();
+		m_instanceBuffer.Update(context, *m_frameRing, m_instances);
+		m_frameRing->Unmap(context);
+
+		auto const& batches = m_instances.GetBatches();
+		for (uint32_t batch = 0; batch < batches.size(); ++batch)
+		{
+			m_renderQueue.Add(SortKey::Make(PASS_SCENE, TARGET_SCENE, SHADER_PRIMITIVE_INSTANCED, batches[batch].material, 0),
+				[](void* game, uint32_t index) { static_cast<Game*>(game)->DrawInstances(index); }, this, batch);
+		}
 	}
 
-	// Limit camera rotation
-	constexpr float limit = XM_PIDIV2 - 0.01f;
-	m_pitch = std::max(-limit, m_pitch);
-	m_pitch = std::min(+limit, m_pitch);
+	m_renderQueue.Sort();
+
+	// The frame graph orders the passes and takes the offscreen targets from the pool
+	auto const size = m_deviceResources->GetOutputSize();
+	const RenderTargetDesc output = { static_cast<uint32_t>(size.right), static_cast<uint32_t>(size.bottom),
+		static_cast<uint32_t>(m_deviceResources->GetBackBufferFormat()), 1 };
 
-	if (m_yaw > XM_PI)
+	m_frameGraph.Reset();
+	m_frameResources = FrameQueue::DeclarePasses(m_frameGraph, m_viewmodelMode, upscale, output,
+		[](void* game, FrameGraph const&, uint32_t pass) { static_cast<Game*>(game)->ExecutePass(pass); }, this);
+	m_frameGraph.Compile();
+
+	auto context = m_deviceResources->GetD3DDeviceContext();
+	if (m_constantRing)
 	{
-		m_yaw -= XM_2PI;
+		m_constantRing->BeginFrame(context);
 	}
-	else if (m_yaw < -XM_PI)
+
+	m_frameGraph.Execute(*m_renderTargetPool);
+
+	m_frameRing->EndFrame(context);
+	if (m_constantRing)
 	{
-		m_yaw += XM_2PI;
+		m_constantRing->EndFrame(context);
 	}
 
-	if (m_aiming) m_sprinting = false;
+	/*ID3D11ShaderResourceView* nullsrv[] = { nullptr };
+	context->PSSetShaderResources(0, 1, nullsrv);*/
 
-	// Only use yaw so that y is not affected by camera pitch
-	Quaternion q = Quaternion::CreateFromYawPitchRoll(m_yaw, 0.0f, 0.0f);
-	move = Vector3::Transform(move, q) * (m_sprinting ? MOVEMENT_SPRINTING_GAIN : MOVEMENT_GAIN) * elapsedTime;
+	m_gpuProfiler->EndFrame();
+	ReportGpuTimings();
 
-	// Move camera by movement vector
-	m_cameraPos += move;
+	// Show the new frame.
+	auto const presentStart = std::chrono::steady_clock::now();
+	m_deviceResources->Present();
+	m_presentTime = std::chrono::steady_clock::now() - presentStart;
 
-	// Calculate positions for lookAt vector
-	float y = sinf(m_pitch);
-	float r = cosf(m_pitch);
-	float z = r * cosf(m_yaw);
-	float x = r * sinf(m_yaw);
+	m_renderTargetPool->EndFrame();
+}
 
-	XMVECTOR lookAt = m_cameraPos + Vector3(x, y, z);
+// Runs one frame graph pass: binds the targets the graph placed, then
+// submits the pass's packets.
+void Game::ExecutePass(uint32_t pass)
+{
+	auto context = m_deviceResources->GetD3DDeviceContext();
+	auto const depthStencil = m_deviceResources->GetDepthStencilView();
 
-	m_view = XMMatrixLookAtRH(m_cameraPos, lookAt, Vector3::Up);
+	if (pass == PASS_VIEWMODEL_TEXTURE)
+	{
+		auto const target = DX::D3D11RenderTargetDevice::Get(m_frameGraph.GetTarget(m_frameResources.viewmodelTexture));
+		context->ClearRenderTargetView(target->GetRenderTargetView(), Colors::Transparent);
 
-	// TODO: Remove
-	if (m_buttons.a == GamePad::ButtonStateTracker::PRESSED || m_keys.pressed.Tab)
+		m_renderBackend->SetTarget(TARGET_VIEWMODEL_TEXTURE, target->GetRenderTargetView(),
+			depthStencil, m_deviceResources->GetScreenViewport());
+	}
+	else if (pass == PASS_SCENE)
 	{
-		if (m_roomColor == Colors::Red.v)
-			m_roomColor = Colors::Green;
-		else if (m_roomColor == Colors::Green.v)
-			m_roomColor = Colors::Blue;
-		else if (m_roomColor == Colors::Blue.v)
-			m_roomColor = Colors::White;
+		// Scene color is the back buffer, cleared already, unless upscaling.
+		auto sceneColor = m_deviceResources->GetRenderTargetView();
+		if (m_frameResources.scene != FrameGraph::InvalidHandle)
+		{
+			sceneColor = DX::D3D11RenderTargetDevice::Get(m_frameGraph.GetTarget(m_frameResources.scene))->GetRenderTargetView();
+			context->ClearRenderTargetView(sceneColor, Colors::CornflowerBlue);
+		}
+
+		if (m_viewmodelMode == ViewmodelMode::RenderTexture)
+		{
+			// The weapon's pass has used the depth buffer already.
+			context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+			m_renderBackend->SetTarget(TARGET_SCENE, sceneColor, depthStencil, m_sceneViewport);
+		}
 		else
-			m_roomColor = Colors::Red;
+		{
+			// Split the depth range so the weapon always lands in front of the
+			// scene without a second depth clear.
+			auto sceneViewport = m_sceneViewport;
+			sceneViewport.MinDepth = ViewmodelDepthRange;
+			m_renderBackend->SetTarget(TARGET_SCENE, sceneColor, depthStencil, sceneViewport);
+
+			auto viewmodelViewport = m_sceneViewport;
+			viewmodelViewport.MaxDepth = ViewmodelDepthRange;
+			m_renderBackend->SetTarget(TARGET_VIEWMODEL, sceneColor, depthStencil, viewmodelViewport);
+		}
+	}
+
+	// The scene's meshes all come from the arena; bind it once for the pass.
+	if (pass == PASS_SCENE)
+	{
+		m_meshArena->Bind(context);
 	}
+
+	m_renderQueue.SubmitPass(*m_renderBackend, pass);
 }
-#pragma endregion
 
-#pragma region Frame Render
-// Draws the scene.
-void Game::Render()
+// Draws the weapon with its own projection, once it has loaded.
+void Game::DrawWeapon()
 {
-	// Don't try to render anything before the first Update.
-	if (m_timer.GetFrameCount() == 0)
-	{
+	auto context = m_deviceResources->GetD3DDeviceContext();
+
+	auto const weapon = DX::D3D11AssetDevice::GetModel(m_assetLoader->Get(m_weaponAsset));
+	if (!weapon)
 		return;
-	}
 
-	Clear();
+	weapon->Draw(context, *m_states, Matrix::Identity, PlayerSimulation::GetWeaponMatrix(m_renderPlayer), m_gunProj);
 
+	// The model binds buffers of its own; put the arena back for the scene draws after it.
+	m_meshArena->Bind(context);
+}
+
+void Game::DrawRoom()
+{
 	auto context = m_deviceResources->GetD3DDeviceContext();
 
-	//---------------------------------------------
-	// Render texture
-	// --------------------------------------------
+	m_roomEffect->SetMatrices(Matrix::Identity, m_view, m_proj);
+	m_roomEffect->SetColorAndAlpha(m_roomColor);
+	m_roomEffect->Apply(context);
 
-	// Draw weapon
-	m_weapon->Draw(context, *m_states, Matrix::Identity, Matrix::CreateFromYawPitchRoll(m_weaponRotation) * Matrix::CreateTranslation(m_weaponOffset * 
-		(m_aiming ?
-		Vector3(1, 1 - (sin(m_steps) / 16.0f), 1) :
-		Vector3(1.0f + (sin(m_steps) / 32.0f), 1.0f - (sin(m_steps) / 16.0f), 1 + (sin(cos(m_steps)) / 16.0f)))), m_gunProj);
+	SetOpaqueMeshStates(context, *m_states);
+	context->IASetInputLayout(m_roomInputLayout.Get());
+	m_meshArena->Draw(context, m_roomMesh);
+}
 
-	//---------------------------------------------
-	// Real view
-	// --------------------------------------------
-	
-	// Get real render target
-	auto renderTarget = m_deviceResources->GetRenderTargetView();
-	// Set render target to real render target
-	context->OMSetRenderTargets(1, &renderTarget, nullptr);
+// Draws one of the frame's instance batches with DrawIndexedInstanced.
+void Game::DrawInstances(uint32_t batch)
+{
+	auto context = m_deviceResources->GetD3DDeviceContext();
+	auto const& instances = m_instances.GetBatches()[batch];
 
-	// Draw floor
-	m_room->Draw(Matrix::Identity, m_view, m_proj,
-		m_roomColor, m_roomTex.Get());
+	m_propEffect->SetView(m_view);
+	m_propEffect->SetProjection(m_proj);
+	m_propEffect->Apply(context);
 
+	SetOpaqueMeshStates(context, *m_states);
+	context->IASetInputLayout(m_propInputLayout.Get());
+	m_instanceBuffer.Bind(context);
+	m_meshArena->DrawInstanced(context, m_propMesh, instances.instanceCount, instances.firstInstance);
+}
+
+// Stretches the scaled scene over the back buffer.
+void Game::DrawUpscale()
+{
+	auto const target = DX::D3D11RenderTargetDevice::Get(m_frameGraph.GetTarget(m_frameResources.scene));
+
+	const RECT source = { 0, 0, LONG(m_sceneViewport.Width), LONG(m_sceneViewport.Height) };
+
+	m_sprites->Begin(SpriteSortMode_Deferred, m_states->Opaque(), m_states->LinearClamp());
+	m_sprites->Draw(target->GetShaderResourceView(), m_deviceResources->GetOutputSize(), &source);
+	m_sprites->End();
+}
+
+// Draws the crosshair, over the composited weapon in RenderTexture mode.
+void Game::DrawComposite()
+{
 	// Begin drawing of sprites for spritebatch
 	m_sprites->Begin();
 
 	// Draw rendertexture view
-	m_sprites->Draw(m_renderTexture->GetShaderResourceView(),
-		m_deviceResources->GetOutputSize());
+	if (m_viewmodelMode == ViewmodelMode::RenderTexture)
+	{
+		auto const target = DX::D3D11RenderTargetDevice::Get(m_frameGraph.GetTarget(m_frameResources.viewmodelTexture));
+		m_sprites->Draw(target->GetShaderResourceView(),
+			m_deviceResources->GetOutputSize());
+	}
+
+	// The crosshair is left out until both halves have loaded.
+	const float crosshairSpread = m_renderPlayer.crosshairSpread;
+	if (crosshairSpread > 15.0f && m_assetLoader->IsReady(m_crosshairAsset) && m_assetLoader->IsReady(m_crosshairHAsset)) {
+		auto const crosshair = DX::D3D11AssetDevice::GetTexture(m_assetLoader->Get(m_crosshairAsset));
+		auto const crosshair_h = DX::D3D11AssetDevice::GetTexture(m_assetLoader->Get(m_crosshairHAsset));
 
-	if (m_crosshair_spread > 15.0f) {
-		m_sprites->Draw(m_crosshair.Get(), m_screenPos + Vector2(0.0f, m_crosshair_spread), nullptr,
+		m_sprites->Draw(crosshair, m_screenPos + Vector2(0.0f, crosshairSpread), nullptr,
 			Colors::White, 0.f, m_origin);
 
-		m_sprites->Draw(m_crosshair.Get(), m_screenPos + Vector2(0.0f, -m_crosshair_spread), nullptr,
+		m_sprites->Draw(crosshair, m_screenPos + Vector2(0.0f, -crosshairSpread), nullptr,
 			Colors::White, 0.f, m_origin);
 
-		m_sprites->Draw(m_crosshair_h.Get(), m_screenPos + Vector2(-m_crosshair_spread, 0.0f), nullptr,
+		m_sprites->Draw(crosshair_h, m_screenPos + Vector2(-crosshairSpread, 0.0f), nullptr,
 			Colors::White, 0.f, m_origin_h);
 
-		m_sprites->Draw(m_crosshair_h.Get(), m_screenPos + Vector2(m_crosshair_spread, 0.0f), nullptr,
+		m_sprites->Draw(crosshair_h, m_screenPos + Vector2(crosshairSpread, 0.0f), nullptr,
 			Colors::White, 0.f, m_origin_h);
 	}
 
 	// End drawing of sprites for spritebatch
 	m_sprites->End();
-
-	/*ID3D11ShaderResourceView* nullsrv[] = { nullptr };
-	context->PSSetShaderResources(0, 1, nullsrv);*/
-
-	// Show the new frame.
-	m_deviceResources->Present();
 }
 
 // Helper method to clear the back buffers.
 void Game::Clear()
 {
+	PROFILE_SCOPE("Clear");
+
 	auto context = m_deviceResources->GetD3DDeviceContext();
 
-	auto renderTarget = m_renderTexture->GetRenderTargetView();
 	auto realRenderTarget = m_deviceResources->GetRenderTargetView();
 	auto depthStencil = m_deviceResources->GetDepthStencilView();
 
-	context->ClearRenderTargetView(renderTarget, Colors::Transparent);
 	context->ClearRenderTargetView(realRenderTarget, Colors::CornflowerBlue);
 	context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
-	context->OMSetRenderTargets(1, &renderTarget, depthStencil);
+	context->OMSetRenderTargets(1, &realRenderTarget, depthStencil);
 
 	// Set the viewport.
 	auto const viewport = m_deviceResources->GetScreenViewport();
 	context->RSSetViewports(1, &viewport);
 }
+
+// Hands on GPU pass timings as they resolve, a few frames after rendering.
+void Game::ReportGpuTimings()
+{
+	const uint64_t frame = m_gpuProfiler->GetResolvedFrame();
+	if (frame == m_reportedGpuFrame)
+		return;
+
+	m_reportedGpuFrame = frame;
+
+	auto const& timings = m_gpuProfiler->GetPassTimings();
+
+	m_gpuFrameMs = 0.0;
+	for (auto const& pass : timings)
+	{
+		m_gpuFrameMs += pass.milliseconds;
+	}
+
+	if (m_benchmark)
+	{
+		for (auto const& pass : timings)
+		{
+			m_benchmark->AddPassTime(pass.name, pass.milliseconds);
+		}
+	}
+
+#ifdef _DEBUG
+	// Roughly every few seconds at 60 Hz.
+	if (frame % 300 == 0)
+	{
+		char buff[128] = {};
+		sprintf_s(buff, "GPU frame %llu:", frame);
+
+		std::string line = buff;
+		for (auto const& pass : timings)
+		{
+			sprintf_s(buff, " %s %.3f ms", pass.name, pass.milliseconds);
+			line += buff;
+		}
+
+		auto const& targets = m_renderTargetPool->GetStats();
+		sprintf_s(buff, ", render targets %zu, %.1f MB resident, %.1f MB peak",
+			targets.residentTargets, double(targets.residentBytes) / (1024.0 * 1024.0),
+			double(targets.peakResidentBytes) / (1024.0 * 1024.0));
+		line += buff;
+
+		if (m_dynamicResolution)
+		{
+			sprintf_s(buff, ", scale %.2f", m_dynamicResolution->GetScale());
+			line += buff;
+		}
+		line += "\n";
+		OutputDebugStringA(line.c_str());
+	}
+#endif
+}
 #pragma endregion
 
 #pragma region Message Handlers
@@ -449,9 +738,20 @@ void Game::OnSuspending()
 	context->ClearState();
 
 	m_deviceResources->Trim();
+	m_renderTargetPool->Trim();
 
 	// TODO: Game is being power-suspended.
 	m_gamePad->Suspend();
+
+	if (m_inputRecorder)
+	{
+		// The app may not come back, so note where the recorded run got to.
+		m_inputRecorder->Checkpoint(PlayerSimulation::Checksum(m_player.GetState()));
+		m_inputRecorder->Flush();
+	}
+
+	// The app can be terminated while suspended without any further notice.
+	WriteTrace();
 }
 
 void Game::OnResuming()
@@ -489,11 +789,154 @@ void Game::GetDefaultSize(int& width, int& height) const noexcept
 	width = 1280;
 	height = 720;
 }
+
+// Input capture
+void Game::StartRecording(std::filesystem::path const& path)
+{
+	// Recordings always start from the initial player state so they can be replayed headless.
+	m_inputRecorder = std::make_unique<InputRecording::Recorder>(path);
+	m_player.Reset();
+	m_previousPlayer = m_player.GetState();
+}
+
+void Game::StartReplay(std::filesystem::path const& path)
+{
+	m_inputReplay = std::make_unique<InputRecording::Replay>(path);
+	m_player.Reset();
+	m_previousPlayer = m_player.GetState();
+}
+
+// A recording that turns out truncated or corrupt part way ends the replay
+// there, as if it had run out, and the devices take over.
+bool Game::NextReplayInput(uint64_t& elapsedTicks, PlayerInput& input)
+{
+	try
+	{
+		return m_inputReplay->Next(elapsedTicks, input);
+	}
+	catch (std::runtime_error const& e)
+	{
+		char buff[160] = {};
+		sprintf_s(buff, "Input replay failed after %llu ticks: %s\n", m_inputReplay->GetPosition(), e.what());
+		OutputDebugStringA(buff);
+
+		m_inputReplay.reset();
+		return false;
+	}
+}
+
+void Game::StartBenchmark(double seconds, std::filesystem::path const& reportPath)
+{
+	m_benchmark = std::make_unique<Benchmark::Session>(seconds, reportPath);
+	m_player.Reset();
+	m_previousPlayer = m_player.GetState();
+	m_lastTickStart = {};
+}
+
+// Rendering options
+void Game::SetViewmodelMode(ViewmodelMode mode)
+{
+	if (mode == m_viewmodelMode)
+		return;
+
+	// The frame graph only asks the pool for the render texture in RenderTexture mode.
+	m_viewmodelMode = mode;
+}
+
+void Game::EnableDynamicResolution(double budgetMs)
+{
+	m_dynamicResolution = std::make_unique<DynamicResolution>(DynamicResolution::GetDefaultSettings(budgetMs));
+}
+
+void Game::EnableOcclusionCulling(uint32_t occluders)
+{
+	// A quarter of the back buffer's resolution, give or take, in whole subtiles.
+	m_occlusionCuller = std::make_unique<OcclusionCuller>(320, 180);
+	m_threadPool = std::make_unique<ThreadPool>(ThreadPool::GetDefaultWorkerCount());
+	m_occluderCount = occluders;
+}
+
+// The nearest props stand in for large occluders; they're tested like the
+// rest, so one hidden behind another is still dropped.
+void Game::CullOccludedProps(FXMMATRIX viewProjection)
+{
+	PROFILE_SCOPE("Occlusion");
+
+	const Vector3 eye = m_renderPlayer.position;
+	auto const distance = [this, &eye](uint32_t index)
+	{
+		return Vector3::DistanceSquared(eye, m_props.GetCenter(index));
+	};
+
+	// Nearest first; the order of the rest doesn't matter, the queue sorts them.
+	const size_t occluders = std::min<size_t>(m_occluderCount, m_visibleProps.size());
+	std::partial_sort(m_visibleProps.begin(), m_visibleProps.begin() + occluders, m_visibleProps.end(),
+		[&distance](uint32_t a, uint32_t b) { return distance(a) < distance(b); });
+
+	m_occlusionCuller->Clear();
+	for (size_t i = 0; i < occluders; ++i)
+	{
+		m_occlusionCuller->AddOccluderBox(viewProjection, m_props.GetCenter(m_visibleProps[i]), m_props.GetExtents(m_visibleProps[i]));
+	}
+
+	m_occlusionCuller->Rasterize(m_threadPool.get());
+	m_occlusionCuller->Cull(viewProjection, m_props, m_visibleProps);
+}
+
+void Game::CreateProps(uint32_t count)
+{
+	// Seeded so every run, and every benchmark, sees the same layout.
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-19.0f, 19.0f);
+	std::uniform_real_distribution<float> extent(0.1f, 0.5f);
+
+	m_props.Clear();
+	m_props.Reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const XMFLOAT3 extents = { extent(random), extent(random), extent(random) };
+		m_props.Add({ position(random), -1.0f + extents.y, position(random) }, extents);
+	}
+
+	m_instances.Reserve(count);
+
+	// Make room for every prop's transform in each frame in flight.
+	if (m_frameRing)
+	{
+		CreateFrameRing();
+	}
+}
+
+// Profiling
+void Game::StartTrace(std::filesystem::path const& path)
+{
+	m_tracePath = path;
+	Profiler::SetThreadName("Main");
+	Profiler::SetEnabled(true);
+}
+
+void Game::WriteTrace() noexcept
+{
+	if (m_tracePath.empty())
+		return;
+
+	try
+	{
+		Profiler::WriteChromeTrace(m_tracePath);
+	}
+	catch (std::exception const& e)
+	{
+		OutputDebugStringA(e.what());
+		OutputDebugStringA("\n");
+	}
+}
 #pragma endregion
 
 #pragma region Direct3D Resources
 void Game::CreateDeviceDependentResources()
 {
+	PROFILE_SCOPE("CreateDeviceDependentResources");
+
 	auto device = m_deviceResources->GetD3DDevice();
 
 	auto context = m_deviceResources->GetD3DDeviceContext();
@@ -502,30 +945,61 @@ void Game::CreateDeviceDependentResources()
 	m_states = std::make_unique<CommonStates>(device);
 	m_fxFactory = std::make_unique<EffectFactory>(device);
 
-	// Load models
-	m_room = GeometricPrimitive::CreateBox(context,
-		XMFLOAT3(40.0f, 2.0f, 40.0f));
-	m_weapon = Model::CreateFromCMO(device, L"Assets/m16.cmo", *m_fxFactory);
-
-	// Load textures
-	DX::ThrowIfFailed(
-		CreateWICTextureFromFile(device, L"Assets/grid.png",
-			nullptr, m_roomTex.ReleaseAndGetAddressOf()));
+	CreateMeshes();
 
-	ComPtr<ID3D11Resource> resource;
-	DX::ThrowIfFailed(
-		CreateWICTextureFromFile(device, L"Assets/crosshair-v.png",
-			resource.GetAddressOf(), m_crosshair.ReleaseAndGetAddressOf()));
+	// The props' instanced effect. NormalMapEffect is the one DirectXTK effect
+	// with instancing and lighting, so it gets a flat normal map.
+	{
+		static const uint32_t flatNormal = 0xFFFF8080;
+		const D3D11_SUBRESOURCE_DATA initialData = { &flatNormal, sizeof(flatNormal), 0 };
+		const CD3D11_TEXTURE2D_DESC desc(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1);
+
+		ComPtr<ID3D11Texture2D> texture;
+		DX::ThrowIfFailed(device->CreateTexture2D(&desc, &initialData, texture.GetAddressOf()));
+		DX::ThrowIfFailed(device->CreateShaderResourceView(texture.Get(), nullptr, m_flatNormals.ReleaseAndGetAddressOf()));
+
+		m_propEffect = std::make_unique<NormalMapEffect>(device);
+		m_propEffect->SetInstancingEnabled(true);
+		m_propEffect->EnableDefaultLighting();
+		m_propEffect->SetDiffuseColor(m_propColor);
+		m_propEffect->SetNormalTexture(m_flatNormals.Get());
+
+		DX::ThrowIfFailed(CreateInputLayoutFromEffect(device, m_propEffect.get(),
+			DX::D3D11InstanceBuffer::InputElements, std::size(DX::D3D11InstanceBuffer::InputElements),
+			m_propInputLayout.ReleaseAndGetAddressOf()));
+	}
 
-	DX::ThrowIfFailed(
-		CreateWICTextureFromFile(device, L"Assets/crosshair-h.png",
-			resource.GetAddressOf(), m_crosshair_h.ReleaseAndGetAddressOf()));
+	CreateFrameRing();
 
-	ComPtr<ID3D11Texture2D> crosshair;
-	DX::ThrowIfFailed(resource.As(&crosshair));
+	// Constant buffer offsets need Direct3D 11.1 and a driver that has them;
+	// without, our own shaders map constant buffers of their own.
+	if (DX::D3D11FrameRing::SupportsConstantOffsets(device))
+	{
+		m_constantRing = std::make_unique<DX::D3D11FrameRing>(device, D3D11_BIND_CONSTANT_BUFFER, CONSTANT_RING_BYTES, FRAMES_IN_FLIGHT);
+	}
+	else
+	{
+		OutputDebugStringA("Constant buffer offsets are not supported; effects use constant buffers of their own\n");
+	}
 
-	CD3D11_TEXTURE2D_DESC crosshairDesc;
-	crosshair->GetDesc(&crosshairDesc);
+	// The weapon (ShooterTools cook-meshes) and textures (cook-textures)
+	// are cooked offline and packed into the archive, so loading is
+	// finding them in its mapping and uploading them. That happens in the
+	// background: the first frame doesn't wait for them, and Render creates
+	// them as they come in.
+	m_assetDevice = std::make_unique<DX::D3D11AssetDevice>(device, context, *m_modelArena, *m_fxFactory, m_constantRing.get(),
+		m_assetArchive.get(), GameAssets::Directory, ASSET_DECOMPRESS_WORKERS);
+	m_assetLoader = std::make_unique<AssetLoader>(*m_assetDevice, ASSET_LOADER_WORKERS, m_assetCache.get());
+	m_assetLoader->SetPlaceholder(DX::ASSET_TEXTURE, m_assetDevice->CreateSolidTexture(PLACEHOLDER_TEXTURE_COLOR));
+
+	m_weaponAsset = m_assetLoader->Load(DX::ASSET_MODEL, GetAssetPath(GameAssets::Weapon));
+	m_roomTexAsset = m_assetLoader->Load(DX::ASSET_TEXTURE, GetAssetPath(GameAssets::RoomTexture));
+	m_crosshairAsset = m_assetLoader->Load(DX::ASSET_TEXTURE, GetAssetPath(GameAssets::CrosshairV));
+	m_crosshairHAsset = m_assetLoader->Load(DX::ASSET_TEXTURE, GetAssetPath(GameAssets::CrosshairH));
+
+	m_roomTex = DX::D3D11AssetDevice::GetTexture(m_assetLoader->Get(m_roomTexAsset));
+	m_roomEffect->SetTexture(m_roomTex);
+	m_propEffect->SetTexture(m_roomTex);
 
 	m_origin.x = 2.0f;
 	m_origin.y = 10.0f;
@@ -535,8 +1009,65 @@ void Game::CreateDeviceDependentResources()
 	// Create sprite batch for rendering rendertexture
 	m_sprites = std::make_unique<SpriteBatch>(context);
 
-	// Assign the device to the render texture
-	m_renderTexture->SetDevice(device);
+	// Offscreen targets come from a pool so resizes and transient effects recycle them
+	m_renderTargetDevice = std::make_unique<DX::D3D11RenderTargetDevice>(device);
+	m_renderTargetPool = std::make_unique<RenderTargetPool>(*m_renderTargetDevice);
+
+	// Time the passes of each frame on the GPU
+	m_gpuProfiler = std::make_unique<DX::D3D11GpuProfiler>(device);
+	m_reportedGpuFrame = 0;
+
+	// Submits the render queue; its passes are the ones timed on the GPU
+	m_renderBackend = std::make_unique<DX::D3D11RenderBackend>(context);
+	for (uint32_t pass = 0; pass < PASS_COUNT; ++pass)
+	{
+		m_renderBackend->SetPassName(pass, GetPassName(pass));
+	}
+	m_renderBackend->SetGpuProfiler(m_gpuProfiler.get());
+}
+
+// Builds the room and prop boxes GeometricPrimitive would, but uploads them
+// into the mesh arena instead of buffers of their own. Also makes the arena
+// cooked models are uploaded into.
+void Game::CreateMeshes()
+{
+	PROFILE_SCOPE("Create meshes");
+
+	auto device = m_deviceResources->GetD3DDevice();
+	auto context = m_deviceResources->GetD3DDeviceContext();
+
+	m_meshArena = std::make_unique<DX::D3D11MeshArena>(device, UINT(sizeof(VertexPositionNormalTexture)),
+		MESH_ARENA_VERTICES, MESH_ARENA_INDICES);
+
+	m_modelArena = std::make_unique<DX::D3D11MeshArena>(device, CookedMesh::GetVertexStride(CookedMesh::VertexFormat::Quantized),
+		MODEL_ARENA_VERTICES, MODEL_ARENA_INDICES);
+
+	GeometricPrimitive::VertexCollection vertices;
+	GeometricPrimitive::IndexCollection indices;
+
+	GeometricPrimitive::CreateBox(vertices, indices, XMFLOAT3(40.0f, 2.0f, 40.0f));
+	m_roomMesh = m_meshArena->Add(context, vertices.data(), uint32_t(vertices.size()), indices.data(), uint32_t(indices.size()));
+
+	GeometricPrimitive::CreateCube(vertices, indices);
+	m_propMesh = m_meshArena->Add(context, vertices.data(), uint32_t(vertices.size()), indices.data(), uint32_t(indices.size()));
+
+	// What GeometricPrimitive::Draw sets up for a textured primitive.
+	m_roomEffect = std::make_unique<BasicEffect>(device);
+	m_roomEffect->EnableDefaultLighting();
+	m_roomEffect->SetTextureEnabled(true);
+
+	DX::ThrowIfFailed(CreateInputLayoutFromEffect<VertexPositionNormalTexture>(device, m_roomEffect.get(),
+		m_roomInputLayout.ReleaseAndGetAddressOf()));
+}
+
+// Sized so that drawing every prop never waits on the GPU for ring space;
+// the extra frame covers the tail skipped when an allocation wraps.
+void Game::CreateFrameRing()
+{
+	const size_t frameBytes = m_props.GetSize() * sizeof(XMFLOAT3X4);
+
+	m_frameRing = std::make_unique<DX::D3D11FrameRing>(m_deviceResources->GetD3DDevice(), D3D11_BIND_VERTEX_BUFFER,
+		std::max(FRAME_RING_BYTES, frameBytes * (FRAMES_IN_FLIGHT + 1)), FRAMES_IN_FLIGHT);
 }
 
 void Game::CreateWindowSizeDependentResources()
@@ -554,9 +1085,6 @@ void Game::CreateWindowSizeDependentResources()
 		XMConvertToRadians(70.0f),
 		float(size.right) / float(size.bottom), m_near, m_far);
 	 
-	// Set size of rendertexture
-	m_renderTexture->SetWindow(size);
-
 	// Required as devices could change orientation
 	m_sprites->SetRotation(m_deviceResources->GetRotation());
 
@@ -566,13 +1094,25 @@ void Game::CreateWindowSizeDependentResources()
 
 void Game::OnDeviceLost()
 {
-	m_room.reset();
-	m_roomTex.Reset();
+	m_meshArena.reset();
+	m_roomEffect.reset();
+	m_roomInputLayout.Reset();
+	m_propEffect.reset();
+	m_propInputLayout.Reset();
+	m_flatNormals.Reset();
+	m_frameRing.reset();
+	m_roomTex = nullptr;
 	m_sprites.reset();
-	m_renderTexture->ReleaseDevice();
-	m_weapon.reset();
+	m_assetLoader.reset();
+	m_assetDevice.reset();
+	m_constantRing.reset();
+	m_modelArena.reset();
 	m_states.reset();
 	m_fxFactory.reset();
+	m_renderBackend.reset();
+	m_gpuProfiler.reset();
+	m_renderTargetPool.reset();
+	m_renderTargetDevice.reset();
 }
 
 void Game::OnDeviceRestored()
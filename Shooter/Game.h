@@ -6,7 +6,27 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
-#include "RenderTexture.h"
+#include "PlayerSimulation.h"
+#include "InputRecording.h"
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "GpuProfiler.h"
+#include "RenderQueue.h"
+#include "FrameQueue.h"
+#include "FrameGraph.h"
+#include "DynamicResolution.h"
+#include "SceneRegistry.h"
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+#include "InstanceBatcher.h"
+#include "D3D11RenderBackend.h"
+#include "D3D11RenderTargetDevice.h"
+#include "D3D11FrameRing.h"
+#include "D3D11InstanceBuffer.h"
+#include "D3D11MeshArena.h"
+#include "D3D11CookedModel.h"
+#include "D3D11AssetDevice.h"
+#include "AssetCache.h"
 
 // A basic game implementation that creates a D3D11 device and
 // provides a game loop.
@@ -14,7 +34,7 @@ class Game final : public DX::IDeviceNotify
 {
 public:
     Game() noexcept(false);
-    ~Game() = default;
+    ~Game();
 
     Game(Game&&) = default;
     Game& operator= (Game&&) = default;
@@ -44,6 +64,29 @@ public:
     // Properties
     void GetDefaultSize( int& width, int& height ) const noexcept;
 
+    // Input capture
+    void StartRecording(std::filesystem::path const& path);
+    void StartReplay(std::filesystem::path const& path);
+
+    // Runs the scripted benchmark for the given simulated time, then writes the report and exits.
+    void StartBenchmark(double seconds, std::filesystem::path const& reportPath);
+
+    // Rendering options
+    void SetViewmodelMode(ViewmodelMode mode);
+
+    // Scales the 3D scene to keep the GPU frame time within the budget.
+    void EnableDynamicResolution(double budgetMs);
+
+    // Scatters count boxes around the room, culled against the view each frame.
+    void CreateProps(uint32_t count);
+
+    // Rasterizes the nearest visible props on the CPU each frame and skips
+    // the props they hide.
+    void EnableOcclusionCulling(uint32_t occluders);
+
+    // Enables the profiler; the trace is written on suspend and on exit.
+    void StartTrace(std::filesystem::path const& path);
+
 private:
 
     void Update(DX::StepTimer const& timer);
@@ -51,6 +94,23 @@ private:
 
     void Clear();
 
+    // Frame graph passes and the render queue packets they submit
+    void ExecutePass(uint32_t pass);
+    void DrawWeapon();
+    void DrawRoom();
+    void DrawInstances(uint32_t batch);
+    void DrawComposite();
+    void DrawUpscale();
+
+    void CullOccludedProps(DirectX::FXMMATRIX viewProjection);
+
+    bool NextReplayInput(uint64_t& elapsedTicks, PlayerInput& input);
+
+    void WriteTrace() noexcept;
+    void ReportGpuTimings();
+
+    void CreateFrameRing();
+    void CreateMeshes();
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
 
@@ -64,61 +124,106 @@ private:
     std::unique_ptr<DirectX::Keyboard> m_keyboard;
     std::unique_ptr<DirectX::Mouse> m_mouse;
 
-    std::unique_ptr<DirectX::Model> m_weapon;
-    
-    //std::unique_ptr<DirectX::GeometricPrimitive> m_weapon;
-    std::unique_ptr<DirectX::GeometricPrimitive> m_room;
+    // The weapon is cooked offline and drawn from an arena of the CMO vertex format
+    std::unique_ptr<DX::D3D11MeshArena> m_modelArena;
+
+    // Textures and the weapon load in the background, from the asset
+    // archive when there is one; handles stand for placeholders until
+    // they're ready. The archive and the cache of decoded assets outlive
+    // the device, so restoring it only uploads them again
+    std::unique_ptr<AssetArchive::Reader> m_assetArchive;
+    std::unique_ptr<AssetCache> m_assetCache;
+    std::unique_ptr<DX::D3D11AssetDevice> m_assetDevice;
+    std::unique_ptr<AssetLoader> m_assetLoader;
+    uint32_t m_weaponAsset;
+    uint32_t m_roomTexAsset;
+    uint32_t m_crosshairAsset;
+    uint32_t m_crosshairHAsset;
+
+    // The room and prop meshes share one vertex and index buffer
+    std::unique_ptr<DX::D3D11MeshArena> m_meshArena;
+    uint32_t m_roomMesh;
+    uint32_t m_propMesh;
+    std::unique_ptr<DirectX::BasicEffect> m_roomEffect;
+    Microsoft::WRL::ComPtr<ID3D11InputLayout> m_roomInputLayout;
 
     DirectX::SimpleMath::Matrix m_view;
     DirectX::SimpleMath::Matrix m_proj;
     DirectX::SimpleMath::Matrix m_gunProj;
 
-    float m_pitch;
-    float m_yaw;
-    DirectX::SimpleMath::Vector3 m_cameraPos;
+    PlayerSimulation m_player;
+    PlayerState m_previousPlayer;
+    PlayerState m_renderPlayer;
 
-    DirectX::SimpleMath::Color m_roomColor;
+    std::unique_ptr<InputRecording::Recorder> m_inputRecorder;
+    std::unique_ptr<InputRecording::Replay> m_inputReplay;
+
+    std::unique_ptr<Benchmark::Session> m_benchmark;
+    std::chrono::steady_clock::time_point m_lastTickStart;
+    std::chrono::steady_clock::duration m_presentTime;
+
+    std::filesystem::path m_tracePath;
+
+    std::unique_ptr<IGpuProfiler> m_gpuProfiler;
+    uint64_t m_reportedGpuFrame;
+    double m_gpuFrameMs;            // Newly resolved GPU frame time, negative when there is none
+
+    RenderQueue m_renderQueue;
+    FrameGraph m_frameGraph;
+    FrameQueue::Resources m_frameResources;
 
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_roomTex;
+    std::unique_ptr<DynamicResolution> m_dynamicResolution;
+    D3D11_VIEWPORT m_sceneViewport;
+    std::unique_ptr<DX::D3D11RenderBackend> m_renderBackend;
 
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_crosshair;
-    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_crosshair_h;
+    std::unique_ptr<DX::D3D11RenderTargetDevice> m_renderTargetDevice;
+    std::unique_ptr<RenderTargetPool> m_renderTargetPool;
+
+    // Per-frame vertex data, instance transforms for now
+    std::unique_ptr<DX::D3D11FrameRing> m_frameRing;
+
+    // Per-draw constants of our own shaders; null without constant buffer offsets,
+    // when the effects keep buffers of their own
+    std::unique_ptr<DX::D3D11FrameRing> m_constantRing;
+
+    SceneRegistry m_props;
+    std::vector<uint32_t> m_visibleProps;
+
+    // Visible props are drawn one instanced draw per mesh and material
+    InstanceBatcher m_instances;
+    DX::D3D11InstanceBuffer m_instanceBuffer;
+    std::unique_ptr<DirectX::NormalMapEffect> m_propEffect;
+    Microsoft::WRL::ComPtr<ID3D11InputLayout> m_propInputLayout;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_flatNormals;
+
+    std::unique_ptr<ThreadPool> m_threadPool;
+    std::unique_ptr<OcclusionCuller> m_occlusionCuller;
+    uint32_t m_occluderCount;
+
+    DirectX::SimpleMath::Color m_roomColor;
+    DirectX::SimpleMath::Color m_propColor;
+
+    // The room texture the effects were last given
+    ID3D11ShaderResourceView* m_roomTex;
 
     DirectX::GamePad::ButtonStateTracker m_buttons;
     DirectX::Keyboard::KeyboardStateTracker m_keys;
     DirectX::Mouse::ButtonStateTracker m_mouseButtons;
 
-    bool m_aiming;
-
+    // Field of view the projection matrix was last built with
     float m_fov;
-    float m_fov_previous = m_fov;
-
-    float m_hipfire_fov;
-    float m_aiming_fov;
-
-    bool m_using_keyboard;
 
     float m_near;
     float m_far;
 
-    bool m_sprinting;
+    ViewmodelMode m_viewmodelMode;
 
-    std::unique_ptr<DX::RenderTexture> m_renderTexture;
     std::unique_ptr<DirectX::SpriteBatch> m_sprites;
 
-    DirectX::SimpleMath::Vector3 m_weaponOffset;
-    DirectX::SimpleMath::Vector3 m_weaponRotation;
-
     std::unique_ptr<DirectX::IEffectFactory> m_fxFactory;
     std::unique_ptr<DirectX::CommonStates> m_states;
 
     DirectX::SimpleMath::Vector2 m_screenPos;
     DirectX::SimpleMath::Vector2 m_origin;
     DirectX::SimpleMath::Vector2 m_origin_h;
-
-    float m_crosshair_spread;
-
-    float m_steps;
-
-    bool m_walking = false;
 };
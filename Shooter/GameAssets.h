@@ -0,0 +1,23 @@
+//
+// GameAssets.h - The asset files the game loads, shared with the tool that packs them
+//
+
+#pragma once
+
+// Names are relative to the asset directory and in the order the game asks
+// for them, which is the order they're packed in. An asset missing from
+// this list is read as a loose file.
+namespace GameAssets
+{
+	constexpr const char* Directory = "Assets";
+
+	constexpr const char* Weapon = "m16.cmesh";
+	constexpr const char* RoomTexture = "grid.dds";
+	constexpr const char* CrosshairV = "crosshair-v.dds";
+	constexpr const char* CrosshairH = "crosshair-h.dds";
+
+	constexpr const char* const All[] = { Weapon, RoomTexture, CrosshairV, CrosshairH };
+
+	// Packed by ShooterTools pack-assets from the files above.
+	constexpr const char* Archive = "Assets.pak";
+}
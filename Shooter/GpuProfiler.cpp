@@ -0,0 +1,107 @@
+//
+// GpuProfiler.cpp
+//
+
+#include "GpuProfiler.h"
+
+#include <stdexcept>
+
+GpuPassRecorder::GpuPassRecorder() noexcept :
+	m_names{},
+	m_passCount(0),
+	m_inFrame(false),
+	m_inPass(false)
+{
+}
+
+void GpuPassRecorder::BeginFrame()
+{
+	if (m_inFrame)
+	{
+		throw std::logic_error("GPU profiler frame begun twice");
+	}
+
+	m_inFrame = true;
+	m_passCount = 0;
+}
+
+void GpuPassRecorder::EndFrame()
+{
+	if (!m_inFrame)
+	{
+		throw std::logic_error("GPU profiler frame ended without being begun");
+	}
+
+	if (m_inPass)
+	{
+		throw std::logic_error("GPU profiler frame ended inside a pass");
+	}
+
+	m_inFrame = false;
+}
+
+size_t GpuPassRecorder::BeginPass(const char* name)
+{
+	if (!m_inFrame)
+	{
+		throw std::logic_error("GPU profiler pass begun outside a frame");
+	}
+
+	if (m_inPass)
+	{
+		throw std::logic_error("GPU profiler passes cannot overlap");
+	}
+
+	if (m_passCount == MaxPasses)
+	{
+		throw std::logic_error("Too many GPU profiler passes in one frame");
+	}
+
+	m_inPass = true;
+	m_names[m_passCount] = name;
+	return m_passCount;
+}
+
+size_t GpuPassRecorder::EndPass()
+{
+	if (!m_inPass)
+	{
+		throw std::logic_error("GPU profiler pass ended without being begun");
+	}
+
+	m_inPass = false;
+	return m_passCount++;
+}
+
+NullGpuProfiler::NullGpuProfiler() noexcept :
+	m_frame(0)
+{
+}
+
+void NullGpuProfiler::BeginFrame()
+{
+	m_recorder.BeginFrame();
+}
+
+void NullGpuProfiler::EndFrame()
+{
+	m_recorder.EndFrame();
+
+	m_timings.clear();
+	for (size_t i = 0; i < m_recorder.GetPassCount(); ++i)
+	{
+		m_timings.push_back({ m_recorder.GetPassName(i), 0.0 });
+	}
+
+	m_frame++;
+}
+
+void NullGpuProfiler::BeginPass(const char* name)
+{
+	m_recorder.BeginPass(name);
+}
+
+void NullGpuProfiler::EndPass()
+{
+	m_recorder.EndPass();
+}
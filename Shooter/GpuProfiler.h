@@ -0,0 +1,114 @@
+//
+// GpuProfiler.h - Per-pass GPU timing interface and backend independent bookkeeping
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct GpuPassTiming
+{
+	const char* name;		// Must point at a string literal or other static storage
+	double milliseconds;
+};
+
+// Frames are bracketed by BeginFrame/EndFrame and split into flat, non
+// overlapping passes. Backends resolve timings some frames later, so the
+// results always describe an earlier frame than the one being recorded.
+class IGpuProfiler
+{
+public:
+	virtual ~IGpuProfiler() = default;
+
+	virtual void BeginFrame() = 0;
+	virtual void EndFrame() = 0;
+
+	virtual void BeginPass(const char* name) = 0;
+	virtual void EndPass() = 0;
+
+	// Timings of the most recently resolved frame, in submission order.
+	virtual std::vector<GpuPassTiming> const& GetPassTimings() const noexcept = 0;
+
+	// Number of the frame GetPassTimings describes; zero until one has resolved.
+	virtual uint64_t GetResolvedFrame() const noexcept = 0;
+};
+
+// Marks a pass for the lifetime of a scope.
+class GpuPassScope
+{
+public:
+	GpuPassScope(IGpuProfiler* profiler, const char* name) :
+		m_profiler(profiler)
+	{
+		if (m_profiler)
+		{
+			m_profiler->BeginPass(name);
+		}
+	}
+
+	~GpuPassScope()
+	{
+		if (m_profiler)
+		{
+			m_profiler->EndPass();
+		}
+	}
+
+	GpuPassScope(GpuPassScope const&) = delete;
+	GpuPassScope& operator= (GpuPassScope const&) = delete;
+
+private:
+	IGpuProfiler* m_profiler;
+};
+
+// Validates frame and pass nesting and hands out a slot index per pass, so
+// backends can map passes onto a fixed set of queries. Misuse throws
+// std::logic_error.
+class GpuPassRecorder
+{
+public:
+	static constexpr size_t MaxPasses = 16;
+
+	GpuPassRecorder() noexcept;
+
+	void BeginFrame();
+	void EndFrame();
+
+	// Both return the slot of the pass.
+	size_t BeginPass(const char* name);
+	size_t EndPass();
+
+	bool IsInFrame() const noexcept { return m_inFrame; }
+	size_t GetPassCount() const noexcept { return m_passCount; }
+	const char* GetPassName(size_t index) const noexcept { return m_names[index]; }
+
+private:
+	const char* m_names[MaxPasses];
+	size_t m_passCount;
+	bool m_inFrame;
+	bool m_inPass;
+};
+
+// Keeps the pass names and order of every frame with zero timings. Stands in
+// for a device when there is none and resolves immediately.
+class NullGpuProfiler final : public IGpuProfiler
+{
+public:
+	NullGpuProfiler() noexcept;
+
+	void BeginFrame() override;
+	void EndFrame() override;
+
+	void BeginPass(const char* name) override;
+	void EndPass() override;
+
+	std::vector<GpuPassTiming> const& GetPassTimings() const noexcept override { return m_timings; }
+	uint64_t GetResolvedFrame() const noexcept override { return m_frame; }
+
+private:
+	GpuPassRecorder m_recorder;
+	std::vector<GpuPassTiming> m_timings;
+	uint64_t m_frame;
+};
@@ -1,6 +1,5 @@
-#include "pch.h"
 #include "Helpers.h"
-using namespace DirectX::SimpleMath;
+using namespace DirectX;
 
 float Helpers::Lerp(float start, float end, float current, float increment) {
     if (start < end) {
@@ -15,6 +14,6 @@ float Helpers::Lerp(float start, float end, float current, float increment) {
     return current;
 }
 
-Vector3 Helpers::LerpVector3(Vector3 start, Vector3 end, Vector3 current, float increment) {
-    return Vector3(Lerp(start.x, end.x, current.x, increment), Lerp(start.y, end.y, current.y, increment), Lerp(start.z, end.z, current.z, increment));
+XMFLOAT3 Helpers::LerpVector3(XMFLOAT3 const& start, XMFLOAT3 const& end, XMFLOAT3 const& current, float increment) {
+    return XMFLOAT3(Lerp(start.x, end.x, current.x, increment), Lerp(start.y, end.y, current.y, increment), Lerp(start.z, end.z, current.z, increment));
 }
\ No newline at end of file
@@ -1,8 +1,8 @@
 #pragma once
 
-using namespace DirectX::SimpleMath;
+#include <DirectXMath.h>
 
 namespace Helpers {
 	float Lerp(float start, float end, float current, float increment);
-	Vector3 LerpVector3(Vector3 start, Vector3 end, Vector3 current, float increment);
+	DirectX::XMFLOAT3 LerpVector3(DirectX::XMFLOAT3 const& start, DirectX::XMFLOAT3 const& end, DirectX::XMFLOAT3 const& current, float increment);
 }
\ No newline at end of file
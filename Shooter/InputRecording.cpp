@@ -0,0 +1,418 @@
+//
+// InputRecording.cpp
+//
+
+#include "InputRecording.h"
+
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+using namespace InputRecording;
+
+namespace
+{
+	enum RecordFlags : uint16_t
+	{
+		PadConnected		= 1 << 0,
+		LeftStickPressed	= 1 << 1,
+		MouseLeft			= 1 << 2,
+		MouseMiddle			= 1 << 3,
+		MouseRight			= 1 << 4,
+		MouseRelative		= 1 << 5,
+		KeyForward			= 1 << 6,
+		KeyBack				= 1 << 7,
+		KeyLeft				= 1 << 8,
+		KeyRight			= 1 << 9,
+		KeySprint			= 1 << 10,
+		MouseMoved			= 1 << 11,
+		SameElapsed			= 1 << 12, // Elapsed ticks unchanged from the previous record
+		IsCheckpoint		= 1 << 15, // Not a tick: a 64 bit state checksum follows
+	};
+
+	constexpr size_t HeaderSize = 16;
+
+	void PutBytes(std::vector<uint8_t>& out, void const* data, size_t size)
+	{
+		auto bytes = static_cast<uint8_t const*>(data);
+		out.insert(out.end(), bytes, bytes + size);
+	}
+
+	void PutU16(std::vector<uint8_t>& out, uint16_t value)
+	{
+		const uint8_t bytes[] = { uint8_t(value), uint8_t(value >> 8) };
+		PutBytes(out, bytes, sizeof(bytes));
+	}
+
+	void PutU32(std::vector<uint8_t>& out, uint32_t value)
+	{
+		const uint8_t bytes[] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+		PutBytes(out, bytes, sizeof(bytes));
+	}
+
+	void PutFloat(std::vector<uint8_t>& out, float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		PutU32(out, bits);
+	}
+
+	// LEB128
+	void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(uint8_t(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(uint8_t(value));
+	}
+
+	void PutSignedVarint(std::vector<uint8_t>& out, int32_t value)
+	{
+		// Zigzag so small negative deltas stay small.
+		const uint32_t zigzag = (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+		PutVarint(out, zigzag);
+	}
+
+	class Reader
+	{
+	public:
+		Reader(std::vector<uint8_t> const& data, size_t& offset) noexcept :
+			m_data(data),
+			m_offset(offset)
+		{
+		}
+
+		uint8_t GetU8()
+		{
+			if (m_offset >= m_data.size())
+			{
+				throw std::runtime_error("Input recording is truncated");
+			}
+			return m_data[m_offset++];
+		}
+
+		uint16_t GetU16()
+		{
+			const uint16_t lo = GetU8();
+			return uint16_t(lo | (GetU8() << 8));
+		}
+
+		uint32_t GetU32()
+		{
+			const uint32_t lo = GetU16();
+			return lo | (uint32_t(GetU16()) << 16);
+		}
+
+		uint64_t GetU64()
+		{
+			const uint64_t lo = GetU32();
+			return lo | (uint64_t(GetU32()) << 32);
+		}
+
+		float GetFloat()
+		{
+			const uint32_t bits = GetU32();
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		uint64_t GetVarint()
+		{
+			uint64_t value = 0;
+			for (unsigned shift = 0; shift < 64; shift += 7)
+			{
+				const uint8_t byte = GetU8();
+				value |= uint64_t(byte & 0x7F) << shift;
+				if (!(byte & 0x80))
+					return value;
+			}
+			throw std::runtime_error("Input recording has a malformed varint");
+		}
+
+		int32_t GetSignedVarint()
+		{
+			const uint32_t zigzag = uint32_t(GetVarint());
+			return int32_t(zigzag >> 1) ^ -int32_t(zigzag & 1);
+		}
+
+	private:
+		std::vector<uint8_t> const& m_data;
+		size_t& m_offset;
+	};
+}
+
+Recorder::Recorder(std::filesystem::path const& path) :
+	m_file(path, std::ios::binary | std::ios::trunc),
+	m_lastElapsedTicks(UINT64_MAX),
+	m_count(0)
+{
+	if (!m_file)
+	{
+		throw std::runtime_error("Failed to create input recording");
+	}
+
+	PutU32(m_buffer, Magic);
+	PutU16(m_buffer, Version);
+	PutU16(m_buffer, 0);
+	PutU32(m_buffer, uint32_t(TicksPerSecond));
+	PutU32(m_buffer, uint32_t(TicksPerSecond >> 32));
+	Flush();
+}
+
+Recorder::~Recorder()
+{
+	try
+	{
+		Flush();
+	}
+	catch (...)
+	{
+	}
+}
+
+void Recorder::Record(uint64_t elapsedTicks, PlayerInput const& input)
+{
+	uint16_t flags = 0;
+	if (input.padConnected)		flags |= PadConnected;
+	if (input.leftStickPressed)	flags |= LeftStickPressed;
+	if (input.mouseLeft)		flags |= MouseLeft;
+	if (input.mouseMiddle)		flags |= MouseMiddle;
+	if (input.mouseRight)		flags |= MouseRight;
+	if (input.mouseRelative)	flags |= MouseRelative;
+	if (input.keyForward)		flags |= KeyForward;
+	if (input.keyBack)			flags |= KeyBack;
+	if (input.keyLeft)			flags |= KeyLeft;
+	if (input.keyRight)			flags |= KeyRight;
+	if (input.keySprint)		flags |= KeySprint;
+	if (input.mouseX != 0 || input.mouseY != 0) flags |= MouseMoved;
+	if (elapsedTicks == m_lastElapsedTicks) flags |= SameElapsed;
+
+	PutU16(m_buffer, flags);
+
+	if (!(flags & SameElapsed))
+	{
+		PutVarint(m_buffer, elapsedTicks);
+		m_lastElapsedTicks = elapsedTicks;
+	}
+
+	// Analog state is only meaningful with a pad attached.
+	if (flags & PadConnected)
+	{
+		PutFloat(m_buffer, input.leftTrigger);
+		PutFloat(m_buffer, input.leftStickX);
+		PutFloat(m_buffer, input.leftStickY);
+		PutFloat(m_buffer, input.rightStickX);
+		PutFloat(m_buffer, input.rightStickY);
+	}
+
+	if (flags & MouseMoved)
+	{
+		PutSignedVarint(m_buffer, input.mouseX);
+		PutSignedVarint(m_buffer, input.mouseY);
+	}
+
+	m_count++;
+
+	if (m_buffer.size() >= 64 * 1024)
+	{
+		Flush();
+	}
+}
+
+void Recorder::Checkpoint(uint64_t checksum)
+{
+	PutU16(m_buffer, IsCheckpoint);
+	PutU32(m_buffer, uint32_t(checksum));
+	PutU32(m_buffer, uint32_t(checksum >> 32));
+}
+
+void Recorder::Flush()
+{
+	if (m_buffer.empty())
+		return;
+
+	m_file.write(reinterpret_cast<const char*>(m_buffer.data()), std::streamsize(m_buffer.size()));
+	m_file.flush();
+	m_buffer.clear();
+
+	if (!m_file)
+	{
+		throw std::runtime_error("Failed to write input recording");
+	}
+}
+
+Replay::Replay(std::filesystem::path const& path) :
+	m_headerSize(0),
+	m_offset(0),
+	m_lastElapsedTicks(0),
+	m_position(0),
+	m_ticksPerSecond(0),
+	m_checkpointCount(0),
+	m_lastCheckpoint{}
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		throw std::runtime_error("Failed to open input recording");
+	}
+
+	m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	ReadHeader();
+}
+
+Replay::Replay(std::vector<uint8_t> data) :
+	m_data(std::move(data)),
+	m_headerSize(0),
+	m_offset(0),
+	m_lastElapsedTicks(0),
+	m_position(0),
+	m_ticksPerSecond(0),
+	m_checkpointCount(0),
+	m_lastCheckpoint{}
+{
+	ReadHeader();
+}
+
+void Replay::ReadHeader()
+{
+	if (m_data.size() < HeaderSize)
+	{
+		throw std::runtime_error("Input recording is truncated");
+	}
+
+	size_t offset = 0;
+	Reader reader(m_data, offset);
+
+	if (reader.GetU32() != Magic)
+	{
+		throw std::runtime_error("Not an input recording");
+	}
+
+	// Version 1 is the same without checkpoints.
+	const uint16_t version = reader.GetU16();
+	if (version < 1 || version > Version)
+	{
+		throw std::runtime_error("Unsupported input recording version");
+	}
+
+	reader.GetU16();
+	m_ticksPerSecond = reader.GetU64();
+	if (m_ticksPerSecond != TicksPerSecond)
+	{
+		throw std::runtime_error("Input recording uses an unknown tick format");
+	}
+
+	m_headerSize = offset;
+	m_offset = offset;
+}
+
+bool Replay::Next(uint64_t& elapsedTicks, PlayerInput& input)
+{
+	if (IsFinished())
+		return false;
+
+	Reader reader(m_data, m_offset);
+
+	uint16_t flags = reader.GetU16();
+	while (flags & IsCheckpoint)
+	{
+		m_lastCheckpoint = { m_position, reader.GetU64() };
+		m_checkpointCount++;
+
+		if (IsFinished())
+			return false;
+
+		flags = reader.GetU16();
+	}
+
+	if (!(flags & SameElapsed))
+	{
+		m_lastElapsedTicks = reader.GetVarint();
+	}
+	elapsedTicks = m_lastElapsedTicks;
+
+	input = {};
+	input.padConnected = (flags & PadConnected) != 0;
+	input.leftStickPressed = (flags & LeftStickPressed) != 0;
+	input.mouseLeft = (flags & MouseLeft) != 0;
+	input.mouseMiddle = (flags & MouseMiddle) != 0;
+	input.mouseRight = (flags & MouseRight) != 0;
+	input.mouseRelative = (flags & MouseRelative) != 0;
+	input.keyForward = (flags & KeyForward) != 0;
+	input.keyBack = (flags & KeyBack) != 0;
+	input.keyLeft = (flags & KeyLeft) != 0;
+	input.keyRight = (flags & KeyRight) != 0;
+	input.keySprint = (flags & KeySprint) != 0;
+
+	if (flags & PadConnected)
+	{
+		input.leftTrigger = reader.GetFloat();
+		input.leftStickX = reader.GetFloat();
+		input.leftStickY = reader.GetFloat();
+		input.rightStickX = reader.GetFloat();
+		input.rightStickY = reader.GetFloat();
+	}
+
+	if (flags & MouseMoved)
+	{
+		input.mouseX = reader.GetSignedVarint();
+		input.mouseY = reader.GetSignedVarint();
+	}
+
+	m_position++;
+
+	return true;
+}
+
+void Replay::Rewind() noexcept
+{
+	m_offset = m_headerSize;
+	m_lastElapsedTicks = 0;
+	m_position = 0;
+	m_checkpointCount = 0;
+	m_lastCheckpoint = {};
+}
+
+PlayerState InputRecording::Simulate(Replay& replay, uint64_t* ticks)
+{
+	PlayerSimulation sim;
+
+	uint64_t elapsedTicks;
+	PlayerInput input;
+	uint64_t total = 0;
+	uint32_t checkpoints = replay.GetCheckpointCount();
+
+	for (;;)
+	{
+		const bool more = replay.Next(elapsedTicks, input);
+
+		// Any checkpoints Next passed precede this tick.
+		if (replay.GetCheckpointCount() != checkpoints)
+		{
+			checkpoints = replay.GetCheckpointCount();
+			if (PlayerSimulation::Checksum(sim.GetState()) != replay.GetLastCheckpoint().checksum)
+			{
+				throw std::runtime_error("Replay diverged from the recorded run");
+			}
+		}
+
+		if (!more)
+			break;
+
+		// Matches the float conversion of StepTimer::GetElapsedSeconds.
+		const double seconds = static_cast<double>(elapsedTicks) / TicksPerSecond;
+		sim.Step(input, float(seconds));
+		total++;
+	}
+
+	if (ticks)
+	{
+		*ticks = total;
+	}
+
+	return sim.GetState();
+}
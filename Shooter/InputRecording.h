@@ -0,0 +1,105 @@
+//
+// InputRecording.h - Capture and playback of per-tick player input
+//
+
+#pragma once
+
+#include "PlayerSimulation.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+// Recordings are a small header followed by one variable length record per
+// simulation tick. Each record stores the elapsed StepTimer ticks and the
+// PlayerInput snapshot fed to PlayerSimulation::Step. Analog values keep their
+// exact bit patterns so a replay reproduces the recorded run bit for bit.
+//
+// Version 2 adds checkpoint records between ticks, holding the
+// PlayerSimulation::Checksum of the live run's state after every tick before
+// them, so a replay can tell whether it lands where the recording did.
+namespace InputRecording
+{
+	constexpr uint32_t Magic = 0x52494853; // 'SHIR'
+	constexpr uint16_t Version = 2;
+
+	// Same canonical tick format as DX::StepTimer.
+	constexpr uint64_t TicksPerSecond = 10000000;
+
+	// Appends records to a file as the game runs.
+	class Recorder
+	{
+	public:
+		explicit Recorder(std::filesystem::path const& path);
+		~Recorder();
+
+		Recorder(Recorder&&) = default;
+		Recorder& operator= (Recorder&&) = default;
+
+		Recorder(Recorder const&) = delete;
+		Recorder& operator= (Recorder const&) = delete;
+
+		void Record(uint64_t elapsedTicks, PlayerInput const& input);
+
+		// Notes the checksum of the state the recorded ticks so far led to.
+		void Checkpoint(uint64_t checksum);
+
+		void Flush();
+
+		uint64_t GetRecordCount() const noexcept { return m_count; }
+
+	private:
+		std::ofstream m_file;
+		std::vector<uint8_t> m_buffer;
+		uint64_t m_lastElapsedTicks;
+		uint64_t m_count;
+	};
+
+	// Loads a recording and hands back its records in order.
+	class Replay
+	{
+	public:
+		// The state the live run was in after a number of ticks.
+		struct Checkpoint
+		{
+			uint64_t position;
+			uint64_t checksum;
+		};
+
+		explicit Replay(std::filesystem::path const& path);
+		explicit Replay(std::vector<uint8_t> data);
+
+		// Returns false once every record has been consumed. Checkpoints
+		// passed on the way are kept rather than returned.
+		bool Next(uint64_t& elapsedTicks, PlayerInput& input);
+
+		void Rewind() noexcept;
+
+		bool IsFinished() const noexcept { return m_offset >= m_data.size(); }
+		uint64_t GetPosition() const noexcept { return m_position; }
+		uint64_t GetTicksPerSecond() const noexcept { return m_ticksPerSecond; }
+
+		// Checkpoints read so far, and the latest of them. Its position is
+		// the number of ticks before it.
+		uint32_t GetCheckpointCount() const noexcept { return m_checkpointCount; }
+		Checkpoint GetLastCheckpoint() const noexcept { return m_lastCheckpoint; }
+
+	private:
+		void ReadHeader();
+
+		std::vector<uint8_t> m_data;
+		size_t m_headerSize;
+		size_t m_offset;
+		uint64_t m_lastElapsedTicks;
+		uint64_t m_position;
+		uint64_t m_ticksPerSecond;
+		uint32_t m_checkpointCount;
+		Checkpoint m_lastCheckpoint;
+	};
+
+	// Runs a whole recording through a fresh simulation. Used to check that a
+	// replay lands on the same state as the live run that produced it: throws
+	// if the state differs from a checkpoint the recording holds.
+	PlayerState Simulate(Replay& replay, uint64_t* ticks = nullptr);
+}
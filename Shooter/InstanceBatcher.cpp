@@ -0,0 +1,63 @@
+//
+// InstanceBatcher.cpp
+//
+
+#include "InstanceBatcher.h"
+#include "RadixSort.h"
+
+using namespace DirectX;
+
+void InstanceBatcher::Reserve(size_t instances)
+{
+	m_transforms.reserve(instances);
+	m_entries.reserve(instances);
+	m_scratch.reserve(instances);
+}
+
+void InstanceBatcher::Clear() noexcept
+{
+	m_transforms.clear();
+	m_entries.clear();
+	m_batches.clear();
+}
+
+void InstanceBatcher::Add(uint32_t mesh, uint32_t material, FXMMATRIX world)
+{
+	m_entries.push_back({ (uint64_t(mesh) << 32) | material, uint32_t(m_transforms.size()) });
+
+	m_transforms.emplace_back();
+	XMStoreFloat3x4(&m_transforms.back(), world);
+}
+
+// Mesh and material ids are small, so most of the key's bytes are shared
+// and skipped by the sort.
+void InstanceBatcher::Build()
+{
+	m_batches.clear();
+
+	const size_t count = m_entries.size();
+	if (count == 0)
+		return;
+
+	RadixSort64(m_entries, m_scratch);
+
+	// Runs of equal keys are the batches.
+	uint32_t first = 0;
+	for (uint32_t i = 1; i <= count; ++i)
+	{
+		if (i == count || m_entries[i].key != m_entries[first].key)
+		{
+			const uint64_t key = m_entries[first].key;
+			m_batches.push_back({ uint32_t(key >> 32), uint32_t(key), first, i - first });
+			first = i;
+		}
+	}
+}
+
+void InstanceBatcher::Pack(XMFLOAT3X4* destination) const noexcept
+{
+	for (auto const& entry : m_entries)
+	{
+		*destination++ = m_transforms[entry.instance];
+	}
+}
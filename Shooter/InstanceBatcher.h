@@ -0,0 +1,66 @@
+//
+// InstanceBatcher.h - Groups repeated mesh draws and packs their transforms for instanced drawing
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+// Instances are collected in any order, then grouped by mesh and material so
+// each group becomes one instanced draw. Transforms are kept the way
+// DirectXTK's instanced effects read them: the transposed world matrix's
+// first three rows, an XMFLOAT3X4 per instance.
+class InstanceBatcher
+{
+public:
+	struct Batch
+	{
+		uint32_t mesh;
+		uint32_t material;
+		uint32_t firstInstance;		// Into the packed transforms
+		uint32_t instanceCount;
+	};
+
+	InstanceBatcher() = default;
+
+	InstanceBatcher(InstanceBatcher&&) = default;
+	InstanceBatcher& operator= (InstanceBatcher&&) = default;
+
+	InstanceBatcher(InstanceBatcher const&) = delete;
+	InstanceBatcher& operator= (InstanceBatcher const&) = delete;
+
+	void Reserve(size_t instances);
+
+	// Empties the batcher but keeps its memory for the next frame.
+	void Clear() noexcept;
+
+	void Add(uint32_t mesh, uint32_t material, DirectX::FXMMATRIX world);
+
+	// Groups the instances with a stable radix sort, so within a batch they
+	// keep the order they were added in. Batches are ordered by mesh, then
+	// material.
+	void Build();
+
+	size_t GetInstanceCount() const noexcept { return m_transforms.size(); }
+	std::vector<Batch> const& GetBatches() const noexcept { return m_batches; }
+
+	// Writes GetInstanceCount() transforms in batch order, typically straight
+	// into a mapped instance buffer. Build must have run since the last Add.
+	void Pack(DirectX::XMFLOAT3X4* destination) const noexcept;
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t instance;
+	};
+
+	std::vector<DirectX::XMFLOAT3X4> m_transforms;
+	std::vector<Entry> m_entries;
+	std::vector<Entry> m_scratch;
+	std::vector<Batch> m_batches;
+};
@@ -0,0 +1,111 @@
+//
+// Lz4.cpp
+//
+
+#include "Lz4.h"
+
+#include <cstring>
+
+namespace
+{
+	constexpr size_t MinMatch = 4;
+
+	// Adds a length's continuation bytes, each 255 until the last, to it.
+	bool ReadLength(const uint8_t*& in, const uint8_t* end, size_t& length) noexcept
+	{
+		for (;;)
+		{
+			if (in == end || length > (SIZE_MAX >> 1))
+				return false;
+
+			const uint8_t byte = *in++;
+			length += byte;
+			if (byte != 255)
+				return true;
+		}
+	}
+}
+
+// Copies run 16 or 8 bytes at a time where both buffers have room past the
+// end of the copy, which the fixed-size memcpy compiles down to a couple of
+// moves for; the bytes written past it are overwritten by what follows.
+// Only matches closer than 8 bytes, which overlap what they copy from, go a
+// byte at a time.
+bool Lz4::Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize) noexcept
+{
+	const uint8_t* in = source;
+	const uint8_t* const inEnd = source + sourceSize;
+	uint8_t* out = destination;
+	uint8_t* const outEnd = destination + destinationSize;
+
+	for (;;)
+	{
+		if (in == inEnd)
+			return false;
+		const unsigned token = *in++;
+
+		size_t literals = token >> 4;
+		if (literals == 15 && !ReadLength(in, inEnd, literals))
+			return false;
+		if (literals > size_t(inEnd - in) || literals > size_t(outEnd - out))
+			return false;
+
+		if (literals <= 16 && inEnd - in >= 16 && outEnd - out >= 16)
+		{
+			std::memcpy(out, in, 16);
+		}
+		else
+		{
+			std::memcpy(out, in, literals);
+		}
+		in += literals;
+		out += literals;
+
+		// The last sequence is literals alone.
+		if (in == inEnd)
+			return out == outEnd;
+
+		if (inEnd - in < 2)
+			return false;
+		const size_t offset = size_t(in[0]) | size_t(in[1]) << 8;
+		in += 2;
+		if (offset == 0 || offset > size_t(out - destination))
+			return false;
+
+		size_t length = token & 15;
+		if (length == 15 && !ReadLength(in, inEnd, length))
+			return false;
+		length += MinMatch;
+		if (length > size_t(outEnd - out))
+			return false;
+
+		const uint8_t* match = out - offset;
+		uint8_t* const end = out + length;
+		if (offset >= 16 && size_t(outEnd - out) >= length + 15)
+		{
+			do
+			{
+				std::memcpy(out, match, 16);
+				out += 16;
+				match += 16;
+			} while (out < end);
+		}
+		else if (offset >= 8 && size_t(outEnd - out) >= length + 7)
+		{
+			do
+			{
+				std::memcpy(out, match, 8);
+				out += 8;
+				match += 8;
+			} while (out < end);
+		}
+		else
+		{
+			while (out < end)
+			{
+				*out++ = *match++;
+			}
+		}
+		out = end;
+	}
+}
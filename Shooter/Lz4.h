@@ -0,0 +1,22 @@
+//
+// Lz4.h - Decodes LZ4 compressed blocks
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The LZ4 block format: sequences of literal bytes, each followed by a copy
+// of bytes already decoded, up to 64 KB back. Decoding is copies and
+// nothing else, so it runs at several GB/s per core, and blocks compressed
+// on their own decode independently, in parallel. The encoder lives with
+// the tools that write compressed data (ShooterTools' Lz4Compressor.h).
+namespace Lz4
+{
+	// Decodes a block that decompresses to exactly destinationSize bytes.
+	// Checks every length and offset against both buffers, so damaged input
+	// returns false rather than reading or writing out of bounds; what was
+	// written to the destination by then is unspecified.
+	bool Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize) noexcept;
+}
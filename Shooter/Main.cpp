@@ -6,6 +6,9 @@
 #include "pch.h"
 #include "Game.h"
 
+#include <map>
+#include <sstream>
+
 using namespace winrt::Windows::ApplicationModel;
 using namespace winrt::Windows::ApplicationModel::Core;
 using namespace winrt::Windows::ApplicationModel::Activation;
@@ -15,6 +18,7 @@ using namespace winrt::Windows::UI::ViewManagement;
 using namespace winrt::Windows::System;
 using namespace winrt::Windows::Foundation;
 using namespace winrt::Windows::Graphics::Display;
+using namespace winrt::Windows::Storage;
 using namespace DirectX;
 
 void ExitGame() noexcept;
@@ -27,6 +31,28 @@ void GetWindowBounds(_In_ ::IUnknown* window, _Out_ RECT* rect);
 
 namespace
 {
+    // Launch arguments come as option and value pairs.
+    std::map<std::wstring, std::wstring> ParseLaunchArguments(winrt::hstring const& arguments)
+    {
+        std::wistringstream stream{ std::wstring(arguments) };
+
+        std::map<std::wstring, std::wstring> options;
+
+        std::wstring option;
+        std::wstring value;
+        while (stream >> option >> value)
+        {
+            options[option] = value;
+        }
+
+        return options;
+    }
+
+    std::filesystem::path ResolveLocalPath(std::wstring const& path)
+    {
+        return std::filesystem::path(std::wstring(ApplicationData::Current().LocalFolder().Path())) / std::filesystem::path(path);
+    }
+
     inline int ConvertDipsToPixels(float dips, float dpi) noexcept
     {
         return int(dips * dpi / 96.f + 0.5f);
@@ -128,6 +154,8 @@ public:
             std::swap(outputWidth, outputHeight);
         }
 
+        StartLaunchTrace();
+
         auto windowPtr = static_cast<::IUnknown*>(winrt::get_abi(window));
         m_game->Initialize(windowPtr, outputWidth, outputHeight, rotation);
 
@@ -169,6 +197,8 @@ protected:
                 CoreApplication::Exit();
                 return;
             }
+
+            ApplyLaunchArguments(launchArgs->Arguments());
         }
 
         int w, h;
@@ -351,6 +381,91 @@ private:
         return rotation;
     }
 
+    // Activation, and with it ApplyLaunchArguments, comes after the game has
+    // initialized; -trace is taken from the launch arguments up front so the
+    // trace covers creating the device and loading assets.
+    void StartLaunchTrace()
+    {
+        try
+        {
+            auto const args = AppInstance::GetActivatedEventArgs();
+            if (!args || args.Kind() != ActivationKind::Launch)
+                return;
+
+            auto options = ParseLaunchArguments(args.as<LaunchActivatedEventArgs>().Arguments());
+            if (options.count(L"-trace"))
+            {
+                m_game->StartTrace(ResolveLocalPath(options[L"-trace"]));
+            }
+        }
+        catch (winrt::hresult_error const& e)
+        {
+            OutputDebugStringW(e.message().c_str());
+            OutputDebugStringW(L"\n");
+        }
+    }
+
+    // Supported arguments:
+    //   -record <file>      Capture player input to a file
+    //   -replay <file>      Drive the player from a recording instead of the devices
+    //   -benchmark <secs>   Run the scripted benchmark, write a report and exit
+    //   -report <file>      Benchmark report path, .json or .csv (default benchmark.csv)
+    //   -trace <file>       Profile startup and every frame and write a Chrome trace on exit, see StartLaunchTrace
+    //   -viewmodel <mode>   'partition' (default) or 'texture' to composite the weapon from a render texture
+    //   -dynres <ms>        Scale the scene's resolution to keep GPU frame time within the budget
+    //   -props <count>      Scatter boxes around the room to exercise culling and submission
+    //   -occlusion <count>  Occlusion cull the props against the nearest count of them, rasterized on the CPU
+    // Relative paths are resolved against the app's local data folder.
+    void ApplyLaunchArguments(winrt::hstring const& arguments)
+    {
+        auto options = ParseLaunchArguments(arguments);
+
+        try
+        {
+            if (options.count(L"-viewmodel"))
+            {
+                m_game->SetViewmodelMode(options[L"-viewmodel"] == L"texture"
+                    ? ViewmodelMode::RenderTexture : ViewmodelMode::DepthPartition);
+            }
+
+            if (options.count(L"-dynres"))
+            {
+                m_game->EnableDynamicResolution(std::stod(options[L"-dynres"]));
+            }
+
+            if (options.count(L"-props"))
+            {
+                m_game->CreateProps(static_cast<uint32_t>(std::stoul(options[L"-props"])));
+            }
+
+            if (options.count(L"-occlusion"))
+            {
+                m_game->EnableOcclusionCulling(static_cast<uint32_t>(std::stoul(options[L"-occlusion"])));
+            }
+
+            if (options.count(L"-record"))
+            {
+                m_game->StartRecording(ResolveLocalPath(options[L"-record"]));
+            }
+
+            if (options.count(L"-replay"))
+            {
+                m_game->StartReplay(ResolveLocalPath(options[L"-replay"]));
+            }
+
+            if (options.count(L"-benchmark"))
+            {
+                auto const report = options.count(L"-report") ? options[L"-report"] : std::wstring(L"benchmark.csv");
+                m_game->StartBenchmark(std::stod(options[L"-benchmark"]), ResolveLocalPath(report));
+            }
+        }
+        catch (std::exception const& e)
+        {
+            OutputDebugStringA(e.what());
+            OutputDebugStringA("\n");
+        }
+    }
+
     void HandleWindowSizeChanged()
     {
         int outputWidth = ConvertDipsToPixels(m_logicalWidth, m_DPI);
@@ -0,0 +1,196 @@
+//
+// MappedFile.cpp
+//
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(std::filesystem::path const& path) :
+	m_data(nullptr),
+	m_size(0),
+	m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr)
+{
+	m_file = CreateFile2(path.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open " + path.string());
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(m_file, &size))
+	{
+		Close();
+		throw std::runtime_error("Failed to get the size of " + path.string());
+	}
+
+	// Nothing to map, and mapping nothing fails.
+	m_size = static_cast<size_t>(size.QuadPart);
+	if (m_size == 0)
+		return;
+
+	m_mapping = CreateFileMappingFromApp(m_file, nullptr, PAGE_READONLY, 0, nullptr);
+	if (m_mapping)
+	{
+		m_data = static_cast<const uint8_t*>(MapViewOfFileFromApp(m_mapping, FILE_MAP_READ, 0, 0));
+	}
+
+	if (!m_data)
+	{
+		Close();
+		throw std::runtime_error("Failed to map " + path.string());
+	}
+}
+
+void MappedFile::Close() noexcept
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const noexcept
+{
+	if (offset >= m_size)
+		return;
+
+	WIN32_MEMORY_RANGE_ENTRY range = {};
+	range.VirtualAddress = const_cast<uint8_t*>(m_data + offset);
+	range.NumberOfBytes = std::min(size, m_size - offset);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+	m_data(std::exchange(other.m_data, nullptr)),
+	m_size(std::exchange(other.m_size, 0)),
+	m_file(std::exchange(other.m_file, INVALID_HANDLE_VALUE)),
+	m_mapping(std::exchange(other.m_mapping, nullptr))
+{
+}
+
+MappedFile& MappedFile::operator= (MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+		m_file = std::exchange(other.m_file, INVALID_HANDLE_VALUE);
+		m_mapping = std::exchange(other.m_mapping, nullptr);
+	}
+	return *this;
+}
+
+#else
+
+MappedFile::MappedFile(std::filesystem::path const& path) :
+	m_data(nullptr),
+	m_size(0),
+	m_file(-1)
+{
+	m_file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (m_file < 0)
+		throw std::runtime_error("Failed to open " + path.string());
+
+	struct stat status = {};
+	if (fstat(m_file, &status) != 0)
+	{
+		Close();
+		throw std::runtime_error("Failed to get the size of " + path.string());
+	}
+
+	m_size = static_cast<size_t>(status.st_size);
+	if (m_size == 0)
+		return;
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		throw std::runtime_error("Failed to map " + path.string());
+	}
+	m_data = static_cast<const uint8_t*>(data);
+}
+
+void MappedFile::Close() noexcept
+{
+	if (m_data)
+	{
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+	if (m_file >= 0)
+	{
+		close(m_file);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_file = -1;
+}
+
+// madvise wants a page-aligned start, which the mapping's is.
+void MappedFile::Prefetch(size_t offset, size_t size) const noexcept
+{
+	if (offset >= m_size)
+		return;
+
+	const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+	const size_t start = offset / pageSize * pageSize;
+	const size_t end = offset + std::min(size, m_size - offset);
+	madvise(const_cast<uint8_t*>(m_data) + start, end - start, MADV_WILLNEED);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+	m_data(std::exchange(other.m_data, nullptr)),
+	m_size(std::exchange(other.m_size, 0)),
+	m_file(std::exchange(other.m_file, -1))
+{
+}
+
+MappedFile& MappedFile::operator= (MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+		m_file = std::exchange(other.m_file, -1);
+	}
+	return *this;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
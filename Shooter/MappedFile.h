@@ -0,0 +1,48 @@
+//
+// MappedFile.h - Read-only memory mapping of a whole file
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Maps a file so parsers can read it in place: pages come in from the file
+// cache as they're touched instead of being copied into a buffer first.
+// Uses file mappings the app container allows on Windows and mmap elsewhere.
+class MappedFile
+{
+public:
+	// Throws std::runtime_error if the file can't be opened or mapped.
+	explicit MappedFile(std::filesystem::path const& path);
+	~MappedFile();
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator= (MappedFile&& other) noexcept;
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator= (MappedFile const&) = delete;
+
+	// Null for an empty file.
+	const uint8_t* GetData() const noexcept { return m_data; }
+	size_t GetSize() const noexcept { return m_size; }
+
+	// Asks the OS to start reading a range of the file in, without waiting
+	// for it, so it arrives while earlier parts are being used. Only a
+	// hint.
+	void Prefetch(size_t offset, size_t size) const noexcept;
+
+private:
+	void Close() noexcept;
+
+	const uint8_t* m_data;
+	size_t m_size;
+
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif
+};
@@ -0,0 +1,84 @@
+//
+// MeshArena.cpp
+//
+
+#include "MeshArena.h"
+
+#include <stdexcept>
+
+MeshArena::MeshArena(uint32_t vertexCapacity, uint32_t indexCapacity) :
+	m_vertices(vertexCapacity),
+	m_indices(indexCapacity),
+	m_meshCount(0),
+	m_defragmentations(0)
+{
+}
+
+uint32_t MeshArena::Add(uint32_t vertexCount, uint32_t indexCount)
+{
+	if (vertexCount == 0 || indexCount == 0)
+		throw std::invalid_argument("Arena meshes need vertices and indices");
+
+	const uint32_t vertices = m_vertices.Allocate(vertexCount);
+	if (vertices == OffsetAllocator::InvalidHandle)
+		return InvalidMesh;
+
+	const uint32_t indices = m_indices.Allocate(indexCount);
+	if (indices == OffsetAllocator::InvalidHandle)
+	{
+		m_vertices.Free(vertices);
+		return InvalidMesh;
+	}
+
+	uint32_t mesh;
+	if (!m_freeMeshes.empty())
+	{
+		mesh = m_freeMeshes.back();
+		m_freeMeshes.pop_back();
+	}
+	else
+	{
+		mesh = uint32_t(m_meshes.size());
+		m_meshes.emplace_back();
+	}
+
+	m_meshes[mesh] = { vertices, indices };
+	m_meshCount++;
+	return mesh;
+}
+
+void MeshArena::Remove(uint32_t mesh)
+{
+	if (mesh >= m_meshes.size() || m_meshes[mesh].vertices == OffsetAllocator::InvalidHandle)
+		throw std::invalid_argument("Mesh is not in the arena");
+
+	m_vertices.Free(m_meshes[mesh].vertices);
+	m_indices.Free(m_meshes[mesh].indices);
+	m_meshes[mesh] = { OffsetAllocator::InvalidHandle, OffsetAllocator::InvalidHandle };
+	m_freeMeshes.push_back(mesh);
+	m_meshCount--;
+}
+
+MeshArena::Range MeshArena::GetRange(uint32_t mesh) const noexcept
+{
+	Mesh const& entry = m_meshes[mesh];
+	return { m_vertices.GetOffset(entry.vertices), m_vertices.GetSize(entry.vertices),
+		m_indices.GetOffset(entry.indices), m_indices.GetSize(entry.indices) };
+}
+
+bool MeshArena::WouldFitDefragmented(uint32_t vertexCount, uint32_t indexCount) const noexcept
+{
+	return vertexCount <= m_vertices.GetFreeUnits() && indexCount <= m_indices.GetFreeUnits();
+}
+
+void MeshArena::Defragment(std::vector<OffsetAllocator::Move>& vertexMoves, std::vector<OffsetAllocator::Move>& indexMoves)
+{
+	m_vertices.Defragment(vertexMoves);
+	m_indices.Defragment(indexMoves);
+	m_defragmentations++;
+}
+
+MeshArena::Stats MeshArena::GetStats() const noexcept
+{
+	return { m_vertices.GetStats(), m_indices.GetStats(), m_meshCount, m_defragmentations };
+}
@@ -0,0 +1,87 @@
+//
+// MeshArena.h - Static meshes packed into shared vertex and index buffers
+//
+
+#pragma once
+
+#include "OffsetAllocator.h"
+
+#include <cstdint>
+#include <vector>
+
+// Keeps track of where each mesh lives in one vertex buffer and one index
+// buffer shared by every mesh of a vertex format. A mesh is a vertex range
+// and an index range; its indices are relative to its first vertex, so
+// they're drawn with that as the base vertex and 16-bit indices reach any
+// vertex in the buffer.
+//
+// Ranges come from an OffsetAllocator each, so meshes can come and go, and
+// Defragment packs them back together when removals leave the buffers too
+// scattered for a new mesh.
+class MeshArena
+{
+public:
+	static constexpr uint32_t InvalidMesh = ~0u;
+
+	struct Range
+	{
+		uint32_t baseVertex;
+		uint32_t vertexCount;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	struct Stats
+	{
+		OffsetAllocator::Stats vertices;
+		OffsetAllocator::Stats indices;
+		uint32_t meshes;
+		uint64_t defragmentations;
+	};
+
+	// Capacities in vertices and indices. Throws std::invalid_argument if either is zero.
+	MeshArena(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+	MeshArena(MeshArena&&) = default;
+	MeshArena& operator= (MeshArena&&) = default;
+
+	MeshArena(MeshArena const&) = delete;
+	MeshArena& operator= (MeshArena const&) = delete;
+
+	// Returns the new mesh, or InvalidMesh if either buffer has no free
+	// range big enough. Throws std::invalid_argument for an empty mesh.
+	uint32_t Add(uint32_t vertexCount, uint32_t indexCount);
+
+	// Throws std::invalid_argument for a mesh that isn't in the arena.
+	void Remove(uint32_t mesh);
+
+	// Only valid for meshes in the arena, and until the next Defragment.
+	Range GetRange(uint32_t mesh) const noexcept;
+
+	// True when both buffers have the space for the mesh, just not in one piece.
+	bool WouldFitDefragmented(uint32_t vertexCount, uint32_t indexCount) const noexcept;
+
+	// Packs both buffers, see OffsetAllocator::Defragment. Meshes keep their
+	// ids; the moves are in vertices and indices.
+	void Defragment(std::vector<OffsetAllocator::Move>& vertexMoves, std::vector<OffsetAllocator::Move>& indexMoves);
+
+	uint32_t GetVertexCapacity() const noexcept { return m_vertices.GetCapacity(); }
+	uint32_t GetIndexCapacity() const noexcept { return m_indices.GetCapacity(); }
+
+	Stats GetStats() const noexcept;
+
+private:
+	struct Mesh
+	{
+		uint32_t vertices;				// Allocator handles; InvalidHandle for a free id
+		uint32_t indices;
+	};
+
+	OffsetAllocator m_vertices;
+	OffsetAllocator m_indices;
+
+	std::vector<Mesh> m_meshes;
+	std::vector<uint32_t> m_freeMeshes;
+	uint32_t m_meshCount;
+	uint64_t m_defragmentations;
+};
@@ -0,0 +1,521 @@
+//
+// OcclusionCuller.cpp
+//
+
+#include "OcclusionCuller.h"
+
+#include "SceneRegistry.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace
+{
+	// Stands in for an edge that doesn't bound a row on that side.
+	constexpr float Unbounded = 1e30f;
+
+	// Box corners are numbered by the sign of each extent: bit 0 is x, 1 is y, 2 is z.
+	const uint32_t c_boxIndices[36] =
+	{
+		0, 1, 3,  0, 3, 2,		// -z
+		4, 6, 7,  4, 7, 5,		// +z
+		0, 2, 6,  0, 6, 4,		// -x
+		1, 5, 7,  1, 7, 3,		// +x
+		0, 4, 5,  0, 5, 1,		// -y
+		2, 3, 7,  2, 7, 6,		// +y
+	};
+
+	// Outside flags for the six clip planes.
+	uint32_t GetOutcode(XMFLOAT4 const& v) noexcept
+	{
+		return (v.x < -v.w ? 1u : 0u) | (v.x > v.w ? 2u : 0u)
+			| (v.y < -v.w ? 4u : 0u) | (v.y > v.w ? 8u : 0u)
+			| (v.z < 0.0f ? 16u : 0u) | (v.z > v.w ? 32u : 0u);
+	}
+
+	constexpr uint32_t NearOutcode = 16;
+
+	// Bits for the pixels in columns [first, last] of one subtile row.
+	uint32_t GetRowBits(int32_t first, int32_t last) noexcept
+	{
+		first = std::max(first, 0);
+		last = std::min(last, int32_t(OcclusionCuller::SubtileWidth) - 1);
+		if (first > last)
+			return 0;
+
+		return (0xFFu << first) & (0xFFu >> (7 - last));
+	}
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height) :
+	m_width(width),
+	m_height(height),
+	m_subtilesX(width / SubtileWidth),
+	m_subtilesY(height / SubtileHeight),
+	m_binsX((width + BinWidth - 1) / BinWidth),
+	m_binsY((height + BinHeight - 1) / BinHeight),
+	m_stats{}
+{
+	if (width == 0 || height == 0 || width % SubtileWidth != 0 || height % SubtileHeight != 0)
+	{
+		throw std::invalid_argument("Occlusion buffer size must be a whole number of subtiles");
+	}
+
+	m_zMax0.resize(size_t(m_subtilesX) * m_subtilesY);
+	m_zMax1.resize(m_zMax0.size());
+	m_mask.resize(m_zMax0.size());
+	m_binTriangles.resize(size_t(m_binsX) * m_binsY);
+	m_binRasterized.resize(m_binTriangles.size());
+
+	Clear();
+}
+
+void OcclusionCuller::Clear() noexcept
+{
+	std::fill(m_zMax0.begin(), m_zMax0.end(), 1.0f);
+	std::fill(m_zMax1.begin(), m_zMax1.end(), 0.0f);
+	std::fill(m_mask.begin(), m_mask.end(), 0u);
+
+	m_triangles.clear();
+	for (auto& bin : m_binTriangles)
+	{
+		bin.clear();
+	}
+}
+
+void OcclusionCuller::AddOccluder(FXMMATRIX worldViewProjection, XMFLOAT3 const* vertices,
+	uint32_t const* indices, size_t indexCount)
+{
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const XMVECTOR a = XMVector3Transform(XMLoadFloat3(&vertices[indices[i]]), worldViewProjection);
+		const XMVECTOR b = XMVector3Transform(XMLoadFloat3(&vertices[indices[i + 1]]), worldViewProjection);
+		const XMVECTOR c = XMVector3Transform(XMLoadFloat3(&vertices[indices[i + 2]]), worldViewProjection);
+		AddClipTriangle(a, b, c);
+	}
+
+	m_stats.triangles += indexCount / 3;
+}
+
+void OcclusionCuller::AddOccluderBox(FXMMATRIX viewProjection, XMFLOAT3 const& center, XMFLOAT3 const& extents)
+{
+	XMFLOAT3 corners[8];
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		corners[i].x = center.x + ((i & 1) ? extents.x : -extents.x);
+		corners[i].y = center.y + ((i & 2) ? extents.y : -extents.y);
+		corners[i].z = center.z + ((i & 4) ? extents.z : -extents.z);
+	}
+
+	AddOccluder(viewProjection, corners, c_boxIndices, 36);
+}
+
+// Rejects triangles outside one clip plane and clips the rest against the
+// near plane only; the other planes are handled by the pixel bounds.
+void OcclusionCuller::AddClipTriangle(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c)
+{
+	XMFLOAT4 clip[4];
+	XMStoreFloat4(&clip[0], a);
+	XMStoreFloat4(&clip[1], b);
+	XMStoreFloat4(&clip[2], c);
+
+	const uint32_t outcodes[3] = { GetOutcode(clip[0]), GetOutcode(clip[1]), GetOutcode(clip[2]) };
+	if (outcodes[0] & outcodes[1] & outcodes[2])
+		return;
+
+	uint32_t count = 3;
+	if ((outcodes[0] | outcodes[1] | outcodes[2]) & NearOutcode)
+	{
+		// z >= 0 keeps a vertex; edges crossing the plane get a new one on it.
+		XMFLOAT4 clipped[4];
+		count = 0;
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			auto const& p = clip[i];
+			auto const& q = clip[(i + 1) % 3];
+
+			if (p.z >= 0.0f)
+			{
+				clipped[count++] = p;
+			}
+
+			if ((p.z >= 0.0f) != (q.z >= 0.0f))
+			{
+				const float t = p.z / (p.z - q.z);
+				clipped[count++] = { p.x + (q.x - p.x) * t, p.y + (q.y - p.y) * t, 0.0f, p.w + (q.w - p.w) * t };
+			}
+		}
+		std::copy(clipped, clipped + count, clip);
+	}
+
+	// To pixels: x right and y down, with Direct3D's depth.
+	XMFLOAT4 screen[4];
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (clip[i].w <= 0.0f)
+			return;
+
+		const float invW = 1.0f / clip[i].w;
+		screen[i].x = (clip[i].x * invW * 0.5f + 0.5f) * float(m_width);
+		screen[i].y = (0.5f - clip[i].y * invW * 0.5f) * float(m_height);
+		screen[i].z = clip[i].z * invW;
+		screen[i].w = 1.0f;
+	}
+
+	AddScreenTriangle(screen);
+	if (count == 4)
+	{
+		const XMFLOAT4 second[3] = { screen[0], screen[2], screen[3] };
+		AddScreenTriangle(second);
+	}
+}
+
+void OcclusionCuller::AddScreenTriangle(XMFLOAT4 const* vertices)
+{
+	XMFLOAT4 v[3] = { vertices[0], vertices[1], vertices[2] };
+
+	float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+	if (area == 0.0f)
+		return;
+
+	// Wind every triangle the same way so the inside is where all three
+	// edge functions are positive.
+	if (area < 0.0f)
+	{
+		std::swap(v[1], v[2]);
+		area = -area;
+	}
+
+	Triangle triangle;
+
+	// Edge a->b: (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x) >= 0 inside,
+	// which solved for x bounds the row from the left when b is below a and
+	// from the right when it's above.
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		auto const& from = v[i];
+		auto const& to = v[(i + 1) % 3];
+
+		const float dx = to.x - from.x;
+		const float dy = to.y - from.y;
+
+		triangle.leftOffset[i] = -Unbounded;
+		triangle.leftSlope[i] = 0.0f;
+		triangle.rightOffset[i] = Unbounded;
+		triangle.rightSlope[i] = 0.0f;
+
+		// Horizontal edges are top or bottom, which the pixel bounds handle.
+		if (dy == 0.0f)
+			continue;
+
+		const float slope = dx / dy;
+		const float offset = from.x - slope * from.y;
+		if (dy < 0.0f)
+		{
+			triangle.leftOffset[i] = offset;
+			triangle.leftSlope[i] = slope;
+		}
+		else
+		{
+			triangle.rightOffset[i] = offset;
+			triangle.rightSlope[i] = slope;
+		}
+	}
+
+	const float dz1 = v[1].z - v[0].z;
+	const float dz2 = v[2].z - v[0].z;
+	triangle.depthX = (dz1 * (v[2].y - v[0].y) - dz2 * (v[1].y - v[0].y)) / area;
+	triangle.depthY = (dz2 * (v[1].x - v[0].x) - dz1 * (v[2].x - v[0].x)) / area;
+	triangle.depthOffset = v[0].z - triangle.depthX * v[0].x - triangle.depthY * v[0].y;
+	triangle.maxDepth = std::max(v[0].z, std::max(v[1].z, v[2].z));
+
+	// Pixels whose centers fall within the triangle's bounds.
+	const float minX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+	const float maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+	const float minY = std::min(v[0].y, std::min(v[1].y, v[2].y));
+	const float maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+
+	triangle.minX = int32_t(std::max(std::ceil(minX - 0.5f), 0.0f));
+	triangle.minY = int32_t(std::max(std::ceil(minY - 0.5f), 0.0f));
+	triangle.maxX = int32_t(std::min(std::floor(maxX - 0.5f), float(m_width - 1)));
+	triangle.maxY = int32_t(std::min(std::floor(maxY - 0.5f), float(m_height - 1)));
+
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	const uint32_t index = uint32_t(m_triangles.size());
+	m_triangles.push_back(triangle);
+
+	for (uint32_t by = uint32_t(triangle.minY) / BinHeight; by <= uint32_t(triangle.maxY) / BinHeight; ++by)
+	{
+		for (uint32_t bx = uint32_t(triangle.minX) / BinWidth; bx <= uint32_t(triangle.maxX) / BinWidth; ++bx)
+		{
+			m_binTriangles[by * m_binsX + bx].push_back(index);
+		}
+	}
+}
+
+void OcclusionCuller::Rasterize(ThreadPool* pool)
+{
+	const uint32_t binCount = uint32_t(m_binTriangles.size());
+	std::fill(m_binRasterized.begin(), m_binRasterized.end(), 0);
+
+	auto const task = [](void* culler, uint32_t bin) { static_cast<OcclusionCuller*>(culler)->RasterizeBin(bin); };
+	if (pool)
+	{
+		pool->ParallelFor(binCount, task, this);
+	}
+	else
+	{
+		for (uint32_t bin = 0; bin < binCount; ++bin)
+		{
+			task(this, bin);
+		}
+	}
+
+	for (auto const rasterized : m_binRasterized)
+	{
+		m_stats.rasterized += rasterized;
+	}
+}
+
+// Bins are whole subtiles, so bins never share a record.
+void OcclusionCuller::RasterizeBin(uint32_t bin) noexcept
+{
+	const int32_t minX = int32_t(bin % m_binsX * BinWidth);
+	const int32_t minY = int32_t(bin / m_binsX * BinHeight);
+	const int32_t maxX = std::min(minX + int32_t(BinWidth), int32_t(m_width)) - 1;
+	const int32_t maxY = std::min(minY + int32_t(BinHeight), int32_t(m_height)) - 1;
+
+	for (const uint32_t index : m_binTriangles[bin])
+	{
+		auto const& triangle = m_triangles[index];
+		RasterizeTriangle(triangle, std::max(triangle.minX, minX), std::max(triangle.minY, minY),
+			std::min(triangle.maxX, maxX), std::min(triangle.maxY, maxY));
+	}
+
+	m_binRasterized[bin] = m_binTriangles[bin].size();
+}
+
+// Walks the triangle a subtile row at a time, finding the span of each of
+// the four pixel rows at once, then turns the spans into coverage masks.
+void OcclusionCuller::RasterizeTriangle(Triangle const& triangle, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY) noexcept
+{
+	const XMVECTOR rowCenters = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	const XMVECTOR half = XMVectorReplicate(0.5f);
+
+	XMVECTOR leftOffset[3], leftSlope[3], rightOffset[3], rightSlope[3];
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		leftOffset[i] = XMVectorReplicate(triangle.leftOffset[i]);
+		leftSlope[i] = XMVectorReplicate(triangle.leftSlope[i]);
+		rightOffset[i] = XMVectorReplicate(triangle.rightOffset[i]);
+		rightSlope[i] = XMVectorReplicate(triangle.rightSlope[i]);
+	}
+
+	// Spans are clamped to one pixel past the bounds either side, so empty
+	// rows stay empty and the conversion to integers can't overflow.
+	const XMVECTOR firstMin = XMVectorReplicate(float(minX));
+	const XMVECTOR firstMax = XMVectorReplicate(float(maxX + 1));
+	const XMVECTOR lastMin = XMVectorReplicate(float(minX - 1));
+	const XMVECTOR lastMax = XMVectorReplicate(float(maxX));
+
+	// The depth plane at the corners of a subtile, relative to its top left.
+	const XMVECTOR cornerDepth = XMVectorSet(0.0f, triangle.depthX * SubtileWidth, triangle.depthY * SubtileHeight,
+		triangle.depthX * SubtileWidth + triangle.depthY * SubtileHeight);
+
+	for (int32_t top = minY / int32_t(SubtileHeight) * int32_t(SubtileHeight); top <= maxY; top += SubtileHeight)
+	{
+		const XMVECTOR y = XMVectorAdd(XMVectorReplicate(float(top)), rowCenters);
+
+		XMVECTOR left = XMVectorMultiplyAdd(leftSlope[0], y, leftOffset[0]);
+		left = XMVectorMax(left, XMVectorMultiplyAdd(leftSlope[1], y, leftOffset[1]));
+		left = XMVectorMax(left, XMVectorMultiplyAdd(leftSlope[2], y, leftOffset[2]));
+
+		XMVECTOR right = XMVectorMultiplyAdd(rightSlope[0], y, rightOffset[0]);
+		right = XMVectorMin(right, XMVectorMultiplyAdd(rightSlope[1], y, rightOffset[1]));
+		right = XMVectorMin(right, XMVectorMultiplyAdd(rightSlope[2], y, rightOffset[2]));
+
+		// First and last pixels whose centers are inside.
+		const XMVECTOR first = XMVectorClamp(XMVectorCeiling(XMVectorSubtract(left, half)), firstMin, firstMax);
+		const XMVECTOR last = XMVectorClamp(XMVectorFloor(XMVectorSubtract(right, half)), lastMin, lastMax);
+
+		XMFLOAT4 firstRows, lastRows;
+		XMStoreFloat4(&firstRows, first);
+		XMStoreFloat4(&lastRows, last);
+
+		int32_t spanFirst[4] = { int32_t(firstRows.x), int32_t(firstRows.y), int32_t(firstRows.z), int32_t(firstRows.w) };
+		int32_t spanLast[4] = { int32_t(lastRows.x), int32_t(lastRows.y), int32_t(lastRows.z), int32_t(lastRows.w) };
+
+		int32_t columnMin = maxX + 1;
+		int32_t columnMax = minX - 1;
+		for (int32_t row = 0; row < int32_t(SubtileHeight); ++row)
+		{
+			if (top + row < minY || top + row > maxY)
+			{
+				spanFirst[row] = maxX + 1;
+				spanLast[row] = minX - 1;
+			}
+			else if (spanFirst[row] <= spanLast[row])
+			{
+				columnMin = std::min(columnMin, spanFirst[row]);
+				columnMax = std::max(columnMax, spanLast[row]);
+			}
+		}
+
+		if (columnMin > columnMax)
+			continue;
+
+		const uint32_t subtileRow = uint32_t(top) / SubtileHeight;
+		const float rowDepth = triangle.depthY * float(top) + triangle.depthOffset;
+
+		for (int32_t column = columnMin / int32_t(SubtileWidth); column <= columnMax / int32_t(SubtileWidth); ++column)
+		{
+			const int32_t x = column * int32_t(SubtileWidth);
+
+			uint32_t coverage = 0;
+			for (uint32_t row = 0; row < SubtileHeight; ++row)
+			{
+				coverage |= GetRowBits(spanFirst[row] - x, spanLast[row] - x) << (row * SubtileWidth);
+			}
+
+			if (coverage == 0)
+				continue;
+
+			// The plane is furthest at one of the corners; the triangle is no
+			// further than its furthest vertex.
+			XMFLOAT4 corners;
+			XMStoreFloat4(&corners, XMVectorAdd(cornerDepth, XMVectorReplicate(triangle.depthX * float(x) + rowDepth)));
+			const float depth = std::min(std::max(std::max(corners.x, corners.y), std::max(corners.z, corners.w)), triangle.maxDepth);
+
+			MergeSubtile(subtileRow * m_subtilesX + uint32_t(column), coverage, depth);
+		}
+	}
+}
+
+// Pixels under the new coverage are no further than depth. They join the
+// working layer, whose bound grows to include them; when it covers the whole
+// subtile it becomes the new base layer. A triangle far in front of the
+// working layer starts a new one instead, dropping the old coverage back to
+// the base bound so the layer's bound stays tight.
+void OcclusionCuller::MergeSubtile(uint32_t subtile, uint32_t coverage, float depth) noexcept
+{
+	float& zMax0 = m_zMax0[subtile];
+	float& zMax1 = m_zMax1[subtile];
+	uint32_t& mask = m_mask[subtile];
+
+	if (depth >= zMax0)
+		return;
+
+	if (zMax1 - depth > zMax0 - zMax1)
+	{
+		zMax1 = 0.0f;
+		mask = 0;
+	}
+
+	zMax1 = std::max(zMax1, depth);
+	mask |= coverage;
+
+	if (mask == ~0u)
+	{
+		zMax0 = zMax1;
+		zMax1 = 0.0f;
+		mask = 0;
+	}
+}
+
+bool OcclusionCuller::IsVisible(FXMMATRIX viewProjection, XMFLOAT3 const& center, XMFLOAT3 const& extents) const noexcept
+{
+	float minX = Unbounded, minY = Unbounded, minZ = Unbounded;
+	float maxX = -Unbounded, maxY = -Unbounded;
+
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		const XMVECTOR corner = XMVectorSet(
+			center.x + ((i & 1) ? extents.x : -extents.x),
+			center.y + ((i & 2) ? extents.y : -extents.y),
+			center.z + ((i & 4) ? extents.z : -extents.z), 1.0f);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(corner, viewProjection));
+
+		// Reaches behind the camera, where the rectangle isn't meaningful.
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+			return true;
+
+		const float invW = 1.0f / clip.w;
+		const float x = (clip.x * invW * 0.5f + 0.5f) * float(m_width);
+		const float y = (0.5f - clip.y * invW * 0.5f) * float(m_height);
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * invW);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= float(m_width) || minY >= float(m_height) || minZ > 1.0f)
+		return false;
+
+	// Every pixel the rectangle touches.
+	const int32_t left = int32_t(std::max(minX, 0.0f));
+	const int32_t top = int32_t(std::max(minY, 0.0f));
+	const int32_t right = int32_t(std::min(maxX, float(m_width - 1)));
+	const int32_t bottom = int32_t(std::min(maxY, float(m_height - 1)));
+
+	for (int32_t subtileY = top / int32_t(SubtileHeight); subtileY <= bottom / int32_t(SubtileHeight); ++subtileY)
+	{
+		const int32_t y = subtileY * int32_t(SubtileHeight);
+
+		uint32_t rows = 0;
+		for (int32_t row = std::max(top - y, 0); row <= std::min(bottom - y, int32_t(SubtileHeight) - 1); ++row)
+		{
+			rows |= 1u << (row * SubtileWidth);
+		}
+
+		for (int32_t subtileX = left / int32_t(SubtileWidth); subtileX <= right / int32_t(SubtileWidth); ++subtileX)
+		{
+			const int32_t x = subtileX * int32_t(SubtileWidth);
+			const uint32_t rectangle = GetRowBits(left - x, right - x) * rows;
+
+			const uint32_t subtile = uint32_t(subtileY) * m_subtilesX + uint32_t(subtileX);
+			const uint32_t mask = m_mask[subtile];
+
+			if ((rectangle & ~mask) && minZ <= m_zMax0[subtile])
+				return true;
+
+			if ((rectangle & mask) && minZ <= m_zMax1[subtile])
+				return true;
+		}
+	}
+
+	return false;
+}
+
+void OcclusionCuller::Cull(FXMMATRIX viewProjection, SceneRegistry const& registry, std::vector<uint32_t>& visible)
+{
+	size_t kept = 0;
+	for (const uint32_t index : visible)
+	{
+		if (IsVisible(viewProjection, registry.GetCenter(index), registry.GetExtents(index)))
+		{
+			visible[kept++] = index;
+		}
+	}
+
+	m_stats.tests += visible.size();
+	m_stats.occluded += visible.size() - kept;
+	visible.resize(kept);
+}
+
+float OcclusionCuller::GetDepthBound(uint32_t x, uint32_t y) const noexcept
+{
+	const uint32_t subtile = (y / SubtileHeight) * m_subtilesX + x / SubtileWidth;
+	const uint32_t bit = (y % SubtileHeight) * SubtileWidth + x % SubtileWidth;
+
+	return (m_mask[subtile] >> bit) & 1 ? m_zMax1[subtile] : m_zMax0[subtile];
+}
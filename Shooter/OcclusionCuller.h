@@ -0,0 +1,135 @@
+//
+// OcclusionCuller.h - Software occlusion culling against a masked, low resolution depth buffer
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+class SceneRegistry;
+class ThreadPool;
+
+// Large occluders are rasterized on the CPU into a small depth buffer, then
+// object bounds are tested against it before their draws are queued.
+//
+// The buffer is hierarchical in the masked occlusion style: it keeps no
+// per-pixel depth, only one record per 8x4 pixel subtile holding a coverage
+// mask and two far depth bounds, one for the covered pixels and one for the
+// rest. Each triangle merges into a subtile as a coverage mask and a single
+// far depth, so it only ever gets further from the truth conservatively: an
+// object reported hidden is hidden. Depth is Direct3D's, 0 near and 1 far.
+//
+// The screen is split into bins that rasterize independently, in parallel
+// when given a thread pool; every bin sees its triangles in submission order,
+// so the result is the same for any number of threads.
+class OcclusionCuller
+{
+public:
+	static constexpr uint32_t SubtileWidth = 8;
+	static constexpr uint32_t SubtileHeight = 4;
+	static constexpr uint32_t BinWidth = 64;
+	static constexpr uint32_t BinHeight = 32;
+
+	struct Stats
+	{
+		uint64_t triangles;			// Occluder triangles submitted
+		uint64_t rasterized;		// Triangles left after clipping and culling, counted once per bin they touch
+		uint64_t tests;				// Bounds tested
+		uint64_t occluded;			// Bounds found hidden
+	};
+
+	// The width must be a multiple of SubtileWidth and the height of
+	// SubtileHeight; throws std::invalid_argument otherwise.
+	OcclusionCuller(uint32_t width, uint32_t height);
+
+	OcclusionCuller(OcclusionCuller&&) = default;
+	OcclusionCuller& operator= (OcclusionCuller&&) = default;
+
+	OcclusionCuller(OcclusionCuller const&) = delete;
+	OcclusionCuller& operator= (OcclusionCuller const&) = delete;
+
+	uint32_t GetWidth() const noexcept { return m_width; }
+	uint32_t GetHeight() const noexcept { return m_height; }
+
+	// Starts a frame: drops the occluders and resets the buffer to the far plane.
+	void Clear() noexcept;
+
+	// Queues indexed triangles, transformed to clip space by the matrix
+	// (world * view * projection for meshes in model space). Triangles
+	// crossing the near plane are clipped; both windings are kept.
+	void AddOccluder(DirectX::FXMMATRIX worldViewProjection, DirectX::XMFLOAT3 const* vertices,
+		uint32_t const* indices, size_t indexCount);
+
+	// A world space box, as stored in SceneRegistry.
+	void AddOccluderBox(DirectX::FXMMATRIX viewProjection, DirectX::XMFLOAT3 const& center, DirectX::XMFLOAT3 const& extents);
+
+	// Rasterizes the queued occluders, one bin per task.
+	void Rasterize(ThreadPool* pool = nullptr);
+
+	// False when every pixel the box's screen rectangle touches is already
+	// covered by something nearer, or when the box is off screen. Boxes
+	// reaching behind the near plane are always visible. Safe to call from
+	// several threads once Rasterize has returned.
+	bool IsVisible(DirectX::FXMMATRIX viewProjection, DirectX::XMFLOAT3 const& center, DirectX::XMFLOAT3 const& extents) const noexcept;
+
+	// Keeps the indices in visible whose registry bounds pass IsVisible,
+	// preserving their order.
+	void Cull(DirectX::FXMMATRIX viewProjection, SceneRegistry const& registry, std::vector<uint32_t>& visible);
+
+	// The far depth bound of one pixel, for tools drawing the buffer.
+	float GetDepthBound(uint32_t x, uint32_t y) const noexcept;
+
+	Stats const& GetStats() const noexcept { return m_stats; }
+	void ResetStats() noexcept { m_stats = {}; }
+
+private:
+	// A screen space triangle: pixel-center edge bounds per row and a depth plane.
+	struct Triangle
+	{
+		// Row y covers x in [max of left bounds, min of right bounds], where
+		// each bound is offset + slope * y.
+		float leftOffset[3];
+		float leftSlope[3];
+		float rightOffset[3];
+		float rightSlope[3];
+
+		// z = depthX * x + depthY * y + depthOffset
+		float depthX;
+		float depthY;
+		float depthOffset;
+		float maxDepth;
+
+		// Pixel bounds, inclusive
+		int32_t minX, minY, maxX, maxY;
+	};
+
+	void AddClipTriangle(DirectX::FXMVECTOR a, DirectX::FXMVECTOR b, DirectX::FXMVECTOR c);
+	void AddScreenTriangle(DirectX::XMFLOAT4 const* vertices);
+	void RasterizeBin(uint32_t bin) noexcept;
+	void RasterizeTriangle(Triangle const& triangle, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY) noexcept;
+	void MergeSubtile(uint32_t subtile, uint32_t coverage, float depth) noexcept;
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_subtilesX;
+	uint32_t m_subtilesY;
+	uint32_t m_binsX;
+	uint32_t m_binsY;
+
+	// One record per subtile, row major. Pixels whose bit is set in the mask
+	// are no further than zMax1, the rest no further than zMax0. Bit
+	// row * 8 + column covers that pixel of the subtile.
+	std::vector<float> m_zMax0;
+	std::vector<float> m_zMax1;
+	std::vector<uint32_t> m_mask;
+
+	std::vector<Triangle> m_triangles;
+	std::vector<std::vector<uint32_t>> m_binTriangles;
+	std::vector<uint64_t> m_binRasterized;
+
+	Stats m_stats;
+};
@@ -0,0 +1,361 @@
+//
+// OffsetAllocator.cpp
+//
+
+#include "OffsetAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	constexpr uint32_t MantissaBits = 3;
+	constexpr uint32_t MantissaValue = 1 << MantissaBits;
+	constexpr uint32_t MantissaMask = MantissaValue - 1;
+
+	// Index of the lowest and highest set bit; value must not be zero.
+	inline uint32_t LowestBit(uint32_t value) noexcept
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return uint32_t(__builtin_ctz(value));
+#endif
+	}
+
+	inline uint32_t HighestBit(uint32_t value) noexcept
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, value);
+		return index;
+#else
+		return 31 - uint32_t(__builtin_clz(value));
+#endif
+	}
+
+	// Sizes map to bins like small floats: a power of two exponent and three
+	// bits below the leading one, with sizes under 8 getting a bin each.
+	// Rounding down gives the bin a free range of that size goes in; rounding
+	// up, the first bin whose every range is at least that big.
+	uint32_t BinRoundDown(uint32_t size) noexcept
+	{
+		if (size < MantissaValue)
+			return size;
+
+		const uint32_t shift = HighestBit(size) - MantissaBits;
+		return ((shift + 1) << MantissaBits) + ((size >> shift) & MantissaMask);
+	}
+
+	uint32_t BinRoundUp(uint32_t size) noexcept
+	{
+		if (size < MantissaValue)
+			return size;
+
+		const uint32_t shift = HighestBit(size) - MantissaBits;
+		uint32_t bin = ((shift + 1) << MantissaBits) + ((size >> shift) & MantissaMask);
+
+		// A carry out of the mantissa moves on to the next exponent, as it should.
+		if (size & ((1u << shift) - 1))
+		{
+			bin++;
+		}
+		return bin;
+	}
+}
+
+OffsetAllocator::OffsetAllocator(uint32_t capacity) :
+	m_capacity(capacity),
+	m_freeUnits(capacity),
+	m_allocations(0),
+	m_freeRanges(0),
+	m_topMask(0),
+	m_binMasks{}
+{
+	if (capacity == 0)
+		throw std::invalid_argument("Offset allocator capacity must not be zero");
+
+	std::fill(std::begin(m_binHeads), std::end(m_binHeads), None);
+	InsertFree(NewNode(0, capacity));
+}
+
+uint32_t OffsetAllocator::Allocate(uint32_t size)
+{
+	if (size == 0)
+		throw std::invalid_argument("Offset allocations must not be empty");
+
+	if (size > m_freeUnits)
+		return InvalidHandle;
+
+	// The smallest bin that's sure to fit, then anything above it.
+	const uint32_t minBin = BinRoundUp(size);
+	uint32_t top = minBin / BinsPerTop;
+	if (top >= TopBins)
+		return InvalidHandle;
+
+	uint32_t node = None;
+	uint32_t bins = m_binMasks[top] & (0xFFu << (minBin % BinsPerTop)) & 0xFFu;
+	if (bins == 0)
+	{
+		const uint32_t higher = top + 1 < TopBins ? m_topMask & (~0u << (top + 1)) : 0;
+		if (higher != 0)
+		{
+			top = LowestBit(higher);
+			node = m_binHeads[top * BinsPerTop + LowestBit(m_binMasks[top])];
+		}
+	}
+	else
+	{
+		node = m_binHeads[top * BinsPerTop + LowestBit(bins)];
+	}
+
+	// Nothing in the bins that are sure to fit. The size's own bin may still
+	// hold a range big enough, like the whole buffer when it's empty.
+	if (node == None)
+	{
+		node = m_binHeads[BinRoundDown(size)];
+		while (node != None && m_nodes[node].size < size)
+		{
+			node = m_nodes[node].binNext;
+		}
+
+		if (node == None)
+			return InvalidHandle;
+	}
+
+	RemoveFree(node);
+
+	// Split what's left over into a free range of its own after this one.
+	const uint32_t remainder = m_nodes[node].size - size;
+	if (remainder > 0)
+	{
+		const uint32_t rest = NewNode(m_nodes[node].offset + size, remainder);
+		m_nodes[rest].neighborPrev = node;
+		m_nodes[rest].neighborNext = m_nodes[node].neighborNext;
+		if (m_nodes[node].neighborNext != None)
+		{
+			m_nodes[m_nodes[node].neighborNext].neighborPrev = rest;
+		}
+		m_nodes[node].neighborNext = rest;
+		m_nodes[node].size = size;
+		InsertFree(rest);
+	}
+
+	m_nodes[node].state = NodeState::Allocated;
+	m_freeUnits -= size;
+	m_allocations++;
+	return node;
+}
+
+void OffsetAllocator::Free(uint32_t handle)
+{
+	if (handle >= m_nodes.size() || m_nodes[handle].state != NodeState::Allocated)
+		throw std::invalid_argument("Offset allocator handle is not allocated");
+
+	Node& node = m_nodes[handle];
+	m_freeUnits += node.size;
+	m_allocations--;
+
+	// Absorb free neighbours so the range goes back as large as it can be.
+	const uint32_t prev = node.neighborPrev;
+	if (prev != None && m_nodes[prev].state == NodeState::Free)
+	{
+		RemoveFree(prev);
+		node.offset = m_nodes[prev].offset;
+		node.size += m_nodes[prev].size;
+		node.neighborPrev = m_nodes[prev].neighborPrev;
+		if (node.neighborPrev != None)
+		{
+			m_nodes[node.neighborPrev].neighborNext = handle;
+		}
+		ReleaseNode(prev);
+	}
+
+	const uint32_t next = node.neighborNext;
+	if (next != None && m_nodes[next].state == NodeState::Free)
+	{
+		RemoveFree(next);
+		node.size += m_nodes[next].size;
+		node.neighborNext = m_nodes[next].neighborNext;
+		if (node.neighborNext != None)
+		{
+			m_nodes[node.neighborNext].neighborPrev = handle;
+		}
+		ReleaseNode(next);
+	}
+
+	InsertFree(handle);
+}
+
+void OffsetAllocator::Defragment(std::vector<Move>& moves)
+{
+	moves.clear();
+
+	std::vector<uint32_t> allocated;
+	allocated.reserve(m_allocations);
+	for (uint32_t i = 0; i < m_nodes.size(); ++i)
+	{
+		if (m_nodes[i].state == NodeState::Allocated)
+		{
+			allocated.push_back(i);
+		}
+		else if (m_nodes[i].state == NodeState::Free)
+		{
+			ReleaseNode(i);
+		}
+	}
+
+	std::sort(allocated.begin(), allocated.end(),
+		[this](uint32_t a, uint32_t b) { return m_nodes[a].offset < m_nodes[b].offset; });
+
+	std::fill(std::begin(m_binHeads), std::end(m_binHeads), None);
+	std::fill(std::begin(m_binMasks), std::end(m_binMasks), uint8_t(0));
+	m_topMask = 0;
+	m_freeRanges = 0;
+
+	uint32_t offset = 0;
+	uint32_t prev = None;
+	for (auto const index : allocated)
+	{
+		Node& node = m_nodes[index];
+		if (node.offset != offset)
+		{
+			// Neighbours that slide by the same distance go as one copy.
+			if (!moves.empty() && moves.back().from + moves.back().size == node.offset
+				&& moves.back().to + moves.back().size == offset)
+			{
+				moves.back().size += node.size;
+			}
+			else
+			{
+				moves.push_back({ node.offset, offset, node.size });
+			}
+		}
+
+		node.offset = offset;
+		node.neighborPrev = prev;
+		node.neighborNext = None;
+		if (prev != None)
+		{
+			m_nodes[prev].neighborNext = index;
+		}
+
+		offset += node.size;
+		prev = index;
+	}
+
+	if (offset < m_capacity)
+	{
+		const uint32_t rest = NewNode(offset, m_capacity - offset);
+		m_nodes[rest].neighborPrev = prev;
+		if (prev != None)
+		{
+			m_nodes[prev].neighborNext = rest;
+		}
+		InsertFree(rest);
+	}
+}
+
+OffsetAllocator::Stats OffsetAllocator::GetStats() const noexcept
+{
+	Stats stats = {};
+	stats.capacity = m_capacity;
+	stats.usedUnits = m_capacity - m_freeUnits;
+	stats.freeUnits = m_freeUnits;
+	stats.allocations = m_allocations;
+	stats.freeRanges = m_freeRanges;
+
+	// The largest range is in the highest non-empty bin, somewhere.
+	if (m_topMask != 0)
+	{
+		const uint32_t top = HighestBit(m_topMask);
+		const uint32_t bin = top * BinsPerTop + HighestBit(m_binMasks[top]);
+		for (uint32_t node = m_binHeads[bin]; node != None; node = m_nodes[node].binNext)
+		{
+			stats.largestFreeRange = std::max(stats.largestFreeRange, m_nodes[node].size);
+		}
+	}
+
+	return stats;
+}
+
+uint32_t OffsetAllocator::NewNode(uint32_t offset, uint32_t size)
+{
+	uint32_t index;
+	if (!m_unusedNodes.empty())
+	{
+		index = m_unusedNodes.back();
+		m_unusedNodes.pop_back();
+	}
+	else
+	{
+		index = uint32_t(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+
+	m_nodes[index] = { offset, size, None, None, None, None, NodeState::Free };
+	return index;
+}
+
+void OffsetAllocator::ReleaseNode(uint32_t node)
+{
+	m_nodes[node].state = NodeState::Unused;
+	m_unusedNodes.push_back(node);
+}
+
+void OffsetAllocator::InsertFree(uint32_t node) noexcept
+{
+	const uint32_t bin = BinRoundDown(m_nodes[node].size);
+	const uint32_t top = bin / BinsPerTop;
+
+	m_nodes[node].state = NodeState::Free;
+	m_nodes[node].binPrev = None;
+	m_nodes[node].binNext = m_binHeads[bin];
+	if (m_binHeads[bin] != None)
+	{
+		m_nodes[m_binHeads[bin]].binPrev = node;
+	}
+	m_binHeads[bin] = node;
+
+	m_binMasks[top] |= uint8_t(1u << (bin % BinsPerTop));
+	m_topMask |= 1u << top;
+	m_freeRanges++;
+}
+
+void OffsetAllocator::RemoveFree(uint32_t node) noexcept
+{
+	Node const& removed = m_nodes[node];
+	const uint32_t bin = BinRoundDown(removed.size);
+
+	if (removed.binPrev != None)
+	{
+		m_nodes[removed.binPrev].binNext = removed.binNext;
+	}
+	else
+	{
+		m_binHeads[bin] = removed.binNext;
+	}
+
+	if (removed.binNext != None)
+	{
+		m_nodes[removed.binNext].binPrev = removed.binPrev;
+	}
+
+	if (m_binHeads[bin] == None)
+	{
+		const uint32_t top = bin / BinsPerTop;
+		m_binMasks[top] &= uint8_t(~(1u << (bin % BinsPerTop)));
+		if (m_binMasks[top] == 0)
+		{
+			m_topMask &= ~(1u << top);
+		}
+	}
+
+	m_freeRanges--;
+}
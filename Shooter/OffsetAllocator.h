@@ -0,0 +1,125 @@
+//
+// OffsetAllocator.h - Two-level segregated fit (TLSF) allocation of ranges within one large buffer
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Hands out ranges of [0, capacity) in whatever unit the owner counts in,
+// vertices or indices for the mesh arena. Free ranges sit in bins by size:
+// 32 power of two classes, each split in 8 linear steps, with a bit per bin
+// so finding a fitting range is two bit scans however full the buffer is.
+// Freed ranges merge with free neighbours straight away.
+//
+// Allocations are named by handles that stay valid across Defragment, which
+// slides every allocation towards offset 0 and reports the copies that
+// brings about. Offsets change under a handle, so holders look them up
+// through it after a Defragment rather than keep them.
+class OffsetAllocator
+{
+public:
+	static constexpr uint32_t InvalidHandle = ~0u;
+
+	struct Stats
+	{
+		uint32_t capacity;
+		uint32_t usedUnits;
+		uint32_t freeUnits;
+		uint32_t largestFreeRange;
+		uint32_t allocations;
+		uint32_t freeRanges;
+
+		// Share of the free space outside the largest free range: 0 when
+		// it's all in one piece, approaching 1 as it's scattered.
+		double GetFragmentation() const noexcept
+		{
+			return freeUnits == 0 ? 0.0 : 1.0 - double(largestFreeRange) / double(freeUnits);
+		}
+	};
+
+	// A range Defragment moved, to be copied from one buffer to another.
+	// Consecutive allocations that moved together come as one move.
+	struct Move
+	{
+		uint32_t from;
+		uint32_t to;
+		uint32_t size;
+	};
+
+	// Throws std::invalid_argument if the capacity is zero.
+	explicit OffsetAllocator(uint32_t capacity);
+
+	OffsetAllocator(OffsetAllocator&&) = default;
+	OffsetAllocator& operator= (OffsetAllocator&&) = default;
+
+	OffsetAllocator(OffsetAllocator const&) = delete;
+	OffsetAllocator& operator= (OffsetAllocator const&) = delete;
+
+	// Returns a handle to size units, or InvalidHandle when no free range
+	// holds them. Throws std::invalid_argument for a size of zero.
+	uint32_t Allocate(uint32_t size);
+
+	// Throws std::invalid_argument for a handle that isn't allocated.
+	void Free(uint32_t handle);
+
+	uint32_t GetOffset(uint32_t handle) const noexcept { return m_nodes[handle].offset; }
+	uint32_t GetSize(uint32_t handle) const noexcept { return m_nodes[handle].size; }
+
+	// Packs every allocation towards offset 0 in address order, leaving one
+	// free range at the end, and fills moves with the ranges that changed
+	// place, in address order. Handles keep naming the same allocations.
+	// Applied in order, no move writes over data a later one reads; a
+	// move's own source and destination may overlap, but copying it front
+	// to back in pieces no longer than from - to is safe in place.
+	void Defragment(std::vector<Move>& moves);
+
+	uint32_t GetCapacity() const noexcept { return m_capacity; }
+	uint32_t GetFreeUnits() const noexcept { return m_freeUnits; }
+
+	// Scans the top bin for the largest free range.
+	Stats GetStats() const noexcept;
+
+private:
+	static constexpr uint32_t TopBins = 32;
+	static constexpr uint32_t BinsPerTop = 8;
+	static constexpr uint32_t BinCount = TopBins * BinsPerTop;
+	static constexpr uint32_t None = ~0u;
+
+	enum class NodeState : uint8_t
+	{
+		Unused,							// Slot on the node free list
+		Free,
+		Allocated,
+	};
+
+	struct Node
+	{
+		uint32_t offset;
+		uint32_t size;
+		uint32_t binPrev;				// Free ranges in the same bin
+		uint32_t binNext;
+		uint32_t neighborPrev;			// Ranges either side in address order
+		uint32_t neighborNext;
+		NodeState state;
+	};
+
+	uint32_t NewNode(uint32_t offset, uint32_t size);
+	void ReleaseNode(uint32_t node);
+	void InsertFree(uint32_t node) noexcept;
+	void RemoveFree(uint32_t node) noexcept;
+
+	uint32_t m_capacity;
+	uint32_t m_freeUnits;
+	uint32_t m_allocations;
+	uint32_t m_freeRanges;
+
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_unusedNodes;
+
+	// A bit per top level class with any free range, and per bin within it
+	uint32_t m_topMask;
+	uint8_t m_binMasks[TopBins];
+	uint32_t m_binHeads[BinCount];
+};
@@ -0,0 +1,341 @@
+//
+// PlayerSimulation.cpp
+//
+
+#include "PlayerSimulation.h"
+#include "Helpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// Dumb hardcoded shit
+	const XMFLOAT3 START_POSITION				= { 0.f, 2.0f, 0.f };
+
+	// Controller
+	const float ROTATION_GAIN					= 3.8f;
+	const float AIMING_ROTATION_GAIN			= 1.8f;
+	const float TRIGGER_THRESHOLD				= 0.2f;
+	const float THUMBSTICK_THRESHOLD			= 0.5f;
+
+	// Mouse + Keyboard
+	const float MOUSE_ROTATION_GAIN				= 0.35f;
+	const float MOUSE_AIMING_ROTATION_GAIN		= 0.195f;
+
+	// Both
+	const float MOVEMENT_GAIN					= 3.7f;
+	const float MOVEMENT_SPRINTING_GAIN			= 7.7f;
+
+	const float CROSSHAIR_SPREAD				= 20;
+	const float CROSSHAIR_SPREAD_SPRINTING		= 45;
+
+	// Weapon
+	constexpr XMFLOAT3 WEAPON_POSITION			= { 3.0f, -1.0f, -7.0f };
+	constexpr XMFLOAT3 WEAPON_POSITION_AIMING	= { 0.0f, 0.0f, -1.2f };
+	constexpr XMFLOAT3 WEAPON_POSITION_SPRINTING = { 2.0f, -1.2f, -3.0f };
+	constexpr XMFLOAT3 WEAPON_ROTATION_SPRINTING = { -0.52359885f, 0.872665f, 0.0f };
+	constexpr XMFLOAT3 WEAPON_ROTATION_SETTLE	= { -0.174533f, 0.872665f, 0.0f };
+	constexpr XMFLOAT3 ZERO						= { 0.0f, 0.0f, 0.0f };
+
+	float LerpFloat(float a, float b, float t) noexcept
+	{
+		return a + (b - a) * t;
+	}
+
+	XMFLOAT3 LerpFloat3(XMFLOAT3 const& a, XMFLOAT3 const& b, float t) noexcept
+	{
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVectorLerp(XMLoadFloat3(&a), XMLoadFloat3(&b), t));
+		return result;
+	}
+
+	// FNV-1a
+	uint64_t HashBytes(uint64_t hash, void const* data, size_t size) noexcept
+	{
+		auto bytes = static_cast<uint8_t const*>(data);
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	uint64_t HashFloat(uint64_t hash, float value) noexcept
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return HashBytes(hash, &bits, sizeof(bits));
+	}
+}
+
+PlayerSimulation::PlayerSimulation() noexcept
+{
+	Reset();
+}
+
+void PlayerSimulation::Reset() noexcept
+{
+	m_state = {};
+	m_state.position = START_POSITION;
+	m_state.fov = 1.0f;
+	m_state.crosshairSpread = CROSSHAIR_SPREAD;
+	m_state.weaponOffset = WEAPON_POSITION;
+	m_state.weaponRotation = ZERO;
+}
+
+void PlayerSimulation::Step(PlayerInput const& input, float elapsedTime) noexcept
+{
+	PlayerState& s = m_state;
+
+	// Movement vector
+	XMFLOAT3 move = ZERO;
+
+	//---------------------------------------------
+	// Gamepad
+	// --------------------------------------------
+	if (input.padConnected)
+	{
+		// Aiming
+		if (input.leftTrigger > TRIGGER_THRESHOLD) {
+			s.aiming = true;
+			s.usingKeyboard = false;
+		}
+		else {
+			s.aiming = false;
+		}
+
+		// Movement
+		{
+			const bool left = input.leftStickX < -THUMBSTICK_THRESHOLD;
+			const bool right = input.leftStickX > THUMBSTICK_THRESHOLD;
+			const bool up = input.leftStickY > THUMBSTICK_THRESHOLD;
+			const bool down = input.leftStickY < -THUMBSTICK_THRESHOLD;
+
+			if (left || right) {
+				move.x = -input.leftStickX;
+				s.usingKeyboard = false;
+			}
+			if (up || down) {
+				move.z = input.leftStickY;
+				s.usingKeyboard = false;
+			}
+
+			if (!left && !right && !up && !down && s.sprinting && !s.usingKeyboard) {
+				s.sprinting = false;
+			}
+
+			if (input.leftStickPressed) {
+				s.sprinting = true;
+			}
+		}
+
+		// Rotation
+		{
+			if (std::abs(input.rightStickX) > THUMBSTICK_THRESHOLD || std::abs(input.rightStickY) > THUMBSTICK_THRESHOLD) s.usingKeyboard = false;
+			s.yaw += -input.rightStickX * ROTATION_GAIN * elapsedTime;
+			s.pitch += input.rightStickY * ROTATION_GAIN * elapsedTime;
+		}
+	}
+
+	//---------------------------------------------
+	// Mouse
+	// --------------------------------------------
+	if (s.usingKeyboard) {
+		s.aiming = input.mouseRight;
+	}
+
+	if (input.mouseLeft || input.mouseMiddle || input.mouseRight) s.usingKeyboard = true;
+
+	if (input.mouseRelative)
+	{
+		const float gain = (s.aiming ? MOUSE_AIMING_ROTATION_GAIN : MOUSE_ROTATION_GAIN) * elapsedTime;
+
+		s.pitch -= float(input.mouseY) * gain;
+		s.yaw -= float(input.mouseX) * gain;
+	}
+
+	//---------------------------------------------
+	// Keyboard
+	// --------------------------------------------
+	if (input.keyForward) {
+		move.z = 1.0f;
+		s.usingKeyboard = true;
+	}
+
+	if (input.keyBack) {
+		move.z = -1.0f;
+		s.usingKeyboard = true;
+	}
+
+	if (input.keyLeft) {
+		move.x = 1.0f;
+		s.usingKeyboard = true;
+	}
+
+	if (input.keyRight) {
+		move.x = -1.0f;
+		s.usingKeyboard = true;
+	}
+
+	if (s.usingKeyboard) s.sprinting = input.keySprint;
+	s.usingKeyboard = true;
+
+	//---------------------------------------------
+	// Agnostic control
+	// --------------------------------------------
+
+	if (s.aiming) s.sprinting = false;
+
+	// Change FOV based on aiming state
+	s.fov = (s.aiming ?
+		Helpers::Lerp(HipfireFov, AimingFov, s.fov, elapsedTime * 200) :
+		Helpers::Lerp(AimingFov, HipfireFov, s.fov, elapsedTime * 200));
+
+	if (!(s.sprinting && s.walking)) {
+		s.weaponOffset = (s.aiming ?
+			Helpers::LerpVector3(WEAPON_POSITION, WEAPON_POSITION_AIMING, s.weaponOffset, elapsedTime * 35) :
+			Helpers::LerpVector3(WEAPON_POSITION_AIMING, WEAPON_POSITION, s.weaponOffset, elapsedTime * 35));
+	}
+
+	s.crosshairSpread = (s.aiming ?
+		Helpers::Lerp(CROSSHAIR_SPREAD_SPRINTING, 15.0f, s.crosshairSpread, elapsedTime * 200) :
+		(s.sprinting && s.walking) ?
+		0 :
+		s.walking ?
+		Helpers::Lerp(s.crosshairSpread < CROSSHAIR_SPREAD ? 15 : CROSSHAIR_SPREAD, CROSSHAIR_SPREAD + 10, s.crosshairSpread, elapsedTime * 200) :
+		Helpers::Lerp(s.crosshairSpread < CROSSHAIR_SPREAD ? 15 : CROSSHAIR_SPREAD + 10, CROSSHAIR_SPREAD, s.crosshairSpread, elapsedTime * 200));
+
+	s.walking = move.x != 0 || move.y != 0 || move.z != 0;
+
+	if (s.sprinting && s.walking) s.steps += elapsedTime * 15;
+	else if (s.walking) s.steps += elapsedTime * 10;
+	else s.steps = 0.0f;
+
+	if (s.sprinting && s.walking) {
+		s.weaponRotation = Helpers::LerpVector3(ZERO, WEAPON_ROTATION_SPRINTING, s.weaponRotation, elapsedTime * 10);
+		s.weaponOffset = Helpers::LerpVector3(WEAPON_POSITION, WEAPON_POSITION_SPRINTING, s.weaponOffset, elapsedTime * 100);
+	}
+	else {
+		s.weaponRotation = Helpers::LerpVector3(WEAPON_ROTATION_SETTLE, ZERO, s.weaponRotation, elapsedTime * 10);
+	}
+
+	// Limit camera rotation
+	constexpr float limit = XM_PIDIV2 - 0.01f;
+	s.pitch = std::max(-limit, s.pitch);
+	s.pitch = std::min(+limit, s.pitch);
+
+	if (s.yaw > XM_PI)
+	{
+		s.yaw -= XM_2PI;
+	}
+	else if (s.yaw < -XM_PI)
+	{
+		s.yaw += XM_2PI;
+	}
+
+	// Only use yaw so that y is not affected by camera pitch
+	const XMVECTOR q = XMQuaternionRotationRollPitchYaw(0.0f, s.yaw, 0.0f);
+	const XMVECTOR step = XMVectorScale(XMVector3Rotate(XMLoadFloat3(&move), q),
+		(s.sprinting ? MOVEMENT_SPRINTING_GAIN : MOVEMENT_GAIN) * elapsedTime);
+
+	// Move camera by movement vector
+	XMStoreFloat3(&s.position, XMVectorAdd(XMLoadFloat3(&s.position), step));
+}
+
+XMMATRIX XM_CALLCONV PlayerSimulation::GetViewMatrix() const noexcept
+{
+	return GetViewMatrix(m_state);
+}
+
+XMMATRIX XM_CALLCONV PlayerSimulation::GetWeaponMatrix() const noexcept
+{
+	return GetWeaponMatrix(m_state);
+}
+
+XMMATRIX XM_CALLCONV PlayerSimulation::GetViewMatrix(PlayerState const& state) noexcept
+{
+	// Calculate positions for lookAt vector
+	const float y = sinf(state.pitch);
+	const float r = cosf(state.pitch);
+	const float z = r * cosf(state.yaw);
+	const float x = r * sinf(state.yaw);
+
+	const XMVECTOR position = XMLoadFloat3(&state.position);
+	const XMVECTOR lookAt = XMVectorAdd(position, XMVectorSet(x, y, z, 0.0f));
+
+	return XMMatrixLookAtRH(position, lookAt, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+}
+
+XMMATRIX XM_CALLCONV PlayerSimulation::GetWeaponMatrix(PlayerState const& state) noexcept
+{
+	// Weapon bob while walking
+	const XMVECTOR bob = state.aiming ?
+		XMVectorSet(1.0f, 1.0f - (sinf(state.steps) / 16.0f), 1.0f, 0.0f) :
+		XMVectorSet(1.0f + (sinf(state.steps) / 32.0f), 1.0f - (sinf(state.steps) / 16.0f), 1.0f + (sinf(cosf(state.steps)) / 16.0f), 0.0f);
+
+	return XMMatrixMultiply(
+		XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&state.weaponRotation)),
+		XMMatrixTranslationFromVector(XMVectorMultiply(XMLoadFloat3(&state.weaponOffset), bob)));
+}
+
+PlayerState PlayerSimulation::Interpolate(PlayerState const& previous, PlayerState const& current, float alpha) noexcept
+{
+	PlayerState result = current;
+
+	result.position = LerpFloat3(previous.position, current.position, alpha);
+	result.pitch = LerpFloat(previous.pitch, current.pitch, alpha);
+
+	// Yaw wraps at +/- pi, so take the short way around.
+	float yawDelta = current.yaw - previous.yaw;
+	if (yawDelta > XM_PI)
+	{
+		yawDelta -= XM_2PI;
+	}
+	else if (yawDelta < -XM_PI)
+	{
+		yawDelta += XM_2PI;
+	}
+	result.yaw = previous.yaw + yawDelta * alpha;
+
+	result.fov = LerpFloat(previous.fov, current.fov, alpha);
+	result.crosshairSpread = LerpFloat(previous.crosshairSpread, current.crosshairSpread, alpha);
+	result.weaponOffset = LerpFloat3(previous.weaponOffset, current.weaponOffset, alpha);
+	result.weaponRotation = LerpFloat3(previous.weaponRotation, current.weaponRotation, alpha);
+
+	// Steps reset to zero when the player stops, don't blend across that.
+	if (current.steps >= previous.steps)
+	{
+		result.steps = LerpFloat(previous.steps, current.steps, alpha);
+	}
+
+	return result;
+}
+
+uint64_t PlayerSimulation::Checksum(PlayerState const& state) noexcept
+{
+	// Hash field by field so struct padding never contributes.
+	const float values[] =
+	{
+		state.position.x, state.position.y, state.position.z,
+		state.pitch, state.yaw,
+		state.fov, state.crosshairSpread, state.steps,
+		state.weaponOffset.x, state.weaponOffset.y, state.weaponOffset.z,
+		state.weaponRotation.x, state.weaponRotation.y, state.weaponRotation.z,
+	};
+
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (float value : values)
+	{
+		hash = HashFloat(hash, value);
+	}
+
+	const uint8_t flags = uint8_t((state.aiming ? 1 : 0) | (state.sprinting ? 2 : 0)
+		| (state.walking ? 4 : 0) | (state.usingKeyboard ? 8 : 0));
+
+	return HashBytes(hash, &flags, sizeof(flags));
+}
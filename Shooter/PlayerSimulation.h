@@ -0,0 +1,93 @@
+//
+// PlayerSimulation.h - Platform independent first person player movement
+//
+
+#pragma once
+
+#include <cstdint>
+
+#include <DirectXMath.h>
+
+// A snapshot of everything the player simulation reads from the input devices
+// during one update. Filled from GamePad/Keyboard/Mouse on the client, or from
+// a script or recording when running headless.
+struct PlayerInput
+{
+	// Gamepad
+	bool padConnected = false;
+	float leftTrigger = 0.0f;
+	float leftStickX = 0.0f;
+	float leftStickY = 0.0f;
+	float rightStickX = 0.0f;
+	float rightStickY = 0.0f;
+	bool leftStickPressed = false;
+
+	// Mouse
+	bool mouseLeft = false;
+	bool mouseMiddle = false;
+	bool mouseRight = false;
+	bool mouseRelative = false;
+	int32_t mouseX = 0;
+	int32_t mouseY = 0;
+
+	// Keyboard
+	bool keyForward = false;
+	bool keyBack = false;
+	bool keyLeft = false;
+	bool keyRight = false;
+	bool keySprint = false;
+};
+
+// Everything the simulation carries from one update to the next.
+struct PlayerState
+{
+	DirectX::XMFLOAT3 position;
+	float pitch;
+	float yaw;
+
+	float fov;
+	float crosshairSpread;
+	float steps;
+
+	DirectX::XMFLOAT3 weaponOffset;
+	DirectX::XMFLOAT3 weaponRotation;
+
+	bool aiming;
+	bool sprinting;
+	bool walking;
+	bool usingKeyboard;
+};
+
+// Advances a single player from input snapshots. Has no dependency on WinRT or
+// Direct3D so it can run on a server or in a headless benchmark.
+class PlayerSimulation
+{
+public:
+	PlayerSimulation() noexcept;
+
+	void Reset() noexcept;
+
+	void Step(PlayerInput const& input, float elapsedTime) noexcept;
+
+	PlayerState const& GetState() const noexcept { return m_state; }
+
+	// Camera and weapon transforms derived from the current state.
+	DirectX::XMMATRIX XM_CALLCONV GetViewMatrix() const noexcept;
+	DirectX::XMMATRIX XM_CALLCONV GetWeaponMatrix() const noexcept;
+
+	static DirectX::XMMATRIX XM_CALLCONV GetViewMatrix(PlayerState const& state) noexcept;
+	static DirectX::XMMATRIX XM_CALLCONV GetWeaponMatrix(PlayerState const& state) noexcept;
+
+	// Blends two consecutive states for rendering between fixed simulation steps.
+	static PlayerState Interpolate(PlayerState const& previous, PlayerState const& current, float alpha) noexcept;
+
+	// Hash of the exact bit patterns of a state, for comparing runs.
+	static uint64_t Checksum(PlayerState const& state) noexcept;
+
+	// Field of view limits in degrees.
+	static constexpr float HipfireFov = 100.0f;
+	static constexpr float AimingFov = 70.0f;
+
+private:
+	PlayerState m_state;
+};
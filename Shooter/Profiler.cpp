@@ -0,0 +1,261 @@
+//
+// Profiler.cpp
+//
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+
+using namespace Profiler;
+
+namespace Profiler::Detail
+{
+	std::atomic<bool> g_enabled{ false };
+}
+
+using Profiler::Detail::Scope;
+using Profiler::Detail::Slot;
+
+namespace
+{
+	struct ThreadBuffer
+	{
+		explicit ThreadBuffer(uint32_t id) :
+			threadId(id),
+			threadName(nullptr),
+			slots(new Slot[EventsPerThread]),
+			head(0)
+		{
+		}
+
+		uint32_t threadId;
+		std::atomic<const char*> threadName;
+		std::unique_ptr<Slot[]> slots;
+		std::atomic<uint64_t> head;		// Total scopes begun on this thread
+	};
+
+	// Buffers live until exit so scopes from finished threads still export.
+	std::mutex s_registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+
+	std::atomic<uint64_t> s_clearedAt{ 0 };
+
+	thread_local ThreadBuffer* t_buffer = nullptr;
+	thread_local const char* t_threadName = nullptr;
+
+	ThreadBuffer* GetThreadBuffer()
+	{
+		if (!t_buffer)
+		{
+			std::lock_guard<std::mutex> lock(s_registryMutex);
+			s_buffers.push_back(std::make_unique<ThreadBuffer>(uint32_t(s_buffers.size() + 1)));
+			t_buffer = s_buffers.back().get();
+			t_buffer->threadName.store(t_threadName, std::memory_order_relaxed);
+		}
+		return t_buffer;
+	}
+
+	void WriteEscaped(std::ostream& out, const char* text)
+	{
+		out << '"';
+		for (; *text; ++text)
+		{
+			const char c = *text;
+			if (c == '"' || c == '\\')
+			{
+				out << '\\' << c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20)
+			{
+				out << ' ';
+			}
+			else
+			{
+				out << c;
+			}
+		}
+		out << '"';
+	}
+}
+
+Scope Profiler::Detail::BeginEvent(const char* name) noexcept
+{
+	ThreadBuffer* buffer;
+	try
+	{
+		buffer = GetThreadBuffer();
+	}
+	catch (...)
+	{
+		// Out of memory registering the thread, drop the scope.
+		return { nullptr, 0 };
+	}
+
+	const uint64_t index = buffer->head.load(std::memory_order_relaxed);
+	Slot* slot = &buffer->slots[index % EventsPerThread];
+	slot->name.store(name, std::memory_order_relaxed);
+	slot->end.store(0, std::memory_order_relaxed);
+	slot->sequence.store(index + 1, std::memory_order_relaxed);
+	slot->start.store(Now(), std::memory_order_relaxed);
+
+	// Publishes the slot to Collect.
+	buffer->head.store(index + 1, std::memory_order_release);
+	return { slot, index + 1 };
+}
+
+void Profiler::SetEnabled(bool enabled) noexcept
+{
+	Detail::g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t Profiler::Now() noexcept
+{
+	using namespace std::chrono;
+	return uint64_t(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+void Profiler::SetThreadName(const char* name) noexcept
+{
+	t_threadName = name;
+	if (t_buffer)
+	{
+		t_buffer->threadName.store(name, std::memory_order_relaxed);
+	}
+}
+
+std::vector<ThreadEvents> Profiler::Collect()
+{
+	const uint64_t clearedAt = s_clearedAt.load(std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+
+	std::vector<ThreadEvents> result;
+	result.reserve(s_buffers.size());
+
+	for (auto const& buffer : s_buffers)
+	{
+		ThreadEvents thread;
+		thread.threadId = buffer->threadId;
+		thread.threadName = buffer->threadName.load(std::memory_order_relaxed);
+
+		const uint64_t head = buffer->head.load(std::memory_order_acquire);
+		const uint64_t first = head > EventsPerThread ? head - EventsPerThread : 0;
+
+		std::vector<uint64_t> indices;
+		indices.reserve(size_t(head - first));
+		thread.events.reserve(size_t(head - first));
+
+		for (uint64_t i = first; i < head; ++i)
+		{
+			Slot const& slot = buffer->slots[i % EventsPerThread];
+			const uint64_t end = slot.end.load(std::memory_order_acquire);
+			if (end == 0)
+				continue;
+
+			Event event;
+			event.name = slot.name.load(std::memory_order_relaxed);
+			event.start = slot.start.load(std::memory_order_relaxed);
+			event.end = end;
+			if (event.start >= clearedAt && event.end >= event.start)
+			{
+				thread.events.push_back(event);
+				indices.push_back(i);
+			}
+		}
+
+		// Slots the owner wrapped around onto while we were copying may hold
+		// a mix of two scopes.
+		const uint64_t after = buffer->head.load(std::memory_order_acquire);
+		if (after > EventsPerThread)
+		{
+			const uint64_t oldestIntact = after - EventsPerThread;
+			const size_t overwritten = size_t(std::lower_bound(indices.begin(), indices.end(), oldestIntact) - indices.begin());
+			thread.events.erase(thread.events.begin(), thread.events.begin() + ptrdiff_t(overwritten));
+		}
+
+		result.push_back(std::move(thread));
+	}
+
+	return result;
+}
+
+void Profiler::Clear() noexcept
+{
+	s_clearedAt.store(Now(), std::memory_order_relaxed);
+}
+
+void Profiler::WriteChromeTrace(std::ostream& out)
+{
+	const auto threads = Collect();
+
+	// Timestamps are relative to the first scope to keep them short.
+	uint64_t origin = UINT64_MAX;
+	for (auto const& thread : threads)
+	{
+		for (auto const& event : thread.events)
+		{
+			origin = std::min(origin, event.start);
+		}
+	}
+
+	const auto flags = out.flags();
+	const auto precision = out.precision();
+	out.setf(std::ios::fixed, std::ios::floatfield);
+	out.precision(3);
+
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+	bool first = true;
+	auto separator = [&]()
+	{
+		if (!first)
+		{
+			out << ",\n";
+		}
+		first = false;
+	};
+
+	for (auto const& thread : threads)
+	{
+		if (thread.threadName)
+		{
+			separator();
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.threadId << ",\"args\":{\"name\":";
+			WriteEscaped(out, thread.threadName);
+			out << "}}";
+		}
+
+		// Complete events, microseconds with nanosecond fractions.
+		for (auto const& event : thread.events)
+		{
+			separator();
+			out << "{\"name\":";
+			WriteEscaped(out, event.name ? event.name : "");
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.threadId
+				<< ",\"ts\":" << double(event.start - origin) / 1000.0
+				<< ",\"dur\":" << double(event.end - event.start) / 1000.0 << '}';
+		}
+	}
+
+	out << "\n]}\n";
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void Profiler::WriteChromeTrace(std::filesystem::path const& path)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+	{
+		throw std::runtime_error("Failed to create trace file");
+	}
+
+	WriteChromeTrace(file);
+}
@@ -0,0 +1,131 @@
+//
+// Profiler.h - Scope based CPU profiler with Chrome trace export
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <vector>
+
+// Scopes are recorded into a ring buffer owned by the calling thread, so
+// markers never take a lock or allocate once a thread has its buffer. The
+// profiler is compiled in by default and switched on at runtime; a disabled
+// scope tests the enabled flag and ends on a slot nobody records into, so it
+// never reads the clock. Define SHOOTER_NO_PROFILE to compile every marker
+// out entirely.
+namespace Profiler
+{
+	struct Event
+	{
+		const char* name;		// Must point at a string literal or other static storage
+		uint64_t start;			// Nanoseconds
+		uint64_t end;
+	};
+
+	struct ThreadEvents
+	{
+		uint32_t threadId;
+		const char* threadName;
+		std::vector<Event> events;
+	};
+
+	// Number of scopes each thread keeps before the oldest are overwritten.
+	constexpr size_t EventsPerThread = 1 << 16;
+
+	// Monotonic timestamp in nanoseconds.
+	uint64_t Now() noexcept;
+
+	namespace Detail
+	{
+		// Written only by the owning thread. Fields are relaxed atomics so a
+		// concurrent Collect reads stale or torn scopes instead of racing; the
+		// ring head tells it which ones to trust.
+		struct Slot
+		{
+			std::atomic<const char*> name;
+			std::atomic<uint64_t> start;
+			std::atomic<uint64_t> end;			// Zero while the scope is still open
+			std::atomic<uint64_t> sequence;		// Which of the thread's scopes, from 1
+		};
+
+		// A scope's slot and the sequence it had there, or no slot for a
+		// scope that isn't recorded. Once the thread's ring wraps around
+		// onto the slot, the sequences differ.
+		struct Scope
+		{
+			Slot* slot;
+			uint64_t sequence;
+		};
+
+		extern std::atomic<bool> g_enabled;
+
+		// No slot if the thread couldn't be registered.
+		Scope BeginEvent(const char* name) noexcept;
+
+		// For a scope with a slot.
+		inline void EndEvent(Scope scope) noexcept
+		{
+			if (scope.slot->sequence.load(std::memory_order_relaxed) == scope.sequence)
+			{
+				scope.slot->end.store(Now(), std::memory_order_release);
+			}
+		}
+	}
+
+	inline bool IsEnabled() noexcept { return Detail::g_enabled.load(std::memory_order_relaxed); }
+	void SetEnabled(bool enabled) noexcept;
+
+	// Names the calling thread in exported traces.
+	void SetThreadName(const char* name) noexcept;
+
+	// Copies out every completed scope still in the buffers, oldest first,
+	// per thread. Safe to call while other threads are recording; scopes they
+	// overwrite during the copy are left out.
+	std::vector<ThreadEvents> Collect();
+
+	// Drops everything recorded before now.
+	void Clear() noexcept;
+
+	// Chrome trace-event JSON, viewable in chrome://tracing or Perfetto.
+	void WriteChromeTrace(std::ostream& out);
+	void WriteChromeTrace(std::filesystem::path const& path);
+
+	// RAII marker covering the lifetime of a scope. A scope outlived by
+	// EventsPerThread newer ones on its thread has lost its slot to them, and
+	// is dropped rather than ending theirs. While disabled, a scope costs the
+	// branch on IsEnabled and a null test.
+	class ScopeMarker
+	{
+	public:
+		explicit ScopeMarker(const char* name) noexcept :
+			m_scope(IsEnabled() ? Detail::BeginEvent(name) : Detail::Scope{ nullptr, 0 })
+		{
+		}
+
+		~ScopeMarker()
+		{
+			if (m_scope.slot)
+			{
+				Detail::EndEvent(m_scope);
+			}
+		}
+
+		ScopeMarker(ScopeMarker const&) = delete;
+		ScopeMarker& operator= (ScopeMarker const&) = delete;
+
+	private:
+		Detail::Scope m_scope;
+	};
+}
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+#ifdef SHOOTER_NO_PROFILE
+#define PROFILE_SCOPE(name) ((void)0)
+#else
+#define PROFILE_SCOPE(name) ::Profiler::ScopeMarker PROFILER_CONCAT(profileScope_, __LINE__)(name)
+#endif
@@ -0,0 +1,57 @@
+//
+// QuantizedMeshEffect.hlsli - Constants and stage interface of the quantized mesh effect
+//
+
+// Laid out as D3D11QuantizedMeshEffect's constants, which it fills in the
+// way BasicEffect does with the default lights: colors are premultiplied by
+// alpha, the emissive color has the ambient light folded in, and matrices
+// are transposed on upload so vectors multiply on the left.
+cbuffer Parameters : register(b0)
+{
+    float4 DiffuseColor             : packoffset(c0);
+    float3 EmissiveColor            : packoffset(c1);
+    float3 SpecularColor            : packoffset(c2);
+    float  SpecularPower            : packoffset(c2.w);
+
+    float3 LightDirection[3]        : packoffset(c3);
+    float3 LightDiffuseColor[3]     : packoffset(c6);
+    float3 LightSpecularColor[3]    : packoffset(c9);
+
+    float3 EyePosition              : packoffset(c12);
+    float3 PositionOffset           : packoffset(c13);
+    float3 PositionScale            : packoffset(c14);
+
+    float4x4 World                  : packoffset(c15);
+    float3x3 WorldInverseTranspose  : packoffset(c19);
+    float4x4 WorldViewProj          : packoffset(c22);
+};
+
+// The input assembler has already turned the SNORM16 and half float
+// attributes into floats. The tangent is in the vertex too, for normal
+// mapping, which this effect doesn't do.
+struct VSInput
+{
+    float4 Position : SV_Position;
+    float2 Normal   : NORMAL;
+    float4 Color    : COLOR;
+    float2 TexCoord : TEXCOORD0;
+};
+
+// The position goes last so the pixel shader's input, which leaves it
+// out, lines up with the rest.
+struct VSOutput
+{
+    float3 PositionWS : TEXCOORD0;
+    float3 NormalWS   : TEXCOORD1;
+    float4 Diffuse    : COLOR0;
+    float2 TexCoord   : TEXCOORD2;
+    float4 PositionPS : SV_Position;
+};
+
+struct PSInput
+{
+    float3 PositionWS : TEXCOORD0;
+    float3 NormalWS   : TEXCOORD1;
+    float4 Diffuse    : COLOR0;
+    float2 TexCoord   : TEXCOORD2;
+};
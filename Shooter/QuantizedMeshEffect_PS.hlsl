@@ -0,0 +1,35 @@
+//
+// QuantizedMeshEffect_PS.hlsl - Per-pixel lighting with three directional lights
+//
+
+#include "QuantizedMeshEffect.hlsli"
+
+Texture2D<float4> Texture : register(t0);
+sampler Sampler : register(s0);
+
+// Lambert diffuse and Blinn-Phong specular, as BasicEffect lights.
+float4 main(PSInput pin) : SV_Target0
+{
+    float4 color = Texture.Sample(Sampler, pin.TexCoord) * pin.Diffuse;
+
+    const float3 eyeVector = normalize(EyePosition - pin.PositionWS);
+    const float3 worldNormal = normalize(pin.NormalWS);
+
+    float3 diffuse = EmissiveColor;
+    float3 specular = 0;
+
+    [unroll]
+    for (int i = 0; i < 3; i++)
+    {
+        const float dotL = dot(-LightDirection[i], worldNormal);
+        const float dotH = dot(normalize(eyeVector - LightDirection[i]), worldNormal);
+        const float lit = step(0, dotL);
+
+        diffuse += lit * dotL * LightDiffuseColor[i] * DiffuseColor.rgb;
+        specular += pow(max(dotH, 0) * lit, SpecularPower) * dotL * LightSpecularColor[i] * SpecularColor;
+    }
+
+    color.rgb *= diffuse;
+    color.rgb += specular * color.a;
+    return color;
+}
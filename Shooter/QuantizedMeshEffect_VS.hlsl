@@ -0,0 +1,29 @@
+//
+// QuantizedMeshEffect_VS.hlsl - Decodes quantized vertices for per-pixel lighting
+//
+
+#include "QuantizedMeshEffect.hlsli"
+
+// Inverse of the cooker's octahedral encoding: the unit vector whose
+// projection onto the octahedron |x| + |y| + |z| = 1, with the lower half
+// folded out over the corners, lands on e.
+float3 DecodeOctahedral(float2 e)
+{
+    float3 v = float3(e, 1 - abs(e.x) - abs(e.y));
+    float t = saturate(-v.z);
+    v.xy += v.xy >= 0 ? -t : t;
+    return normalize(v);
+}
+
+VSOutput main(VSInput vin)
+{
+    const float4 position = float4(PositionOffset + vin.Position.xyz * PositionScale, 1);
+
+    VSOutput vout;
+    vout.PositionPS = mul(position, WorldViewProj);
+    vout.PositionWS = mul(position, World).xyz;
+    vout.NormalWS = normalize(mul(DecodeOctahedral(vin.Normal), WorldInverseTranspose));
+    vout.Diffuse = float4(vin.Color.rgb, vin.Color.a * DiffuseColor.a);
+    vout.TexCoord = vin.TexCoord;
+    return vout;
+}
@@ -0,0 +1,62 @@
+//
+// RadixSort.h - Stable LSD radix sort of items by a 64 bit key
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sorts items on their uint64_t key member, keeping the order of equal keys,
+// a byte at a time from the least significant. One pass over the keys builds
+// every byte's histogram, and bytes every key shares are skipped, so keys
+// with unused or constant fields cost only the bytes that differ. The
+// scratch vector is resized to match and left holding garbage; keeping it
+// between calls means sorting doesn't allocate.
+template<typename T>
+void RadixSort64(std::vector<T>& items, std::vector<T>& scratch)
+{
+	constexpr unsigned digits = sizeof(uint64_t);
+	constexpr unsigned radix = 256;
+
+	const size_t count = items.size();
+	if (count < 2)
+		return;
+
+	size_t histograms[digits][radix] = {};
+	for (auto const& item : items)
+	{
+		for (unsigned digit = 0; digit < digits; ++digit)
+		{
+			histograms[digit][(item.key >> (digit * 8)) & 0xFF]++;
+		}
+	}
+
+	scratch.resize(count);
+
+	for (unsigned digit = 0; digit < digits; ++digit)
+	{
+		size_t* histogram = histograms[digit];
+
+		// Every key has the same byte here, nothing would move.
+		const unsigned shift = digit * 8;
+		if (histogram[(items[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		size_t offset = 0;
+		for (unsigned bucket = 0; bucket < radix; ++bucket)
+		{
+			const size_t size = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += size;
+		}
+
+		for (auto const& item : items)
+		{
+			scratch[histogram[(item.key >> shift) & 0xFF]++] = item;
+		}
+
+		items.swap(scratch);
+	}
+}
@@ -0,0 +1,178 @@
+//
+// RenderQueue.cpp
+//
+
+#include "RenderQueue.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t SortKey::QuantizeDepth(float distance, float farPlane, bool backToFront) noexcept
+{
+	constexpr uint32_t maxDepth = (1u << DepthBits) - 1;
+
+	if (!(farPlane > 0.0f))
+		return 0;
+
+	// Also catches NaN.
+	const float normalized = std::min(std::max(distance / farPlane, 0.0f), 1.0f);
+	const uint32_t depth = uint32_t(normalized * float(maxDepth));
+	return backToFront ? maxDepth - depth : depth;
+}
+
+void RenderQueue::Reserve(size_t packets)
+{
+	m_packets.reserve(packets);
+	m_entries.reserve(packets);
+	m_scratch.reserve(packets);
+}
+
+void RenderQueue::Clear() noexcept
+{
+	m_packets.clear();
+	m_entries.clear();
+}
+
+void RenderQueue::Add(uint64_t key, RenderPacket::DrawFunction draw, void* context, uint32_t param)
+{
+	m_entries.push_back({ key, uint32_t(m_packets.size()) });
+	m_packets.push_back({ key, draw, context, param });
+}
+
+// Unused depth or material bits and a single pass leave whole bytes of the
+// keys equal, which the sort skips.
+void RenderQueue::Sort()
+{
+	RadixSort64(m_entries, m_scratch);
+}
+
+void RenderQueue::Submit(IRenderBackend& backend) const
+{
+	Submit(backend, 0, m_entries.size());
+}
+
+void RenderQueue::SubmitPass(IRenderBackend& backend, uint32_t pass) const
+{
+	auto const first = std::partition_point(m_entries.begin(), m_entries.end(),
+		[pass](Entry const& entry) { return SortKey::GetPass(entry.key) < pass; });
+
+	auto const last = std::partition_point(first, m_entries.end(),
+		[pass](Entry const& entry) { return SortKey::GetPass(entry.key) == pass; });
+
+	Submit(backend, size_t(first - m_entries.begin()), size_t(last - m_entries.begin()));
+}
+
+void RenderQueue::Submit(IRenderBackend& backend, size_t begin, size_t end) const
+{
+	bool inPass = false;
+	uint32_t pass = 0;
+	uint32_t target = UINT32_MAX;
+	uint32_t shader = UINT32_MAX;
+	uint32_t material = UINT32_MAX;
+
+	for (size_t i = begin; i < end; ++i)
+	{
+		auto const& entry = m_entries[i];
+		const uint64_t key = entry.key;
+
+		const uint32_t packetPass = SortKey::GetPass(key);
+		if (!inPass || packetPass != pass)
+		{
+			if (inPass)
+			{
+				backend.EndPass(pass);
+			}
+
+			pass = packetPass;
+			inPass = true;
+			backend.BeginPass(pass);
+
+			// Passes can be run one at a time with other work in between, so
+			// each binds its own state.
+			target = shader = material = UINT32_MAX;
+		}
+
+		const uint32_t packetTarget = SortKey::GetTarget(key);
+		if (packetTarget != target)
+		{
+			target = packetTarget;
+			backend.SetRenderTarget(target);
+		}
+
+		const uint32_t packetShader = SortKey::GetShader(key);
+		if (packetShader != shader)
+		{
+			shader = packetShader;
+			backend.SetShader(shader);
+		}
+
+		const uint32_t packetMaterial = SortKey::GetMaterial(key);
+		if (packetMaterial != material)
+		{
+			material = packetMaterial;
+			backend.SetMaterial(material);
+		}
+
+		backend.Draw(m_packets[entry.packet]);
+	}
+
+	if (inPass)
+	{
+		backend.EndPass(pass);
+	}
+}
+
+NullRenderBackend::NullRenderBackend() noexcept :
+	m_stats{},
+	m_executeDraws(false)
+{
+}
+
+void NullRenderBackend::BeginPass(uint32_t)
+{
+	m_stats.passes++;
+}
+
+void NullRenderBackend::EndPass(uint32_t)
+{
+}
+
+void NullRenderBackend::SetRenderTarget(uint32_t)
+{
+	m_stats.targetChanges++;
+}
+
+void NullRenderBackend::SetShader(uint32_t)
+{
+	m_stats.shaderChanges++;
+}
+
+void NullRenderBackend::SetMaterial(uint32_t)
+{
+	m_stats.materialChanges++;
+}
+
+void NullRenderBackend::Draw(RenderPacket const& packet)
+{
+	m_stats.draws++;
+
+	if (m_executeDraws && packet.draw)
+	{
+		packet.draw(packet.context, packet.param);
+	}
+}
+
+const char* RecordingRenderBackend::GetCommandName(CommandType type) noexcept
+{
+	switch (type)
+	{
+	case CommandType::BeginPass:		return "BeginPass";
+	case CommandType::EndPass:			return "EndPass";
+	case CommandType::SetRenderTarget:	return "SetRenderTarget";
+	case CommandType::SetShader:		return "SetShader";
+	case CommandType::SetMaterial:		return "SetMaterial";
+	case CommandType::Draw:				return "Draw";
+	default:							return "Unknown";
+	}
+}
@@ -0,0 +1,207 @@
+//
+// RenderQueue.h - Sortable list of draw packets and the backends that submit them
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packets are ordered by a 64-bit key, most significant field first:
+//
+//   63      60 59      52 51      40 39      24 23       0
+//   |  pass  |  target  |  shader  | material |  depth   |
+//
+// Passes always run in order. Within a pass, packets sharing a render
+// target, shader and material end up next to each other so the state is
+// bound once, and ties are broken by depth.
+namespace SortKey
+{
+	constexpr unsigned PassBits = 4;
+	constexpr unsigned TargetBits = 8;
+	constexpr unsigned ShaderBits = 12;
+	constexpr unsigned MaterialBits = 16;
+	constexpr unsigned DepthBits = 24;
+
+	constexpr unsigned DepthShift = 0;
+	constexpr unsigned MaterialShift = DepthShift + DepthBits;
+	constexpr unsigned ShaderShift = MaterialShift + MaterialBits;
+	constexpr unsigned TargetShift = ShaderShift + ShaderBits;
+	constexpr unsigned PassShift = TargetShift + TargetBits;
+
+	static_assert(PassShift + PassBits == 64, "Sort key fields must fill 64 bits");
+
+	// Fields wider than their bit range are masked.
+	constexpr uint64_t Make(uint32_t pass, uint32_t target, uint32_t shader, uint32_t material, uint32_t depth) noexcept
+	{
+		return (uint64_t(pass & ((1u << PassBits) - 1)) << PassShift)
+			| (uint64_t(target & ((1u << TargetBits) - 1)) << TargetShift)
+			| (uint64_t(shader & ((1u << ShaderBits) - 1)) << ShaderShift)
+			| (uint64_t(material & ((1u << MaterialBits) - 1)) << MaterialShift)
+			| (uint64_t(depth & ((1u << DepthBits) - 1)) << DepthShift);
+	}
+
+	constexpr uint32_t GetPass(uint64_t key) noexcept { return uint32_t(key >> PassShift) & ((1u << PassBits) - 1); }
+	constexpr uint32_t GetTarget(uint64_t key) noexcept { return uint32_t(key >> TargetShift) & ((1u << TargetBits) - 1); }
+	constexpr uint32_t GetShader(uint64_t key) noexcept { return uint32_t(key >> ShaderShift) & ((1u << ShaderBits) - 1); }
+	constexpr uint32_t GetMaterial(uint64_t key) noexcept { return uint32_t(key >> MaterialShift) & ((1u << MaterialBits) - 1); }
+	constexpr uint32_t GetDepth(uint64_t key) noexcept { return uint32_t(key >> DepthShift) & ((1u << DepthBits) - 1); }
+
+	// Maps a view distance in [0, farPlane] onto the depth field. Opaque
+	// geometry sorts front to back; blended geometry wants back to front.
+	uint32_t QuantizeDepth(float distance, float farPlane, bool backToFront = false) noexcept;
+}
+
+struct RenderPacket
+{
+	// Issues the draw. Packets carry a plain function and context rather than
+	// a closure so filling the queue never allocates.
+	using DrawFunction = void (*)(void* context, uint32_t param);
+
+	uint64_t key;
+	DrawFunction draw;
+	void* context;
+	uint32_t param;
+};
+
+// Receives a queue's packets in order. State is set at the start of each
+// pass and then only when it differs from the previous packet.
+class IRenderBackend
+{
+public:
+	virtual ~IRenderBackend() = default;
+
+	virtual void BeginPass(uint32_t pass) = 0;
+	virtual void EndPass(uint32_t pass) = 0;
+
+	virtual void SetRenderTarget(uint32_t target) = 0;
+	virtual void SetShader(uint32_t shader) = 0;
+	virtual void SetMaterial(uint32_t material) = 0;
+
+	virtual void Draw(RenderPacket const& packet) = 0;
+};
+
+class RenderQueue
+{
+public:
+	RenderQueue() = default;
+
+	RenderQueue(RenderQueue&&) = default;
+	RenderQueue& operator= (RenderQueue&&) = default;
+
+	RenderQueue(RenderQueue const&) = delete;
+	RenderQueue& operator= (RenderQueue const&) = delete;
+
+	void Reserve(size_t packets);
+
+	// Empties the queue but keeps its memory for the next frame.
+	void Clear() noexcept;
+
+	void Add(uint64_t key, RenderPacket::DrawFunction draw, void* context, uint32_t param = 0);
+
+	// Stable LSD radix sort on the keys. Byte positions every key agrees on are skipped.
+	void Sort();
+
+	// Hands the packets to the backend in queue order, sorted or not, and
+	// only sets state that changed since the previous packet in the pass.
+	void Submit(IRenderBackend& backend) const;
+
+	// Submits only the packets of one pass, for callers that run the passes
+	// themselves. The queue must be sorted.
+	void SubmitPass(IRenderBackend& backend, uint32_t pass) const;
+
+	size_t GetSize() const noexcept { return m_entries.size(); }
+	RenderPacket const& GetPacket(size_t index) const noexcept { return m_packets[m_entries[index].packet]; }
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t packet;
+	};
+
+	void Submit(IRenderBackend& backend, size_t begin, size_t end) const;
+
+	std::vector<RenderPacket> m_packets;
+	std::vector<Entry> m_entries;
+	std::vector<Entry> m_scratch;
+};
+
+// Counts what a queue asks of a device, without one.
+class NullRenderBackend final : public IRenderBackend
+{
+public:
+	struct Stats
+	{
+		uint64_t passes;
+		uint64_t draws;
+		uint64_t targetChanges;
+		uint64_t shaderChanges;
+		uint64_t materialChanges;
+
+		uint64_t GetStateChanges() const noexcept { return targetChanges + shaderChanges + materialChanges; }
+	};
+
+	NullRenderBackend() noexcept;
+
+	void BeginPass(uint32_t pass) override;
+	void EndPass(uint32_t pass) override;
+
+	void SetRenderTarget(uint32_t target) override;
+	void SetShader(uint32_t shader) override;
+	void SetMaterial(uint32_t material) override;
+
+	void Draw(RenderPacket const& packet) override;
+
+	Stats const& GetStats() const noexcept { return m_stats; }
+	void ResetStats() noexcept { m_stats = {}; }
+
+	// Calls each packet's draw function as well as counting it.
+	void SetExecuteDraws(bool execute) noexcept { m_executeDraws = execute; }
+
+private:
+	Stats m_stats;
+	bool m_executeDraws;
+};
+
+// Keeps every call in order, to check the sequence a queue produces.
+class RecordingRenderBackend final : public IRenderBackend
+{
+public:
+	enum class CommandType
+	{
+		BeginPass,
+		EndPass,
+		SetRenderTarget,
+		SetShader,
+		SetMaterial,
+		Draw,			// Value is the packet param
+	};
+
+	struct Command
+	{
+		CommandType type;
+		uint32_t value;
+
+		bool operator== (Command const& other) const noexcept { return type == other.type && value == other.value; }
+		bool operator!= (Command const& other) const noexcept { return !(*this == other); }
+	};
+
+	void BeginPass(uint32_t pass) override { m_commands.push_back({ CommandType::BeginPass, pass }); }
+	void EndPass(uint32_t pass) override { m_commands.push_back({ CommandType::EndPass, pass }); }
+
+	void SetRenderTarget(uint32_t target) override { m_commands.push_back({ CommandType::SetRenderTarget, target }); }
+	void SetShader(uint32_t shader) override { m_commands.push_back({ CommandType::SetShader, shader }); }
+	void SetMaterial(uint32_t material) override { m_commands.push_back({ CommandType::SetMaterial, material }); }
+
+	void Draw(RenderPacket const& packet) override { m_commands.push_back({ CommandType::Draw, packet.param }); }
+
+	std::vector<Command> const& GetCommands() const noexcept { return m_commands; }
+	void Clear() noexcept { m_commands.clear(); }
+
+	static const char* GetCommandName(CommandType type) noexcept;
+
+private:
+	std::vector<Command> m_commands;
+};
@@ -0,0 +1,165 @@
+//
+// RenderTargetPool.cpp
+//
+
+#include "RenderTargetPool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+RenderTargetPool::RenderTargetPool(IRenderTargetDevice& device, uint32_t maxIdleFrames) noexcept :
+	m_device(device),
+	m_maxIdleFrames(maxIdleFrames),
+	m_frame(0),
+	m_stats{}
+{
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+	// Targets still acquired are destroyed with the pool; their users must
+	// not outlive it.
+	while (!m_entries.empty())
+	{
+		Destroy(m_entries.size() - 1);
+	}
+}
+
+IRenderTarget* RenderTargetPool::Acquire(RenderTargetDesc const& desc)
+{
+	// Prefer the most recently used match, it's the most likely to be warm.
+	Entry* best = nullptr;
+	for (auto& entry : m_entries)
+	{
+		if (!entry.inUse && entry.desc == desc && (!best || entry.lastUsedFrame > best->lastUsedFrame))
+		{
+			best = &entry;
+		}
+	}
+
+	if (best)
+	{
+		m_stats.reused++;
+	}
+	else
+	{
+		Entry entry;
+		entry.desc = desc;
+		entry.target = m_device.CreateTarget(desc);
+		entry.bytes = m_device.GetTargetBytes(desc);
+		entry.lastUsedFrame = m_frame;
+		entry.inUse = false;
+		m_entries.push_back(std::move(entry));
+		best = &m_entries.back();
+
+		m_stats.created++;
+		m_stats.residentTargets++;
+		m_stats.residentBytes += best->bytes;
+		m_stats.peakResidentBytes = std::max(m_stats.peakResidentBytes, m_stats.residentBytes);
+	}
+
+	best->inUse = true;
+	best->lastUsedFrame = m_frame;
+
+	m_stats.inUseBytes += best->bytes;
+	m_stats.peakInUseBytes = std::max(m_stats.peakInUseBytes, m_stats.inUseBytes);
+
+	return best->target.get();
+}
+
+void RenderTargetPool::Release(IRenderTarget* target)
+{
+	auto it = std::find_if(m_entries.begin(), m_entries.end(),
+		[target](Entry const& entry) { return entry.target.get() == target; });
+
+	if (it == m_entries.end() || !it->inUse)
+	{
+		throw std::invalid_argument("Render target was not acquired from this pool");
+	}
+
+	it->inUse = false;
+	it->lastUsedFrame = m_frame;
+	m_stats.inUseBytes -= it->bytes;
+}
+
+void RenderTargetPool::EndFrame()
+{
+	m_frame++;
+
+	for (size_t i = m_entries.size(); i-- > 0;)
+	{
+		auto const& entry = m_entries[i];
+		if (!entry.inUse && m_frame - entry.lastUsedFrame > m_maxIdleFrames)
+		{
+			Destroy(i);
+		}
+	}
+}
+
+void RenderTargetPool::Trim()
+{
+	for (size_t i = m_entries.size(); i-- > 0;)
+	{
+		if (!m_entries[i].inUse)
+		{
+			Destroy(i);
+		}
+	}
+}
+
+void RenderTargetPool::Destroy(size_t index)
+{
+	auto& entry = m_entries[index];
+
+	if (entry.inUse)
+	{
+		m_stats.inUseBytes -= entry.bytes;
+	}
+
+	m_stats.residentBytes -= entry.bytes;
+	m_stats.residentTargets--;
+	m_stats.destroyed++;
+
+	// Order doesn't matter, swap with the last entry instead of shifting.
+	if (index + 1 != m_entries.size())
+	{
+		entry = std::move(m_entries.back());
+	}
+	m_entries.pop_back();
+}
+
+class NullRenderTargetDevice::Target final : public IRenderTarget
+{
+public:
+	explicit Target(uint64_t& live) noexcept :
+		m_live(live)
+	{
+		m_live++;
+	}
+
+	~Target() override
+	{
+		m_live--;
+	}
+
+private:
+	uint64_t& m_live;
+};
+
+NullRenderTargetDevice::NullRenderTargetDevice() noexcept :
+	m_created(0),
+	m_live(0)
+{
+}
+
+std::unique_ptr<IRenderTarget> NullRenderTargetDevice::CreateTarget(RenderTargetDesc const&)
+{
+	m_created++;
+	return std::make_unique<Target>(m_live);
+}
+
+uint64_t NullRenderTargetDevice::GetTargetBytes(RenderTargetDesc const& desc) const noexcept
+{
+	// Counts everything as 32 bits per sample.
+	return uint64_t(desc.width) * desc.height * std::max(desc.sampleCount, 1u) * 4;
+}
@@ -0,0 +1,124 @@
+//
+// RenderTargetPool.h - Recycles transient render targets across frames and resizes
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct RenderTargetDesc
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;		// DXGI_FORMAT
+	uint32_t sampleCount;
+
+	bool operator== (RenderTargetDesc const& other) const noexcept
+	{
+		return width == other.width && height == other.height
+			&& format == other.format && sampleCount == other.sampleCount;
+	}
+
+	bool operator!= (RenderTargetDesc const& other) const noexcept { return !(*this == other); }
+};
+
+// A target created by a device. The pool only owns it; users cast to the
+// device's concrete type to get at views.
+class IRenderTarget
+{
+public:
+	virtual ~IRenderTarget() = default;
+};
+
+// Creates the targets a pool hands out.
+class IRenderTargetDevice
+{
+public:
+	virtual ~IRenderTargetDevice() = default;
+
+	// Throws if the target can't be created.
+	virtual std::unique_ptr<IRenderTarget> CreateTarget(RenderTargetDesc const& desc) = 0;
+
+	// Memory a target with this description occupies.
+	virtual uint64_t GetTargetBytes(RenderTargetDesc const& desc) const noexcept = 0;
+};
+
+// Targets are acquired for as long as they're needed within a frame and
+// released back. Released targets with a matching description are reused;
+// ones nobody asks for are destroyed after a few frames, so targets left
+// behind by a resize go away without thrashing when the size flips back.
+class RenderTargetPool
+{
+public:
+	struct Stats
+	{
+		uint64_t residentBytes;			// Every target the pool holds
+		uint64_t peakResidentBytes;
+		uint64_t inUseBytes;			// Targets currently acquired
+		uint64_t peakInUseBytes;
+		size_t residentTargets;
+		uint64_t created;
+		uint64_t reused;
+		uint64_t destroyed;
+	};
+
+	explicit RenderTargetPool(IRenderTargetDevice& device, uint32_t maxIdleFrames = 4) noexcept;
+	~RenderTargetPool();
+
+	RenderTargetPool(RenderTargetPool const&) = delete;
+	RenderTargetPool& operator= (RenderTargetPool const&) = delete;
+
+	IRenderTarget* Acquire(RenderTargetDesc const& desc);
+
+	// Throws std::invalid_argument for a target the pool didn't hand out.
+	void Release(IRenderTarget* target);
+
+	// Ages released targets and destroys the ones idle for too long.
+	void EndFrame();
+
+	// Destroys every released target now, e.g. on suspend.
+	void Trim();
+
+	Stats const& GetStats() const noexcept { return m_stats; }
+	uint64_t GetFrame() const noexcept { return m_frame; }
+
+private:
+	struct Entry
+	{
+		RenderTargetDesc desc;
+		std::unique_ptr<IRenderTarget> target;
+		uint64_t bytes;
+		uint64_t lastUsedFrame;
+		bool inUse;
+	};
+
+	void Destroy(size_t index);
+
+	IRenderTargetDevice& m_device;
+	std::vector<Entry> m_entries;
+	uint32_t m_maxIdleFrames;
+	uint64_t m_frame;
+	Stats m_stats;
+};
+
+// Hands out empty targets and keeps count, for exercising a pool without a GPU.
+class NullRenderTargetDevice final : public IRenderTargetDevice
+{
+public:
+	NullRenderTargetDevice() noexcept;
+
+	std::unique_ptr<IRenderTarget> CreateTarget(RenderTargetDesc const& desc) override;
+	uint64_t GetTargetBytes(RenderTargetDesc const& desc) const noexcept override;
+
+	uint64_t GetCreatedCount() const noexcept { return m_created; }
+	uint64_t GetLiveCount() const noexcept { return m_live; }
+
+private:
+	class Target;
+
+	uint64_t m_created;
+	uint64_t m_live;
+};
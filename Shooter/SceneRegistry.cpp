@@ -0,0 +1,395 @@
+//
+// SceneRegistry.cpp
+//
+
+#include "SceneRegistry.h"
+
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+// x86 and x64 builds carry an AVX path whatever instruction set they target,
+// and take it when the CPU has AVX.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SHOOTER_CULL_AVX
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SHOOTER_TARGET_AVX
+#else
+#define SHOOTER_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	// A plane with each component splatted across a vector, plus the
+	// absolute normal that projects a box's extents onto it.
+	struct PlaneSplat
+	{
+		XMVECTOR nx, ny, nz, w;
+		XMVECTOR ax, ay, az;
+	};
+
+	size_t RoundUp(size_t count) noexcept
+	{
+		return (count + SceneRegistry::Lanes - 1) / SceneRegistry::Lanes * SceneRegistry::Lanes;
+	}
+
+	// One bit per lane that's set in a comparison result.
+	uint32_t GetLaneMask(FXMVECTOR mask) noexcept
+	{
+#if defined(_XM_SSE_INTRINSICS_)
+		return uint32_t(_mm_movemask_ps(mask));
+#else
+		return (XMVectorGetIntX(mask) & 1) | (XMVectorGetIntY(mask) & 2)
+			| (XMVectorGetIntZ(mask) & 4) | (XMVectorGetIntW(mask) & 8);
+#endif
+	}
+
+	// Writes base + lane for every set bit without branching; out needs
+	// room for all lanes.
+	uint32_t* AppendLanes(uint32_t* out, uint32_t mask, uint32_t base, uint32_t lanes) noexcept
+	{
+		for (uint32_t lane = 0; lane < lanes; ++lane)
+		{
+			*out = base + lane;
+			out += (mask >> lane) & 1;
+		}
+		return out;
+	}
+
+#if defined(SHOOTER_CULL_AVX)
+	// The CPU has AVX and the OS saves its registers.
+	bool DetectAvx() noexcept
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+		return __builtin_cpu_supports("avx");
+#endif
+	}
+
+	// PlaneSplat's values before splatting, which CullEight does itself.
+	struct PlaneValues
+	{
+		float nx, ny, nz, w;
+		float ax, ay, az;
+	};
+
+	// Eight objects per step over all the padded arrays. Only 256-bit
+	// instructions inside, so a build targeting SSE doesn't switch between
+	// the two on every object.
+	SHOOTER_TARGET_AVX uint32_t* CullEight(float const* const centers[3], float const* const extents[3],
+		PlaneValues const (&planes)[6], size_t count, size_t padded, uint32_t* out) noexcept
+	{
+		for (size_t i = 0; i < padded; i += 8)
+		{
+			const __m256 cx = _mm256_loadu_ps(centers[0] + i);
+			const __m256 cy = _mm256_loadu_ps(centers[1] + i);
+			const __m256 cz = _mm256_loadu_ps(centers[2] + i);
+			const __m256 ex = _mm256_loadu_ps(extents[0] + i);
+			const __m256 ey = _mm256_loadu_ps(extents[1] + i);
+			const __m256 ez = _mm256_loadu_ps(extents[2] + i);
+
+			__m256 outside = _mm256_setzero_ps();
+			for (auto const& plane : planes)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.nx), cx), _mm256_set1_ps(plane.w));
+				distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.ny), cy), distance);
+				distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.nz), cz), distance);
+				distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.ax), ex), distance);
+				distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.ay), ey), distance);
+				distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.az), ez), distance);
+
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+			}
+
+			uint32_t mask = ~uint32_t(_mm256_movemask_ps(outside)) & 0xFF;
+			if (i + 8 > count)
+			{
+				mask &= (1u << (count - i)) - 1;
+			}
+			out = AppendLanes(out, mask, uint32_t(i), 8);
+		}
+
+		_mm256_zeroupper();
+		return out;
+	}
+#endif
+}
+
+Frustum Frustum::FromViewProjection(FXMMATRIX viewProjection) noexcept
+{
+	// Clip space is point * matrix, so the rows of the transpose are the
+	// matrix columns, and each clip plane is a sum of two of them.
+	const XMMATRIX m = XMMatrixTranspose(viewProjection);
+
+	const XMVECTOR planes[6] =
+	{
+		XMVectorAdd(m.r[3], m.r[0]),		// Left:   x >= -w
+		XMVectorSubtract(m.r[3], m.r[0]),	// Right:  x <= w
+		XMVectorAdd(m.r[3], m.r[1]),		// Bottom: y >= -w
+		XMVectorSubtract(m.r[3], m.r[1]),	// Top:    y <= w
+		m.r[2],								// Near:   z >= 0
+		XMVectorSubtract(m.r[3], m.r[2]),	// Far:    z <= w
+	};
+
+	Frustum frustum;
+	for (size_t i = 0; i < 6; ++i)
+	{
+		XMStoreFloat4(&frustum.planes[i], XMPlaneNormalize(planes[i]));
+	}
+	return frustum;
+}
+
+void SceneRegistry::Reserve(size_t objects)
+{
+	const size_t padded = RoundUp(objects);
+	for (auto array : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+	{
+		array->reserve(padded);
+	}
+	m_handles.reserve(objects);
+	m_indices.reserve(objects);
+}
+
+void SceneRegistry::Clear() noexcept
+{
+	for (auto array : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+	{
+		array->clear();
+	}
+	m_handles.clear();
+	m_indices.clear();
+	m_freeHandles.clear();
+}
+
+SceneRegistry::Handle SceneRegistry::Add(XMFLOAT3 const& center, XMFLOAT3 const& extents)
+{
+	Handle handle;
+	if (!m_freeHandles.empty())
+	{
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+	}
+	else
+	{
+		handle = Handle(m_indices.size());
+		m_indices.push_back(InvalidHandle);
+	}
+
+	const uint32_t index = uint32_t(m_handles.size());
+	m_handles.push_back(handle);
+	m_indices[handle] = index;
+
+	Resize(m_handles.size());
+	m_centerX[index] = center.x;
+	m_centerY[index] = center.y;
+	m_centerZ[index] = center.z;
+	m_extentX[index] = extents.x;
+	m_extentY[index] = extents.y;
+	m_extentZ[index] = extents.z;
+
+	return handle;
+}
+
+void SceneRegistry::Remove(Handle handle)
+{
+	if (handle >= m_indices.size() || m_indices[handle] == InvalidHandle)
+	{
+		throw std::out_of_range("Scene object handle is not live");
+	}
+
+	const uint32_t index = m_indices[handle];
+	const uint32_t last = uint32_t(m_handles.size() - 1);
+
+	if (index != last)
+	{
+		for (auto array : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+		{
+			(*array)[index] = (*array)[last];
+		}
+
+		m_handles[index] = m_handles[last];
+		m_indices[m_handles[index]] = index;
+	}
+
+	m_handles.pop_back();
+	m_indices[handle] = InvalidHandle;
+	m_freeHandles.push_back(handle);
+
+	// Padding lanes are masked off when culling, but keep them empty anyway.
+	for (auto array : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+	{
+		(*array)[last] = 0.0f;
+	}
+	Resize(m_handles.size());
+}
+
+void SceneRegistry::SetBounds(Handle handle, XMFLOAT3 const& center, XMFLOAT3 const& extents)
+{
+	if (handle >= m_indices.size() || m_indices[handle] == InvalidHandle)
+	{
+		throw std::out_of_range("Scene object handle is not live");
+	}
+
+	const uint32_t index = m_indices[handle];
+	m_centerX[index] = center.x;
+	m_centerY[index] = center.y;
+	m_centerZ[index] = center.z;
+	m_extentX[index] = extents.x;
+	m_extentY[index] = extents.y;
+	m_extentZ[index] = extents.z;
+}
+
+void SceneRegistry::Resize(size_t count)
+{
+	const size_t padded = RoundUp(count);
+	for (auto array : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+	{
+		array->resize(padded, 0.0f);
+	}
+}
+
+// A box is outside a plane when its center is further behind it than the
+// box reaches: dot(n, c) + w + dot(|n|, e) < 0. Objects are visible unless
+// they're outside one of the six planes.
+void SceneRegistry::Cull(Frustum const& frustum, std::vector<uint32_t>& visible) const
+{
+	const size_t count = m_handles.size();
+	const size_t padded = m_centerX.size();
+
+	visible.resize(padded);
+	uint32_t* out = visible.data();
+
+	PlaneSplat planes[6];
+	for (size_t p = 0; p < 6; ++p)
+	{
+		auto const& plane = frustum.planes[p];
+		planes[p].nx = XMVectorReplicate(plane.x);
+		planes[p].ny = XMVectorReplicate(plane.y);
+		planes[p].nz = XMVectorReplicate(plane.z);
+		planes[p].w = XMVectorReplicate(plane.w);
+		planes[p].ax = XMVectorReplicate(std::abs(plane.x));
+		planes[p].ay = XMVectorReplicate(std::abs(plane.y));
+		planes[p].az = XMVectorReplicate(std::abs(plane.z));
+	}
+
+	size_t i = 0;
+
+#if defined(SHOOTER_CULL_AVX)
+	if (UsesAvx())
+	{
+		PlaneValues values[6];
+		for (size_t p = 0; p < 6; ++p)
+		{
+			auto const& plane = frustum.planes[p];
+			values[p] = { plane.x, plane.y, plane.z, plane.w, std::abs(plane.x), std::abs(plane.y), std::abs(plane.z) };
+		}
+
+		const float* centers[3] = { m_centerX.data(), m_centerY.data(), m_centerZ.data() };
+		const float* extents[3] = { m_extentX.data(), m_extentY.data(), m_extentZ.data() };
+		out = CullEight(centers, extents, values, count, padded, out);
+		i = padded;
+	}
+#endif
+
+	// Four objects per step.
+	for (; i < padded; i += 4)
+	{
+		const XMVECTOR cx = XMLoadFloat4(reinterpret_cast<XMFLOAT4 const*>(&m_centerX[i]));
+		const XMVECTOR cy = XMLoadFloat4(reinterpret_cast<XMFLOAT4 const*>(&m_centerY[i]));
+		const XMVECTOR cz = XMLoadFloat4(reinterpret_cast<XMFLOAT4 const*>(&m_centerZ[i]));
+		const XMVECTOR ex = XMLoadFloat4(reinterpret_cast<XMFLOAT4 const*>(&m_extentX[i]));
+		const XMVECTOR ey = XMLoadFloat4(reinterpret_cast<XMFLOAT4 const*>(&m_extentY[i]));
+		const XMVECTOR ez = XMLoadFloat4(reinterpret_cast<XMFLOAT4 const*>(&m_extentZ[i]));
+
+		XMVECTOR outside = XMVectorFalseInt();
+		for (auto const& plane : planes)
+		{
+			XMVECTOR distance = XMVectorMultiplyAdd(plane.nx, cx, plane.w);
+			distance = XMVectorMultiplyAdd(plane.ny, cy, distance);
+			distance = XMVectorMultiplyAdd(plane.nz, cz, distance);
+			distance = XMVectorMultiplyAdd(plane.ax, ex, distance);
+			distance = XMVectorMultiplyAdd(plane.ay, ey, distance);
+			distance = XMVectorMultiplyAdd(plane.az, ez, distance);
+
+			outside = XMVectorOrInt(outside, XMVectorLess(distance, XMVectorZero()));
+		}
+
+		uint32_t mask = ~GetLaneMask(outside) & 0xF;
+		if (i + 4 > count)
+		{
+			mask &= i < count ? (1u << (count - i)) - 1 : 0;
+		}
+		out = AppendLanes(out, mask, uint32_t(i), 4);
+	}
+
+	visible.resize(size_t(out - visible.data()));
+}
+
+void SceneRegistry::CullReference(Frustum const& frustum, std::vector<uint32_t>& visible, std::vector<uint32_t>& uncertain) const
+{
+	visible.clear();
+	uncertain.clear();
+
+	for (uint32_t i = 0; i < m_handles.size(); ++i)
+	{
+		bool outside = false;
+		bool close = false;
+		for (auto const& plane : frustum.planes)
+		{
+			const float terms[] =
+			{
+				plane.x * m_centerX[i], plane.w,
+				plane.y * m_centerY[i],
+				plane.z * m_centerZ[i],
+				std::abs(plane.x) * m_extentX[i],
+				std::abs(plane.y) * m_extentY[i],
+				std::abs(plane.z) * m_extentZ[i],
+			};
+
+			float distance = 0.0f;
+			float magnitude = 0.0f;
+			for (const float term : terms)
+			{
+				distance += term;
+				magnitude += std::abs(term);
+			}
+
+			// Each product and sum rounds by at most half an ulp of the
+			// magnitude, whichever order they're done in.
+			const float tolerance = magnitude * 8.0f * FLT_EPSILON;
+			if (distance < -tolerance)
+			{
+				outside = true;
+				break;
+			}
+			close = close || distance < tolerance;
+		}
+
+		if (!outside)
+		{
+			(close ? uncertain : visible).push_back(i);
+		}
+	}
+}
+
+bool SceneRegistry::UsesAvx() noexcept
+{
+#if defined(SHOOTER_CULL_AVX)
+	static const bool avx = DetectAvx();
+	return avx;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,88 @@
+//
+// SceneRegistry.h - World-space bounds of scene objects, kept in SIMD friendly arrays for frustum culling
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+// The six planes of a view frustum in world space, normalised and facing
+// inwards: a point is inside when dot(plane.xyz, point) + plane.w >= 0 for
+// every plane.
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+
+	// From a view * projection matrix in the row vector convention DirectXMath
+	// and SimpleMath use, with Direct3D's [0, w] clip space depth.
+	static Frustum FromViewProjection(DirectX::FXMMATRIX viewProjection) noexcept;
+};
+
+// Objects are axis aligned boxes, stored as centers and half extents with
+// one array per component so a frustum plane can be tested against four
+// objects (SSE) or eight (AVX, on x86 and x64 CPUs that have it) at once. Handles stay valid until removed;
+// cull results are dense indices, which change when an object is removed.
+class SceneRegistry
+{
+public:
+	using Handle = uint32_t;
+	static constexpr Handle InvalidHandle = UINT32_MAX;
+
+	SceneRegistry() = default;
+
+	SceneRegistry(SceneRegistry&&) = default;
+	SceneRegistry& operator= (SceneRegistry&&) = default;
+
+	SceneRegistry(SceneRegistry const&) = delete;
+	SceneRegistry& operator= (SceneRegistry const&) = delete;
+
+	void Reserve(size_t objects);
+	void Clear() noexcept;
+
+	Handle Add(DirectX::XMFLOAT3 const& center, DirectX::XMFLOAT3 const& extents);
+
+	// Moves the last object into the hole to keep the arrays dense. Both
+	// throw std::out_of_range for handles that aren't live.
+	void Remove(Handle handle);
+	void SetBounds(Handle handle, DirectX::XMFLOAT3 const& center, DirectX::XMFLOAT3 const& extents);
+
+	size_t GetSize() const noexcept { return m_handles.size(); }
+
+	Handle GetHandle(uint32_t index) const noexcept { return m_handles[index]; }
+	DirectX::XMFLOAT3 GetCenter(uint32_t index) const noexcept { return { m_centerX[index], m_centerY[index], m_centerZ[index] }; }
+	DirectX::XMFLOAT3 GetExtents(uint32_t index) const noexcept { return { m_extentX[index], m_extentY[index], m_extentZ[index] }; }
+
+	// Replaces visible with the indices, in order, of the objects whose box
+	// isn't entirely behind one of the planes. Conservative: a box just
+	// outside a corner of the frustum can pass.
+	void Cull(Frustum const& frustum, std::vector<uint32_t>& visible) const;
+
+	// The same test one object at a time, to check Cull against. Cull sums in
+	// its own order and may fuse multiply-adds, so a box within rounding
+	// error of a plane can land either way; those go in uncertain instead.
+	void CullReference(Frustum const& frustum, std::vector<uint32_t>& visible, std::vector<uint32_t>& uncertain) const;
+
+	// Whether Cull takes eight objects at a time on this CPU.
+	static bool UsesAvx() noexcept;
+
+	// Objects each SIMD step covers; the arrays are padded to a multiple of it.
+	static constexpr size_t Lanes = 8;
+
+private:
+	void Resize(size_t count);
+
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_extentX;
+	std::vector<float> m_extentY;
+	std::vector<float> m_extentZ;
+
+	std::vector<Handle> m_handles;			// Dense index to handle
+	std::vector<uint32_t> m_indices;		// Handle to dense index, InvalidHandle when free
+	std::vector<Handle> m_freeHandles;
+};
@@ -4,18 +4,100 @@
 
 #pragma once
 
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <exception>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 
 namespace DX
 {
+    // Clock sources provide a monotonic counter and the number of counts per second.
+#ifdef _WIN32
+    // Windows high resolution performance counter.
+    class QpcClock
+    {
+    public:
+        QpcClock() noexcept(false)
+        {
+            LARGE_INTEGER frequency;
+            if (!QueryPerformanceFrequency(&frequency))
+            {
+                throw std::exception();
+            }
+
+            m_frequency = static_cast<uint64_t>(frequency.QuadPart);
+        }
+
+        uint64_t GetFrequency() const noexcept { return m_frequency; }
+
+        uint64_t GetCounter() const
+        {
+            LARGE_INTEGER counter;
+            if (!QueryPerformanceCounter(&counter))
+            {
+                throw std::exception();
+            }
+
+            return static_cast<uint64_t>(counter.QuadPart);
+        }
+
+    private:
+        uint64_t m_frequency;
+    };
+#endif
+
+    // Portable clock backed by std::chrono::steady_clock.
+    class SteadyClock
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        static_assert(clock::period::num == 1, "steady_clock period must be a fraction of a second");
+
+        uint64_t GetFrequency() const noexcept { return static_cast<uint64_t>(clock::period::den); }
+        uint64_t GetCounter() const noexcept { return static_cast<uint64_t>(clock::now().time_since_epoch().count()); }
+    };
+
+    // Manually advanced clock for tests, replays and headless runs.
+    class VirtualClock
+    {
+    public:
+        explicit VirtualClock(uint64_t frequency = 10000000) noexcept :
+            m_frequency(frequency),
+            m_counter(0)
+        {
+        }
+
+        uint64_t GetFrequency() const noexcept { return m_frequency; }
+        uint64_t GetCounter() const noexcept { return m_counter; }
+
+        void Advance(uint64_t counts) noexcept { m_counter += counts; }
+        void AdvanceSeconds(double seconds) noexcept { m_counter += static_cast<uint64_t>(seconds * static_cast<double>(m_frequency)); }
+
+    private:
+        uint64_t m_frequency;
+        uint64_t m_counter;
+    };
+
+#ifdef _WIN32
+    using DefaultClock = QpcClock;
+#else
+    using DefaultClock = SteadyClock;
+#endif
+
     // Helper class for animation and simulation timing.
-    class StepTimer
+    template<typename TClock>
+    class BasicStepTimer
     {
     public:
-        StepTimer() noexcept(false) :
+        explicit BasicStepTimer(TClock clock = TClock()) noexcept(false) :
+            m_clock(std::move(clock)),
             m_elapsedTicks(0),
             m_totalTicks(0),
             m_leftOverTicks(0),
@@ -26,18 +108,16 @@ namespace DX
             m_isFixedTimeStep(false),
             m_targetElapsedTicks(TicksPerSecond / 60)
         {
-            if (!QueryPerformanceFrequency(&m_qpcFrequency))
+            m_qpcFrequency = m_clock.GetFrequency();
+            if (m_qpcFrequency == 0)
             {
                 throw std::exception();
             }
 
-            if (!QueryPerformanceCounter(&m_qpcLastTime))
-            {
-                throw std::exception();
-            }
+            m_qpcLastTime = m_clock.GetCounter();
 
             // Initialize max delta to 1/10 of a second.
-            m_qpcMaxDelta = static_cast<uint64_t>(m_qpcFrequency.QuadPart / 10);
+            m_qpcMaxDelta = m_qpcFrequency / 10;
         }
 
         // Get elapsed time since the previous Update call.
@@ -56,11 +136,27 @@ namespace DX
 
         // Set whether to use fixed or variable timestep mode.
         void SetFixedTimeStep(bool isFixedTimestep) noexcept { m_isFixedTimeStep = isFixedTimestep; }
+        bool IsFixedTimeStep() const noexcept { return m_isFixedTimeStep; }
 
         // Set how often to call Update when in fixed timestep mode.
         void SetTargetElapsedTicks(uint64_t targetElapsed) noexcept { m_targetElapsedTicks = targetElapsed; }
         void SetTargetElapsedSeconds(double targetElapsed) noexcept { m_targetElapsedTicks = SecondsToTicks(targetElapsed); }
 
+        // Fraction of a fixed step that has accumulated but not yet been simulated, in [0, 1).
+        // Renderers blend between the previous and current simulation state by this amount.
+        // Always 1 in variable timestep mode, where the latest state is exactly current.
+        double GetInterpolationAlpha() const noexcept
+        {
+            if (!m_isFixedTimeStep || m_targetElapsedTicks == 0)
+                return 1.0;
+
+            return static_cast<double>(m_leftOverTicks) / static_cast<double>(m_targetElapsedTicks);
+        }
+
+        // Access the clock source, e.g. to advance a VirtualClock.
+        TClock& GetClock() noexcept { return m_clock; }
+        TClock const& GetClock() const noexcept { return m_clock; }
+
         // Integer format represents time using 10,000,000 ticks per second.
         static constexpr uint64_t TicksPerSecond = 10000000;
 
@@ -73,10 +169,7 @@ namespace DX
 
         void ResetElapsedTime()
         {
-            if (!QueryPerformanceCounter(&m_qpcLastTime))
-            {
-                throw std::exception();
-            }
+            m_qpcLastTime = m_clock.GetCounter();
 
             m_leftOverTicks = 0;
             m_framesPerSecond = 0;
@@ -89,14 +182,9 @@ namespace DX
         void Tick(const TUpdate& update)
         {
             // Query the current time.
-            LARGE_INTEGER currentTime;
+            const uint64_t currentTime = m_clock.GetCounter();
 
-            if (!QueryPerformanceCounter(&currentTime))
-            {
-                throw std::exception();
-            }
-
-            uint64_t timeDelta = static_cast<uint64_t>(currentTime.QuadPart - m_qpcLastTime.QuadPart);
+            uint64_t timeDelta = currentTime - m_qpcLastTime;
 
             m_qpcLastTime = currentTime;
             m_qpcSecondCounter += timeDelta;
@@ -109,7 +197,7 @@ namespace DX
 
             // Convert QPC units into a canonical tick format. This cannot overflow due to the previous clamp.
             timeDelta *= TicksPerSecond;
-            timeDelta /= static_cast<uint64_t>(m_qpcFrequency.QuadPart);
+            timeDelta /= m_qpcFrequency;
 
             const uint32_t lastFrameCount = m_frameCount;
 
@@ -158,18 +246,20 @@ namespace DX
                 m_framesThisSecond++;
             }
 
-            if (m_qpcSecondCounter >= static_cast<uint64_t>(m_qpcFrequency.QuadPart))
+            if (m_qpcSecondCounter >= m_qpcFrequency)
             {
                 m_framesPerSecond = m_framesThisSecond;
                 m_framesThisSecond = 0;
-                m_qpcSecondCounter %= static_cast<uint64_t>(m_qpcFrequency.QuadPart);
+                m_qpcSecondCounter %= m_qpcFrequency;
             }
         }
 
     private:
-        // Source timing data uses QPC units.
-        LARGE_INTEGER m_qpcFrequency;
-        LARGE_INTEGER m_qpcLastTime;
+        TClock m_clock;
+
+        // Source timing data uses clock units.
+        uint64_t m_qpcFrequency;
+        uint64_t m_qpcLastTime;
         uint64_t m_qpcMaxDelta;
 
         // Derived timing data uses a canonical tick format.
@@ -187,4 +277,6 @@ namespace DX
         bool m_isFixedTimeStep;
         uint64_t m_targetElapsedTicks;
     };
+
+    using StepTimer = BasicStepTimer<DefaultClock>;
 }
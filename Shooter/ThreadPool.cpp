@@ -0,0 +1,141 @@
+//
+// ThreadPool.cpp
+//
+
+#include "ThreadPool.h"
+
+#include "Profiler.h"
+
+ThreadPool::ThreadPool(unsigned workerCount) :
+	m_task(nullptr),
+	m_context(nullptr),
+	m_count(0),
+	m_next(0),
+	m_generation(0),
+	m_busyWorkers(0),
+	m_running(false),
+	m_stopping(false)
+{
+	m_workers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; ++i)
+	{
+		m_workers.emplace_back([this]() { WorkerMain(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+unsigned ThreadPool::GetDefaultWorkerCount() noexcept
+{
+	const unsigned hardware = std::thread::hardware_concurrency();
+	return hardware > 1 ? hardware - 1 : 0;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, TaskFunction task, void* context)
+{
+	if (count == 0)
+		return;
+
+	// Not worth waking anyone for a single iteration.
+	if (m_workers.empty() || count == 1)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			task(context, i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = task;
+		m_context = context;
+		m_count = count;
+		m_next.store(0, std::memory_order_relaxed);
+		m_error = nullptr;
+		m_running = true;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	RunTasks();
+
+	// Every iteration is claimed now; wait for the workers still running one.
+	// Workers that wake after this find the loop gone.
+	std::exception_ptr error;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this]() { return m_busyWorkers == 0; });
+		m_running = false;
+		error = m_error;
+		m_error = nullptr;
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+void ThreadPool::WorkerMain()
+{
+	Profiler::SetThreadName("Worker");
+
+	uint64_t seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this, seen]() { return m_stopping || (m_running && m_generation != seen); });
+
+			if (m_stopping)
+				return;
+
+			seen = m_generation;
+			m_busyWorkers++;
+		}
+
+		RunTasks();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busyWorkers--;
+		}
+		m_idle.notify_one();
+	}
+}
+
+void ThreadPool::RunTasks() noexcept
+{
+	for (;;)
+	{
+		const uint32_t index = m_next.fetch_add(1, std::memory_order_relaxed);
+		if (index >= m_count)
+			return;
+
+		try
+		{
+			m_task(m_context, index);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_error)
+			{
+				m_error = std::current_exception();
+			}
+		}
+	}
+}
@@ -0,0 +1,65 @@
+//
+// ThreadPool.h - Worker threads that split a loop's iterations with the calling thread
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs one loop at a time. Workers and the caller claim iterations from a
+// shared counter, so an uneven loop balances itself, and ParallelFor returns
+// once every iteration has finished. Tasks are a plain function and context,
+// like render packets, so starting a loop never allocates.
+class ThreadPool
+{
+public:
+	using TaskFunction = void (*)(void* context, uint32_t index);
+
+	// With no workers every loop runs on the calling thread.
+	explicit ThreadPool(unsigned workerCount);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool&&) = delete;
+	ThreadPool& operator= (ThreadPool&&) = delete;
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator= (ThreadPool const&) = delete;
+
+	// One fewer than the hardware threads, leaving the caller's.
+	static unsigned GetDefaultWorkerCount() noexcept;
+
+	unsigned GetWorkerCount() const noexcept { return unsigned(m_workers.size()); }
+
+	// Calls task(context, i) for every i in [0, count). Not reentrant: call it
+	// from one thread at a time, and not from inside a task. The first
+	// exception a task throws is rethrown once the loop has finished.
+	void ParallelFor(uint32_t count, TaskFunction task, void* context);
+
+private:
+	void WorkerMain();
+	void RunTasks() noexcept;
+
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+
+	// The current loop, valid while m_running
+	TaskFunction m_task;
+	void* m_context;
+	uint32_t m_count;
+	std::atomic<uint32_t> m_next;
+
+	uint64_t m_generation;
+	unsigned m_busyWorkers;
+	bool m_running;
+	bool m_stopping;
+	std::exception_ptr m_error;
+};
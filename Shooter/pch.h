@@ -22,6 +22,7 @@
 #include <cstdio>
 #include <cwchar>
 #include <exception>
+#include <filesystem>
 #include <future>
 #include <iterator>
 #include <memory>
@@ -38,6 +39,7 @@
 #include "winrt/Windows.ApplicationModel.Activation.h"
 #include "winrt/Windows.Foundation.h"
 #include "winrt/Windows.Graphics.Display.h"
+#include "winrt/Windows.Storage.h"
 #include "winrt/Windows.System.h"
 #include "winrt/Windows.UI.Core.h"
 #include "winrt/Windows.UI.Input.h"
@@ -0,0 +1,356 @@
+//
+// ArchiveBenchmark.cpp - Compares loading assets from an archive against loading them as loose files, cold and warm
+//
+
+#include "Tools.h"
+#include "ArchivePacker.h"
+
+#include "../Shooter/AssetArchive.h"
+#include "../Shooter/MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr size_t PageSize = 4096;
+
+	// What the game's asset device does with a mapping before uploading
+	// it: read a byte of every page, so the page faults happen here. The
+	// sum keeps the reads from being optimized away and lets the methods be
+	// compared.
+	uint64_t TouchPages(const uint8_t* data, size_t size) noexcept
+	{
+		uint64_t sum = 0;
+		for (size_t offset = 0; offset < size; offset += PageSize)
+		{
+			sum += data[offset];
+		}
+		return sum;
+	}
+
+	// Drops a file's pages from the OS file cache, so the next read of it
+	// comes from the disk. Only possible through posix_fadvise, and only
+	// for pages nothing maps.
+	bool Evict(std::filesystem::path const& path)
+	{
+#ifdef _WIN32
+		(void)path;
+		return false;
+#else
+		const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0)
+			return false;
+		const bool evicted = fdatasync(file) == 0 && posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		close(file);
+		return evicted;
+#endif
+	}
+
+	struct Method
+	{
+		const char* name;
+		uint32_t opens;
+		uint64_t (*load)(std::vector<ArchivePacker::Source> const& sources, std::filesystem::path const& archive,
+			std::vector<uint8_t>& buffer);
+	};
+
+	uint64_t LoadLooseMapped(std::vector<ArchivePacker::Source> const& sources, std::filesystem::path const&, std::vector<uint8_t>&)
+	{
+		uint64_t sum = 0;
+		for (auto const& source : sources)
+		{
+			const MappedFile file(source.path);
+			sum += TouchPages(file.GetData(), file.GetSize());
+		}
+		return sum;
+	}
+
+	uint64_t LoadLooseRead(std::vector<ArchivePacker::Source> const& sources, std::filesystem::path const&, std::vector<uint8_t>& buffer)
+	{
+		uint64_t sum = 0;
+		for (auto const& source : sources)
+		{
+			std::ifstream file(source.path, std::ios::binary | std::ios::ate);
+			buffer.resize(size_t(file.tellg()));
+			file.seekg(0);
+			if (!file.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(buffer.size())))
+				throw std::runtime_error("Failed to read " + source.path.string());
+			sum += TouchPages(buffer.data(), buffer.size());
+		}
+		return sum;
+	}
+
+	uint64_t LoadArchiveMapped(std::vector<ArchivePacker::Source> const& sources, std::filesystem::path const& archivePath, std::vector<uint8_t>&)
+	{
+		const AssetArchive::Reader archive(archivePath, AssetArchive::Reader::Backend::Mapped);
+
+		uint64_t sum = 0;
+		for (auto const& source : sources)
+		{
+			auto const entry = archive.Find(source.name);
+			sum += TouchPages(archive.GetData(*entry), size_t(entry->size));
+		}
+		return sum;
+	}
+
+	uint64_t LoadArchiveRead(std::vector<ArchivePacker::Source> const& sources, std::filesystem::path const& archivePath, std::vector<uint8_t>& buffer)
+	{
+		const AssetArchive::Reader archive(archivePath, AssetArchive::Reader::Backend::Read);
+
+		uint64_t sum = 0;
+		for (auto const& source : sources)
+		{
+			auto const entry = archive.Find(source.name);
+			buffer.resize(size_t(entry->size));
+			archive.Read(*entry, 0, buffer.data(), buffer.size());
+			sum += TouchPages(buffer.data(), buffer.size());
+		}
+		return sum;
+	}
+
+	// Random sizes spread evenly on a log scale from a page to 2 MB, as
+	// textures and meshes are, scaled to add up to about totalBytes.
+	std::vector<ArchivePacker::Source> WriteFiles(std::filesystem::path const& directory, uint32_t count, uint64_t totalBytes)
+	{
+		std::mt19937 random(23);
+		std::uniform_real_distribution<double> logSize(std::log(double(PageSize)), std::log(2.0 * 1024 * 1024));
+
+		std::vector<double> sizes(count);
+		double sum = 0;
+		for (auto& size : sizes)
+		{
+			size = std::exp(logSize(random));
+			sum += size;
+		}
+
+		std::filesystem::create_directories(directory);
+
+		std::vector<ArchivePacker::Source> sources;
+		std::vector<uint8_t> bytes;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			bytes.resize(std::max<size_t>(1, size_t(sizes[i] * double(totalBytes) / sum)));
+			for (auto& byte : bytes)
+			{
+				byte = uint8_t(random());
+			}
+
+			char name[32];
+			std::snprintf(name, sizeof(name), "asset-%04u.bin", i);
+			const auto path = directory / name;
+
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+			if (!file)
+				throw std::runtime_error("Failed to write " + path.string());
+
+			sources.push_back({ name, path });
+		}
+		return sources;
+	}
+
+	std::vector<uint8_t> ReadAll(std::filesystem::path const& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void WriteAll(std::filesystem::path const& path, std::vector<uint8_t> const& bytes)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+	}
+
+	// Damaged archives must be rejected when they're opened, by both
+	// backends, rather than read out of bounds later.
+	void CheckDamage(std::filesystem::path const& archivePath, std::filesystem::path const& damagedPath)
+	{
+		using AssetArchive::Header;
+		using AssetArchive::Entry;
+		using Backend = AssetArchive::Reader::Backend;
+
+		const auto original = ReadAll(archivePath);
+		Header header;
+		std::memcpy(&header, original.data(), sizeof(header));
+
+		auto const rejected = [&](std::vector<uint8_t> const& bytes)
+		{
+			WriteAll(damagedPath, bytes);
+			return Tools::Throws<std::runtime_error>([&]() { AssetArchive::Reader archive(damagedPath, Backend::Mapped); })
+				&& Tools::Throws<std::runtime_error>([&]() { AssetArchive::Reader archive(damagedPath, Backend::Read); });
+		};
+
+		auto const patched = [&](size_t offset, auto value)
+		{
+			auto bytes = original;
+			std::memcpy(bytes.data() + offset, &value, sizeof(value));
+			return bytes;
+		};
+
+		const size_t firstEntry = header.entryOffset;
+		Tools::Check(rejected(std::vector<uint8_t>(original.begin(), original.begin() + sizeof(Header) - 1)), "truncated header");
+		Tools::Check(rejected(std::vector<uint8_t>(original.begin(), original.end() - 1)), "truncated archive");
+		Tools::Check(rejected(patched(offsetof(Header, magic), uint32_t(0))), "magic");
+		Tools::Check(rejected(patched(offsetof(Header, version), AssetArchive::Version + 1)), "version");
+		Tools::Check(rejected(patched(offsetof(Header, entryCount), header.entryCount + 1)), "entry count");
+		Tools::Check(rejected(patched(offsetof(Header, nameSize), ~0u)), "name size");
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, hash), uint64_t(0))), "entry hash");
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, offset), uint64_t(header.fileSize))), "entry offset");
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, offset), uint64_t(AssetArchive::EntryAlignment + 1))), "entry alignment");
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, size), ~0ull)), "entry size");
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, name), ~0u)), "entry name");
+
+		// Swapping the first two records breaks the sort.
+		if (header.entryCount > 1)
+		{
+			auto bytes = original;
+			std::swap_ranges(bytes.begin() + firstEntry, bytes.begin() + firstEntry + sizeof(Entry),
+				bytes.begin() + firstEntry + sizeof(Entry));
+			Tools::Check(rejected(bytes), "entry order");
+		}
+
+		std::filesystem::remove(damagedPath);
+
+		const AssetArchive::Reader read(archivePath, Backend::Read);
+		auto const& entry = read.GetEntry(0);
+		uint8_t byte;
+		Tools::Check(Tools::Throws<std::logic_error>([&]() { read.GetData(entry); }), "GetData on the read backend");
+		Tools::Check(Tools::Throws<std::out_of_range>([&]() { read.Read(entry, entry.size, &byte, 1); }), "read past the end");
+	}
+}
+
+int RunArchiveBenchmark(int argc, char** argv)
+{
+	const uint32_t fileCount = uint32_t(std::max<uint64_t>(2, Tools::GetArgument(argc, argv, 0, 256)));
+	const uint64_t totalBytes = Tools::GetArgument(argc, argv, 1, 64) * 1024 * 1024;
+	const std::filesystem::path directory = argc > 2
+		? std::filesystem::path(argv[2])
+		: std::filesystem::temp_directory_path() / "shooter-archive-benchmark";
+
+	constexpr int ColdRuns = 3;
+	constexpr int WarmRuns = 10;
+
+	try
+	{
+		std::printf("writing %u loose files, %.0f MB, to %s\n", fileCount, double(totalBytes) / (1024 * 1024), directory.string().c_str());
+		auto sources = WriteFiles(directory / "loose", fileCount, totalBytes);
+
+		const auto archivePath = directory / "Assets.pak";
+		auto const start = std::chrono::steady_clock::now();
+		const auto stats = ArchivePacker::Pack(sources, archivePath);
+		std::printf("packed into %llu bytes (%.2f%% table and alignment) in %.0f ms\n\n",
+			(unsigned long long)stats.fileSize, 100.0 * double(stats.fileSize - stats.contentBytes) / double(stats.contentBytes),
+			Tools::Seconds(start) * 1000.0);
+
+		CheckDamage(archivePath, directory / "damaged.pak");
+
+		// Assets are asked for in whatever order the game needs them, not
+		// the order they were packed in.
+		std::shuffle(sources.begin(), sources.end(), std::mt19937(5));
+
+		const Method methods[] =
+		{
+			{ "loose files, mapped", fileCount, LoadLooseMapped },
+			{ "loose files, read", fileCount, LoadLooseRead },
+			{ "archive, mapped", 1, LoadArchiveMapped },
+			{ "archive, pread", 1, LoadArchiveRead },
+		};
+
+		auto const evictAll = [&]()
+		{
+			bool evicted = Evict(archivePath);
+			for (auto const& source : sources)
+			{
+				evicted = Evict(source.path) && evicted;
+			}
+			return evicted;
+		};
+
+		const bool canEvict = evictAll();
+		if (!canEvict)
+		{
+			std::printf("can't drop files from the file cache here, so there are no cold loads\n\n");
+		}
+
+		std::printf("%-22s %6s %12s %12s %12s %12s\n", "", "opens", "cold ms", "cold MB/s", "warm ms", "warm MB/s");
+
+		std::vector<uint8_t> buffer;
+		uint64_t expected = 0;
+		double looseCold = 0, looseWarm = 0;
+		for (auto const& method : methods)
+		{
+			// Best of a few runs each, each cold one after dropping every
+			// file from the cache.
+			double cold = 0;
+			if (canEvict)
+			{
+				cold = 1e30;
+				for (int run = 0; run < ColdRuns; ++run)
+				{
+					evictAll();
+					auto const coldStart = std::chrono::steady_clock::now();
+					const uint64_t sum = method.load(sources, archivePath, buffer);
+					cold = std::min(cold, Tools::Seconds(coldStart));
+
+					expected = expected ? expected : sum;
+					Tools::Check(sum == expected, "every method loads the same bytes");
+				}
+			}
+
+			method.load(sources, archivePath, buffer);
+			double warm = 1e30;
+			for (int run = 0; run < WarmRuns; ++run)
+			{
+				auto const warmStart = std::chrono::steady_clock::now();
+				const uint64_t sum = method.load(sources, archivePath, buffer);
+				warm = std::min(warm, Tools::Seconds(warmStart));
+
+				expected = expected ? expected : sum;
+				Tools::Check(sum == expected, "every method loads the same bytes");
+			}
+
+			if (method.load == LoadLooseMapped)
+			{
+				looseCold = cold;
+				looseWarm = warm;
+			}
+
+			const double megabytes = double(stats.contentBytes) / (1024 * 1024);
+			std::printf("%-22s %6u %12.2f %12.0f %12.2f %12.0f", method.name, method.opens,
+				cold * 1000.0, cold > 0 ? megabytes / cold : 0.0, warm * 1000.0, megabytes / warm);
+			if (method.load != LoadLooseMapped)
+			{
+				std::printf("   %.2fx cold, %.2fx warm against loose mapped", cold > 0 ? looseCold / cold : 0.0, looseWarm / warm);
+			}
+			std::printf("\n");
+		}
+
+		std::filesystem::remove_all(directory / "loose");
+		std::filesystem::remove(archivePath);
+		std::filesystem::remove(directory);
+	}
+	catch (std::exception const& e)
+	{
+		Tools::Check(false, e.what());
+	}
+
+	return Tools::Finish("archive-benchmark");
+}
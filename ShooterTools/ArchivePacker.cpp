@@ -0,0 +1,291 @@
+//
+// ArchivePacker.cpp
+//
+
+#include "ArchivePacker.h"
+#include "Lz4Compressor.h"
+
+#include "../Shooter/ThreadPool.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment) noexcept
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void WritePadding(std::ofstream& stream, uint64_t bytes)
+	{
+		static const char zeros[AssetArchive::EntryAlignment] = {};
+		while (bytes > 0)
+		{
+			const uint64_t chunk = std::min<uint64_t>(bytes, sizeof(zeros));
+			stream.write(zeros, std::streamsize(chunk));
+			bytes -= chunk;
+		}
+	}
+
+	std::vector<uint8_t> ReadFile(std::filesystem::path const& path)
+	{
+		std::vector<uint8_t> bytes(size_t(std::filesystem::file_size(path)));
+		std::ifstream file(path, std::ios::binary);
+		if (!file.read(reinterpret_cast<char*>(bytes.data()), std::streamsize(bytes.size())))
+			throw std::runtime_error("Failed to read " + path.string());
+		return bytes;
+	}
+
+	struct PackedEntry
+	{
+		AssetArchive::Entry entry;
+
+		// A compressed entry's blocks' stored sizes and bytes; for an
+		// uncompressed one, both are empty and its file is copied in.
+		std::vector<uint32_t> blockSizes;
+		std::vector<uint8_t> stored;
+	};
+
+	// Compresses every block on its own, keeping those that don't shrink
+	// as they are.
+	void CompressBlocks(std::vector<uint8_t> const& bytes, ArchivePacker::Options const& options, ThreadPool* pool,
+		PackedEntry& packed)
+	{
+		const uint32_t blockCount = uint32_t((bytes.size() + options.blockSize - 1) / options.blockSize);
+		std::vector<std::vector<uint8_t>> blocks(blockCount);
+
+		struct Context
+		{
+			std::vector<uint8_t> const* bytes;
+			ArchivePacker::Options const* options;
+			std::vector<std::vector<uint8_t>>* blocks;
+		};
+		Context context = { &bytes, &options, &blocks };
+
+		auto const task = [](void* data, uint32_t index)
+		{
+			auto const& context = *static_cast<Context*>(data);
+			const size_t start = size_t(index) * context.options->blockSize;
+			const size_t size = std::min<size_t>(context.options->blockSize, context.bytes->size() - start);
+			const uint8_t* const source = context.bytes->data() + start;
+
+			auto& block = (*context.blocks)[index];
+			block.resize(Lz4::GetMaxCompressedSize(size));
+			const size_t compressed = Lz4::Compress(source, size, block.data(), context.options->searchDepth);
+			if (compressed < size)
+			{
+				block.resize(compressed);
+			}
+			else
+			{
+				block.assign(source, source + size);
+			}
+		};
+
+		if (pool)
+		{
+			pool->ParallelFor(blockCount, task, &context);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < blockCount; ++i)
+			{
+				task(&context, i);
+			}
+		}
+
+		for (auto const& block : blocks)
+		{
+			packed.blockSizes.push_back(uint32_t(block.size()));
+			packed.stored.insert(packed.stored.end(), block.begin(), block.end());
+		}
+	}
+}
+
+std::vector<ArchivePacker::Source> ArchivePacker::ListDirectory(std::filesystem::path const& directory,
+	std::vector<std::string> const& extensions)
+{
+	std::vector<Source> sources;
+	for (auto const& item : std::filesystem::directory_iterator(directory))
+	{
+		if (!item.is_regular_file())
+			continue;
+
+		const std::string extension = item.path().extension().string();
+		if (!extensions.empty() && std::find(extensions.begin(), extensions.end(), extension) == extensions.end())
+			continue;
+
+		sources.push_back({ item.path().filename().string(), item.path() });
+	}
+
+	std::sort(sources.begin(), sources.end(),
+		[](Source const& a, Source const& b) { return a.name < b.name; });
+	return sources;
+}
+
+ArchivePacker::Stats ArchivePacker::Pack(std::vector<Source> const& sources, std::filesystem::path const& output,
+	Options const& options, ThreadPool* pool)
+{
+	using namespace AssetArchive;
+
+	const bool compress = options.compression != Compression::None;
+	if (compress && (options.blockSize < MinBlockSize || options.blockSize > MaxBlockSize
+		|| (options.blockSize & (options.blockSize - 1)) != 0))
+		throw std::invalid_argument("Archive block size must be a power of two from 64 to 256 KB");
+
+	Stats stats = {};
+	stats.entryCount = uint32_t(sources.size());
+
+	// Names and stored bytes first, in source order, then the table sorted
+	// by hash and name with the entries' offsets filled in.
+	std::vector<PackedEntry> packed(sources.size());
+	std::vector<char> names;
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		const std::string name = NormalizeName(sources[i].name);
+		if (name.empty())
+			throw std::invalid_argument("Empty archive entry name for " + sources[i].path.string());
+
+		Entry& entry = packed[i].entry;
+		entry = {};
+		entry.hash = HashName(name);
+		entry.size = std::filesystem::file_size(sources[i].path);
+		entry.storedSize = entry.size;
+		entry.name = uint32_t(names.size());
+		entry.compression = Compression::None;
+		names.insert(names.end(), name.begin(), name.end());
+		names.push_back(0);
+
+		if (compress && entry.size > 0)
+		{
+			CompressBlocks(ReadFile(sources[i].path), options, pool, packed[i]);
+			if (double(packed[i].stored.size()) <= double(entry.size) * (1.0 - options.minSaving))
+			{
+				entry.compression = options.compression;
+				entry.blockSize = options.blockSize;
+				entry.storedSize = packed[i].stored.size();
+				stats.compressedCount++;
+			}
+			else
+			{
+				packed[i].blockSizes.clear();
+				packed[i].stored.clear();
+			}
+		}
+
+		stats.contentBytes += entry.size;
+		stats.storedBytes += entry.storedSize;
+	}
+
+	uint32_t blockCount = 0;
+	for (auto const& item : packed)
+	{
+		blockCount += uint32_t(item.blockSizes.size());
+	}
+
+	Header header = {};
+	header.magic = Magic;
+	header.version = Version;
+	header.entryCount = uint32_t(packed.size());
+	header.entryOffset = sizeof(Header);
+	header.blockCount = blockCount;
+	header.blockOffset = header.entryOffset + uint32_t(packed.size() * sizeof(Entry));
+	header.nameOffset = header.blockOffset + uint32_t(blockCount * sizeof(Block));
+	header.nameSize = uint32_t(names.size());
+
+	std::vector<Block> blocks;
+	blocks.reserve(blockCount);
+	uint64_t offset = AlignUp(uint64_t(header.nameOffset) + header.nameSize, EntryAlignment);
+	for (auto& item : packed)
+	{
+		item.entry.offset = offset;
+		if (!item.blockSizes.empty())
+		{
+			item.entry.firstBlock = uint32_t(blocks.size());
+			uint64_t blockOffset = offset;
+			for (const uint32_t storedSize : item.blockSizes)
+			{
+				blocks.push_back({ blockOffset, storedSize, 0 });
+				blockOffset += storedSize;
+			}
+		}
+		offset = AlignUp(offset + item.entry.storedSize, EntryAlignment);
+	}
+
+	// The last entry isn't padded; nothing follows it.
+	header.fileSize = packed.empty()
+		? uint64_t(header.nameOffset) + header.nameSize
+		: packed.back().entry.offset + packed.back().entry.storedSize;
+	stats.fileSize = header.fileSize;
+
+	std::vector<uint32_t> order(packed.size());
+	for (uint32_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+
+	auto const nameOf = [&](uint32_t index) { return std::string_view(&names[packed[index].entry.name]); };
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		if (packed[a].entry.hash != packed[b].entry.hash)
+			return packed[a].entry.hash < packed[b].entry.hash;
+		return nameOf(a) < nameOf(b);
+	});
+
+	for (size_t i = 1; i < order.size(); ++i)
+	{
+		if (packed[order[i - 1]].entry.hash == packed[order[i]].entry.hash && nameOf(order[i - 1]) == nameOf(order[i]))
+			throw std::invalid_argument("Two archive entries named " + std::string(nameOf(order[i])));
+	}
+
+	std::filesystem::path temporary = output;
+	temporary += ".tmp";
+	{
+		std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+		if (!stream)
+			throw std::runtime_error("Failed to create " + temporary.string());
+
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const uint32_t index : order)
+		{
+			stream.write(reinterpret_cast<const char*>(&packed[index].entry), sizeof(Entry));
+		}
+		stream.write(reinterpret_cast<const char*>(blocks.data()), std::streamsize(blocks.size() * sizeof(Block)));
+		stream.write(names.data(), std::streamsize(names.size()));
+
+		uint64_t position = uint64_t(header.nameOffset) + header.nameSize;
+		std::vector<char> buffer(1 << 20);
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			Entry const& entry = packed[i].entry;
+			WritePadding(stream, entry.offset - position);
+			position = entry.offset + entry.storedSize;
+
+			if (Reader::IsCompressed(entry))
+			{
+				stream.write(reinterpret_cast<const char*>(packed[i].stored.data()), std::streamsize(packed[i].stored.size()));
+				continue;
+			}
+
+			std::ifstream input(sources[i].path, std::ios::binary);
+			uint64_t remaining = entry.size;
+			while (input && remaining > 0)
+			{
+				const size_t chunk = size_t(std::min<uint64_t>(remaining, buffer.size()));
+				input.read(buffer.data(), std::streamsize(chunk));
+				stream.write(buffer.data(), input.gcount());
+				remaining -= uint64_t(input.gcount());
+			}
+			if (remaining != 0)
+				throw std::runtime_error("Failed to read " + sources[i].path.string());
+		}
+
+		if (!stream.flush())
+			throw std::runtime_error("Failed to write " + temporary.string());
+	}
+
+	std::filesystem::rename(temporary, output);
+	return stats;
+}
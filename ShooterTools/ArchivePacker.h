@@ -0,0 +1,60 @@
+//
+// ArchivePacker.h - Packs loose asset files into an asset archive
+//
+
+#pragma once
+
+#include "../Shooter/AssetArchive.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Entries are laid out in the order they're given, so assets loaded
+// together can be packed next to each other; the table is sorted by hash
+// regardless. See AssetArchive.h for the format.
+namespace ArchivePacker
+{
+	struct Source
+	{
+		std::string name;
+		std::filesystem::path path;
+	};
+
+	struct Options
+	{
+		AssetArchive::Compression compression = AssetArchive::Compression::None;
+		uint32_t blockSize = 128 * 1024;
+
+		// See Lz4::Compress.
+		unsigned searchDepth = 64;
+
+		// A file stays uncompressed, and usable in place from a mapping,
+		// unless compressing saves at least this much of it.
+		double minSaving = 0.125;
+	};
+
+	struct Stats
+	{
+		uint32_t entryCount;
+		uint32_t compressedCount;
+		uint64_t contentBytes;		// The files' own bytes
+		uint64_t storedBytes;		// What they take in the archive
+		uint64_t fileSize;			// With the tables, names and alignment padding
+	};
+
+	// The files directly in a directory with one of the extensions (all of
+	// them for none), named after themselves and sorted by name.
+	std::vector<Source> ListDirectory(std::filesystem::path const& directory, std::vector<std::string> const& extensions);
+
+	// Writes the archive next to output and renames it into place, so a
+	// reader never sees half of one. Compresses a file's blocks on the
+	// pool's threads where there's one. Throws std::invalid_argument for
+	// two sources with the same normalized name or a block size out of
+	// range, and std::runtime_error if a file can't be read or written.
+	Stats Pack(std::vector<Source> const& sources, std::filesystem::path const& output, Options const& options = {},
+		ThreadPool* pool = nullptr);
+}
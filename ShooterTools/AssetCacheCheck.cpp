@@ -0,0 +1,326 @@
+//
+// AssetCacheCheck.cpp - Checks the asset cache's budget and eviction, and times device restore against a fake device
+//
+
+#include "Tools.h"
+
+#include "../Shooter/AssetArchive.h"
+#include "../Shooter/AssetCache.h"
+#include "../Shooter/AssetLoader.h"
+#include "../Shooter/CookedMesh.h"
+#include "../Shooter/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	class SizedPayload final : public IAssetPayload
+	{
+	public:
+		explicit SizedPayload(size_t size) noexcept : size(size) {}
+
+		size_t GetSize() const noexcept override { return size; }
+
+		size_t size;
+	};
+
+	std::shared_ptr<IAssetPayload const> MakePayload(size_t size)
+	{
+		return std::make_shared<SizedPayload>(size);
+	}
+
+	// Least recently used first out, within the budget at every step.
+	void CheckEviction()
+	{
+		std::printf("eviction:\n");
+
+		AssetCache cache(100);
+		auto const a = MakePayload(40);
+		cache.Insert(0, "a", a);
+		cache.Insert(0, "b", MakePayload(40));
+		Tools::Check(cache.Find(0, "a") == a, "found what was inserted");
+		Tools::Check(cache.Find(1, "a") == nullptr, "same path of another kind not found");
+		Tools::Check(cache.Find(0, "./a") == nullptr && cache.Find(0, "A") == nullptr, "paths aren't normalized");
+
+		// a was used after b, so b goes first.
+		cache.Insert(0, "c", MakePayload(40));
+		Tools::Check(cache.Find(0, "b") == nullptr && cache.Find(0, "a") && cache.Find(0, "c"), "least recently used evicted");
+
+		auto stats = cache.GetStats();
+		Tools::Check(stats.count == 2 && stats.bytes == 80 && stats.evictions == 1, "count, bytes and evictions");
+
+		// Too big for the whole budget: not kept, and nothing else dropped.
+		auto const big = MakePayload(101);
+		cache.Insert(0, "big", big);
+		Tools::Check(cache.Find(0, "big") == nullptr && cache.GetStats().count == 2, "payload over the budget not kept");
+		Tools::Check(big.use_count() == 1, "cache let go of it");
+
+		// Replacing an asset's payload counts its new size.
+		cache.Insert(0, "c", MakePayload(10));
+		stats = cache.GetStats();
+		Tools::Check(stats.count == 2 && stats.bytes == 50, "replaced payload");
+
+		// c was used last, so shrinking drops a.
+		cache.SetBudget(20);
+		Tools::Check(cache.Find(0, "a") == nullptr && cache.Find(0, "c") != nullptr && cache.GetStats().bytes == 10, "shrunk budget");
+		Tools::Check(a.use_count() == 1, "evicted payload freed once unused");
+
+		cache.Clear();
+		stats = cache.GetStats();
+		Tools::Check(stats.count == 0 && stats.bytes == 0, "cleared");
+		std::printf("  %llu hits, %llu misses, %llu evictions\n",
+			(unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.evictions);
+	}
+
+	// Threads finding and inserting at random leave the books balanced.
+	void CheckThreads()
+	{
+		constexpr uint64_t Budget = 64 * 1024;
+		constexpr unsigned ThreadCount = 4;
+		constexpr uint32_t Operations = 20000;
+
+		AssetCache cache(Budget);
+		std::atomic<uint32_t> found(0);
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < ThreadCount; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				std::mt19937 random(25 + t);
+				for (uint32_t i = 0; i < Operations; ++i)
+				{
+					const std::string name = std::to_string(random() % 64);
+					if (cache.Find(0, name))
+					{
+						found++;
+					}
+					else
+					{
+						cache.Insert(0, name, MakePayload(1 + random() % 4096));
+					}
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		auto const stats = cache.GetStats();
+		std::printf("\n%u threads: %llu hits, %llu misses, %llu evictions, %u payloads in %llu bytes\n", ThreadCount,
+			(unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.evictions,
+			stats.count, (unsigned long long)stats.bytes);
+		Tools::Check(stats.hits == found && stats.hits + stats.misses == uint64_t(ThreadCount) * Operations, "every lookup counted");
+		Tools::Check(stats.bytes <= Budget && stats.count <= 64, "within the budget");
+	}
+
+	enum Kind : uint32_t
+	{
+		KIND_TEXTURE,
+		KIND_MESH,
+	};
+
+	class Payload final : public IAssetPayload
+	{
+	public:
+		size_t GetSize() const noexcept override { return buffer.size(); }
+
+		std::vector<uint8_t> buffer;
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		std::unique_ptr<CookedMesh::File> mesh;
+	};
+
+	class Asset final : public IAsset
+	{
+	public:
+		std::vector<uint8_t> memory;
+	};
+
+	// Decodes from the archive as the game's device does, decompressing
+	// entries on a block pool and parsing meshes, and creates assets by
+	// copying their bytes to memory of its own, where the GPU's would be.
+	class FakeDevice final : public IAssetDevice
+	{
+	public:
+		FakeDevice(AssetArchive::Reader const& archive, unsigned blockWorkers) :
+			m_archive(archive),
+			m_blockPool(blockWorkers),
+			m_decodes(0),
+			m_creates(0)
+		{
+		}
+
+		std::unique_ptr<IAssetPayload> Decode(uint32_t kind, std::filesystem::path const& path) override
+		{
+			auto const entry = m_archive.Find(path.generic_string());
+			if (!entry)
+				throw std::runtime_error(path.generic_string() + " isn't in the archive");
+
+			m_decodes++;
+			auto payload = std::make_unique<Payload>();
+			payload->size = size_t(entry->size);
+			if (AssetArchive::Reader::IsCompressed(*entry))
+			{
+				payload->buffer.resize(payload->size);
+				payload->data = payload->buffer.data();
+
+				std::unique_lock<std::mutex> lock(m_blockPoolMutex, std::try_to_lock);
+				m_archive.ReadEntry(*entry, payload->buffer.data(), lock.owns_lock() ? &m_blockPool : nullptr);
+			}
+			else
+			{
+				payload->data = m_archive.GetData(*entry);
+			}
+
+			if (kind == KIND_MESH)
+			{
+				payload->mesh = std::make_unique<CookedMesh::File>(payload->data, payload->size);
+			}
+			else if (payload->size < 4 || std::memcmp(payload->data, "DDS ", 4) != 0)
+			{
+				throw std::runtime_error(path.generic_string() + " isn't a DDS file");
+			}
+			return payload;
+		}
+
+		std::unique_ptr<IAsset> Create(uint32_t, IAssetPayload const& base) override
+		{
+			auto const& payload = static_cast<Payload const&>(base);
+			auto asset = std::make_unique<Asset>();
+			asset->memory.assign(payload.data, payload.data + payload.size);
+			m_creates++;
+			return asset;
+		}
+
+		uint32_t GetDecodes() const noexcept { return m_decodes; }
+		uint32_t GetCreates() const noexcept { return m_creates; }
+
+	private:
+		AssetArchive::Reader const& m_archive;
+		ThreadPool m_blockPool;
+		std::mutex m_blockPoolMutex;
+		std::atomic<uint32_t> m_decodes;
+		std::atomic<uint32_t> m_creates;
+	};
+
+	struct Restore
+	{
+		double seconds;
+		uint32_t ready;
+		uint32_t decodes;
+		uint32_t cached;
+	};
+
+	// Makes a device and loader, as the game does after device loss, and
+	// loads every asset in the archive.
+	Restore LoadAll(AssetArchive::Reader const& archive, AssetCache* cache)
+	{
+		constexpr unsigned LoaderWorkers = 2;
+		constexpr unsigned BlockWorkers = 2;
+
+		auto const start = std::chrono::steady_clock::now();
+		FakeDevice device(archive, BlockWorkers);
+		AssetLoader loader(device, LoaderWorkers, cache);
+
+		std::vector<uint32_t> handles;
+		for (uint32_t i = 0; i < archive.GetEntryCount(); ++i)
+		{
+			const std::filesystem::path name = archive.GetName(archive.GetEntry(i));
+			handles.push_back(loader.Load(name.extension() == ".cmesh" ? KIND_MESH : KIND_TEXTURE, name));
+		}
+		const uint32_t missing = loader.Load(KIND_TEXTURE, "missing.dds");
+
+		loader.Finish();
+		const double seconds = Tools::Seconds(start);
+
+		Restore restore = { seconds, 0, device.GetDecodes(), loader.GetStats().cached };
+		for (auto const handle : handles)
+		{
+			restore.ready += loader.IsReady(handle) ? 1 : 0;
+		}
+		Tools::Check(loader.GetState(missing) == AssetLoader::State::Failed, "missing asset fails");
+		Tools::Check(device.GetCreates() == restore.ready, "every ready asset created");
+		return restore;
+	}
+
+	// The best of several, so a restore's time isn't a scheduling hiccup.
+	Restore BestOf(uint32_t count, AssetArchive::Reader const& archive, AssetCache* cache)
+	{
+		Restore best = LoadAll(archive, cache);
+		for (uint32_t i = 1; i < count; ++i)
+		{
+			const Restore restore = LoadAll(archive, cache);
+			best = restore.seconds < best.seconds ? restore : best;
+		}
+		return best;
+	}
+}
+
+int RunAssetCacheCheck(int argc, char** argv)
+{
+	const std::filesystem::path archivePath = argc > 0 ? argv[0] : "Shooter/Assets/Assets.pak";
+	const uint32_t restores = uint32_t(std::max<uint64_t>(1, Tools::GetArgument(argc, argv, 1, 20)));
+
+	CheckEviction();
+	CheckThreads();
+
+	try
+	{
+		const AssetArchive::Reader archive(archivePath);
+		const uint32_t count = archive.GetEntryCount();
+		uint64_t total = 0;
+		uint64_t owned = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			auto const& entry = archive.GetEntry(i);
+			total += entry.size;
+			owned += AssetArchive::Reader::IsCompressed(entry) ? entry.size : 0;
+		}
+
+		std::printf("\n%s: %u assets, %llu bytes decoded, %llu of them into buffers; best of %u restores\n",
+			archivePath.string().c_str(), count, (unsigned long long)total, (unsigned long long)owned, restores);
+
+		AssetCache cache(owned);
+		const Restore first = LoadAll(archive, &cache);
+		Tools::Check(first.ready == count && first.decodes == count && first.cached == 0, "first load decodes everything");
+		Tools::Check(cache.GetStats().count == count, "everything cached");
+		Tools::Check(cache.GetStats().bytes == owned, "only decoded buffers charged, not the mapped archive");
+
+		const Restore uncached = BestOf(restores, archive, nullptr);
+		const Restore cached = BestOf(restores, archive, &cache);
+		Tools::Check(uncached.ready == count && uncached.decodes == count, "restore without the cache decodes again");
+		Tools::Check(cached.ready == count && cached.decodes == 0 && cached.cached == count, "restore with the cache only creates");
+
+		// Half the budget keeps some; the rest are decoded again.
+		cache.SetBudget(owned / 2);
+		const Restore partial = LoadAll(archive, &cache);
+		auto const stats = cache.GetStats();
+		Tools::Check(partial.ready == count && partial.decodes + partial.cached == count, "partly cached restore");
+		Tools::Check(stats.bytes <= owned / 2, "within the smaller budget");
+
+		std::printf("  %-30s %10s %10s %10s\n", "", "ms", "decoded", "cached");
+		std::printf("  %-30s %10.3f %10u %10u\n", "first load", first.seconds * 1000.0, first.decodes, first.cached);
+		std::printf("  %-30s %10.3f %10u %10u\n", "restore, no cache", uncached.seconds * 1000.0, uncached.decodes, uncached.cached);
+		std::printf("  %-30s %10.3f %10u %10u\n", "restore, cached", cached.seconds * 1000.0, cached.decodes, cached.cached);
+		std::printf("  %-30s %10.3f %10u %10u\n", "restore, half the budget", partial.seconds * 1000.0, partial.decodes, partial.cached);
+		std::printf("  restore %.2fx faster from the cache, which holds %llu bytes\n",
+			uncached.seconds / cached.seconds, (unsigned long long)owned);
+	}
+	catch (std::exception const& e)
+	{
+		Tools::Check(false, e.what());
+	}
+
+	return Tools::Finish("asset cache");
+}
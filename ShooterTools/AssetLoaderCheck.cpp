@@ -0,0 +1,344 @@
+//
+// AssetLoaderCheck.cpp - Checks asset loader scheduling and dependencies against a fake device, and times parallel loads
+//
+
+#include "Tools.h"
+
+#include "../Shooter/AssetLoader.h"
+#include "../Shooter/CookedMesh.h"
+#include "../Shooter/MappedFile.h"
+#include "../Shooter/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	enum Kind : uint32_t
+	{
+		KIND_FAKE,		// Waits as long as a read would, then decodes to its path
+		KIND_FILE,		// Maps the file and reads every page in
+		KIND_MESH,		// A cooked mesh, mapped and checked
+	};
+
+	class Payload final : public IAssetPayload
+	{
+	public:
+		std::string name;
+		std::thread::id decodeThread;
+		std::unique_ptr<MappedFile> file;
+		std::unique_ptr<CookedMesh::File> mesh;
+		uint32_t checksum = 0;
+
+		size_t GetSize() const noexcept override { return name.size(); }
+	};
+
+	class Asset final : public IAsset
+	{
+	public:
+		explicit Asset(std::string name) : name(std::move(name)) {}
+
+		std::string name;
+	};
+
+	// Stands in for the GPU: notes which threads decode and create, and in
+	// what order assets are created. Paths naming a failure fail there.
+	class FakeDevice final : public IAssetDevice
+	{
+	public:
+		explicit FakeDevice(std::chrono::microseconds decodeTime) :
+			m_decodeTime(decodeTime),
+			m_deviceThread(std::this_thread::get_id()),
+			m_decodesOnDeviceThread(0),
+			m_createsOffDeviceThread(0)
+		{
+		}
+
+		std::unique_ptr<IAssetPayload> Decode(uint32_t kind, std::filesystem::path const& path) override
+		{
+			auto payload = std::make_unique<Payload>();
+			payload->name = path.generic_string();
+			payload->decodeThread = std::this_thread::get_id();
+			if (payload->decodeThread == m_deviceThread)
+			{
+				m_decodesOnDeviceThread++;
+			}
+
+			switch (kind)
+			{
+			case KIND_FAKE:
+				std::this_thread::sleep_for(m_decodeTime);
+				if (payload->name.find("fail-decode") != std::string::npos)
+					throw std::runtime_error("Decode failed for " + payload->name);
+				break;
+
+			case KIND_FILE:
+				payload->file = std::make_unique<MappedFile>(path);
+				for (size_t i = 0; i < payload->file->GetSize(); i += 4096)
+				{
+					payload->checksum += payload->file->GetData()[i];
+				}
+				break;
+
+			case KIND_MESH:
+				payload->mesh = std::make_unique<CookedMesh::File>(path);
+				break;
+
+			default:
+				throw std::invalid_argument("Unknown asset kind");
+			}
+			return payload;
+		}
+
+		std::unique_ptr<IAsset> Create(uint32_t, IAssetPayload const& base) override
+		{
+			auto const& payload = static_cast<Payload const&>(base);
+			if (std::this_thread::get_id() != m_deviceThread)
+			{
+				m_createsOffDeviceThread++;
+			}
+			if (payload.name.find("fail-create") != std::string::npos)
+				throw std::runtime_error("Create failed for " + payload.name);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_created.push_back(payload.name);
+			return std::make_unique<Asset>(payload.name);
+		}
+
+		std::vector<std::string> GetCreated() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_created;
+		}
+
+		uint32_t GetDecodesOnDeviceThread() const noexcept { return m_decodesOnDeviceThread; }
+		uint32_t GetCreatesOffDeviceThread() const noexcept { return m_createsOffDeviceThread; }
+
+	private:
+		std::chrono::microseconds m_decodeTime;
+		std::thread::id m_deviceThread;
+		std::atomic<uint32_t> m_decodesOnDeviceThread;
+		std::atomic<uint32_t> m_createsOffDeviceThread;
+
+		mutable std::mutex m_mutex;
+		std::vector<std::string> m_created;
+	};
+
+	std::string NameOf(AssetLoader const& loader, uint32_t handle)
+	{
+		auto const asset = loader.Get(handle);
+		return asset ? static_cast<Asset*>(asset)->name : std::string();
+	}
+
+	// A short chain with failures, loaded without workers so every step is
+	// deterministic.
+	void CheckBasics()
+	{
+		std::printf("basics:\n");
+
+		FakeDevice device(std::chrono::microseconds(0));
+		AssetLoader loader(device, 0);
+		loader.SetPlaceholder(KIND_FAKE, std::make_unique<Asset>("placeholder"));
+
+		const uint32_t a = loader.Load(KIND_FAKE, "a");
+		const uint32_t b = loader.Load(KIND_FAKE, "b", { a });
+		const uint32_t c = loader.Load(KIND_FAKE, "c", { a, b });
+		const uint32_t badDecode = loader.Load(KIND_FAKE, "fail-decode");
+		const uint32_t afterBad = loader.Load(KIND_FAKE, "d", { a, badDecode });
+		const uint32_t badCreate = loader.Load(KIND_FAKE, "fail-create");
+		const uint32_t file = loader.Load(KIND_FILE, "missing.dds");
+
+		Tools::Check(loader.Load(KIND_FAKE, "a") == a, "same asset, same handle");
+		Tools::Check(loader.Load(KIND_FILE, "a") != a, "same path of another kind, another handle");
+		Tools::Check(Tools::Throws<std::invalid_argument>([&]() { loader.Load(KIND_FAKE, "e", { 999 }); }), "unknown dependency rejected");
+
+		Tools::Check(loader.GetState(a) == AssetLoader::State::Queued && NameOf(loader, a) == "placeholder", "placeholder before update");
+		Tools::Check(loader.Get(file) == nullptr, "no placeholder for a kind without one");
+
+		Tools::Check(loader.Update(1) == 1, "one creation per update when limited to one");
+		Tools::Check(loader.IsReady(a) && NameOf(loader, a) == "a", "first asset ready");
+		Tools::Check(loader.GetState(b) == AssetLoader::State::Decoded && NameOf(loader, b) == "placeholder", "second asset waits its turn");
+
+		loader.Finish();
+		Tools::Check(loader.IsIdle(), "idle after finish");
+		Tools::Check(loader.IsReady(b) && loader.IsReady(c), "chain ready");
+		Tools::Check(loader.GetState(badDecode) == AssetLoader::State::Failed && !loader.GetError(badDecode).empty(), "decode failure reported");
+		Tools::Check(loader.GetState(afterBad) == AssetLoader::State::Failed
+			&& loader.GetError(afterBad).find("fail-decode") != std::string::npos, "dependent of a failure fails");
+		Tools::Check(loader.GetState(badCreate) == AssetLoader::State::Failed, "create failure reported");
+		Tools::Check(loader.GetState(file) == AssetLoader::State::Failed, "missing file fails");
+		Tools::Check(NameOf(loader, badCreate) == "placeholder", "failed asset keeps its placeholder");
+
+		const std::vector<std::string> order = { "a", "b", "c" };
+		Tools::Check(device.GetCreated() == order, "created in dependency order");
+
+		auto const stats = loader.GetStats();
+		std::printf("  %u requested, %u ready, %u failed; \"%s\"\n", stats.requested, stats.ready, stats.failed, loader.GetError(afterBad).c_str());
+		Tools::Check(stats.requested == 8 && stats.ready == 3 && stats.failed == 5, "stats");
+	}
+
+	// Random assets each depending on a few earlier ones, some failing,
+	// created a few per frame. Returns the time to load them all.
+	double LoadGraph(unsigned workers, uint32_t count, std::chrono::microseconds decodeTime, uint32_t createsPerFrame, bool check)
+	{
+		FakeDevice device(decodeTime);
+		AssetLoader loader(device, workers);
+		loader.SetPlaceholder(KIND_FAKE, std::make_unique<Asset>("placeholder"));
+
+		std::mt19937 random(22);
+		std::vector<std::vector<uint32_t>> dependencies(count);
+		std::vector<bool> shouldFail(count);
+		std::vector<uint32_t> handles(count);
+
+		auto const start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const bool fails = i % 37 == 36;
+			const std::string name = std::to_string(i) + (fails ? (i % 2 ? "-fail-decode" : "-fail-create") : "");
+
+			uint32_t depends[3];
+			const uint32_t dependencyCount = i == 0 ? 0 : std::min<uint32_t>(i, random() % 4);
+			for (uint32_t d = 0; d < dependencyCount; ++d)
+			{
+				depends[d] = handles[random() % i];
+				dependencies[i].push_back(depends[d]);
+			}
+
+			shouldFail[i] = fails;
+			for (auto const dependency : dependencies[i])
+			{
+				shouldFail[i] = shouldFail[i] || shouldFail[dependency];
+			}
+
+			handles[i] = dependencyCount == 0 ? loader.Load(KIND_FAKE, name)
+				: dependencyCount == 1 ? loader.Load(KIND_FAKE, name, { depends[0] })
+				: dependencyCount == 2 ? loader.Load(KIND_FAKE, name, { depends[0], depends[1] })
+				: loader.Load(KIND_FAKE, name, { depends[0], depends[1], depends[2] });
+		}
+
+		uint32_t frames = 0;
+		uint32_t mostPerFrame = 0;
+		while (!loader.IsIdle())
+		{
+			mostPerFrame = std::max(mostPerFrame, loader.Update(createsPerFrame));
+			frames++;
+			if (!loader.IsIdle())
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(500));
+			}
+		}
+		const double seconds = Tools::Seconds(start);
+
+		if (check)
+		{
+			auto const created = device.GetCreated();
+			std::vector<uint32_t> position(count, ~0u);
+			for (uint32_t i = 0; i < created.size(); ++i)
+			{
+				position[std::stoul(created[i])] = i;
+			}
+
+			bool ordered = true;
+			bool failures = true;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				failures = failures && (loader.GetState(handles[i]) == AssetLoader::State::Failed) == shouldFail[i];
+				for (auto const dependency : dependencies[i])
+				{
+					ordered = ordered && (position[i] == ~0u || position[dependency] < position[i]);
+				}
+			}
+
+			std::printf("  %u workers: %u assets in %u frames, at most %u created a frame, %.1f ms\n",
+				workers, count, frames, mostPerFrame, seconds * 1000.0);
+			Tools::Check(ordered, "dependencies created first");
+			Tools::Check(failures, "exactly the failures and their dependents failed");
+			Tools::Check(mostPerFrame <= createsPerFrame, "creations per frame within the limit");
+			Tools::Check(device.GetCreatesOffDeviceThread() == 0, "creation only on the device thread");
+			Tools::Check(workers == 0 || device.GetDecodesOnDeviceThread() == 0, "decoding only on workers");
+		}
+		return seconds;
+	}
+
+	// The game's own files, decoded as the game would before creating them.
+	double LoadFiles(unsigned workers, uint32_t& ready)
+	{
+		FakeDevice device(std::chrono::microseconds(0));
+		AssetLoader loader(device, workers);
+
+		auto const start = std::chrono::steady_clock::now();
+		std::vector<uint32_t> handles;
+		for (auto const& entry : std::filesystem::directory_iterator("Shooter/Assets"))
+		{
+			auto const extension = entry.path().extension();
+			if (extension == ".cmesh")
+			{
+				handles.push_back(loader.Load(KIND_MESH, entry.path()));
+			}
+			else if (extension == ".dds" || extension == ".cmo" || extension == ".png")
+			{
+				handles.push_back(loader.Load(KIND_FILE, entry.path()));
+			}
+		}
+		loader.Finish();
+		const double seconds = Tools::Seconds(start);
+
+		ready = 0;
+		for (auto const handle : handles)
+		{
+			ready += loader.IsReady(handle) ? 1 : 0;
+		}
+		Tools::Check(ready == handles.size(), "every asset file loads");
+		return seconds;
+	}
+}
+
+int RunAssetLoaderCheck(int argc, char** argv)
+{
+	const unsigned workers = static_cast<unsigned>(Tools::GetArgument(argc, argv, 0, std::max(ThreadPool::GetDefaultWorkerCount(), 3u)));
+	const uint32_t count = static_cast<uint32_t>(Tools::GetArgument(argc, argv, 1, 256));
+	const std::chrono::microseconds decodeTime(Tools::GetArgument(argc, argv, 2, 2000));
+	const uint32_t createsPerFrame = 4;
+
+	CheckBasics();
+
+	std::printf("\ndependency graph, %u assets taking %.1f ms each to decode, %u created a frame:\n",
+		count, decodeTime.count() / 1000.0, createsPerFrame);
+	const double serial = LoadGraph(0, count, decodeTime, createsPerFrame, true);
+	const double parallel = LoadGraph(workers, count, decodeTime, createsPerFrame, true);
+	std::printf("  %.2fx faster on %u workers\n", serial / parallel, workers);
+	Tools::Check(workers < 2 || parallel < serial, "workers load faster than the device thread alone");
+
+	// Dropping a loader with work queued doesn't wait for it.
+	{
+		FakeDevice device(decodeTime);
+		auto const start = std::chrono::steady_clock::now();
+		{
+			AssetLoader loader(device, 2);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				loader.Load(KIND_FAKE, std::to_string(i));
+			}
+		}
+		const double seconds = Tools::Seconds(start);
+		std::printf("\ndestroyed with %u queued in %.1f ms\n", count, seconds * 1000.0);
+		Tools::Check(seconds < 0.5 * double(count) * decodeTime.count() * 1e-6, "queued work dropped on destruction");
+	}
+
+	uint32_t files = 0;
+	LoadFiles(workers, files);
+	const double serialFiles = LoadFiles(0, files);
+	const double parallelFiles = LoadFiles(workers, files);
+	std::printf("\nasset files: %u read in %.3f ms on the device thread, %.3f ms on %u workers (warm cache)\n",
+		files, serialFiles * 1000.0, parallelFiles * 1000.0, workers);
+
+	return Tools::Finish("asset loader");
+}
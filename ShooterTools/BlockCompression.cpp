@@ -0,0 +1,1064 @@
+//
+// BlockCompression.cpp
+//
+
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace BlockCompression;
+
+namespace
+{
+	// Errors are squared differences summed over the block's channels.
+	using Error = uint32_t;
+
+	int Clamp(int value, int low, int high) noexcept
+	{
+		return std::min(std::max(value, low), high);
+	}
+
+	int Round(float value) noexcept
+	{
+		return int(std::floor(value + 0.5f));
+	}
+
+	// The direction a covariance matrix varies most along, by power
+	// iteration.
+	template<int Channels>
+	void GetPrincipalAxis(float const (&covariance)[Channels][Channels], float (&axis)[Channels]) noexcept
+	{
+		for (int c = 0; c < Channels; ++c)
+		{
+			axis[c] = 1.0f;
+		}
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[Channels] = {};
+			float length = 0.0f;
+			for (int a = 0; a < Channels; ++a)
+			{
+				for (int b = 0; b < Channels; ++b)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length += next[a] * next[a];
+			}
+			if (length < 1e-12f)
+				break;
+
+			length = 1.0f / std::sqrt(length);
+			for (int c = 0; c < Channels; ++c)
+			{
+				axis[c] = next[c] * length;
+			}
+		}
+	}
+
+	// The mean of the pixels and the direction they vary most along, over
+	// the first channels of each.
+	template<int Channels>
+	void FitLine(const uint8_t (&pixels)[64], const uint8_t* selected, int count, float (&mean)[Channels], float (&axis)[Channels]) noexcept
+	{
+		for (int c = 0; c < Channels; ++c)
+		{
+			mean[c] = 0.0f;
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			for (int c = 0; c < Channels; ++c)
+			{
+				mean[c] += pixels[selected[i] * 4 + c];
+			}
+		}
+		for (int c = 0; c < Channels; ++c)
+		{
+			mean[c] /= float(count);
+		}
+
+		float covariance[Channels][Channels] = {};
+		for (int i = 0; i < count; ++i)
+		{
+			float d[Channels];
+			for (int c = 0; c < Channels; ++c)
+			{
+				d[c] = pixels[selected[i] * 4 + c] - mean[c];
+			}
+			for (int a = 0; a < Channels; ++a)
+			{
+				for (int b = 0; b < Channels; ++b)
+				{
+					covariance[a][b] += d[a] * d[b];
+				}
+			}
+		}
+
+		GetPrincipalAxis(covariance, axis);
+	}
+
+	// The two ends of the pixels' spread along the axis.
+	template<int Channels>
+	void GetExtremes(const uint8_t (&pixels)[64], const uint8_t* selected, int count, float const (&mean)[Channels], float const (&axis)[Channels],
+		float (&low)[Channels], float (&high)[Channels]) noexcept
+	{
+		float minimum = std::numeric_limits<float>::max();
+		float maximum = -std::numeric_limits<float>::max();
+		for (int i = 0; i < count; ++i)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < Channels; ++c)
+			{
+				t += (pixels[selected[i] * 4 + c] - mean[c]) * axis[c];
+			}
+			minimum = std::min(minimum, t);
+			maximum = std::max(maximum, t);
+		}
+
+		for (int c = 0; c < Channels; ++c)
+		{
+			low[c] = mean[c] + axis[c] * minimum;
+			high[c] = mean[c] + axis[c] * maximum;
+		}
+	}
+
+	// Endpoints minimizing the squared error for fixed interpolation
+	// weights, weight[i] being how much of the second endpoint pixel i gets.
+	// Returns false when the weights don't pin the endpoints down.
+	template<int Channels>
+	bool SolveEndpoints(const uint8_t (&pixels)[64], const uint8_t* selected, int count, const float* weight,
+		float (&first)[Channels], float (&second)[Channels]) noexcept
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[Channels] = {};
+		float bx[Channels] = {};
+		for (int i = 0; i < count; ++i)
+		{
+			const float b = weight[i];
+			const float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < Channels; ++c)
+			{
+				ax[c] += a * pixels[selected[i] * 4 + c];
+				bx[c] += b * pixels[selected[i] * 4 + c];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+
+		for (int c = 0; c < Channels; ++c)
+		{
+			first[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / determinant, 0.0f), 255.0f);
+			second[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / determinant, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	const uint8_t c_allPixels[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+	//
+	// BC1 color blocks
+	//
+
+	int Expand5(int value) noexcept { return (value << 3) | (value >> 2); }
+	int Expand6(int value) noexcept { return (value << 2) | (value >> 4); }
+
+	uint16_t Pack565(int r, int g, int b) noexcept
+	{
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	void Unpack565(uint16_t color, int (&rgb)[3]) noexcept
+	{
+		rgb[0] = Expand5(color >> 11);
+		rgb[1] = Expand6((color >> 5) & 0x3F);
+		rgb[2] = Expand5(color & 0x1F);
+	}
+
+	uint16_t Quantize565(float const (&rgb)[3]) noexcept
+	{
+		return Pack565(Clamp(Round(rgb[0] * 31.0f / 255.0f), 0, 31), Clamp(Round(rgb[1] * 63.0f / 255.0f), 0, 63),
+			Clamp(Round(rgb[2] * 31.0f / 255.0f), 0, 31));
+	}
+
+	// The four colors a block in four-color mode decodes to.
+	void GetPalette(uint16_t color0, uint16_t color1, int (&palette)[4][3]) noexcept
+	{
+		Unpack565(color0, palette[0]);
+		Unpack565(color1, palette[1]);
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+	}
+
+	Error AssignColorIndices(const uint8_t (&pixels)[64], int const (&palette)[4][3], uint8_t (&indices)[16]) noexcept
+	{
+		Error total = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			Error best = std::numeric_limits<Error>::max();
+			for (uint8_t entry = 0; entry < 4; ++entry)
+			{
+				Error error = 0;
+				for (int c = 0; c < 3; ++c)
+				{
+					const int d = pixels[i * 4 + c] - palette[entry][c];
+					error += Error(d * d);
+				}
+				if (error < best)
+				{
+					best = error;
+					indices[i] = entry;
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	// For each 8-bit value, the 5 or 6-bit endpoints whose two-thirds point
+	// decodes closest to it.
+	struct SingleColorTable
+	{
+		uint8_t endpoints[256][2];
+
+		explicit SingleColorTable(int bits) noexcept
+		{
+			const int levels = 1 << bits;
+			for (int value = 0; value < 256; ++value)
+			{
+				int best = std::numeric_limits<int>::max();
+				for (int a = 0; a < levels; ++a)
+				{
+					for (int b = 0; b < levels; ++b)
+					{
+						const int ea = bits == 5 ? Expand5(a) : Expand6(a);
+						const int eb = bits == 5 ? Expand5(b) : Expand6(b);
+						const int error = std::abs((2 * ea + eb) / 3 - value);
+						if (error < best)
+						{
+							best = error;
+							endpoints[value][0] = uint8_t(a);
+							endpoints[value][1] = uint8_t(b);
+						}
+					}
+				}
+			}
+		}
+	};
+
+	void WriteColorBlock(uint16_t color0, uint16_t color1, uint8_t const (&indices)[16], uint8_t* block) noexcept
+	{
+		uint8_t remap[4] = { 0, 1, 2, 3 };
+
+		// Four-color mode needs the first endpoint to be the greater; the same
+		// colors come out with the endpoints and the indices swapped. Equal
+		// endpoints would read as three-color mode, where they only decode
+		// right through index 0.
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+			remap[0] = 1; remap[1] = 0; remap[2] = 3; remap[3] = 2;
+		}
+		else if (color0 == color1)
+		{
+			remap[1] = remap[2] = remap[3] = 0;
+		}
+
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			bits |= uint32_t(remap[indices[i]]) << (i * 2);
+		}
+
+		block[0] = uint8_t(color0);
+		block[1] = uint8_t(color0 >> 8);
+		block[2] = uint8_t(color1);
+		block[3] = uint8_t(color1 >> 8);
+		std::memcpy(block + 4, &bits, 4);
+	}
+
+	void EncodeColorBlock(const uint8_t (&pixels)[64], uint8_t* block) noexcept
+	{
+		bool solid = true;
+		for (int i = 1; i < 16 && solid; ++i)
+		{
+			solid = std::memcmp(pixels, pixels + i * 4, 3) == 0;
+		}
+
+		uint8_t indices[16];
+		if (solid)
+		{
+			static const SingleColorTable table5(5);
+			static const SingleColorTable table6(6);
+
+			const uint16_t color0 = Pack565(table5.endpoints[pixels[0]][0], table6.endpoints[pixels[1]][0], table5.endpoints[pixels[2]][0]);
+			const uint16_t color1 = Pack565(table5.endpoints[pixels[0]][1], table6.endpoints[pixels[1]][1], table5.endpoints[pixels[2]][1]);
+			std::fill(std::begin(indices), std::end(indices), uint8_t(2));
+			WriteColorBlock(color0, color1, indices, block);
+			return;
+		}
+
+		float mean[3], axis[3], low[3], high[3];
+		FitLine(pixels, c_allPixels, 16, mean, axis);
+		GetExtremes(pixels, c_allPixels, 16, mean, axis, low, high);
+
+		uint16_t bestColors[2] = {};
+		uint8_t bestIndices[16] = {};
+		Error bestError = std::numeric_limits<Error>::max();
+
+		// Each pass quantizes the endpoints and picks indices for them, then
+		// fits new endpoints to those indices.
+		static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		for (int pass = 0; pass < 3; ++pass)
+		{
+			const uint16_t color0 = Quantize565(high);
+			const uint16_t color1 = Quantize565(low);
+
+			int palette[4][3];
+			GetPalette(color0, color1, palette);
+			const Error error = AssignColorIndices(pixels, palette, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				bestColors[0] = color0;
+				bestColors[1] = color1;
+				std::memcpy(bestIndices, indices, sizeof(indices));
+			}
+			if (error == 0)
+				break;
+
+			float weight[16];
+			for (int i = 0; i < 16; ++i)
+			{
+				weight[i] = weights[indices[i]];
+			}
+			if (!SolveEndpoints(pixels, c_allPixels, 16, weight, high, low))
+				break;
+		}
+
+		WriteColorBlock(bestColors[0], bestColors[1], bestIndices, block);
+	}
+
+	void DecodeColorBlock(const uint8_t* block, bool alwaysFourColors, uint8_t (&pixels)[64]) noexcept
+	{
+		const uint16_t color0 = uint16_t(block[0] | (block[1] << 8));
+		const uint16_t color1 = uint16_t(block[2] | (block[3] << 8));
+
+		int palette[4][3];
+		int alpha[4] = { 255, 255, 255, 255 };
+		if (alwaysFourColors || color0 > color1)
+		{
+			GetPalette(color0, color1, palette);
+		}
+		else
+		{
+			Unpack565(color0, palette[0]);
+			Unpack565(color1, palette[1]);
+			for (int c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+			alpha[3] = 0;
+		}
+
+		uint32_t bits;
+		std::memcpy(&bits, block + 4, 4);
+		for (int i = 0; i < 16; ++i)
+		{
+			const uint32_t index = (bits >> (i * 2)) & 3;
+			for (int c = 0; c < 3; ++c)
+			{
+				pixels[i * 4 + c] = uint8_t(palette[index][c]);
+			}
+			pixels[i * 4 + 3] = uint8_t(alpha[index]);
+		}
+	}
+
+	//
+	// BC3 alpha blocks
+	//
+
+	void GetAlphaPalette(int alpha0, int alpha1, int (&palette)[8]) noexcept
+	{
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		if (alpha0 > alpha1)
+		{
+			for (int i = 1; i < 7; ++i)
+			{
+				palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+			}
+		}
+		else
+		{
+			for (int i = 1; i < 5; ++i)
+			{
+				palette[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	// Spans the block's alpha range with the eight-value mode; a single
+	// value is exact through index 0.
+	void EncodeAlphaBlock(const uint8_t (&pixels)[64], uint8_t* block) noexcept
+	{
+		int minimum = 255;
+		int maximum = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			minimum = std::min(minimum, int(pixels[i * 4 + 3]));
+			maximum = std::max(maximum, int(pixels[i * 4 + 3]));
+		}
+
+		int palette[8];
+		GetAlphaPalette(maximum, minimum, palette);
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			uint64_t best = 0;
+			int bestError = std::numeric_limits<int>::max();
+			for (int entry = 0; entry < (maximum > minimum ? 8 : 1); ++entry)
+			{
+				const int error = std::abs(palette[entry] - pixels[i * 4 + 3]);
+				if (error < bestError)
+				{
+					bestError = error;
+					best = uint64_t(entry);
+				}
+			}
+			bits |= best << (i * 3);
+		}
+
+		block[0] = uint8_t(maximum);
+		block[1] = uint8_t(minimum);
+		for (int i = 0; i < 6; ++i)
+		{
+			block[2 + i] = uint8_t(bits >> (i * 8));
+		}
+	}
+
+	void DecodeAlphaBlock(const uint8_t* block, uint8_t (&pixels)[64]) noexcept
+	{
+		int palette[8];
+		GetAlphaPalette(block[0], block[1], palette);
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+		{
+			bits |= uint64_t(block[2 + i]) << (i * 8);
+		}
+		for (int i = 0; i < 16; ++i)
+		{
+			pixels[i * 4 + 3] = uint8_t(palette[(bits >> (i * 3)) & 7]);
+		}
+	}
+
+	//
+	// BC7
+	//
+
+	const int c_weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const int c_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	int Interpolate(int e0, int e1, int weight) noexcept
+	{
+		return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+	}
+
+	// Subset of each pixel for the 64 two-subset partitions.
+	const uint8_t c_partitions2[64][16] =
+	{
+		{ 0,0,1,1,0,0,1,1,0,0,1,1,0,0,1,1 }, { 0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,1 }, { 0,1,1,1,0,1,1,1,0,1,1,1,0,1,1,1 }, { 0,0,0,1,0,0,1,1,0,0,1,1,0,1,1,1 },
+		{ 0,0,0,0,0,0,0,1,0,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,1,0,1,1,1,1,1,1,1 }, { 0,0,0,1,0,0,1,1,0,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,1,0,0,1,1,0,1,1,1 },
+		{ 0,0,0,0,0,0,0,0,0,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,1,0,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,0,0,0,1,0,1,1,1 },
+		{ 0,0,0,1,0,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1 }, { 0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1 },
+		{ 0,0,0,0,1,0,0,0,1,1,1,0,1,1,1,1 }, { 0,1,1,1,0,0,0,1,0,0,0,0,0,0,0,0 }, { 0,0,0,0,0,0,0,0,1,0,0,0,1,1,1,0 }, { 0,1,1,1,0,0,1,1,0,0,0,1,0,0,0,0 },
+		{ 0,0,1,1,0,0,0,1,0,0,0,0,0,0,0,0 }, { 0,0,0,0,1,0,0,0,1,1,0,0,1,1,1,0 }, { 0,0,0,0,0,0,0,0,1,0,0,0,1,1,0,0 }, { 0,1,1,1,0,0,1,1,0,0,1,1,0,0,0,1 },
+		{ 0,0,1,1,0,0,0,1,0,0,0,1,0,0,0,0 }, { 0,0,0,0,1,0,0,0,1,0,0,0,1,1,0,0 }, { 0,1,1,0,0,1,1,0,0,1,1,0,0,1,1,0 }, { 0,0,1,1,0,1,1,0,0,1,1,0,1,1,0,0 },
+		{ 0,0,0,1,0,1,1,1,1,1,1,0,1,0,0,0 }, { 0,0,0,0,1,1,1,1,1,1,1,1,0,0,0,0 }, { 0,1,1,1,0,0,0,1,1,0,0,0,1,1,1,0 }, { 0,0,1,1,1,0,0,1,1,0,0,1,1,1,0,0 },
+		{ 0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1 }, { 0,0,0,0,1,1,1,1,0,0,0,0,1,1,1,1 }, { 0,1,0,1,1,0,1,0,0,1,0,1,1,0,1,0 }, { 0,0,1,1,0,0,1,1,1,1,0,0,1,1,0,0 },
+		{ 0,0,1,1,1,1,0,0,0,0,1,1,1,1,0,0 }, { 0,1,0,1,0,1,0,1,1,0,1,0,1,0,1,0 }, { 0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1 }, { 0,1,0,1,1,0,1,0,1,0,1,0,0,1,0,1 },
+		{ 0,1,1,1,0,0,1,1,1,1,0,0,1,1,1,0 }, { 0,0,0,1,0,0,1,1,1,1,0,0,1,0,0,0 }, { 0,0,1,1,0,0,1,0,0,1,0,0,1,1,0,0 }, { 0,0,1,1,1,0,1,1,1,1,0,1,1,1,0,0 },
+		{ 0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0 }, { 0,0,1,1,1,1,0,0,1,1,0,0,0,0,1,1 }, { 0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1 }, { 0,0,0,0,0,1,1,0,0,1,1,0,0,0,0,0 },
+		{ 0,1,0,0,1,1,1,0,0,1,0,0,0,0,0,0 }, { 0,0,1,0,0,1,1,1,0,0,1,0,0,0,0,0 }, { 0,0,0,0,0,0,1,0,0,1,1,1,0,0,1,0 }, { 0,0,0,0,0,1,0,0,1,1,1,0,0,1,0,0 },
+		{ 0,1,1,0,1,1,0,0,1,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,0,1,1,0,0,1,0,0,1 }, { 0,1,1,0,0,0,1,1,1,0,0,1,1,1,0,0 }, { 0,0,1,1,1,0,0,1,1,1,0,0,0,1,1,0 },
+		{ 0,1,1,0,1,1,0,0,1,1,0,0,1,0,0,1 }, { 0,1,1,0,0,0,1,1,0,0,1,1,1,0,0,1 }, { 0,1,1,1,1,1,1,0,1,0,0,0,0,0,0,1 }, { 0,0,0,1,1,0,0,0,1,1,1,0,0,1,1,1 },
+		{ 0,0,0,0,1,1,1,1,0,0,1,1,0,0,1,1 }, { 0,0,1,1,0,0,1,1,1,1,1,1,0,0,0,0 }, { 0,0,1,0,0,0,1,0,1,1,1,0,1,1,1,0 }, { 0,1,0,0,0,1,0,0,0,1,1,1,0,1,1,1 },
+	};
+
+	// The pixel of the second subset whose index drops its top bit.
+	const uint8_t c_anchors2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+		15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+		 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+	};
+
+	// Bits go in least significant first, from the first byte.
+	class BlockWriter
+	{
+	public:
+		explicit BlockWriter(uint8_t* block) noexcept : m_block(block), m_position(0)
+		{
+			std::memset(block, 0, 16);
+		}
+
+		void Put(uint32_t value, int count) noexcept
+		{
+			for (int i = 0; i < count; ++i, ++m_position)
+			{
+				m_block[m_position >> 3] |= uint8_t(((value >> i) & 1) << (m_position & 7));
+			}
+		}
+
+	private:
+		uint8_t* m_block;
+		int m_position;
+	};
+
+	class BlockReader
+	{
+	public:
+		explicit BlockReader(const uint8_t* block) noexcept : m_block(block), m_position(0) {}
+
+		uint32_t Get(int count) noexcept
+		{
+			uint32_t value = 0;
+			for (int i = 0; i < count; ++i, ++m_position)
+			{
+				value |= uint32_t((m_block[m_position >> 3] >> (m_position & 7)) & 1) << i;
+			}
+			return value;
+		}
+
+	private:
+		const uint8_t* m_block;
+		int m_position;
+	};
+
+	// Mode 6 stores 7-bit endpoint channels with a p-bit each endpoint
+	// shares as its low bit; mode 1 stores 6-bit ones with a p-bit the
+	// subset shares, and the 7 bits are widened to 8 by repeating the top.
+	int ExpandMode6(int value, int pBit) noexcept { return (value << 1) | pBit; }
+	int ExpandMode1(int value, int pBit) noexcept
+	{
+		const int wide = (value << 1) | pBit;
+		return (wide << 1) | (wide >> 6);
+	}
+
+	// The stored value that expands closest to each 8-bit value, per p-bit.
+	struct EndpointTable
+	{
+		uint8_t values[2][256];
+
+		explicit EndpointTable(int (*expand)(int, int), int levels) noexcept
+		{
+			for (int pBit = 0; pBit < 2; ++pBit)
+			{
+				for (int target = 0; target < 256; ++target)
+				{
+					int best = std::numeric_limits<int>::max();
+					for (int value = 0; value < levels; ++value)
+					{
+						const int error = std::abs(expand(value, pBit) - target);
+						if (error < best)
+						{
+							best = error;
+							values[pBit][target] = uint8_t(value);
+						}
+					}
+				}
+			}
+		}
+	};
+
+	struct Bc7Subset
+	{
+		int stored[2][4];		// Endpoint channels as written
+		int expanded[2][4];		// And as the decoder sees them
+		int pBits[2];
+	};
+
+	template<int Channels>
+	Error AssignBc7Indices(const uint8_t (&pixels)[64], const uint8_t* selected, int count, int const (&expanded)[2][4],
+		const int* weights, int weightCount, uint8_t* indices) noexcept
+	{
+		int palette[16][4];
+		for (int entry = 0; entry < weightCount; ++entry)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				palette[entry][c] = Interpolate(expanded[0][c], expanded[1][c], weights[entry]);
+			}
+		}
+
+		// The palette runs along a line, so projecting onto it finds the
+		// nearest entry give or take one, and only those are compared.
+		int direction[Channels];
+		int lengthSquared = 0;
+		for (int c = 0; c < Channels; ++c)
+		{
+			direction[c] = expanded[1][c] - expanded[0][c];
+			lengthSquared += direction[c] * direction[c];
+		}
+		const float scale = lengthSquared > 0 ? float(weightCount - 1) / float(lengthSquared) : 0.0f;
+
+		Error total = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			int projection = 0;
+			for (int c = 0; c < Channels; ++c)
+			{
+				projection += (pixels[selected[i] * 4 + c] - expanded[0][c]) * direction[c];
+			}
+			const int nearest = Clamp(Round(projection * scale), 0, weightCount - 1);
+
+			Error best = std::numeric_limits<Error>::max();
+			for (int entry = std::max(nearest - 1, 0); entry <= std::min(nearest + 1, weightCount - 1); ++entry)
+			{
+				Error error = 0;
+				for (int c = 0; c < Channels; ++c)
+				{
+					const int d = pixels[selected[i] * 4 + c] - palette[entry][c];
+					error += Error(d * d);
+				}
+				if (error < best)
+				{
+					best = error;
+					indices[i] = uint8_t(entry);
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	// Fits one subset's endpoints: along its principal axis first, then by
+	// least squares on the indices that gave, keeping whichever quantizes
+	// to the smaller error. Channels past the fitted ones are left at 255.
+	template<int Channels>
+	Error FitBc7Subset(const uint8_t (&pixels)[64], const uint8_t* selected, int count, bool sharedPBit,
+		const int* weights, int weightCount, Bc7Subset& best, uint8_t* bestIndices) noexcept
+	{
+		static const EndpointTable mode6Table(ExpandMode6, 128);
+		static const EndpointTable mode1Table(ExpandMode1, 64);
+		EndpointTable const& table = sharedPBit ? mode1Table : mode6Table;
+		const auto expand = sharedPBit ? ExpandMode1 : ExpandMode6;
+
+		float mean[Channels], axis[Channels];
+		float ends[2][Channels];
+		FitLine<Channels>(pixels, selected, count, mean, axis);
+		GetExtremes<Channels>(pixels, selected, count, mean, axis, ends[0], ends[1]);
+
+		Error bestError = std::numeric_limits<Error>::max();
+		uint8_t indices[16];
+
+		for (int pass = 0; pass < 3; ++pass)
+		{
+			int target[2][Channels];
+			for (int e = 0; e < 2; ++e)
+			{
+				for (int c = 0; c < Channels; ++c)
+				{
+					target[e][c] = Clamp(Round(ends[e][c]), 0, 255);
+				}
+			}
+
+			// Every p-bit choice: one per endpoint, or one for both.
+			for (int choice = 0; choice < (sharedPBit ? 2 : 4); ++choice)
+			{
+				Bc7Subset subset = {};
+				subset.pBits[0] = sharedPBit ? choice : choice & 1;
+				subset.pBits[1] = sharedPBit ? choice : choice >> 1;
+				for (int e = 0; e < 2; ++e)
+				{
+					for (int c = 0; c < 4; ++c)
+					{
+						if (c < Channels)
+						{
+							subset.stored[e][c] = table.values[subset.pBits[e]][target[e][c]];
+							subset.expanded[e][c] = expand(subset.stored[e][c], subset.pBits[e]);
+						}
+						else
+						{
+							subset.expanded[e][c] = 255;
+						}
+					}
+				}
+
+				const Error error = AssignBc7Indices<Channels>(pixels, selected, count, subset.expanded, weights, weightCount, indices);
+				if (error < bestError)
+				{
+					bestError = error;
+					best = subset;
+					std::memcpy(bestIndices, indices, size_t(count));
+				}
+			}
+			if (bestError == 0)
+				break;
+
+			float weight[16];
+			for (int i = 0; i < count; ++i)
+			{
+				weight[i] = weights[bestIndices[i]] / 64.0f;
+			}
+			if (!SolveEndpoints<Channels>(pixels, selected, count, weight, ends[0], ends[1]))
+				break;
+		}
+		return bestError;
+	}
+
+	// Swaps a subset's endpoints and mirrors its indices, which decodes to
+	// the same colors, when its anchor pixel's index has the top bit set.
+	void FixAnchor(Bc7Subset& subset, uint8_t* indices, int count, int anchor, int indexBits) noexcept
+	{
+		const int top = 1 << (indexBits - 1);
+		if (indices[anchor] < top)
+			return;
+
+		std::swap(subset.stored[0], subset.stored[1]);
+		std::swap(subset.expanded[0], subset.expanded[1]);
+		std::swap(subset.pBits[0], subset.pBits[1]);
+		for (int i = 0; i < count; ++i)
+		{
+			indices[i] = uint8_t((1 << indexBits) - 1 - indices[i]);
+		}
+	}
+
+	Error EncodeMode6(const uint8_t (&pixels)[64], uint8_t* block) noexcept
+	{
+		Bc7Subset subset;
+		uint8_t indices[16];
+		const Error error = FitBc7Subset<4>(pixels, c_allPixels, 16, false, c_weights4, 16, subset, indices);
+		FixAnchor(subset, indices, 16, 0, 4);
+
+		BlockWriter writer(block);
+		writer.Put(1 << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			writer.Put(uint32_t(subset.stored[0][c]), 7);
+			writer.Put(uint32_t(subset.stored[1][c]), 7);
+		}
+		writer.Put(uint32_t(subset.pBits[0]), 1);
+		writer.Put(uint32_t(subset.pBits[1]), 1);
+		for (int i = 0; i < 16; ++i)
+		{
+			writer.Put(indices[i], i == 0 ? 3 : 4);
+		}
+		return error;
+	}
+
+	// Sums of a subset's colors and of their pairwise products, from which
+	// its covariance follows without another pass over the pixels.
+	struct Moments
+	{
+		int count;
+		int sum[3];
+		int products[3][3];
+	};
+
+	// The squared distance of a subset's colors from their best fitting
+	// line, what the subset would cost with unlimited index precision: all
+	// of their variance but the part along the principal axis.
+	float EstimateLineError(Moments const& moments) noexcept
+	{
+		if (moments.count == 0)
+			return 0.0f;
+
+		float covariance[3][3];
+		float total = 0.0f;
+		for (int a = 0; a < 3; ++a)
+		{
+			for (int b = 0; b < 3; ++b)
+			{
+				covariance[a][b] = moments.products[a][b] - float(moments.sum[a]) * float(moments.sum[b]) / float(moments.count);
+			}
+			total += covariance[a][a];
+		}
+
+		float axis[3];
+		GetPrincipalAxis(covariance, axis);
+
+		float along = 0.0f;
+		for (int a = 0; a < 3; ++a)
+		{
+			for (int b = 0; b < 3; ++b)
+			{
+				along += axis[a] * covariance[a][b] * axis[b];
+			}
+		}
+		return total - along;
+	}
+
+	void Accumulate(Moments& moments, Moments const& other, int sign) noexcept
+	{
+		moments.count += sign * other.count;
+		for (int a = 0; a < 3; ++a)
+		{
+			moments.sum[a] += sign * other.sum[a];
+			for (int b = 0; b < 3; ++b)
+			{
+				moments.products[a][b] += sign * other.products[a][b];
+			}
+		}
+	}
+
+	// Tries the partitions whose subsets lie closest to lines.
+	Error EncodeMode1(const uint8_t (&pixels)[64], uint8_t* block) noexcept
+	{
+		constexpr int Candidates = 4;
+
+		// Each partition's second subset is the block less its first.
+		Moments pixelMoments[16];
+		Moments whole = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			Moments& moments = pixelMoments[i];
+			moments.count = 1;
+			for (int a = 0; a < 3; ++a)
+			{
+				moments.sum[a] = pixels[i * 4 + a];
+				for (int b = 0; b < 3; ++b)
+				{
+					moments.products[a][b] = pixels[i * 4 + a] * pixels[i * 4 + b];
+				}
+			}
+			Accumulate(whole, moments, 1);
+		}
+
+		std::array<std::pair<float, int>, 64> estimates;
+		for (int partition = 0; partition < 64; ++partition)
+		{
+			Moments first = {};
+			for (int i = 0; i < 16; ++i)
+			{
+				if (c_partitions2[partition][i] == 0)
+				{
+					Accumulate(first, pixelMoments[i], 1);
+				}
+			}
+
+			Moments second = whole;
+			Accumulate(second, first, -1);
+			estimates[partition] = { EstimateLineError(first) + EstimateLineError(second), partition };
+		}
+		std::partial_sort(estimates.begin(), estimates.begin() + Candidates, estimates.end());
+
+		Error bestError = std::numeric_limits<Error>::max();
+		for (int candidate = 0; candidate < Candidates; ++candidate)
+		{
+			const int partition = estimates[candidate].second;
+
+			Bc7Subset subsets[2];
+			uint8_t indices[16];
+			Error error = 0;
+			for (int s = 0; s < 2; ++s)
+			{
+				uint8_t selected[16];
+				int count = 0;
+				for (uint8_t i = 0; i < 16; ++i)
+				{
+					if (c_partitions2[partition][i] == s)
+					{
+						selected[count++] = i;
+					}
+				}
+
+				uint8_t subsetIndices[16];
+				error += FitBc7Subset<3>(pixels, selected, count, true, c_weights3, 8, subsets[s], subsetIndices);
+
+				const int anchor = s == 0 ? 0 : c_anchors2[partition];
+				int anchorPosition = 0;
+				for (int i = 0; i < count; ++i)
+				{
+					anchorPosition = selected[i] == anchor ? i : anchorPosition;
+				}
+				FixAnchor(subsets[s], subsetIndices, count, anchorPosition, 3);
+
+				for (int i = 0; i < count; ++i)
+				{
+					indices[selected[i]] = subsetIndices[i];
+				}
+			}
+
+			if (error >= bestError)
+				continue;
+			bestError = error;
+
+			BlockWriter writer(block);
+			writer.Put(1 << 1, 2);
+			writer.Put(uint32_t(partition), 6);
+			for (int c = 0; c < 3; ++c)
+			{
+				for (int s = 0; s < 2; ++s)
+				{
+					writer.Put(uint32_t(subsets[s].stored[0][c]), 6);
+					writer.Put(uint32_t(subsets[s].stored[1][c]), 6);
+				}
+			}
+			writer.Put(uint32_t(subsets[0].pBits[0]), 1);
+			writer.Put(uint32_t(subsets[1].pBits[0]), 1);
+			for (int i = 0; i < 16; ++i)
+			{
+				writer.Put(indices[i], i == 0 || i == c_anchors2[partition] ? 2 : 3);
+			}
+		}
+		return bestError;
+	}
+
+	void EncodeBc7(const uint8_t (&pixels)[64], uint8_t* block) noexcept
+	{
+		const Error error = EncodeMode6(pixels, block);
+
+		bool opaque = true;
+		for (int i = 0; i < 16; ++i)
+		{
+			opaque = opaque && pixels[i * 4 + 3] == 255;
+		}
+		if (!opaque || error == 0)
+			return;
+
+		uint8_t mode1[16];
+		if (EncodeMode1(pixels, mode1) < error)
+		{
+			std::memcpy(block, mode1, sizeof(mode1));
+		}
+	}
+
+	void DecodeBc7(const uint8_t* block, uint8_t (&pixels)[64]) noexcept
+	{
+		BlockReader reader(block);
+
+		if (block[0] & 0x40 && !(block[0] & 0x3F))
+		{
+			reader.Get(7);
+			int endpoints[2][4];
+			for (int c = 0; c < 4; ++c)
+			{
+				endpoints[0][c] = int(reader.Get(7));
+				endpoints[1][c] = int(reader.Get(7));
+			}
+			const int pBits[2] = { int(reader.Get(1)), int(reader.Get(1)) };
+			for (int e = 0; e < 2; ++e)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					endpoints[e][c] = ExpandMode6(endpoints[e][c], pBits[e]);
+				}
+			}
+
+			for (int i = 0; i < 16; ++i)
+			{
+				const int weight = c_weights4[reader.Get(i == 0 ? 3 : 4)];
+				for (int c = 0; c < 4; ++c)
+				{
+					pixels[i * 4 + c] = uint8_t(Interpolate(endpoints[0][c], endpoints[1][c], weight));
+				}
+			}
+		}
+		else if ((block[0] & 3) == 2)
+		{
+			reader.Get(2);
+			const uint32_t partition = reader.Get(6);
+			int endpoints[4][3];
+			for (int c = 0; c < 3; ++c)
+			{
+				for (int e = 0; e < 4; ++e)
+				{
+					endpoints[e][c] = int(reader.Get(6));
+				}
+			}
+			const int pBits[2] = { int(reader.Get(1)), int(reader.Get(1)) };
+			for (int e = 0; e < 4; ++e)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					endpoints[e][c] = ExpandMode1(endpoints[e][c], pBits[e / 2]);
+				}
+			}
+
+			for (int i = 0; i < 16; ++i)
+			{
+				const int subset = c_partitions2[partition][i];
+				const int weight = c_weights3[reader.Get(i == 0 || i == c_anchors2[partition] ? 2 : 3)];
+				for (int c = 0; c < 3; ++c)
+				{
+					pixels[i * 4 + c] = uint8_t(Interpolate(endpoints[subset * 2][c], endpoints[subset * 2 + 1][c], weight));
+				}
+				pixels[i * 4 + 3] = 255;
+			}
+		}
+		else
+		{
+			std::memset(pixels, 0, sizeof(pixels));
+		}
+	}
+}
+
+const char* BlockCompression::GetName(Format format) noexcept
+{
+	switch (format)
+	{
+	case Format::BC1: return "BC1";
+	case Format::BC3: return "BC3";
+	default: return "BC7";
+	}
+}
+
+size_t BlockCompression::GetBlockBytes(Format format) noexcept
+{
+	return format == Format::BC1 ? 8 : 16;
+}
+
+void BlockCompression::Encode(Format format, const uint8_t (&pixels)[64], uint8_t* block) noexcept
+{
+	switch (format)
+	{
+	case Format::BC1:
+		EncodeColorBlock(pixels, block);
+		break;
+
+	case Format::BC3:
+		EncodeAlphaBlock(pixels, block);
+		EncodeColorBlock(pixels, block + 8);
+		break;
+
+	case Format::BC7:
+		EncodeBc7(pixels, block);
+		break;
+	}
+}
+
+void BlockCompression::Decode(Format format, const uint8_t* block, uint8_t (&pixels)[64]) noexcept
+{
+	switch (format)
+	{
+	case Format::BC1:
+		DecodeColorBlock(block, false, pixels);
+		break;
+
+	case Format::BC3:
+		DecodeColorBlock(block + 8, true, pixels);
+		DecodeAlphaBlock(block, pixels);
+		break;
+
+	case Format::BC7:
+		DecodeBc7(block, pixels);
+		break;
+	}
+}
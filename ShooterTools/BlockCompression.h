@@ -0,0 +1,45 @@
+//
+// BlockCompression.h - BC1, BC3 and BC7 encoding of 4x4 pixel blocks for the texture cooker
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Encoders for the block compressed formats the texture cooker writes, and
+// decoders to measure what they lost. A block is 16 RGBA8 pixels, rows top
+// to bottom; edge blocks of images that aren't a multiple of 4 wide or
+// high are padded by the caller.
+//
+// - BC1: 4 bits per pixel, opaque RGB. Endpoints are fitted along the
+//   colors' principal axis, then refined by least squares on the chosen
+//   indices; single colors come from tables of the best endpoint pairs.
+// - BC3: 8 bits per pixel, BC1's color block and an alpha block spanning
+//   the block's alpha range.
+// - BC7: 8 bits per pixel, RGBA. Opaque blocks try mode 6 (one line
+//   through RGBA, 4-bit indices) and mode 1 (two subsets over the most
+//   promising partitions, 3-bit indices); blocks with alpha use mode 6.
+//   The decoder handles those two modes only.
+//
+// Errors are measured unweighted in the stored values, so for sRGB
+// textures in the sRGB encoding, as PSNR is reported. Everything is
+// deterministic and the functions share no state, so blocks can be
+// encoded from any number of threads.
+namespace BlockCompression
+{
+	enum class Format : uint32_t
+	{
+		BC1,
+		BC3,
+		BC7,
+	};
+
+	const char* GetName(Format format) noexcept;
+
+	// 8 bytes for BC1, 16 for the others.
+	size_t GetBlockBytes(Format format) noexcept;
+
+	void Encode(Format format, const uint8_t (&pixels)[64], uint8_t* block) noexcept;
+	void Decode(Format format, const uint8_t* block, uint8_t (&pixels)[64]) noexcept;
+}
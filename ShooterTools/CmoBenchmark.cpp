@@ -0,0 +1,185 @@
+//
+// CmoBenchmark.cpp - Compares parsing CMO models in place against reading and copying them out
+//
+
+#include "Tools.h"
+
+#include "../Shooter/CmoReader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// What Model::CreateFromCMO does before creating anything: read the
+	// whole file, then copy every name, material, buffer and bone out of it
+	// into containers of their own.
+	struct CopiedMesh
+	{
+		std::u16string name;
+		std::vector<std::u16string> materialNames;
+		std::vector<Cmo::MaterialConstants> materials;
+		std::vector<Cmo::SubMesh> submeshes;
+		std::vector<std::vector<uint16_t>> indexBuffers;
+		std::vector<std::vector<Cmo::Vertex>> vertexBuffers;
+		std::vector<std::vector<Cmo::SkinningVertex>> skinningVertexBuffers;
+		std::vector<Cmo::BoneTransforms> bones;
+		std::vector<std::vector<Cmo::Keyframe>> clips;
+	};
+
+	std::unique_ptr<uint8_t[]> ReadFile(const char* path, size_t& size)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+			throw std::runtime_error(std::string("Failed to open ") + path);
+
+		size = size_t(file.tellg());
+		file.seekg(0);
+
+		std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
+		if (!file.read(reinterpret_cast<char*>(data.get()), std::streamsize(size)))
+			throw std::runtime_error(std::string("Failed to read ") + path);
+		return data;
+	}
+
+	template<typename T>
+	std::vector<T> Copy(Cmo::ArrayView<T> const& view)
+	{
+		std::vector<T> copy(view.GetCount());
+		if (!copy.empty())
+		{
+			std::memcpy(copy.data(), view.GetBytes(), view.GetByteSize());
+		}
+		return copy;
+	}
+
+	// Uses the reader's validated views to find things, so both sides are
+	// checked the same way and only the copies differ.
+	std::vector<CopiedMesh> CopyMeshes(Cmo::File const& file)
+	{
+		std::vector<CopiedMesh> meshes;
+		for (auto const& mesh : file.GetMeshes())
+		{
+			CopiedMesh copied;
+			copied.name = mesh.name.ToUtf16();
+			for (auto const& material : mesh.materials)
+			{
+				copied.materialNames.push_back(material.name.ToUtf16());
+				copied.materials.push_back(material.constants[0]);
+			}
+			copied.submeshes = Copy(mesh.submeshes);
+			for (auto const& indices : mesh.indexBuffers)
+			{
+				copied.indexBuffers.push_back(Copy(indices));
+			}
+			for (auto const& vertices : mesh.vertexBuffers)
+			{
+				copied.vertexBuffers.push_back(Copy(vertices));
+			}
+			for (auto const& skin : mesh.skinningVertexBuffers)
+			{
+				copied.skinningVertexBuffers.push_back(Copy(skin));
+			}
+			for (auto const& bone : mesh.bones)
+			{
+				copied.bones.push_back(bone.transforms[0]);
+			}
+			for (auto const& clip : mesh.clips)
+			{
+				copied.clips.push_back(Copy(clip.keyframes));
+			}
+			meshes.push_back(std::move(copied));
+		}
+		return meshes;
+	}
+
+	template<typename Load>
+	double Measure(uint64_t iterations, Load load)
+	{
+		// One untimed run to warm the file cache and the allocator.
+		uint64_t checksum = load();
+
+		auto const start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; ++i)
+		{
+			checksum += load();
+		}
+		auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// Keeps the loads from being optimized away.
+		if (checksum == 0)
+		{
+			std::printf("  (empty model)\n");
+		}
+		return elapsed / double(iterations);
+	}
+
+	void Report(const char* name, double seconds, size_t bytes, double baseline)
+	{
+		std::printf("  %-26s %8.3f ms %9.1f MB/s", name, seconds * 1000.0, double(bytes) / seconds / (1024.0 * 1024.0));
+		if (baseline > 0.0)
+		{
+			std::printf("   %.1fx", baseline / seconds);
+		}
+		std::printf("\n");
+	}
+}
+
+int RunCmoBenchmark(int argc, char** argv)
+{
+	const uint64_t iterations = std::max<uint64_t>(1, Tools::GetArgument(argc, argv, 0, 200));
+	const char* modelPath = argc > 1 ? argv[1] : "Shooter/Assets/m16.cmo";
+
+	size_t size = 0;
+	auto const bytes = ReadFile(modelPath, size);
+	std::printf("%s: %zu bytes, %llu iterations\n\n", modelPath, size, static_cast<unsigned long long>(iterations));
+
+	// From bytes already in memory: parsing and validation against parsing,
+	// validation and copying out.
+	std::printf("in memory:\n");
+	const double parse = Measure(iterations, [&]()
+	{
+		Cmo::File file(bytes.get(), size);
+		return uint64_t(file.GetMeshes()[0].vertexBuffers[0].GetCount());
+	});
+
+	const double parseCopy = Measure(iterations, [&]()
+	{
+		Cmo::File file(bytes.get(), size);
+		auto const meshes = CopyMeshes(file);
+		return uint64_t(meshes[0].vertexBuffers[0].size());
+	});
+
+	Report("copying reader", parseCopy, size, 0.0);
+	Report("zero-copy reader", parse, size, parseCopy);
+
+	// From the file, warm in the cache: mapping against reading it into a
+	// buffer first, as DirectXTK's loader does.
+	std::printf("from file:\n");
+	const double mapped = Measure(iterations, [&]()
+	{
+		Cmo::File file(modelPath);
+		return uint64_t(file.GetMeshes()[0].vertexBuffers[0].GetCount());
+	});
+
+	const double readCopy = Measure(iterations, [&]()
+	{
+		size_t fileSize = 0;
+		auto const data = ReadFile(modelPath, fileSize);
+		Cmo::File file(data.get(), fileSize);
+		auto const meshes = CopyMeshes(file);
+		return uint64_t(meshes[0].vertexBuffers[0].size());
+	});
+
+	Report("read and copy", readCopy, size, 0.0);
+	Report("mapped zero-copy", mapped, size, readCopy);
+
+	return 0;
+}
@@ -0,0 +1,375 @@
+//
+// CmoFuzz.cpp - Feeds the CMO reader truncated and mutated models; it must reject them or return in-bounds views
+//
+
+#include "Tools.h"
+
+#include "../Shooter/CmoReader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	class Writer
+	{
+	public:
+		void UInt32(uint32_t value)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				m_bytes.push_back(uint8_t(value >> (8 * i)));
+			}
+		}
+
+		void Float(float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, 4);
+			UInt32(bits);
+		}
+
+		void String(const char* text)
+		{
+			const uint32_t length = uint32_t(std::strlen(text)) + 1;
+			UInt32(length);
+			for (uint32_t i = 0; i < length; ++i)
+			{
+				m_bytes.push_back(uint8_t(text[i]));
+				m_bytes.push_back(0);
+			}
+		}
+
+		template<typename T>
+		void Record(T const& value)
+		{
+			auto const bytes = reinterpret_cast<const uint8_t*>(&value);
+			m_bytes.insert(m_bytes.end(), bytes, bytes + sizeof(T));
+		}
+
+		void Byte(uint8_t value) { m_bytes.push_back(value); }
+
+		std::vector<uint8_t>& GetBytes() noexcept { return m_bytes; }
+
+	private:
+		std::vector<uint8_t> m_bytes;
+	};
+
+	// A skinned quad with two materials, three bones and a clip, so every
+	// part of the format is covered, not just what the weapon uses.
+	std::vector<uint8_t> MakeSkinnedSample()
+	{
+		Writer writer;
+		writer.UInt32(1);
+		writer.String("quad");
+
+		writer.UInt32(2);
+		for (const char* name : { "red", "blue" })
+		{
+			writer.String(name);
+			Cmo::MaterialConstants constants = {};
+			constants.diffuse[0] = 1.0f;
+			constants.specularPower = 16.0f;
+			writer.Record(constants);
+			writer.String("phong.dgsl");
+			writer.String("albedo.dds");
+			for (uint32_t t = 1; t < Cmo::MaxTextures; ++t)
+			{
+				writer.String("");
+			}
+		}
+
+		writer.Byte(1);
+
+		const Cmo::SubMesh submeshes[] = { { 0, 0, 0, 0, 1 }, { 1, 0, 0, 3, 1 } };
+		writer.UInt32(2);
+		for (auto const& submesh : submeshes)
+		{
+			writer.Record(submesh);
+		}
+
+		const uint16_t indices[] = { 0, 1, 2, 2, 1, 3 };
+		writer.UInt32(1);
+		writer.UInt32(6);
+		for (auto const index : indices)
+		{
+			writer.Record(index);
+		}
+
+		writer.UInt32(1);
+		writer.UInt32(4);
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			Cmo::Vertex vertex = {};
+			vertex.position[0] = float(i & 1);
+			vertex.position[1] = float(i >> 1);
+			vertex.normal[2] = 1.0f;
+			vertex.color = 0xFFFFFFFF;
+			writer.Record(vertex);
+		}
+
+		writer.UInt32(1);
+		writer.UInt32(4);
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			const Cmo::SkinningVertex skin = { { i % 3, 0, 0, 0 }, { 1.0f, 0.0f, 0.0f, 0.0f } };
+			writer.Record(skin);
+		}
+
+		writer.Record(Cmo::MeshExtents{ { 0.5f, 0.5f, 0.0f }, 0.71f, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f } });
+
+		writer.UInt32(3);
+		for (int32_t bone = 0; bone < 3; ++bone)
+		{
+			writer.String(bone == 0 ? "root" : "child");
+			Cmo::BoneTransforms transforms = {};
+			transforms.parentIndex = bone - 1;
+			writer.Record(transforms);
+		}
+
+		writer.UInt32(1);
+		writer.String("wave");
+		writer.Float(0.0f);
+		writer.Float(1.0f);
+		writer.UInt32(2);
+		writer.Record(Cmo::Keyframe{ 1, 0.0f, {} });
+		writer.Record(Cmo::Keyframe{ 2, 1.0f, {} });
+
+		return std::move(writer.GetBytes());
+	}
+
+	void CheckSample(std::vector<uint8_t> const& sample)
+	{
+		std::printf("sample:\n");
+
+		Cmo::File file(sample.data(), sample.size());
+		auto const& mesh = file.GetMeshes().at(0);
+
+		Tools::Check(mesh.name.Equals("quad") && mesh.name.ToUtf8() == "quad", "mesh name should read back without its terminator");
+		Tools::Check(mesh.materials.size() == 2 && mesh.materials[1].name.Equals("blue"), "materials should read back");
+		Tools::Check(mesh.materials[0].constants[0].specularPower == 16.0f, "material constants should read back");
+		Tools::Check(mesh.materials[0].textures[0].Equals("albedo.dds") && mesh.materials[0].textures[1].IsEmpty(), "texture names should read back");
+		Tools::Check(mesh.submeshes.GetCount() == 2 && mesh.submeshes[1].startIndex == 3, "submeshes should read back");
+		Tools::Check(mesh.indexBuffers.size() == 1 && mesh.indexBuffers[0][5] == 3, "indices should read back");
+		Tools::Check(mesh.vertexBuffers.size() == 1 && mesh.vertexBuffers[0][3].position[1] == 1.0f, "vertices should read back");
+		Tools::Check(mesh.skinningVertexBuffers.size() == 1 && mesh.skinningVertexBuffers[0][2].boneIndex[0] == 2, "skinning should read back");
+		Tools::Check(mesh.hasSkeleton && mesh.bones.size() == 3 && mesh.bones[2].transforms[0].parentIndex == 1, "bones should read back");
+		Tools::Check(mesh.clips.size() == 1 && mesh.clips[0].endTime == 1.0f && mesh.clips[0].keyframes[1].boneIndex == 2, "clips should read back");
+
+		// The views are into the sample, not copies of it.
+		Tools::Check(mesh.vertexBuffers[0].GetBytes() > sample.data()
+			&& mesh.vertexBuffers[0].GetBytes() + mesh.vertexBuffers[0].GetByteSize() <= sample.data() + sample.size(),
+			"vertex views should point into the file");
+
+		std::printf("  %s\n", Tools::Passed() ? "ok" : "failed");
+	}
+
+	bool InBounds(const uint8_t* begin, const uint8_t* end, const uint8_t* data, size_t size)
+	{
+		return size == 0 || (data >= begin && data + size <= end);
+	}
+
+	// Every view must lie within the input; touching each byte lets a
+	// sanitizer build catch anything the bounds check misses.
+	bool CheckViews(Cmo::File const& file, const uint8_t* begin, const uint8_t* end, uint64_t& checksum)
+	{
+		bool ok = true;
+		auto const touch = [&](const uint8_t* data, size_t size)
+		{
+			ok = ok && InBounds(begin, end, data, size);
+			for (size_t i = 0; ok && i < size; ++i)
+			{
+				checksum += data[i];
+			}
+		};
+
+		for (auto const& mesh : file.GetMeshes())
+		{
+			checksum += mesh.name.ToUtf8().size();
+			for (auto const& material : mesh.materials)
+			{
+				touch(material.constants.GetBytes(), material.constants.GetByteSize());
+				checksum += material.pixelShader.ToUtf16().size();
+			}
+
+			touch(mesh.submeshes.GetBytes(), mesh.submeshes.GetByteSize());
+			for (auto const& indices : mesh.indexBuffers)
+			{
+				touch(indices.GetBytes(), indices.GetByteSize());
+			}
+			for (auto const& vertices : mesh.vertexBuffers)
+			{
+				touch(vertices.GetBytes(), vertices.GetByteSize());
+			}
+			for (auto const& skin : mesh.skinningVertexBuffers)
+			{
+				touch(skin.GetBytes(), skin.GetByteSize());
+			}
+			for (auto const& bone : mesh.bones)
+			{
+				touch(bone.transforms.GetBytes(), bone.transforms.GetByteSize());
+			}
+			for (auto const& clip : mesh.clips)
+			{
+				touch(clip.keyframes.GetBytes(), clip.keyframes.GetByteSize());
+			}
+
+			// What the reader promised: every submesh index addresses its vertex buffer.
+			for (size_t s = 0; s < mesh.submeshes.GetCount(); ++s)
+			{
+				auto const submesh = mesh.submeshes[s];
+				auto const& indices = mesh.indexBuffers[submesh.indexBufferIndex];
+				const size_t vertexCount = mesh.vertexBuffers[submesh.vertexBufferIndex].GetCount();
+				for (uint32_t i = 0; i < submesh.primCount * 3; ++i)
+				{
+					ok = ok && indices[submesh.startIndex + i] < vertexCount;
+				}
+			}
+		}
+		return ok;
+	}
+
+	struct Outcome
+	{
+		uint64_t accepted;
+		uint64_t rejected;
+		uint64_t unexpected;
+		uint64_t checksum;
+	};
+
+	void Parse(std::vector<uint8_t> const& bytes, Outcome& outcome)
+	{
+		try
+		{
+			Cmo::File file(bytes.data(), bytes.size());
+			if (!CheckViews(file, bytes.data(), bytes.data() + bytes.size(), outcome.checksum))
+			{
+				outcome.unexpected++;
+			}
+			outcome.accepted++;
+		}
+		catch (std::runtime_error const&)
+		{
+			outcome.rejected++;
+		}
+		catch (std::exception const& e)
+		{
+			// Anything else, like bad_alloc from a count the reader trusted, is a bug.
+			std::printf("  unexpected exception: %s\n", e.what());
+			outcome.unexpected++;
+		}
+	}
+
+	// Every proper prefix is missing something, so none may parse.
+	void CheckTruncation(const char* name, std::vector<uint8_t> const& seed)
+	{
+		Outcome outcome = {};
+		const size_t step = std::max<size_t>(1, seed.size() / 4096);
+		for (size_t length = 0; length < seed.size(); length += step)
+		{
+			Parse(std::vector<uint8_t>(seed.begin(), seed.begin() + length), outcome);
+		}
+
+		std::printf("  %s: %llu truncations rejected\n", name, static_cast<unsigned long long>(outcome.rejected));
+		Tools::Check(outcome.accepted == 0 && outcome.unexpected == 0, "a truncated file should be rejected");
+	}
+
+	void Mutate(std::vector<uint8_t>& bytes, std::mt19937& random)
+	{
+		static const uint32_t interesting[] = { 0, 1, 2, 0x7F, 0x80, 0xFF, 0xFFFF, 0x10000, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFE, 0xFFFFFFFF };
+
+		const uint32_t mutations = 1 + random() % 8;
+		for (uint32_t m = 0; m < mutations && !bytes.empty(); ++m)
+		{
+			const size_t at = random() % bytes.size();
+			switch (random() % 6)
+			{
+			case 0:
+				bytes[at] ^= uint8_t(1u << (random() % 8));
+				break;
+
+			case 1:
+				bytes[at] = uint8_t(interesting[random() % 6]);
+				break;
+
+			case 2:
+			{
+				// Counts and indices are 32-bit; hit them on their alignment
+				// or off it, since strings shift everything after them.
+				const uint32_t value = interesting[random() % std::size(interesting)];
+				for (size_t i = 0; i < 4 && at + i < bytes.size(); ++i)
+				{
+					bytes[at + i] = uint8_t(value >> (8 * i));
+				}
+				break;
+			}
+
+			case 3:
+				bytes.resize(at);
+				break;
+
+			case 4:
+			{
+				const size_t count = std::min<size_t>(1 + random() % 64, bytes.size() - at);
+				bytes.erase(bytes.begin() + at, bytes.begin() + at + count);
+				break;
+			}
+
+			default:
+			{
+				const size_t count = 1 + random() % 64;
+				bytes.insert(bytes.begin() + at, count, uint8_t(random()));
+				break;
+			}
+			}
+		}
+	}
+
+	void Fuzz(const char* name, std::vector<uint8_t> const& seed, uint64_t iterations, uint32_t seedValue)
+	{
+		std::mt19937 random(seedValue);
+		Outcome outcome = {};
+
+		std::vector<uint8_t> bytes;
+		for (uint64_t i = 0; i < iterations; ++i)
+		{
+			bytes = seed;
+			Mutate(bytes, random);
+			Parse(bytes, outcome);
+		}
+
+		std::printf("  %s: %llu mutants, %llu accepted, %llu rejected\n", name, static_cast<unsigned long long>(iterations),
+			static_cast<unsigned long long>(outcome.accepted), static_cast<unsigned long long>(outcome.rejected));
+		Tools::Check(outcome.unexpected == 0, "a mutant produced an out of bounds view or an unexpected exception");
+	}
+}
+
+int RunCmoFuzz(int argc, char** argv)
+{
+	const uint64_t iterations = Tools::GetArgument(argc, argv, 0, 20000);
+	const char* modelPath = argc > 1 ? argv[1] : "Shooter/Assets/m16.cmo";
+	const uint32_t seed = static_cast<uint32_t>(Tools::GetArgument(argc, argv, 2, 1234));
+
+	const auto sample = MakeSkinnedSample();
+	CheckSample(sample);
+
+	const Cmo::File model(modelPath);
+	const std::vector<uint8_t> modelBytes(model.GetData(), model.GetData() + model.GetSize());
+	std::printf("model: %s, %zu bytes, %zu meshes\n", modelPath, modelBytes.size(), model.GetMeshes().size());
+
+	std::printf("truncation:\n");
+	CheckTruncation("sample", sample);
+	CheckTruncation("model", modelBytes);
+
+	// Each of the model's mutants reparses and revalidates 850 KB, so it gets fewer.
+	std::printf("mutation:\n");
+	Fuzz("sample", sample, iterations, seed);
+	Fuzz("model", modelBytes, iterations / 10, seed + 1);
+
+	return Tools::Finish("cmo fuzz");
+}
@@ -0,0 +1,305 @@
+//
+// CompressionBenchmark.cpp - Measures block compressed archives of the game's meshes and textures: ratio and decode speed
+//
+
+#include "Tools.h"
+#include "ArchivePacker.h"
+#include "Lz4Compressor.h"
+
+#include "../Shooter/AssetArchive.h"
+#include "../Shooter/Lz4.h"
+#include "../Shooter/MappedFile.h"
+#include "../Shooter/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Repeats an action for a quarter of a second or more, after once to
+	// warm up, and returns the average time of one.
+	template<typename Action>
+	double Measure(Action action)
+	{
+		action();
+
+		int iterations = 0;
+		auto const start = std::chrono::steady_clock::now();
+		do
+		{
+			action();
+			++iterations;
+		} while (Tools::Seconds(start) < 0.25);
+		return Tools::Seconds(start) / iterations;
+	}
+
+	std::vector<uint8_t> ReadAll(std::filesystem::path const& path)
+	{
+		std::vector<uint8_t> bytes(size_t(std::filesystem::file_size(path)));
+		std::ifstream file(path, std::ios::binary);
+		file.read(reinterpret_cast<char*>(bytes.data()), std::streamsize(bytes.size()));
+		return bytes;
+	}
+
+	void WriteAll(std::filesystem::path const& path, std::vector<uint8_t> const& bytes)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+	}
+
+	// Every entry must decode to its file from both backends, with and
+	// without the pool.
+	void CheckRoundTrip(std::vector<ArchivePacker::Source> const& sources, std::filesystem::path const& archivePath, ThreadPool& pool)
+	{
+		using Backend = AssetArchive::Reader::Backend;
+
+		for (const Backend backend : { Backend::Mapped, Backend::Read })
+		{
+			const AssetArchive::Reader archive(archivePath, backend);
+			std::vector<uint8_t> decoded;
+			for (auto const& source : sources)
+			{
+				const auto expected = ReadAll(source.path);
+				auto const entry = archive.Find(source.name);
+				Tools::Check(entry && AssetArchive::Reader::IsCompressed(*entry), "entry compressed");
+				if (!entry)
+					continue;
+
+				for (ThreadPool* const entryPool : { static_cast<ThreadPool*>(nullptr), &pool })
+				{
+					decoded.assign(size_t(entry->size), 0);
+					archive.ReadEntry(*entry, decoded.data(), entryPool);
+					Tools::Check(decoded == expected, "entry decodes to its file");
+				}
+			}
+		}
+	}
+
+	// A damaged table must be rejected when the archive is opened, and a
+	// damaged block when it's decoded, rather than read or written out of
+	// bounds. Data damaged in ways that still decode can't be told apart
+	// from the real thing without checksums, which the archive leaves to
+	// the file system and the store; the decoder only has to stay inside
+	// its buffers, which the random damage below exercises.
+	void CheckDamage(std::filesystem::path const& archivePath, std::filesystem::path const& damagedPath)
+	{
+		using AssetArchive::Block;
+		using AssetArchive::Entry;
+		using AssetArchive::Header;
+		using Backend = AssetArchive::Reader::Backend;
+
+		const auto original = ReadAll(archivePath);
+		Header header;
+		std::memcpy(&header, original.data(), sizeof(header));
+
+		auto const rejected = [&](std::vector<uint8_t> const& bytes)
+		{
+			WriteAll(damagedPath, bytes);
+			return Tools::Throws<std::runtime_error>([&]() { AssetArchive::Reader archive(damagedPath, Backend::Mapped); })
+				&& Tools::Throws<std::runtime_error>([&]() { AssetArchive::Reader archive(damagedPath, Backend::Read); });
+		};
+
+		auto const patched = [&](size_t offset, auto value)
+		{
+			auto bytes = original;
+			std::memcpy(bytes.data() + offset, &value, sizeof(value));
+			return bytes;
+		};
+
+		const size_t firstEntry = header.entryOffset;
+		const size_t firstBlock = header.blockOffset;
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, compression), uint32_t(7))), "entry compression");
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, blockSize), uint32_t(100000))), "entry block size");
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, firstBlock), header.blockCount)), "entry first block");
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, size), ~0ull)), "entry size");
+		Tools::Check(rejected(patched(firstEntry + offsetof(Entry, storedSize), uint64_t(1))), "entry stored size");
+		Tools::Check(rejected(patched(firstBlock + offsetof(Block, offset), uint64_t(0))), "block offset");
+		Tools::Check(rejected(patched(firstBlock + offsetof(Block, storedSize), uint32_t(0))), "block stored size");
+		Tools::Check(rejected(patched(offsetof(Header, blockCount), header.blockCount + 1)), "block count");
+
+		// A block of nothing but 255s is a literal length that never ends.
+		{
+			const AssetArchive::Reader archive(archivePath, Backend::Read);
+			Entry const& entry = archive.GetEntry(0);
+			Block const& block = archive.GetBlock(entry, 0);
+
+			auto bytes = original;
+			std::fill_n(bytes.begin() + ptrdiff_t(block.offset), block.storedSize, uint8_t(255));
+			WriteAll(damagedPath, bytes);
+
+			std::vector<uint8_t> decoded(size_t(entry.size));
+			for (const Backend backend : { Backend::Mapped, Backend::Read })
+			{
+				const AssetArchive::Reader damaged(damagedPath, backend);
+				Tools::Check(Tools::Throws<std::runtime_error>([&]() { damaged.ReadEntry(*damaged.Find(archive.GetName(entry)), decoded.data()); }),
+					"damaged block");
+			}
+
+			uint8_t byte;
+			Tools::Check(Tools::Throws<std::logic_error>([&]() { archive.Read(entry, 0, &byte, 1); }), "Read of a compressed entry");
+		}
+
+		std::filesystem::remove(damagedPath);
+	}
+
+	// Flips random bytes of compressed blocks and decodes them. Returns how
+	// many of the decodes noticed.
+	uint32_t FuzzDecoder(std::vector<uint8_t> const& bytes, uint32_t blockSize, uint32_t iterations)
+	{
+		std::mt19937 random(11);
+		std::vector<uint8_t> compressed(Lz4::GetMaxCompressedSize(blockSize));
+		std::vector<uint8_t> decoded(blockSize);
+
+		uint32_t detected = 0;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			const size_t start = random() % bytes.size();
+			const size_t size = std::min<size_t>(blockSize, bytes.size() - start);
+			compressed.resize(Lz4::GetMaxCompressedSize(size));
+			compressed.resize(Lz4::Compress(bytes.data() + start, size, compressed.data(), 1));
+
+			const uint32_t flips = 1 + random() % 4;
+			for (uint32_t flip = 0; flip < flips; ++flip)
+			{
+				compressed[random() % compressed.size()] ^= uint8_t(1 + random() % 255);
+			}
+
+			// Sometimes a block cut short, or decoded to the wrong size.
+			if (random() % 4 == 0)
+			{
+				compressed.resize(random() % compressed.size());
+			}
+			const size_t decodedSize = random() % 4 == 0 ? random() % (size + 1) : size;
+
+			detected += Lz4::Decompress(compressed.data(), compressed.size(), decoded.data(), decodedSize) ? 0 : 1;
+		}
+		return detected;
+	}
+}
+
+int RunCompressionBenchmark(int argc, char** argv)
+{
+	const unsigned threads = unsigned(std::max<uint64_t>(1, Tools::GetArgument(argc, argv, 0, ThreadPool::GetDefaultWorkerCount() + 1)));
+	const unsigned searchDepth = unsigned(std::max<uint64_t>(1, Tools::GetArgument(argc, argv, 1, 64)));
+
+	ThreadPool pool(threads - 1);
+
+	try
+	{
+		const auto sources = ArchivePacker::ListDirectory("Shooter/Assets", { ".cmo", ".cmesh", ".dds" });
+		if (sources.empty())
+			throw std::runtime_error("No meshes or textures in Shooter/Assets; run from the repository's root");
+
+		const auto directory = std::filesystem::temp_directory_path() / "shooter-compression-benchmark";
+		std::filesystem::create_directories(directory);
+
+		std::printf("%zu meshes and textures, LZ4 with a search depth of %u, decoding on %u threads\n\n",
+			sources.size(), searchDepth, threads);
+		std::printf("%-10s %8s %12s %14s %14s %14s\n", "block KB", "ratio", "pack MB/s", "decode GB/s", "on threads", "memcpy GB/s");
+
+		for (const uint32_t blockSize : { 64u * 1024, 128u * 1024, 256u * 1024 })
+		{
+			ArchivePacker::Options options;
+			options.compression = AssetArchive::Compression::Lz4;
+			options.blockSize = blockSize;
+			options.searchDepth = searchDepth;
+			options.minSaving = 0.0;
+
+			const auto archivePath = directory / "Assets.pak";
+			auto const start = std::chrono::steady_clock::now();
+			const auto stats = ArchivePacker::Pack(sources, archivePath, options, &pool);
+			const double packTime = Tools::Seconds(start);
+
+			CheckRoundTrip(sources, archivePath, pool);
+			if (blockSize == ArchivePacker::Options().blockSize)
+			{
+				CheckDamage(archivePath, directory / "damaged.pak");
+			}
+
+			// Warm: what decoding costs once the archive is in the file cache.
+			const AssetArchive::Reader archive(archivePath);
+			std::vector<std::vector<uint8_t>> decoded(archive.GetEntryCount());
+			for (uint32_t i = 0; i < archive.GetEntryCount(); ++i)
+			{
+				decoded[i].resize(size_t(archive.GetEntry(i).size));
+			}
+
+			auto const decodeAll = [&](ThreadPool* entryPool)
+			{
+				for (uint32_t i = 0; i < archive.GetEntryCount(); ++i)
+				{
+					archive.ReadEntry(archive.GetEntry(i), decoded[i].data(), entryPool);
+				}
+			};
+
+			const double serial = Measure([&]() { decodeAll(nullptr); });
+			const double parallel = Measure([&]() { decodeAll(&pool); });
+
+			// The floor: copying the same bytes without decoding them.
+			std::vector<uint8_t> copy(decoded.empty() ? 0 : decoded.front().size());
+			const double copyTime = Measure([&]()
+			{
+				for (auto const& bytes : decoded)
+				{
+					copy.resize(bytes.size());
+					std::memcpy(copy.data(), bytes.data(), bytes.size());
+				}
+			});
+
+			const double gigabytes = double(stats.contentBytes) / 1e9;
+			std::printf("%-10u %8.3f %12.1f %14.2f %14.2f %14.2f\n", blockSize / 1024,
+				double(stats.contentBytes) / double(stats.storedBytes), double(stats.contentBytes) / 1e6 / packTime,
+				gigabytes / serial, gigabytes / parallel, gigabytes / copyTime);
+		}
+
+		// Each file on its own, at the default block size.
+		{
+			ArchivePacker::Options options;
+			options.compression = AssetArchive::Compression::Lz4;
+			options.searchDepth = searchDepth;
+			options.minSaving = 0.0;
+
+			const auto archivePath = directory / "Assets.pak";
+			ArchivePacker::Pack(sources, archivePath, options, &pool);
+			const AssetArchive::Reader archive(archivePath);
+
+			std::printf("\n%-26s %10s %10s %8s %14s %14s\n", "128 KB blocks", "bytes", "stored", "ratio", "decode GB/s", "on threads");
+			for (auto const& source : sources)
+			{
+				auto const& entry = *archive.Find(source.name);
+				std::vector<uint8_t> decoded(size_t(entry.size));
+				const double serial = Measure([&]() { archive.ReadEntry(entry, decoded.data()); });
+				const double parallel = Measure([&]() { archive.ReadEntry(entry, decoded.data(), &pool); });
+
+				std::printf("%-26s %10llu %10llu %8.3f %14.2f %14.2f\n", source.name.c_str(),
+					(unsigned long long)entry.size, (unsigned long long)entry.storedSize,
+					double(entry.size) / double(entry.storedSize), double(entry.size) / 1e9 / serial, double(entry.size) / 1e9 / parallel);
+			}
+
+			std::filesystem::remove(archivePath);
+		}
+
+		std::filesystem::remove(directory);
+
+		constexpr uint32_t FuzzIterations = 2000;
+		const auto fuzzBytes = ReadAll(sources.front().path);
+		const uint32_t detected = FuzzDecoder(fuzzBytes, 64 * 1024, FuzzIterations);
+		std::printf("\n%u of %u randomly damaged blocks rejected by the decoder, the rest decoded within bounds\n",
+			detected, FuzzIterations);
+	}
+	catch (std::exception const& e)
+	{
+		Tools::Check(false, e.what());
+	}
+
+	return Tools::Finish("compression-benchmark");
+}
@@ -0,0 +1,369 @@
+//
+// CookMeshes.cpp - Cooks CMO models into optimized, quantized mesh files and reports what that gained and cost
+//
+
+#include "Tools.h"
+#include "MeshCooker.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Average of repeated loads, after one to warm the file cache.
+	template<typename Load>
+	double MeasureLoad(Load load)
+	{
+		constexpr int Iterations = 50;
+
+		load();
+		auto const start = std::chrono::steady_clock::now();
+		for (int i = 0; i < Iterations; ++i)
+		{
+			load();
+		}
+		return Tools::Seconds(start) / Iterations;
+	}
+
+	// A triangle as the bytes of its vertices, rotated to start at the
+	// smallest so the same triangle compares equal in any order it's drawn
+	// in, without changing its winding.
+	using Triangle = std::array<uint8_t, 3 * sizeof(Cmo::Vertex)>;
+
+	Triangle MakeTriangle(Cmo::Vertex const (&corners)[3])
+	{
+		int first = 0;
+		for (int corner = 1; corner < 3; ++corner)
+		{
+			if (std::memcmp(&corners[corner], &corners[first], sizeof(Cmo::Vertex)) < 0)
+			{
+				first = corner;
+			}
+		}
+
+		Triangle triangle;
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			std::memcpy(triangle.data() + corner * sizeof(Cmo::Vertex), &corners[(first + corner) % 3], sizeof(Cmo::Vertex));
+		}
+		return triangle;
+	}
+
+	// Every part draws the triangles its submesh did, in whatever order,
+	// and the tables say what the source did.
+	void Verify(Cmo::File const& source, CookedMesh::File const& cooked)
+	{
+		uint32_t part = 0;
+		uint32_t meshIndex = 0;
+		std::vector<Triangle> expected;
+		std::vector<Triangle> actual;
+
+		for (auto const& mesh : source.GetMeshes())
+		{
+			auto const& cookedMesh = cooked.GetMesh(meshIndex++);
+			Tools::Check(mesh.name.Equals(cooked.GetString(cookedMesh.name)), "mesh name");
+			Tools::Check(cookedMesh.firstPart == part && cookedMesh.partCount == mesh.submeshes.GetCount(), "mesh parts");
+			Tools::Check(std::memcmp(cookedMesh.center, mesh.extents.center, sizeof(cookedMesh.center)) == 0
+				&& std::memcmp(cookedMesh.min, mesh.extents.min, sizeof(cookedMesh.min)) == 0
+				&& std::memcmp(cookedMesh.max, mesh.extents.max, sizeof(cookedMesh.max)) == 0, "mesh extents");
+
+			for (size_t i = 0; i < mesh.submeshes.GetCount(); ++i)
+			{
+				const Cmo::SubMesh submesh = mesh.submeshes[i];
+				auto const& cookedPart = cooked.GetPart(part++);
+				if (cookedPart.indexCount != submesh.primCount * 3)
+				{
+					Tools::Check(false, "part index count");
+					continue;
+				}
+
+				auto const& indices = mesh.indexBuffers[submesh.indexBufferIndex];
+				auto const& vertices = mesh.vertexBuffers[submesh.vertexBufferIndex];
+				const Cmo::MaterialConstants constants = mesh.materials.empty() ? Cmo::MaterialConstants{} : mesh.materials[submesh.materialIndex].constants[0];
+
+				expected.clear();
+				actual.clear();
+				for (uint32_t index = 0; index < cookedPart.indexCount; index += 3)
+				{
+					Cmo::Vertex corners[3];
+					for (int corner = 0; corner < 3; ++corner)
+					{
+						corners[corner] = vertices[indices[submesh.startIndex + index + corner]];
+						if (!mesh.materials.empty())
+						{
+							MeshCooker::TransformTextureCoordinate(constants.uvTransform, corners[corner].textureCoordinate);
+						}
+					}
+					expected.push_back(MakeTriangle(corners));
+
+					for (int corner = 0; corner < 3; ++corner)
+					{
+						const size_t vertex = size_t(cookedPart.baseVertex) + cooked.GetIndices()[cookedPart.startIndex + index + corner];
+						if (vertex >= cooked.GetHeader().vertexCount)
+						{
+							Tools::Check(false, "part vertex in range");
+							return;
+						}
+						std::memcpy(&corners[corner], cooked.GetVertices() + vertex * sizeof(Cmo::Vertex), sizeof(Cmo::Vertex));
+					}
+					actual.push_back(MakeTriangle(corners));
+				}
+
+				std::sort(expected.begin(), expected.end());
+				std::sort(actual.begin(), actual.end());
+				Tools::Check(expected == actual, "part triangles");
+			}
+		}
+		Tools::Check(meshIndex == cooked.GetMeshCount() && part == cooked.GetPartCount(), "mesh and part counts");
+	}
+
+	struct QuantizationError
+	{
+		double position;
+		double normalDegrees;
+		double tangentDegrees;
+		double textureCoordinate;
+	};
+
+	// The decode the vertex shader does, written out again here so the
+	// cooker's encoding is checked against it rather than against itself.
+	double DecodeSnorm(int16_t value)
+	{
+		return std::max(value / 32767.0, -1.0);
+	}
+
+	void DecodeOctahedral(int16_t const (&encoded)[2], double (&vector)[3])
+	{
+		double x = DecodeSnorm(encoded[0]);
+		double y = DecodeSnorm(encoded[1]);
+		const double z = 1.0 - std::abs(x) - std::abs(y);
+		const double t = std::max(-z, 0.0);
+		x += x >= 0.0 ? -t : t;
+		y += y >= 0.0 ? -t : t;
+
+		const double length = std::sqrt(x * x + y * y + z * z);
+		vector[0] = x / length;
+		vector[1] = y / length;
+		vector[2] = z / length;
+	}
+
+	double HalfToFloat(uint16_t half)
+	{
+		const int exponent = (half >> 10) & 0x1F;
+		const int mantissa = half & 0x3FF;
+		const double magnitude = exponent == 0 ? std::ldexp(mantissa, -24)
+			: exponent == 31 ? std::numeric_limits<double>::infinity()
+			: std::ldexp(mantissa + 1024, exponent - 25);
+		return (half & 0x8000) ? -magnitude : magnitude;
+	}
+
+	double AngleDegrees(const float* original, double const (&decoded)[3])
+	{
+		const double length = std::sqrt(double(original[0]) * original[0] + double(original[1]) * original[1] + double(original[2]) * original[2]);
+		if (length == 0.0)
+			return 0.0;
+
+		const double cosine = (original[0] * decoded[0] + original[1] * decoded[1] + original[2] * decoded[2]) / length;
+		return std::acos(std::clamp(cosine, -1.0, 1.0)) * 180.0 / 3.14159265358979323846;
+	}
+
+	// Worst error over the vertices the mesh's parts draw, and a check that
+	// positions are within half a step of where they were.
+	QuantizationError MeasureQuantizationError(MeshCooker::Model const& model, CookedMesh::File const& cooked, uint32_t meshIndex)
+	{
+		QuantizationError worst = {};
+
+		auto const& mesh = cooked.GetMesh(meshIndex);
+		const auto* vertices = reinterpret_cast<const CookedMesh::QuantizedVertex*>(cooked.GetVertices());
+
+		double bound = 0.0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const double step = mesh.positionScale[i] / 32767.0;
+			bound += step * step / 4.0;
+		}
+		bound = std::sqrt(bound) * 1.001 + 1e-6 * mesh.radius;
+
+		for (uint32_t part = mesh.firstPart; part < mesh.firstPart + mesh.partCount; ++part)
+		{
+			auto const& cookedPart = cooked.GetPart(part);
+			for (uint32_t i = cookedPart.startIndex; i < cookedPart.startIndex + cookedPart.indexCount; ++i)
+			{
+				const uint32_t vertex = cookedPart.baseVertex + cooked.GetIndices()[i];
+				auto const& original = model.vertices[vertex];
+				auto const& quantized = vertices[vertex];
+
+				double squared = 0.0;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const double decoded = mesh.positionOffset[axis] + DecodeSnorm(quantized.position[axis]) * mesh.positionScale[axis];
+					squared += (decoded - original.position[axis]) * (decoded - original.position[axis]);
+				}
+				worst.position = std::max(worst.position, std::sqrt(squared));
+
+				double normal[3];
+				DecodeOctahedral(quantized.normal, normal);
+				worst.normalDegrees = std::max(worst.normalDegrees, AngleDegrees(original.normal, normal));
+
+				double tangent[3];
+				DecodeOctahedral(quantized.tangent, tangent);
+				worst.tangentDegrees = std::max(worst.tangentDegrees, AngleDegrees(original.tangent, tangent));
+				Tools::Check((quantized.position[3] < 0) == (original.tangent[3] < 0.0f), "tangent handedness");
+
+				for (int axis = 0; axis < 2; ++axis)
+				{
+					worst.textureCoordinate = std::max(worst.textureCoordinate,
+						std::abs(HalfToFloat(quantized.textureCoordinate[axis]) - original.textureCoordinate[axis]));
+				}
+				Tools::Check(quantized.color == original.color, "vertex color");
+			}
+		}
+
+		Tools::Check(worst.position <= bound, "position within half a step");
+		return worst;
+	}
+
+	// A damaged or stale file must be turned away, not drawn.
+	void CheckRejects(std::vector<uint8_t> const& bytes)
+	{
+		auto const rejects = [&](const char* what, size_t offset, uint32_t value)
+		{
+			std::vector<uint8_t> damaged(bytes);
+			std::memcpy(damaged.data() + offset, &value, sizeof(value));
+			Tools::Check(Tools::Throws<std::runtime_error>([&]() { CookedMesh::File file(damaged.data(), damaged.size()); }), what);
+		};
+
+		rejects("bad magic rejected", offsetof(CookedMesh::Header, magic), 0);
+		rejects("old version rejected", offsetof(CookedMesh::Header, version), CookedMesh::Version - 1);
+		rejects("unknown vertex format rejected", offsetof(CookedMesh::Header, vertexFormat), 99);
+		rejects("oversized index count rejected", offsetof(CookedMesh::Header, indexCount), ~0u);
+		rejects("overlapping section rejected", offsetof(CookedMesh::Header, vertexOffset), 0);
+
+		Tools::Check(Tools::Throws<std::runtime_error>([&]() { CookedMesh::File file(bytes.data(), bytes.size() - 1); }), "truncation rejected");
+	}
+}
+
+int RunCookMeshes(int argc, char** argv)
+{
+	const std::filesystem::path outputDirectory = argc > 0 ? argv[0] : "Shooter/Assets";
+
+	std::vector<std::filesystem::path> models;
+	for (int i = 1; i < argc; ++i)
+	{
+		models.emplace_back(argv[i]);
+	}
+	if (models.empty())
+	{
+		models.emplace_back("Shooter/Assets/m16.cmo");
+	}
+
+	const std::filesystem::path reportPath = outputDirectory / "mesh-cook-report.csv";
+	std::ofstream report(reportPath);
+	report << "asset,source bytes,cooked bytes,float vertex bytes,quantized vertex bytes,vertices,indices,parts,materials,"
+		"cook ms,cmo parse ms,cooked load ms,acmr before,acmr after,atvr before,atvr after,overfetch before,overfetch after,"
+		"position error,normal error degrees,tangent error degrees,texture coordinate error\n";
+
+	for (auto const& modelPath : models)
+	{
+		const std::filesystem::path cookedPath = outputDirectory / modelPath.filename().replace_extension(".cmesh");
+		const std::string asset = cookedPath.filename().string();
+		std::printf("%s:\n", asset.c_str());
+
+		try
+		{
+			auto const start = std::chrono::steady_clock::now();
+			const Cmo::File source(modelPath);
+			auto model = MeshCooker::ImportCmo(source);
+			const auto before = MeshCooker::Analyze(model);
+			MeshCooker::Optimize(model);
+			const auto quantization = MeshCooker::Quantize(model);
+			const auto bytes = MeshCooker::Write(model, &quantization);
+			const double cookTime = Tools::Seconds(start);
+
+			const auto after = MeshCooker::Analyze(model);
+			Tools::Check(after.vertexCache.triangles == before.vertexCache.triangles, "triangle count");
+
+			// Import and optimization are checked exactly on the float layout,
+			// quantization against it.
+			const auto floatBytes = MeshCooker::Write(model);
+			Verify(source, CookedMesh::File(floatBytes.data(), floatBytes.size()));
+
+			// The same source must cook to the same bytes.
+			auto again = MeshCooker::ImportCmo(source);
+			MeshCooker::Optimize(again);
+			const auto quantizedAgain = MeshCooker::Quantize(again);
+			Tools::Check(MeshCooker::Write(again, &quantizedAgain) == bytes, "deterministic output");
+
+			std::ofstream output(cookedPath, std::ios::binary);
+			output.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+			output.close();
+			if (!output)
+				throw std::runtime_error("Failed to write " + cookedPath.string());
+
+			// Check what landed on disk, then what loading it costs against
+			// parsing the source as the game did.
+			const CookedMesh::File cooked(cookedPath);
+			Tools::Check(cooked.GetSize() == bytes.size() && std::memcmp(cooked.GetData(), bytes.data(), bytes.size()) == 0, "file contents");
+			CheckRejects(bytes);
+
+			const double parseTime = MeasureLoad([&]() { Cmo::File file(modelPath); });
+			const double loadTime = MeasureLoad([&]() { CookedMesh::File file(cookedPath); });
+
+			auto const& header = cooked.GetHeader();
+			const size_t floatVertexBytes = model.vertices.size() * sizeof(Cmo::Vertex);
+			const size_t quantizedVertexBytes = size_t(header.vertexCount) * header.vertexStride;
+
+			std::printf("  size:         %zu bytes of CMO, %zu cooked; vertices %zu -> %zu bytes, %.1f%% saved\n",
+				source.GetSize(), bytes.size(), floatVertexBytes, quantizedVertexBytes,
+				100.0 * (1.0 - double(quantizedVertexBytes) / double(floatVertexBytes)));
+			std::printf("  contents:     %u vertices, %u indices, %u parts, %u materials\n",
+				header.vertexCount, header.indexCount, header.partCount, header.materialCount);
+			std::printf("  time:         %.3f ms to cook, %.3f ms to load against %.3f ms to parse the CMO\n",
+				cookTime * 1000.0, loadTime * 1000.0, parseTime * 1000.0);
+			std::printf("  vertex reuse: acmr %.3f -> %.3f, atvr %.3f -> %.3f, overfetch %.3f -> %.3f\n",
+				before.vertexCache.GetAcmr(), after.vertexCache.GetAcmr(),
+				before.vertexCache.GetAtvr(), after.vertexCache.GetAtvr(),
+				before.vertexFetch.GetOverfetch(), after.vertexFetch.GetOverfetch());
+
+			QuantizationError worst = {};
+			for (uint32_t mesh = 0; mesh < cooked.GetMeshCount(); ++mesh)
+			{
+				const auto error = MeasureQuantizationError(model, cooked, mesh);
+				std::printf("  %s: position %.6f (%.4f%% of radius), normal %.4f deg, tangent %.4f deg, uv %.6f\n",
+					cooked.GetString(cooked.GetMesh(mesh).name), error.position,
+					100.0 * error.position / cooked.GetMesh(mesh).radius, error.normalDegrees, error.tangentDegrees, error.textureCoordinate);
+
+				worst.position = std::max(worst.position, error.position);
+				worst.normalDegrees = std::max(worst.normalDegrees, error.normalDegrees);
+				worst.tangentDegrees = std::max(worst.tangentDegrees, error.tangentDegrees);
+				worst.textureCoordinate = std::max(worst.textureCoordinate, error.textureCoordinate);
+			}
+
+			report << asset << ',' << source.GetSize() << ',' << bytes.size() << ',' << floatVertexBytes << ',' << quantizedVertexBytes << ','
+				<< header.vertexCount << ',' << header.indexCount << ',' << header.partCount << ',' << header.materialCount << ','
+				<< cookTime * 1000.0 << ',' << parseTime * 1000.0 << ',' << loadTime * 1000.0 << ','
+				<< before.vertexCache.GetAcmr() << ',' << after.vertexCache.GetAcmr() << ','
+				<< before.vertexCache.GetAtvr() << ',' << after.vertexCache.GetAtvr() << ','
+				<< before.vertexFetch.GetOverfetch() << ',' << after.vertexFetch.GetOverfetch() << ','
+				<< worst.position << ',' << worst.normalDegrees << ',' << worst.tangentDegrees << ',' << worst.textureCoordinate << '\n';
+		}
+		catch (std::exception const& e)
+		{
+			Tools::Check(false, e.what());
+		}
+	}
+
+	std::printf("\nreport: %s\n", reportPath.string().c_str());
+	return Tools::Finish("cook meshes");
+}
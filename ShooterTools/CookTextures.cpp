@@ -0,0 +1,284 @@
+//
+// CookTextures.cpp - Cooks the game's PNG textures into block compressed DDS files and reports their quality and encode speed
+//
+
+#include "Tools.h"
+#include "PngReader.h"
+#include "TextureCooker.h"
+#include "../Shooter/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace TextureCooker;
+
+namespace
+{
+	// The textures Game::CreateDeviceDependentResources loads. The grid
+	// tiles across the room, so it's mipmapped and filtered with wrapping;
+	// the crosshairs are drawn at their size by the sprite batch, whose
+	// origins depend on it.
+	struct Asset
+	{
+		const char* name;
+		bool mips;
+		AddressMode addressMode;
+	};
+
+	const Asset c_assets[] =
+	{
+		{ "grid", true, AddressMode::Wrap },
+		{ "crosshair-v", false, AddressMode::Clamp },
+		{ "crosshair-h", false, AddressMode::Clamp },
+	};
+
+	const BlockCompression::Format c_formats[] =
+	{
+		BlockCompression::Format::BC1,
+		BlockCompression::Format::BC3,
+		BlockCompression::Format::BC7,
+	};
+
+	// Over RGB, and alpha too when the texture has any; BC1 keeps none.
+	double GetPsnr(Surface const& expected, Surface const& actual, bool alpha)
+	{
+		double squared = 0.0;
+		size_t count = 0;
+		for (size_t i = 0; i < expected.rgba.size(); ++i)
+		{
+			if (i % 4 == 3 && !alpha)
+				continue;
+
+			const double difference = double(expected.rgba[i]) - double(actual.rgba[i]);
+			squared += difference * difference;
+			++count;
+		}
+
+		if (squared == 0.0)
+			return INFINITY;
+		return 10.0 * std::log10(255.0 * 255.0 / (squared / double(count)));
+	}
+
+	double GetLinearMean(Surface const& surface, int channel)
+	{
+		double sum = 0.0;
+		for (size_t i = channel; i < surface.rgba.size(); i += 4)
+		{
+			const double value = surface.rgba[i] / 255.0;
+			sum += value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+		}
+		return sum / double(surface.rgba.size() / 4);
+	}
+
+	std::vector<std::vector<uint8_t>> CompressChain(std::vector<Surface> const& chain, BlockCompression::Format format, ThreadPool& pool)
+	{
+		std::vector<std::vector<uint8_t>> levels;
+		for (auto const& level : chain)
+		{
+			levels.push_back(Compress(level, format, pool));
+		}
+		return levels;
+	}
+
+	size_t GetPixelCount(std::vector<Surface> const& chain)
+	{
+		size_t pixels = 0;
+		for (auto const& level : chain)
+		{
+			pixels += size_t(level.width) * level.height;
+		}
+		return pixels;
+	}
+
+	// Solid blocks have encodings within a step of the color in every
+	// format, and two-color blocks separate cleanly in BC7.
+	void CheckEncoders()
+	{
+		std::mt19937 random(21);
+		int worstSolid[3] = {};
+		int worstTwoColor = 0;
+
+		for (int trial = 0; trial < 1000; ++trial)
+		{
+			uint8_t color[2][4];
+			for (auto& channels : color)
+			{
+				for (auto& channel : channels)
+				{
+					channel = uint8_t(random());
+				}
+				channels[3] = 255;
+			}
+
+			uint8_t solid[64];
+			uint8_t twoColor[64];
+			for (int pixel = 0; pixel < 16; ++pixel)
+			{
+				std::memcpy(solid + pixel * 4, color[0], 4);
+				std::memcpy(twoColor + pixel * 4, color[pixel % 4 < 2 ? 0 : 1], 4);
+			}
+
+			for (int format = 0; format < 3; ++format)
+			{
+				uint8_t block[16];
+				uint8_t decoded[64];
+				BlockCompression::Encode(c_formats[format], solid, block);
+				BlockCompression::Decode(c_formats[format], block, decoded);
+				for (int i = 0; i < 64; ++i)
+				{
+					worstSolid[format] = std::max(worstSolid[format], std::abs(int(decoded[i]) - int(solid[i])));
+				}
+			}
+
+			uint8_t block[16];
+			uint8_t decoded[64];
+			BlockCompression::Encode(BlockCompression::Format::BC7, twoColor, block);
+			BlockCompression::Decode(BlockCompression::Format::BC7, block, decoded);
+			for (int i = 0; i < 64; ++i)
+			{
+				worstTwoColor = std::max(worstTwoColor, std::abs(int(decoded[i]) - int(twoColor[i])));
+			}
+		}
+
+		std::printf("encoders: worst solid block error BC1 %d, BC3 %d, BC7 %d; two-color BC7 %d\n",
+			worstSolid[0], worstSolid[1], worstSolid[2], worstTwoColor);
+		Tools::Check(worstSolid[0] <= 2 && worstSolid[1] <= 2, "BC1 solid colors within 2");
+		Tools::Check(worstSolid[2] <= 1, "BC7 solid colors within 1");
+		Tools::Check(worstTwoColor <= 2, "BC7 two-color blocks within 2");
+
+		Surface uneven = { 6, 4, std::vector<uint8_t>(6 * 4 * 4, 255) };
+		Tools::Check(Tools::Throws<std::invalid_argument>([&]() { BuildMipChain(uneven, true, false, AddressMode::Clamp); }),
+			"unmipped texture that isn't a whole number of blocks rejected");
+	}
+}
+
+int RunCookTextures(int argc, char** argv)
+{
+	const std::filesystem::path outputDirectory = argc > 0 ? argv[0] : "Shooter/Assets";
+	const uint32_t threads = std::max(1u, static_cast<uint32_t>(Tools::GetArgument(argc, argv, 1, ThreadPool::GetDefaultWorkerCount() + 1)));
+	const std::string formatName = argc > 2 ? argv[2] : "auto";
+
+	bool autoFormat = formatName == "auto";
+	BlockCompression::Format chosenFormat = BlockCompression::Format::BC1;
+	if (!autoFormat)
+	{
+		auto const format = std::find_if(std::begin(c_formats), std::end(c_formats),
+			[&](BlockCompression::Format format) { return formatName == BlockCompression::GetName(format); });
+		if (format == std::end(c_formats))
+		{
+			std::printf("Unknown format %s; expected auto, BC1, BC3 or BC7\n", formatName.c_str());
+			return 1;
+		}
+		chosenFormat = *format;
+	}
+
+	ThreadPool pool(threads - 1);
+	ThreadPool single(0);
+
+	CheckEncoders();
+
+	const std::filesystem::path reportPath = outputDirectory / "texture-cook-report.csv";
+	std::ofstream report(reportPath);
+	report << "asset,format,width,height,mips,png bytes,rgba bytes,dds bytes,mip ms,psnr,"
+		"encode ms,threads,mpixels per second,single thread mpixels per second\n";
+
+	for (auto const& asset : c_assets)
+	{
+		const std::filesystem::path sourcePath = std::filesystem::path("Shooter/Assets") / (std::string(asset.name) + ".png");
+		const std::filesystem::path cookedPath = outputDirectory / (std::string(asset.name) + ".dds");
+		std::printf("\n%s:\n", cookedPath.filename().string().c_str());
+
+		try
+		{
+			const auto image = Png::Read(sourcePath);
+			const Surface source = { image.width, image.height, image.rgba };
+
+			auto start = std::chrono::steady_clock::now();
+			const auto chain = BuildMipChain(source, image.srgb, asset.mips, asset.addressMode);
+			const double mipTime = Tools::Seconds(start);
+
+			const bool opaque = IsOpaque(source);
+			const BlockCompression::Format format = autoFormat
+				? (opaque ? BlockCompression::Format::BC1 : BlockCompression::Format::BC3) : chosenFormat;
+			const size_t pixels = GetPixelCount(chain);
+
+			// What the WIC loader made of the PNG: the top level alone, as RGBA8.
+			const size_t pngBytes = size_t(std::filesystem::file_size(sourcePath));
+			const size_t rgbaBytes = source.rgba.size();
+
+			std::printf("  source:  %ux%u %s, %s, %zu bytes of PNG, %zu as RGBA8\n", source.width, source.height,
+				image.srgb ? "sRGB" : "linear", opaque ? "opaque" : "with alpha", pngBytes, rgbaBytes);
+			std::printf("  mips:    %zu levels from %ux%u in %.3f ms\n", chain.size(), chain.front().width, chain.front().height, mipTime * 1000.0);
+
+			if (chain.size() > 1)
+			{
+				// Filtering in linear light keeps the smallest mip as bright as
+				// the texture; averaging sRGB values would darken it.
+				auto const& smallest = chain.back();
+				double worst = 0.0;
+				for (int channel = 0; channel < 3; ++channel)
+				{
+					worst = std::max(worst, std::abs(GetLinearMean(smallest, channel) - GetLinearMean(source, channel)));
+				}
+				std::printf("  1x1 mip: linear mean within %.4f of the source's\n", worst);
+				Tools::Check(worst < 0.01, "smallest mip keeps the source's brightness");
+			}
+
+			std::vector<uint8_t> cooked;
+			for (auto const candidate : c_formats)
+			{
+				start = std::chrono::steady_clock::now();
+				const auto levels = CompressChain(chain, candidate, pool);
+				const double encodeTime = Tools::Seconds(start);
+
+				start = std::chrono::steady_clock::now();
+				const auto serial = CompressChain(chain, candidate, single);
+				const double serialTime = Tools::Seconds(start);
+				Tools::Check(serial == levels, "same blocks from one thread as from many");
+
+				const Surface decoded = Decompress(levels.front().data(), chain.front().width, chain.front().height, candidate);
+				const double psnr = GetPsnr(chain.front(), decoded, !opaque);
+
+				const auto dds = WriteDds(chain.front().width, chain.front().height, candidate, image.srgb, levels);
+				std::printf("  %s%s %7zu bytes, PSNR %6.2f dB, %7.1f Mpixel/s on %u threads, %6.1f on one\n",
+					BlockCompression::GetName(candidate), candidate == format ? "*:" : ": ", dds.size(), psnr,
+					pixels / encodeTime / 1e6, threads, pixels / serialTime / 1e6);
+
+				report << asset.name << ',' << BlockCompression::GetName(candidate) << ',' << chain.front().width << ','
+					<< chain.front().height << ',' << chain.size() << ',' << pngBytes << ',' << rgbaBytes << ',' << dds.size() << ','
+					<< mipTime * 1000.0 << ',' << psnr << ',' << encodeTime * 1000.0 << ',' << threads << ','
+					<< pixels / encodeTime / 1e6 << ',' << pixels / serialTime / 1e6 << '\n';
+
+				if (candidate == format)
+				{
+					cooked = dds;
+				}
+			}
+
+			std::ofstream output(cookedPath, std::ios::binary);
+			output.write(reinterpret_cast<const char*>(cooked.data()), std::streamsize(cooked.size()));
+			output.close();
+			if (!output)
+				throw std::runtime_error("Failed to write " + cookedPath.string());
+
+			std::printf("  wrote:   %s, %zu bytes of video memory against %zu as RGBA8\n",
+				BlockCompression::GetName(format), cooked.size() - DdsHeaderSize, rgbaBytes);
+		}
+		catch (std::exception const& e)
+		{
+			Tools::Check(false, e.what());
+		}
+	}
+
+	std::printf("\nreport: %s\n", reportPath.string().c_str());
+	return Tools::Finish("cook textures");
+}
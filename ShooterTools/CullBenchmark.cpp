@@ -0,0 +1,191 @@
+//
+// CullBenchmark.cpp - Times frustum culling of scene object bounds, checking the SIMD path against the scalar one
+//
+
+#include "Tools.h"
+
+#include "../Shooter/SceneRegistry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr float WorldSize = 1000.0f;
+	constexpr float TargetMs = 1.0f;
+
+	// Cull must keep everything the reference clearly sees and nothing it
+	// clearly doesn't; boxes on a plane can go either way.
+	bool Agrees(std::vector<uint32_t> const& simd, std::vector<uint32_t> const& visible, std::vector<uint32_t> const& uncertain)
+	{
+		if (!std::includes(simd.begin(), simd.end(), visible.begin(), visible.end()))
+			return false;
+
+		std::vector<uint32_t> extra;
+		std::set_difference(simd.begin(), simd.end(), visible.begin(), visible.end(), std::back_inserter(extra));
+		return std::includes(uncertain.begin(), uncertain.end(), extra.begin(), extra.end());
+	}
+
+	// The game's camera: 70 degree FOV at 16:9, looking from eye height.
+	Frustum GetFrustum(float yaw)
+	{
+		const XMVECTOR position = XMVectorSet(0.0f, 1.8f, 0.0f, 0.0f);
+		const XMVECTOR direction = XMVectorSet(std::sin(yaw), 0.0f, std::cos(yaw), 0.0f);
+
+		const XMMATRIX view = XMMatrixLookAtRH(position, XMVectorAdd(position, direction), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		const XMMATRIX proj = XMMatrixPerspectiveFovRH(XMConvertToRadians(70.0f), 16.0f / 9.0f, 0.01f, 500.0f);
+
+		return Frustum::FromViewProjection(XMMatrixMultiply(view, proj));
+	}
+
+	// Boxes up to a couple of metres across, scattered on the ground around
+	// the camera.
+	void Populate(SceneRegistry& registry, size_t count)
+	{
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-WorldSize / 2, WorldSize / 2);
+		std::uniform_real_distribution<float> height(0.0f, 20.0f);
+		std::uniform_real_distribution<float> extent(0.1f, 1.0f);
+
+		registry.Reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			registry.Add({ position(random), height(random), position(random) },
+				{ extent(random), extent(random), extent(random) });
+		}
+	}
+
+	void CheckCorners()
+	{
+		std::printf("corners:\n");
+
+		SceneRegistry registry;
+		const XMFLOAT3 small = { 0.5f, 0.5f, 0.5f };
+		const auto ahead = registry.Add({ 0.0f, 1.8f, 10.0f }, small);
+		const auto behind = registry.Add({ 0.0f, 1.8f, -10.0f }, small);
+		const auto beyond = registry.Add({ 0.0f, 1.8f, 600.0f }, small);
+		const auto straddling = registry.Add({ 0.0f, 1.8f, 0.0f }, small);
+
+		std::vector<uint32_t> visible;
+		registry.Cull(GetFrustum(0.0f), visible);
+
+		auto const isVisible = [&](SceneRegistry::Handle handle)
+		{
+			for (auto index : visible)
+			{
+				if (registry.GetHandle(index) == handle)
+					return true;
+			}
+			return false;
+		};
+
+		std::printf("  %zu of %zu visible\n", visible.size(), registry.GetSize());
+		Tools::Check(isVisible(ahead), "box ahead should be visible");
+		Tools::Check(!isVisible(behind), "box behind should be culled");
+		Tools::Check(!isVisible(beyond), "box past the far plane should be culled");
+		Tools::Check(isVisible(straddling), "box around the camera should be visible");
+
+		// Turning around swaps the first two.
+		registry.Cull(GetFrustum(XM_PI), visible);
+		Tools::Check(!isVisible(ahead) && isVisible(behind), "turning around swaps what's visible");
+	}
+
+	void CheckRemoval(size_t count)
+	{
+		std::printf("removal:\n");
+
+		SceneRegistry registry;
+		Populate(registry, count);
+
+		// Remove every third object, then add some back to reuse handles.
+		for (SceneRegistry::Handle handle = 0; handle < count; handle += 3)
+		{
+			registry.Remove(handle);
+		}
+		for (size_t i = 0; i < count / 10; ++i)
+		{
+			registry.Add({ float(i % 100) - 50.0f, 1.0f, float(i / 100) }, { 0.5f, 0.5f, 0.5f });
+		}
+
+		std::vector<uint32_t> simd;
+		std::vector<uint32_t> reference;
+		std::vector<uint32_t> uncertain;
+		for (float yaw = 0.0f; yaw < XM_2PI; yaw += 0.5f)
+		{
+			auto const frustum = GetFrustum(yaw);
+			registry.Cull(frustum, simd);
+			registry.CullReference(frustum, reference, uncertain);
+			Tools::Check(Agrees(simd, reference, uncertain), "SIMD cull differs from the reference after removals");
+		}
+
+		std::printf("  %zu objects, %zu visible\n", registry.GetSize(), simd.size());
+
+		bool thrown = false;
+		try
+		{
+			registry.Remove(0);
+		}
+		catch (std::out_of_range const&)
+		{
+			thrown = true;
+		}
+		Tools::Check(thrown, "removing a dead handle should throw");
+	}
+
+	template<typename Cull>
+	double Measure(uint32_t iterations, Cull cull)
+	{
+		double best = 1e9;
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			auto const start = std::chrono::steady_clock::now();
+			cull(XM_2PI * float(i) / float(iterations));
+			auto const elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = std::min(best, elapsed);
+		}
+		return best;
+	}
+}
+
+int RunCullBenchmark(int argc, char** argv)
+{
+	const size_t count = static_cast<size_t>(Tools::GetArgument(argc, argv, 0, 100000));
+	const uint32_t iterations = std::max(1u, static_cast<uint32_t>(Tools::GetArgument(argc, argv, 1, 200)));
+
+	CheckCorners();
+	CheckRemoval(std::min<size_t>(count, 10000));
+
+	SceneRegistry registry;
+	Populate(registry, count);
+
+	std::vector<uint32_t> simd;
+	std::vector<uint32_t> reference;
+	std::vector<uint32_t> uncertain;
+	simd.reserve(count + SceneRegistry::Lanes);
+	reference.reserve(count);
+
+	registry.Cull(GetFrustum(0.0f), simd);
+	registry.CullReference(GetFrustum(0.0f), reference, uncertain);
+	Tools::Check(Agrees(simd, reference, uncertain), "SIMD cull differs from the reference");
+	const size_t visible = simd.size();
+	const size_t onPlanes = uncertain.size();
+
+	const double simdMs = Measure(iterations, [&](float yaw) { registry.Cull(GetFrustum(yaw), simd); });
+	const double referenceMs = Measure(iterations, [&](float yaw) { registry.CullReference(GetFrustum(yaw), reference, uncertain); });
+
+	std::printf("\n%zu objects, %zu visible facing +z, %zu of them within rounding of a plane\n", count, visible, onPlanes);
+	std::printf("  simd:      %.3f ms per cull (best of %u), %s\n", simdMs, iterations, SceneRegistry::UsesAvx() ? "AVX" : "SSE");
+	std::printf("  reference: %.3f ms per cull (best of %u)\n", referenceMs, iterations);
+	std::printf("  speedup:   %.1fx, %s the %.1f ms target\n", referenceMs / simdMs,
+		simdMs <= TargetMs ? "within" : "OVER", TargetMs);
+
+	return Tools::Finish("cull");
+}
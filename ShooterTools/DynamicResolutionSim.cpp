@@ -0,0 +1,192 @@
+//
+// DynamicResolutionSim.cpp - Runs the dynamic resolution controller over synthetic frame time traces
+//
+
+#include "Tools.h"
+
+#include "../Shooter/DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t Frames = 1200;
+
+	// A scene's cost on each frame: GPU milliseconds at full resolution, of
+	// which fixedMs doesn't scale with the pixel count, and CPU milliseconds.
+	struct FrameCost
+	{
+		double gpuMs;
+		double fixedMs;
+		double cpuMs;
+	};
+
+	using Trace = FrameCost(*)(uint32_t frame, uint32_t& noise);
+
+	// Small deterministic jitter in [-1, 1].
+	double Jitter(uint32_t& state) noexcept
+	{
+		state = state * 1664525u + 1013904223u;
+		return double(state >> 8) / double(1u << 23) - 1.0;
+	}
+
+	struct Result
+	{
+		std::vector<float> scales;			// Scale each frame was rendered at
+		std::vector<double> gpuMs;			// GPU time of each frame at that scale
+		DynamicResolution::Stats stats;
+	};
+
+	// GPU times come back latency frames late, like the timestamp queries.
+	Result Run(Trace trace, double budgetMs, uint32_t latency)
+	{
+		DynamicResolution controller(DynamicResolution::GetDefaultSettings(budgetMs));
+
+		Result result;
+		std::deque<double> pending;
+		uint32_t noise = 12345;
+
+		for (uint32_t frame = 0; frame < Frames; ++frame)
+		{
+			auto const cost = trace(frame, noise);
+			const float scale = controller.GetScale();
+			const double gpuMs = cost.fixedMs + (cost.gpuMs - cost.fixedMs) * double(scale) * double(scale);
+
+			result.scales.push_back(scale);
+			result.gpuMs.push_back(gpuMs);
+
+			pending.push_back(gpuMs);
+			double resolved = -1.0;
+			if (pending.size() > latency)
+			{
+				resolved = pending.front();
+				pending.pop_front();
+			}
+
+			controller.AddFrame(cost.cpuMs, resolved);
+		}
+
+		result.stats = controller.GetStats();
+		return result;
+	}
+
+	uint32_t CountChanges(std::vector<float> const& scales, size_t begin, size_t end)
+	{
+		uint32_t changes = 0;
+		for (size_t i = std::max<size_t>(begin, 1); i < end; ++i)
+		{
+			changes += scales[i] != scales[i - 1] ? 1 : 0;
+		}
+		return changes;
+	}
+
+	uint32_t CountOverBudget(std::vector<double> const& gpuMs, double budgetMs, size_t begin, size_t end)
+	{
+		uint32_t over = 0;
+		for (size_t i = begin; i < end; ++i)
+		{
+			over += gpuMs[i] > budgetMs ? 1 : 0;
+		}
+		return over;
+	}
+
+	void Print(const char* title, Result const& result)
+	{
+		float lowest = 1.0f;
+		for (auto scale : result.scales)
+		{
+			lowest = std::min(lowest, scale);
+		}
+
+		std::printf("%s:\n", title);
+		std::printf("  final scale %.2f, lowest %.2f, %llu decreases, %llu increases\n",
+			result.scales.back(), lowest,
+			static_cast<unsigned long long>(result.stats.decreases), static_cast<unsigned long long>(result.stats.increases));
+		std::printf("  %llu of %llu GPU frames over budget, %llu CPU bound\n",
+			static_cast<unsigned long long>(result.stats.overBudgetFrames), static_cast<unsigned long long>(result.stats.gpuFrames),
+			static_cast<unsigned long long>(result.stats.cpuBoundFrames));
+	}
+}
+
+int RunDynamicResolutionSim(int argc, char** argv)
+{
+	const double budgetMs = double(Tools::GetArgument(argc, argv, 0, 16667)) / 1000.0;
+	const uint32_t latency = static_cast<uint32_t>(Tools::GetArgument(argc, argv, 1, 3));
+
+	std::printf("budget %.3f ms, GPU latency %u frames\n\n", budgetMs, latency);
+
+	// A scene 30% over budget at full resolution settles on the largest
+	// scale that fits and stays there.
+	{
+		auto const result = Run([](uint32_t, uint32_t& noise) -> FrameCost
+		{
+			return { 21.7 + 0.3 * Jitter(noise), 1.0, 8.0 };
+		}, budgetMs, latency);
+
+		Print("heavy scene", result);
+		Tools::Check(result.scales.back() < 1.0f, "scale should drop");
+		Tools::Check(CountChanges(result.scales, Frames / 4, Frames) == 0, "scale should settle");
+		Tools::Check(CountOverBudget(result.gpuMs, budgetMs, Frames / 4, Frames) == 0, "settled frames fit the budget");
+	}
+
+	// A light scene with a two second GPU spike: the drop is fast, the
+	// recovery slow, and it ends back at full resolution.
+	{
+		auto const result = Run([](uint32_t frame, uint32_t& noise) -> FrameCost
+		{
+			const bool spike = frame >= 200 && frame < 320;
+			return { (spike ? 28.0 : 11.0) + 0.2 * Jitter(noise), 1.0, 6.0 };
+		}, budgetMs, latency);
+
+		Print("spike", result);
+		Tools::Check(result.scales[200 + latency + 4] < 1.0f, "scale drops within a few frames of the spike");
+		Tools::Check(CountOverBudget(result.gpuMs, budgetMs, 200 + 2 * (latency + 4), 320) == 0, "spike frames fit once scaled");
+		Tools::Check(result.scales.back() == 1.0f, "scale recovers after the spike");
+	}
+
+	// A scene sitting just under budget with noise either side of it
+	// shouldn't make the scale bounce.
+	{
+		auto const result = Run([](uint32_t, uint32_t& noise) -> FrameCost
+		{
+			return { 16.0 + 1.2 * Jitter(noise), 1.0, 6.0 };
+		}, budgetMs, latency);
+
+		Print("near budget", result);
+		Tools::Check(CountChanges(result.scales, Frames / 4, Frames) <= 2, "hysteresis keeps the scale steady");
+	}
+
+	// CPU bound with a GPU spike: the scale drops for the spike but doesn't
+	// climb back while the CPU is over budget anyway.
+	{
+		auto const result = Run([](uint32_t frame, uint32_t& noise) -> FrameCost
+		{
+			const bool spike = frame >= 100 && frame < 160;
+			return { (spike ? 24.0 : 10.0) + 0.2 * Jitter(noise), 1.0, 22.0 };
+		}, budgetMs, latency);
+
+		Print("CPU bound", result);
+		Tools::Check(result.stats.decreases > 0, "GPU spike still lowers the scale");
+		Tools::Check(result.stats.increases == 0, "no increase while CPU bound");
+	}
+
+	// The same trace must give the same scales.
+	{
+		auto trace = [](uint32_t frame, uint32_t& noise) -> FrameCost
+		{
+			return { 14.0 + 6.0 * std::sin(frame * 0.01) + Jitter(noise), 1.0, 6.0 };
+		};
+
+		auto const first = Run(trace, budgetMs, latency);
+		auto const second = Run(trace, budgetMs, latency);
+
+		Print("slow swell", first);
+		Tools::Check(first.scales == second.scales, "deterministic");
+	}
+
+	return Tools::Finish("dynamic resolution");
+}
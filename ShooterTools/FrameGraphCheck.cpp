@@ -0,0 +1,279 @@
+//
+// FrameGraphCheck.cpp - Checks frame graph ordering, culling, lifetimes and aliasing
+//
+
+#include "Tools.h"
+
+#include "../Shooter/FrameGraph.h"
+#include "../Shooter/FrameQueue.h"
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	constexpr uint32_t FormatColor = 28;	// DXGI_FORMAT_R8G8B8A8_UNORM
+	constexpr uint32_t FormatHdr = 10;		// DXGI_FORMAT_R16G16B16A16_FLOAT
+
+	std::string GetOrder(FrameGraph const& graph)
+	{
+		std::string order;
+		for (auto pass : graph.GetOrder())
+		{
+			if (!order.empty())
+			{
+				order += ' ';
+			}
+			order += graph.GetPassName(pass);
+		}
+		return order;
+	}
+
+	bool HasLifetime(FrameGraph const& graph, FrameGraph::Handle resource, uint32_t first, uint32_t last)
+	{
+		auto const lifetime = graph.GetLifetime(resource);
+		return lifetime.first == first && lifetime.last == last;
+	}
+
+	// A post-processing chain, declared back to front so the graph has to
+	// order it, with a debug view nothing reads.
+	struct PostChain
+	{
+		FrameGraph::Handle hdr, half0, half1, half2, ldr, debug, backBuffer;
+	};
+
+	PostChain DeclarePostChain(FrameGraph& graph, uint32_t width, uint32_t height)
+	{
+		const RenderTargetDesc full = { width, height, FormatColor, 1 };
+		const RenderTargetDesc fullHdr = { width, height, FormatHdr, 1 };
+		const RenderTargetDesc half = { width / 2, height / 2, FormatHdr, 1 };
+
+		PostChain chain;
+		chain.backBuffer = graph.Import("backbuffer", true);
+		chain.hdr = graph.CreateTransient("hdr", fullHdr);
+		chain.half0 = graph.CreateTransient("half0", half);
+		chain.half1 = graph.CreateTransient("half1", half);
+		chain.half2 = graph.CreateTransient("half2", half);
+		chain.ldr = graph.CreateTransient("ldr", full);
+		chain.debug = graph.CreateTransient("debug", full);
+
+		auto const fxaa = graph.AddPass("fxaa", 0, nullptr, nullptr);
+		graph.Read(fxaa, chain.ldr);
+		graph.Write(fxaa, chain.backBuffer);
+
+		auto const tonemap = graph.AddPass("tonemap", 0, nullptr, nullptr);
+		graph.Read(tonemap, chain.hdr);
+		graph.Read(tonemap, chain.half2);
+		graph.Write(tonemap, chain.ldr);
+
+		auto const debug = graph.AddPass("debug", 0, nullptr, nullptr);
+		graph.Read(debug, chain.hdr);
+		graph.Write(debug, chain.debug);
+
+		auto const blurV = graph.AddPass("blurV", 0, nullptr, nullptr);
+		graph.Read(blurV, chain.half1);
+		graph.Write(blurV, chain.half2);
+
+		auto const blurH = graph.AddPass("blurH", 0, nullptr, nullptr);
+		graph.Read(blurH, chain.half0);
+		graph.Write(blurH, chain.half1);
+
+		auto const downsample = graph.AddPass("downsample", 0, nullptr, nullptr);
+		graph.Read(downsample, chain.hdr);
+		graph.Write(downsample, chain.half0);
+
+		auto const scene = graph.AddPass("scene", 0, nullptr, nullptr);
+		graph.Write(scene, chain.hdr);
+
+		return chain;
+	}
+
+	void CheckPostChain()
+	{
+		std::printf("post chain:\n");
+
+		FrameGraph graph;
+		auto const chain = DeclarePostChain(graph, 1920, 1080);
+		graph.Compile();
+
+		std::printf("  order:    %s\n", GetOrder(graph).c_str());
+		for (FrameGraph::Handle resource : { chain.hdr, chain.half0, chain.half1, chain.half2, chain.ldr, chain.debug })
+		{
+			auto const lifetime = graph.GetLifetime(resource);
+			if (lifetime.first == FrameGraph::InvalidHandle)
+			{
+				std::printf("  %-8s  unused\n", graph.GetResourceName(resource));
+			}
+			else
+			{
+				std::printf("  %-8s  passes %u-%u, physical %u\n", graph.GetResourceName(resource),
+					lifetime.first, lifetime.last, graph.GetPhysicalIndex(resource));
+			}
+		}
+
+		Tools::Check(GetOrder(graph) == "scene downsample blurH blurV tonemap fxaa", "post chain order");
+		Tools::Check(graph.IsCulled(2), "debug pass should be culled");
+
+		Tools::Check(HasLifetime(graph, chain.hdr, 0, 4), "hdr lifetime");
+		Tools::Check(HasLifetime(graph, chain.half0, 1, 2), "half0 lifetime");
+		Tools::Check(HasLifetime(graph, chain.half1, 2, 3), "half1 lifetime");
+		Tools::Check(HasLifetime(graph, chain.half2, 3, 4), "half2 lifetime");
+		Tools::Check(HasLifetime(graph, chain.ldr, 4, 5), "ldr lifetime");
+		Tools::Check(HasLifetime(graph, chain.debug, FrameGraph::InvalidHandle, FrameGraph::InvalidHandle), "debug target unused");
+
+		// half2 starts after half0's last use and matches it; half1 overlaps both.
+		Tools::Check(graph.GetPhysicalIndex(chain.half2) == graph.GetPhysicalIndex(chain.half0), "half2 should alias half0");
+		Tools::Check(graph.GetPhysicalIndex(chain.half1) != graph.GetPhysicalIndex(chain.half0), "half1 overlaps half0");
+		Tools::Check(graph.GetPhysicalIndex(chain.ldr) != graph.GetPhysicalIndex(chain.hdr), "ldr and hdr differ in format");
+		Tools::Check(graph.GetPhysicalIndex(chain.debug) == FrameGraph::InvalidHandle, "debug target gets no memory");
+		Tools::Check(graph.GetPhysicalCount() == 4, "5 transient targets fit in 4");
+
+		std::printf("  targets:  %zu physical for 5 transient\n", graph.GetPhysicalCount());
+	}
+
+	void CheckReadModifyWrite()
+	{
+		std::printf("read-modify-write:\n");
+
+		FrameGraph graph;
+		auto const backBuffer = graph.Import("backbuffer", true);
+
+		auto const scene = graph.AddPass("scene", 0, nullptr, nullptr);
+		graph.Write(scene, backBuffer);
+
+		auto const decals = graph.AddPass("decals", 0, nullptr, nullptr);
+		graph.Read(decals, backBuffer);
+		graph.Write(decals, backBuffer);
+
+		auto const ui = graph.AddPass("ui", 0, nullptr, nullptr);
+		graph.Write(ui, backBuffer);
+
+		graph.Compile();
+		std::printf("  order:    %s\n", GetOrder(graph).c_str());
+		Tools::Check(GetOrder(graph) == "scene decals ui", "writers keep declaration order");
+	}
+
+	void CheckCycle()
+	{
+		std::printf("cycle:\n");
+
+		FrameGraph graph;
+		auto const backBuffer = graph.Import("backbuffer", true);
+		auto const a = graph.CreateTransient("a", { 64, 64, FormatColor, 1 });
+		auto const b = graph.CreateTransient("b", { 64, 64, FormatColor, 1 });
+
+		auto const first = graph.AddPass("first", 0, nullptr, nullptr);
+		graph.Read(first, b);
+		graph.Write(first, a);
+		graph.Write(first, backBuffer);
+
+		auto const second = graph.AddPass("second", 0, nullptr, nullptr);
+		graph.Read(second, a);
+		graph.Write(second, b);
+
+		bool thrown = false;
+		try
+		{
+			graph.Compile();
+		}
+		catch (std::logic_error const& e)
+		{
+			std::printf("  rejected: %s\n", e.what());
+			thrown = true;
+		}
+		Tools::Check(thrown, "cycle should be rejected");
+	}
+
+	// The game's passes run through the graph one by one should produce the
+	// same sequence as submitting the whole queue.
+	struct GameFrame
+	{
+		RenderQueue queue;
+		RecordingRenderBackend backend;
+		FrameQueue::Resources resources;
+		bool sawTexture;
+	};
+
+	void CheckGameFrame(ViewmodelMode mode, bool upscale, const char* title)
+	{
+		std::printf("%s:\n", title);
+
+		FrameQueue::Draws draws = {};
+
+		GameFrame frame;
+		frame.sawTexture = false;
+		FrameQueue::Build(frame.queue, mode, upscale, SortKey::QuantizeDepth(10.0f, 5000.0f), draws);
+		frame.queue.Sort();
+
+		RecordingRenderBackend expected;
+		frame.queue.Submit(expected);
+
+		FrameGraph graph;
+		frame.resources = FrameQueue::DeclarePasses(graph, mode, upscale, { 1920, 1080, FormatColor, 1 },
+			[](void* context, FrameGraph const& graph, uint32_t pass)
+		{
+			auto& frame = *static_cast<GameFrame*>(context);
+			if (frame.resources.viewmodelTexture != FrameGraph::InvalidHandle)
+			{
+				frame.sawTexture |= graph.GetTarget(frame.resources.viewmodelTexture) != nullptr;
+			}
+			frame.queue.SubmitPass(frame.backend, pass);
+		}, &frame);
+		graph.Compile();
+
+		NullRenderTargetDevice device;
+		RenderTargetPool pool(device);
+		graph.Execute(pool);
+
+		std::printf("  order:    %s\n", GetOrder(graph).c_str());
+		Tools::Check(frame.backend.GetCommands() == expected.GetCommands(), "pass-by-pass submission differs from Submit");
+		Tools::Check(pool.GetStats().inUseBytes == 0, "targets released after the frame");
+
+		// The render texture and the scene target overlap, so they can't share.
+		const uint64_t targets = (mode == ViewmodelMode::RenderTexture ? 1 : 0) + (upscale ? 1 : 0);
+		Tools::Check(pool.GetStats().created == targets, "one pooled target each for the render texture and scene");
+		Tools::Check(graph.GetPhysicalCount() == targets, "render texture and scene target overlap");
+
+		if (mode == ViewmodelMode::RenderTexture)
+		{
+			Tools::Check(frame.sawTexture, "render texture available while passes run");
+		}
+	}
+
+	void MeasureCompile(uint32_t iterations)
+	{
+		FrameGraph graph;
+		auto const start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; ++i)
+		{
+			graph.Reset();
+			DeclarePostChain(graph, 1920, 1080);
+			graph.Compile();
+		}
+		auto const elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		std::printf("\ndeclare + compile: %.2f us per frame (%u frames)\n", elapsed / iterations, iterations);
+	}
+}
+
+int RunFrameGraph(int argc, char** argv)
+{
+	const uint32_t iterations = static_cast<uint32_t>(Tools::GetArgument(argc, argv, 0, 100000));
+
+	CheckPostChain();
+	CheckReadModifyWrite();
+	CheckCycle();
+	CheckGameFrame(ViewmodelMode::DepthPartition, false, "depth partition frame");
+	CheckGameFrame(ViewmodelMode::RenderTexture, false, "render texture frame");
+	CheckGameFrame(ViewmodelMode::DepthPartition, true, "depth partition frame, upscaled");
+	CheckGameFrame(ViewmodelMode::RenderTexture, true, "render texture frame, upscaled");
+
+	if (iterations > 0)
+	{
+		MeasureCompile(iterations);
+	}
+
+	return Tools::Finish("frame graph");
+}
@@ -0,0 +1,261 @@
+//
+// FrameRingBenchmark.cpp - Checks the frame ring allocator's alignment, wraparound and fencing, then times it
+//
+
+#include "Tools.h"
+
+#include "../Shooter/FrameRingAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	template<typename Exception, typename Call>
+	bool Throws(Call call)
+	{
+		try
+		{
+			call();
+		}
+		catch (Exception const&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	void CheckAlignment()
+	{
+		std::printf("alignment:\n");
+
+		FrameRingAllocator ring(4096, 2);
+		Tools::Check(ring.Allocate(3, 1) == 0, "first allocation should start at 0");
+		Tools::Check(ring.Allocate(16, 16) == 16, "16 byte alignment should skip to 16");
+		Tools::Check(ring.Allocate(1, 256) == 256, "constant alignment should skip to 256");
+		Tools::Check(ring.Allocate(8, 8) == 264, "8 byte allocation should follow directly");
+		Tools::Check(ring.GetUsedBytes() == 272, "padding should count as used");
+		Tools::Check(ring.GetStats().paddingBytes == 272 - 28, "padding should be reported");
+
+		Tools::Check(Tools::Throws<std::invalid_argument>([&] { ring.Allocate(16, 0); }), "zero alignment should throw");
+		Tools::Check(Tools::Throws<std::invalid_argument>([&] { ring.Allocate(16, 24); }), "non power of two alignment should throw");
+		Tools::Check(Tools::Throws<std::invalid_argument>([] { FrameRingAllocator(0, 2); }), "zero capacity should throw");
+		Tools::Check(Tools::Throws<std::invalid_argument>([] { FrameRingAllocator(64, 0); }), "zero frames in flight should throw");
+
+		std::printf("  %s\n", Tools::Passed() ? "ok" : "failed");
+	}
+
+	void CheckWraparound()
+	{
+		std::printf("wraparound:\n");
+
+		FrameRingAllocator ring(1000, 3);
+
+		// Frame 1 takes [0, 400), frame 2 [400, 800).
+		Tools::Check(ring.Allocate(400, 16) == 0, "frame 1 should start at 0");
+		ring.EndFrame(1);
+		Tools::Check(ring.Allocate(400, 16) == 400, "frame 2 should follow frame 1");
+		ring.EndFrame(2);
+
+		// 300 bytes don't fit in the 200 byte tail, and the front is frame 1's.
+		Tools::Check(ring.Allocate(300, 16) == FrameRingAllocator::InvalidOffset, "front is still in use");
+		Tools::Check(ring.GetStats().failures == 1, "failure should be counted");
+
+		// Once frame 1 retires the allocation skips the tail and starts over.
+		ring.Retire(1);
+		Tools::Check(ring.Allocate(300, 16) == 0, "allocation should wrap to 0");
+		Tools::Check(ring.GetStats().wraps == 1, "wrap should be counted");
+		Tools::Check(ring.GetUsedBytes() == 400 + 200 + 300, "skipped tail should count as used");
+
+		// It can't run into frame 2.
+		Tools::Check(ring.Allocate(101, 1) == FrameRingAllocator::InvalidOffset, "wrapped head must stop at frame 2");
+		Tools::Check(ring.Allocate(100, 1) == 300, "the gap before frame 2 should be usable");
+		ring.EndFrame(3);
+
+		// Retiring everything frees the skipped tail with the frame that skipped it.
+		ring.Retire(3);
+		Tools::Check(ring.GetUsedBytes() == 0, "retiring every frame should free everything");
+		Tools::Check(ring.Allocate(1000, 1) == 0, "an empty ring should start over at the front");
+
+		// Exactly full, then an allocation the size of the ring never fits beside anything.
+		Tools::Check(ring.Allocate(1, 1) == FrameRingAllocator::InvalidOffset, "a full ring should fail");
+		Tools::Check(ring.Allocate(1001, 1) == FrameRingAllocator::InvalidOffset, "oversized allocations should fail");
+
+		std::printf("  %s\n", Tools::Passed() ? "ok" : "failed");
+	}
+
+	void CheckFencing()
+	{
+		std::printf("fencing:\n");
+
+		FrameRingAllocator ring(1024, 2);
+		ring.Allocate(100, 1);
+		ring.EndFrame(5);
+		ring.Allocate(100, 1);
+		ring.EndFrame(9);
+
+		Tools::Check(ring.GetPendingFrameCount() == 2, "two frames should be pending");
+		Tools::Check(ring.GetOldestPendingFence() == 5, "oldest fence should be the first frame's");
+		Tools::Check(Tools::Throws<std::logic_error>([&] { ring.EndFrame(10); }), "a third frame in flight should throw");
+		Tools::Check(Tools::Throws<std::invalid_argument>([&] { ring.Retire(9); ring.EndFrame(9); }), "fences must increase");
+
+		FrameRingAllocator partial(1024, 4);
+		for (uint64_t fence = 1; fence <= 3; ++fence)
+		{
+			partial.Allocate(100, 1);
+			partial.EndFrame(fence);
+		}
+		partial.Retire(0);
+		Tools::Check(partial.GetPendingFrameCount() == 3, "no frame is done before its fence");
+		partial.Retire(2);
+		Tools::Check(partial.GetPendingFrameCount() == 1 && partial.GetOldestPendingFence() == 3, "frames retire up to the fence");
+		Tools::Check(partial.GetUsedBytes() == 100, "retired frames free their bytes");
+
+		std::printf("  %s\n", Tools::Passed() ? "ok" : "failed");
+	}
+
+	struct Range
+	{
+		uint64_t frame;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// A GPU running up to framesInFlight frames behind, at a random pace,
+	// with a random mix of constant, instance and sprite allocations each
+	// frame. No allocation may overlap one from a frame the GPU hasn't
+	// finished.
+	void Simulate(uint64_t frames, uint32_t framesInFlight, uint64_t capacity)
+	{
+		std::printf("simulation:\n");
+
+		FrameRingAllocator ring(capacity, framesInFlight);
+
+		std::mt19937 random(1234);
+		std::uniform_int_distribution<uint32_t> allocationCount(1, 24);
+		std::uniform_int_distribution<uint32_t> kind(0, 2);
+		std::uniform_int_distribution<uint64_t> constantSize(16, 512);
+		std::uniform_int_distribution<uint64_t> instanceSize(48, 48 * 512);
+		std::uniform_int_distribution<uint64_t> spriteSize(96, 96 * 64);
+		std::uniform_int_distribution<uint32_t> gpuProgress(0, 2);
+
+		std::deque<Range> live;
+		uint64_t completed = 0;
+		uint64_t waits = 0;
+		bool overlap = false;
+		bool misaligned = false;
+
+		for (uint64_t frame = 1; frame <= frames; ++frame)
+		{
+			// The GPU catches up on zero to two frames; the CPU waits when it
+			// would get more than framesInFlight ahead.
+			completed = std::min(frame - 1, completed + gpuProgress(random));
+			if (frame - 1 - completed >= framesInFlight)
+			{
+				completed = frame - framesInFlight;
+				waits++;
+			}
+			ring.Retire(completed);
+			while (!live.empty() && live.front().frame <= completed)
+			{
+				live.pop_front();
+			}
+
+			const uint32_t count = allocationCount(random);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				uint64_t size = 0;
+				uint64_t alignment = 0;
+				switch (kind(random))
+				{
+				case 0: size = constantSize(random); alignment = 256; break;
+				case 1: size = instanceSize(random); alignment = 16; break;
+				default: size = spriteSize(random); alignment = 4; break;
+				}
+
+				uint64_t offset = ring.Allocate(size, alignment);
+				while (offset == FrameRingAllocator::InvalidOffset && completed + 1 < frame)
+				{
+					// Out of room: wait for the oldest frame, as D3D11FrameRing does.
+					completed++;
+					waits++;
+					ring.Retire(completed);
+					while (!live.empty() && live.front().frame <= completed)
+					{
+						live.pop_front();
+					}
+					offset = ring.Allocate(size, alignment);
+				}
+
+				if (offset == FrameRingAllocator::InvalidOffset)
+					continue;
+
+				misaligned = misaligned || (offset % alignment) != 0 || offset + size > capacity;
+				for (auto const& range : live)
+				{
+					overlap = overlap || (offset < range.offset + range.size && range.offset < offset + size);
+				}
+				live.push_back({ frame, offset, size });
+			}
+
+			ring.EndFrame(frame);
+		}
+
+		auto const& stats = ring.GetStats();
+		std::printf("  %llu frames, %llu allocations, %llu wraps, %llu waits, %.1f%% padding\n",
+			static_cast<unsigned long long>(frames), static_cast<unsigned long long>(stats.allocations),
+			static_cast<unsigned long long>(stats.wraps), static_cast<unsigned long long>(waits),
+			100.0 * double(stats.paddingBytes) / double(stats.allocatedBytes + stats.paddingBytes));
+
+		Tools::Check(!overlap, "an allocation overlapped one the GPU may still read");
+		Tools::Check(!misaligned, "an allocation was misaligned or past the end");
+		// With a single frame in flight the ring is empty at every frame start and never wraps.
+		Tools::Check(framesInFlight == 1 || stats.wraps > 0, "the simulation should wrap");
+	}
+
+	double MeasureAllocations(uint64_t count)
+	{
+		FrameRingAllocator ring(64 * 1024 * 1024, 3);
+
+		// Constant-sized allocations, a frame's worth at a time.
+		constexpr uint64_t PerFrame = 1024;
+		uint64_t fence = 0;
+		uint64_t failures = 0;
+
+		auto const start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < count; i += PerFrame)
+		{
+			for (uint64_t j = 0; j < PerFrame; ++j)
+			{
+				failures += ring.Allocate(256, 256) == FrameRingAllocator::InvalidOffset;
+			}
+			ring.EndFrame(++fence);
+			ring.Retire(fence > 2 ? fence - 2 : 0);
+		}
+		auto const elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		Tools::Check(failures == 0, "a ring three frames deep should never fill up");
+		return elapsed / double(count);
+	}
+}
+
+int RunFrameRingBenchmark(int argc, char** argv)
+{
+	const uint64_t frames = std::max<uint64_t>(1, Tools::GetArgument(argc, argv, 0, 20000));
+	const uint32_t framesInFlight = std::max(1u, static_cast<uint32_t>(Tools::GetArgument(argc, argv, 1, 3)));
+
+	CheckAlignment();
+	CheckWraparound();
+	CheckFencing();
+	Simulate(frames, framesInFlight, 256 * 1024);
+
+	const double ns = MeasureAllocations(10000000);
+	std::printf("\nallocate: %.2f ns per allocation\n", ns);
+
+	return Tools::Finish("frame ring");
+}
@@ -0,0 +1,105 @@
+//
+// FrameSequence.cpp - Checks the draw sequence of each viewmodel mode
+//
+
+#include "Tools.h"
+
+#include "../Shooter/FrameQueue.h"
+
+#include <cstdio>
+
+using namespace FrameQueue;
+
+namespace
+{
+	using Command = RecordingRenderBackend::Command;
+	using CommandType = RecordingRenderBackend::CommandType;
+
+	std::vector<Command> Record(ViewmodelMode mode)
+	{
+		Draws draws = {};
+
+		RenderQueue queue;
+		Build(queue, mode, false, SortKey::QuantizeDepth(10.0f, 5000.0f), draws);
+		queue.Sort();
+
+		RecordingRenderBackend backend;
+		queue.Submit(backend);
+		return backend.GetCommands();
+	}
+
+	void Print(const char* title, std::vector<Command> const& commands)
+	{
+		std::printf("%s:\n", title);
+		for (auto const& command : commands)
+		{
+			std::printf("  %-16s %u\n", RecordingRenderBackend::GetCommandName(command.type), command.value);
+		}
+	}
+
+	// Target each packet was drawn into, in draw order.
+	std::vector<std::pair<uint32_t, uint32_t>> GetDraws(std::vector<Command> const& commands)
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> draws;
+		uint32_t target = UINT32_MAX;
+		for (auto const& command : commands)
+		{
+			if (command.type == CommandType::SetRenderTarget)
+			{
+				target = command.value;
+			}
+			else if (command.type == CommandType::Draw)
+			{
+				draws.emplace_back(command.value, target);
+			}
+		}
+		return draws;
+	}
+}
+
+int RunFrameSequence(int argc, char** argv)
+{
+	const uint64_t width = Tools::GetArgument(argc, argv, 0, 3840);
+	const uint64_t height = Tools::GetArgument(argc, argv, 1, 2160);
+
+	auto const partition = Record(ViewmodelMode::DepthPartition);
+	auto const texture = Record(ViewmodelMode::RenderTexture);
+
+	Print("depth partition", partition);
+	Print("render texture", texture);
+
+	const std::vector<std::pair<uint32_t, uint32_t>> expectedPartition =
+	{
+		{ PACKET_ROOM, TARGET_SCENE },
+		{ PACKET_WEAPON, TARGET_VIEWMODEL },
+		{ PACKET_COMPOSITE, TARGET_BACKBUFFER },
+	};
+
+	const std::vector<std::pair<uint32_t, uint32_t>> expectedTexture =
+	{
+		{ PACKET_WEAPON, TARGET_VIEWMODEL_TEXTURE },
+		{ PACKET_ROOM, TARGET_SCENE },
+		{ PACKET_COMPOSITE, TARGET_BACKBUFFER },
+	};
+
+	const bool partitionOk = GetDraws(partition) == expectedPartition;
+	const bool textureOk = GetDraws(texture) == expectedTexture;
+
+	// What the render texture path adds per frame, at 4 bytes per pixel: a
+	// clear, then the composite reads the texture and blends it over the
+	// back buffer (read and write). Ignores framebuffer compression.
+	const double pixels = double(width) * double(height);
+	const double extraBytes = pixels * 4.0 * 4.0;
+
+	std::printf("\nrender texture overhead at %llux%llu (estimate):\n",
+		static_cast<unsigned long long>(width), static_cast<unsigned long long>(height));
+	std::printf("  full-screen passes:  2 (clear, composite)\n");
+	std::printf("  pixels shaded:       %.1f M per frame\n", pixels / 1e6);
+	std::printf("  memory traffic:      %.1f MB per frame, %.2f GB/s at 60 Hz\n", extraBytes / 1e6, extraBytes * 60.0 / 1e9);
+	std::printf("  render texture:      %.1f MB resident\n", pixels * 4.0 / 1e6);
+
+	std::printf("\npartition sequence: %s\n", partitionOk ? "ok" : "UNEXPECTED");
+	std::printf("texture sequence:   %s\n", textureOk ? "ok" : "UNEXPECTED");
+
+	return partitionOk && textureOk ? 0 : 1;
+}
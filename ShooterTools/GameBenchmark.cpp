@@ -0,0 +1,299 @@
+//
+// GameBenchmark.cpp - The game's scripted benchmark against a null renderer
+//
+
+#include "Tools.h"
+
+#include "../Shooter/Benchmark.h"
+#include "../Shooter/FrameQueue.h"
+#include "../Shooter/GpuProfiler.h"
+#include "../Shooter/RenderTargetPool.h"
+#include "../Shooter/StepTimer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+using namespace FrameQueue;
+
+namespace
+{
+	constexpr float FarPlane = 5000.0f;
+	constexpr uint32_t FormatColor = 87;	// DXGI_FORMAT_B8G8R8A8_UNORM
+
+	// Times each queue pass under its FrameQueue name, as D3D11RenderBackend
+	// does, and runs the draws.
+	class ProfilingBackend final : public IRenderBackend
+	{
+	public:
+		explicit ProfilingBackend(IGpuProfiler& profiler) noexcept : m_profiler(profiler) {}
+
+		void BeginPass(uint32_t pass) override { m_profiler.BeginPass(GetPassName(pass)); }
+		void EndPass(uint32_t) override { m_profiler.EndPass(); }
+
+		void SetRenderTarget(uint32_t) override {}
+		void SetShader(uint32_t) override {}
+		void SetMaterial(uint32_t) override {}
+
+		void Draw(RenderPacket const& packet) override { packet.draw(packet.context, packet.param); }
+
+	private:
+		IGpuProfiler& m_profiler;
+	};
+
+	// Submits a frame the way Game::Render does, without a device: the same
+	// packets, run and timed pass by pass by the same frame graph, with
+	// draws that build the transforms the game's would.
+	class NullRenderer
+	{
+	public:
+		NullRenderer(ViewmodelMode mode, bool upscale) :
+			m_mode(mode),
+			m_upscale(upscale),
+			m_pool(m_targetDevice),
+			m_backend(m_gpuProfiler),
+			m_player(nullptr),
+			m_checksum(0.0f)
+		{
+			m_proj = XMMatrixPerspectiveFovRH(XMConvertToRadians(PlayerSimulation::HipfireFov), 16.0f / 9.0f, 0.01f, FarPlane);
+			m_viewProj = m_weapon = XMMatrixIdentity();
+		}
+
+		void Render(PlayerState const& player)
+		{
+			m_player = &player;
+
+			m_gpuProfiler.BeginFrame();
+
+			{
+				GpuPassScope pass(&m_gpuProfiler, "Clear");
+			}
+
+			Draws draws;
+			draws.weapon = [](void* renderer, uint32_t) { static_cast<NullRenderer*>(renderer)->DrawWeapon(); };
+			draws.room = [](void* renderer, uint32_t) { static_cast<NullRenderer*>(renderer)->DrawRoom(); };
+			draws.composite = [](void* renderer, uint32_t) { static_cast<NullRenderer*>(renderer)->DrawComposite(); };
+			draws.upscale = [](void*, uint32_t) {};
+			draws.context = this;
+
+			const float roomDistance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&player.position)));
+
+			m_queue.Clear();
+			Build(m_queue, m_mode, m_upscale, SortKey::QuantizeDepth(roomDistance, FarPlane), draws);
+			m_queue.Sort();
+
+			const RenderTargetDesc output = { 1920, 1080, FormatColor, 1 };
+
+			m_graph.Reset();
+			DeclarePasses(m_graph, m_mode, m_upscale, output,
+				[](void* renderer, FrameGraph const&, uint32_t pass) { static_cast<NullRenderer*>(renderer)->ExecutePass(pass); }, this);
+			m_graph.Compile();
+			m_graph.Execute(m_pool);
+
+			m_gpuProfiler.EndFrame();
+			m_pool.EndFrame();
+		}
+
+		// The frame graph's passes in the order it ran them last frame.
+		std::vector<const char*> GetGraphOrder() const
+		{
+			std::vector<const char*> names;
+			for (auto const pass : m_graph.GetOrder())
+			{
+				names.push_back(m_graph.GetPassName(pass));
+			}
+			return names;
+		}
+
+		float GetChecksum() const noexcept { return m_checksum; }
+		IGpuProfiler const& GetGpuProfiler() const noexcept { return m_gpuProfiler; }
+
+	private:
+		void ExecutePass(uint32_t pass)
+		{
+			m_queue.SubmitPass(m_backend, pass);
+		}
+
+		void DrawWeapon()
+		{
+			m_weapon = PlayerSimulation::GetWeaponMatrix(*m_player);
+		}
+
+		void DrawRoom()
+		{
+			m_viewProj = XMMatrixMultiply(PlayerSimulation::GetViewMatrix(*m_player), m_proj);
+		}
+
+		void DrawComposite()
+		{
+			XMFLOAT4X4 sink;
+			XMStoreFloat4x4(&sink, XMMatrixMultiply(m_weapon, m_viewProj));
+			m_checksum += sink.m[3][0] + m_player->crosshairSpread;
+		}
+
+		ViewmodelMode m_mode;
+		bool m_upscale;
+
+		NullRenderTargetDevice m_targetDevice;
+		RenderTargetPool m_pool;
+		NullGpuProfiler m_gpuProfiler;
+		ProfilingBackend m_backend;
+		RenderQueue m_queue;
+		FrameGraph m_graph;
+
+		PlayerState const* m_player;
+		XMMATRIX m_proj;
+		XMMATRIX m_viewProj;
+		XMMATRIX m_weapon;
+		float m_checksum;
+	};
+
+	// Every mode's frame times the clear and then the frame graph's passes,
+	// in the graph's order.
+	void CheckPasses()
+	{
+		struct Case
+		{
+			const char* title;
+			ViewmodelMode mode;
+			bool upscale;
+			std::vector<const char*> expected;
+		};
+
+		const Case cases[] =
+		{
+			{ "depth partition", ViewmodelMode::DepthPartition, false, { "Clear", "Room", "Weapon", "Composite" } },
+			{ "depth partition, upscaled", ViewmodelMode::DepthPartition, true, { "Clear", "Room", "Weapon", "Upscale", "Composite" } },
+			{ "render texture", ViewmodelMode::RenderTexture, false, { "Clear", "Weapon", "Room", "Composite" } },
+			{ "render texture, upscaled", ViewmodelMode::RenderTexture, true, { "Clear", "Weapon", "Room", "Upscale", "Composite" } },
+		};
+
+		std::printf("passes:\n");
+
+		PlayerSimulation player;
+		for (auto const& test : cases)
+		{
+			NullRenderer renderer(test.mode, test.upscale);
+			renderer.Render(player.GetState());
+			renderer.Render(player.GetState());
+
+			auto const& timings = renderer.GetGpuProfiler().GetPassTimings();
+			auto const graph = renderer.GetGraphOrder();
+
+			std::printf("  %-26s", test.title);
+			for (auto const& pass : timings)
+			{
+				std::printf(" %s", pass.name);
+			}
+			std::printf("\n");
+
+			bool asExpected = timings.size() == test.expected.size();
+			bool followsGraph = timings.size() == graph.size() + 1 && std::strcmp(timings[0].name, "Clear") == 0;
+			for (size_t i = 0; i < timings.size(); ++i)
+			{
+				asExpected = asExpected && std::strcmp(timings[i].name, test.expected[i]) == 0;
+				followsGraph = followsGraph && (i == 0 || std::strcmp(timings[i].name, graph[i - 1]) == 0);
+			}
+			Tools::Check(asExpected, "GPU passes in the expected order");
+			Tools::Check(followsGraph, "GPU passes follow the frame graph");
+		}
+	}
+
+	// Unbalanced and nested passes and frames are caught.
+	void CheckMisuse()
+	{
+		NullGpuProfiler profiler;
+		Tools::Check(Tools::Throws<std::logic_error>([&]() { profiler.BeginPass("Outside"); }), "pass begun outside a frame");
+		Tools::Check(Tools::Throws<std::logic_error>([&]() { profiler.EndFrame(); }), "frame ended without being begun");
+
+		profiler.BeginFrame();
+		Tools::Check(Tools::Throws<std::logic_error>([&]() { profiler.BeginFrame(); }), "frame begun twice");
+		Tools::Check(Tools::Throws<std::logic_error>([&]() { profiler.EndPass(); }), "pass ended without being begun");
+
+		profiler.BeginPass("Outer");
+		Tools::Check(Tools::Throws<std::logic_error>([&]() { profiler.BeginPass("Inner"); }), "nested pass");
+		Tools::Check(Tools::Throws<std::logic_error>([&]() { profiler.EndFrame(); }), "frame ended inside a pass");
+		profiler.EndPass();
+		Tools::Check(Tools::Throws<std::logic_error>([&]() { profiler.EndPass(); }), "pass ended twice");
+		profiler.EndFrame();
+
+		auto const& timings = profiler.GetPassTimings();
+		Tools::Check(timings.size() == 1 && std::strcmp(timings[0].name, "Outer") == 0, "balanced pass still recorded");
+	}
+}
+
+int RunGameBenchmark(int argc, char** argv)
+{
+	using clock = std::chrono::steady_clock;
+	using milliseconds = std::chrono::duration<double, std::milli>;
+
+	const double seconds = double(Tools::GetArgument(argc, argv, 0, 60));
+	const std::string report = argc > 1 ? argv[1] : "benchmark.csv";
+	const uint64_t renderRate = Tools::GetArgument(argc, argv, 2, 144);
+
+	if (seconds <= 0.0 || renderRate == 0)
+	{
+		std::fprintf(stderr, "bench: duration and render rate must be non-zero\n");
+		return 1;
+	}
+
+	CheckPasses();
+	CheckMisuse();
+
+	// Same fixed step simulation as the game, with display frames advanced on a virtual clock.
+	DX::BasicStepTimer<DX::VirtualClock> timer;
+	timer.SetFixedTimeStep(true);
+	timer.SetTargetElapsedSeconds(1.0 / 60.0);
+
+	Benchmark::Session session(seconds, report);
+	PlayerSimulation player;
+	PlayerState previous = player.GetState();
+	NullRenderer renderer(ViewmodelMode::DepthPartition, false);
+
+	while (!session.IsComplete())
+	{
+		timer.GetClock().Advance(DX::VirtualClock().GetFrequency() / renderRate);
+
+		auto const frameStart = clock::now();
+
+		timer.Tick([&]()
+			{
+				previous = player.GetState();
+				player.Step(session.NextInput(timer.GetElapsedSeconds()), float(timer.GetElapsedSeconds()));
+			});
+
+		auto const renderStart = clock::now();
+		renderer.Render(PlayerSimulation::Interpolate(previous, player.GetState(), float(timer.GetInterpolationAlpha())));
+		auto const frameEnd = clock::now();
+
+		session.AddFrame(milliseconds(frameEnd - frameStart).count(),
+			milliseconds(renderStart - frameStart).count(), milliseconds(frameEnd - renderStart).count());
+		for (auto const& pass : renderer.GetGpuProfiler().GetPassTimings())
+		{
+			session.AddPassTime(pass.name, pass.milliseconds);
+		}
+	}
+
+	session.WriteReport();
+
+	auto const& timings = session.GetTimings();
+	auto const frame = timings.GetFrameSummary();
+	std::printf("\nframes:   %zu\n", timings.GetFrameCount());
+	std::printf("frame ms: avg %.5f p50 %.5f p95 %.5f p99 %.5f max %.5f\n", frame.average, frame.p50, frame.p95, frame.p99, frame.max);
+	std::printf("report:   %s\n", report.c_str());
+
+	std::printf("passes:  ");
+	for (auto const& pass : renderer.GetGpuProfiler().GetPassTimings())
+	{
+		std::printf(" %s", pass.name);
+	}
+	std::printf(" (%llu frames)\n", static_cast<unsigned long long>(renderer.GetGpuProfiler().GetResolvedFrame()));
+
+	std::printf("checksum: %f\n", renderer.GetChecksum());
+
+	return Tools::Finish("bench");
+}
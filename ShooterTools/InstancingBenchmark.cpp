@@ -0,0 +1,191 @@
+//
+// InstancingBenchmark.cpp - Times grouping repeated draws into instance batches and packing their transforms
+//
+
+#include "Tools.h"
+
+#include "../Shooter/InstanceBatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Instance
+	{
+		uint32_t mesh;
+		uint32_t material;
+		XMFLOAT4X4 world;
+	};
+
+	// Boxes of random size and orientation with a random mesh and material,
+	// in the order a culled scene would hand them over.
+	std::vector<Instance> MakeInstances(size_t count, uint32_t meshes, uint32_t materials)
+	{
+		std::mt19937 random(1234);
+		std::uniform_int_distribution<uint32_t> mesh(0, meshes - 1);
+		std::uniform_int_distribution<uint32_t> material(0, materials - 1);
+		std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> scale(0.1f, 2.0f);
+		std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+
+		std::vector<Instance> instances(count);
+		for (auto& instance : instances)
+		{
+			instance.mesh = mesh(random);
+			instance.material = material(random);
+
+			const XMMATRIX world = XMMatrixMultiply(XMMatrixMultiply(
+				XMMatrixScaling(scale(random), scale(random), scale(random)),
+				XMMatrixRotationY(angle(random))),
+				XMMatrixTranslation(position(random), position(random), position(random)));
+			XMStoreFloat4x4(&instance.world, world);
+		}
+		return instances;
+	}
+
+	void Fill(InstanceBatcher& batcher, std::vector<Instance> const& instances)
+	{
+		batcher.Clear();
+		for (auto const& instance : instances)
+		{
+			batcher.Add(instance.mesh, instance.material, XMLoadFloat4x4(&instance.world));
+		}
+	}
+
+	// Every instance lands in exactly one batch of its own mesh and material,
+	// batches keep the order instances were added in, and each packed
+	// transform is the one its instance was added with.
+	void CheckBatches(InstanceBatcher const& batcher, std::vector<Instance> const& instances,
+		std::vector<XMFLOAT3X4> const& packed)
+	{
+		// Rebuild the expected packing: instances grouped by key, stable.
+		std::vector<uint32_t> order(instances.size());
+		for (uint32_t i = 0; i < order.size(); ++i)
+		{
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+		{
+			if (instances[a].mesh != instances[b].mesh)
+				return instances[a].mesh < instances[b].mesh;
+			return instances[a].material < instances[b].material;
+		});
+
+		uint32_t covered = 0;
+		bool homogeneous = true;
+		bool ordered = true;
+		for (auto const& batch : batcher.GetBatches())
+		{
+			ordered = ordered && batch.firstInstance == covered && batch.instanceCount > 0;
+			for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount && i < order.size(); ++i)
+			{
+				auto const& instance = instances[order[i]];
+				homogeneous = homogeneous && instance.mesh == batch.mesh && instance.material == batch.material;
+			}
+			covered += batch.instanceCount;
+		}
+
+		Tools::Check(covered == instances.size(), "batches should cover every instance once");
+		Tools::Check(homogeneous, "a batch mixes meshes or materials");
+		Tools::Check(ordered, "batches should be contiguous and non-empty");
+
+		bool transforms = packed.size() == instances.size();
+		for (uint32_t i = 0; transforms && i < order.size(); ++i)
+		{
+			XMFLOAT3X4 expected;
+			XMStoreFloat3x4(&expected, XMLoadFloat4x4(&instances[order[i]].world));
+			transforms = std::memcmp(&expected, &packed[i], sizeof(expected)) == 0;
+		}
+		Tools::Check(transforms, "packed transforms should follow batch order");
+	}
+
+	void CheckEdges()
+	{
+		std::printf("edges:\n");
+
+		InstanceBatcher batcher;
+		batcher.Build();
+		Tools::Check(batcher.GetBatches().empty(), "no instances should give no batches");
+
+		// A single key skips every radix pass.
+		batcher.Add(3, 7, XMMatrixIdentity());
+		batcher.Add(3, 7, XMMatrixTranslation(1.0f, 2.0f, 3.0f));
+		batcher.Build();
+		auto const& batches = batcher.GetBatches();
+		Tools::Check(batches.size() == 1 && batches[0].mesh == 3 && batches[0].material == 7 && batches[0].instanceCount == 2,
+			"equal keys should make one batch");
+
+		XMFLOAT3X4 packed[2];
+		batcher.Pack(packed);
+		Tools::Check(packed[1]._14 == 1.0f && packed[1]._24 == 2.0f && packed[1]._34 == 3.0f,
+			"translation should land in the last column");
+
+		// Clear keeps nothing from the last frame.
+		batcher.Clear();
+		batcher.Add(0, 0, XMMatrixIdentity());
+		batcher.Build();
+		Tools::Check(batcher.GetInstanceCount() == 1 && batcher.GetBatches().size() == 1, "clear should drop the last frame");
+
+		std::printf("  %s\n", Tools::Passed() ? "ok" : "failed");
+	}
+}
+
+int RunInstancingBenchmark(int argc, char** argv)
+{
+	const size_t count = std::max<size_t>(1, static_cast<size_t>(Tools::GetArgument(argc, argv, 0, 50000)));
+	const uint32_t meshes = std::max(1u, static_cast<uint32_t>(Tools::GetArgument(argc, argv, 1, 16)));
+	const uint32_t materials = std::max(1u, static_cast<uint32_t>(Tools::GetArgument(argc, argv, 2, 8)));
+	const uint32_t frames = std::max(1u, static_cast<uint32_t>(Tools::GetArgument(argc, argv, 3, 100)));
+
+	CheckEdges();
+
+	const auto instances = MakeInstances(count, meshes, materials);
+
+	InstanceBatcher batcher;
+	batcher.Reserve(count);
+
+	// Stands in for the mapped instance buffer.
+	std::vector<XMFLOAT3X4> packed(count);
+
+	Fill(batcher, instances);
+	batcher.Build();
+	batcher.Pack(packed.data());
+	CheckBatches(batcher, instances, packed);
+
+	double addMs = 1e9;
+	double buildMs = 1e9;
+	double packMs = 1e9;
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		auto const start = std::chrono::steady_clock::now();
+		Fill(batcher, instances);
+		auto const added = std::chrono::steady_clock::now();
+		batcher.Build();
+		auto const built = std::chrono::steady_clock::now();
+		batcher.Pack(packed.data());
+		auto const end = std::chrono::steady_clock::now();
+
+		addMs = std::min(addMs, std::chrono::duration<double, std::milli>(added - start).count());
+		buildMs = std::min(buildMs, std::chrono::duration<double, std::milli>(built - added).count());
+		packMs = std::min(packMs, std::chrono::duration<double, std::milli>(end - built).count());
+	}
+
+	const double totalMs = addMs + buildMs + packMs;
+
+	std::printf("\n%zu instances, %u meshes, %u materials\n", count, meshes, materials);
+	std::printf("  draw calls: %zu before, %zu instanced\n", count, batcher.GetBatches().size());
+	std::printf("  add:        %.3f ms (best of %u)\n", addMs, frames);
+	std::printf("  build:      %.3f ms\n", buildMs);
+	std::printf("  pack:       %.3f ms, %.1f MB of transforms\n", packMs,
+		double(count * sizeof(XMFLOAT3X4)) / (1024.0 * 1024.0));
+	std::printf("  total:      %.3f ms, %.1f ns per instance\n", totalMs, totalMs * 1e6 / double(count));
+
+	return Tools::Finish("instancing");
+}
@@ -0,0 +1,191 @@
+//
+// Lz4Compressor.cpp
+//
+
+#include "Lz4Compressor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	constexpr size_t MinMatch = 4;
+	constexpr size_t MaxOffset = 65535;
+
+	// A block ends with at least LastLiterals literals, and its last match
+	// starts at least MatchStartLimit bytes before the end, so decoders can
+	// copy in wide chunks until near the end.
+	constexpr size_t LastLiterals = 5;
+	constexpr size_t MatchStartLimit = 12;
+
+	constexpr unsigned HashBits = 16;
+	constexpr size_t ChainSize = MaxOffset + 1;
+
+	inline uint32_t Read32(const uint8_t* bytes) noexcept
+	{
+		uint32_t value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t Read64(const uint8_t* bytes) noexcept
+	{
+		uint64_t value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t Hash(uint32_t sequence) noexcept
+	{
+		return (sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	// Index of the lowest set bit; value must not be zero.
+	inline uint32_t LowestBit(uint64_t value) noexcept
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return index;
+#else
+		return uint32_t(__builtin_ctzll(value));
+#endif
+	}
+
+	// How far the bytes at a and b match, from and up to limit bytes; a
+	// little-endian compare of eight at a time finds the first that differs.
+	size_t MatchLength(const uint8_t* a, const uint8_t* b, size_t limit) noexcept
+	{
+		size_t length = 0;
+		while (length + 8 <= limit)
+		{
+			const uint64_t difference = Read64(a + length) ^ Read64(b + length);
+			if (difference != 0)
+				return length + LowestBit(difference) / 8;
+			length += 8;
+		}
+		while (length < limit && a[length] == b[length])
+		{
+			++length;
+		}
+		return length;
+	}
+
+	uint8_t* WriteLength(uint8_t* out, size_t length) noexcept
+	{
+		for (; length >= 255; length -= 255)
+		{
+			*out++ = 255;
+		}
+		*out++ = uint8_t(length);
+		return out;
+	}
+
+	// A match length of 0 ends the block with the literals alone.
+	uint8_t* WriteSequence(uint8_t* out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) noexcept
+	{
+		uint8_t* const token = out++;
+		*token = uint8_t(std::min<size_t>(literalCount, 15) << 4);
+		if (literalCount >= 15)
+		{
+			out = WriteLength(out, literalCount - 15);
+		}
+		std::memcpy(out, literals, literalCount);
+		out += literalCount;
+
+		if (matchLength == 0)
+			return out;
+
+		*out++ = uint8_t(offset);
+		*out++ = uint8_t(offset >> 8);
+
+		const size_t length = matchLength - MinMatch;
+		*token |= uint8_t(std::min<size_t>(length, 15));
+		if (length >= 15)
+		{
+			out = WriteLength(out, length - 15);
+		}
+		return out;
+	}
+}
+
+// Greedy parsing over hash chains: every position goes into the chain of
+// its first four bytes' hash, linked by the distance back to the one
+// before, and a position takes the longest match its chain offers within
+// the 64 KB window. A match is then stretched backwards over the literals
+// before it where they match too.
+size_t Lz4::Compress(const uint8_t* source, size_t size, uint8_t* destination, unsigned searchDepth)
+{
+	uint8_t* out = destination;
+	size_t anchor = 0;
+
+	if (size > MatchStartLimit)
+	{
+		std::vector<int32_t> head(size_t(1) << HashBits, -1);
+		std::vector<uint16_t> chain(ChainSize, 0);
+
+		const size_t matchEnd = size - LastLiterals;
+		const size_t matchStartEnd = size - MatchStartLimit;
+
+		size_t inserted = 0;
+		size_t position = 0;
+		while (position < matchStartEnd)
+		{
+			for (; inserted <= position; ++inserted)
+			{
+				int32_t& first = head[Hash(Read32(source + inserted))];
+				const size_t distance = inserted - size_t(first);
+				chain[inserted % ChainSize] = (first < 0 || distance > MaxOffset) ? 0 : uint16_t(distance);
+				first = int32_t(inserted);
+			}
+
+			const uint32_t sequence = Read32(source + position);
+			size_t bestLength = 0;
+			size_t bestOffset = 0;
+
+			size_t candidate = position;
+			for (unsigned attempt = 0; attempt < searchDepth; ++attempt)
+			{
+				const uint16_t distance = chain[candidate % ChainSize];
+				if (distance == 0 || position - (candidate - distance) > MaxOffset)
+					break;
+				candidate -= distance;
+
+				if (Read32(source + candidate) != sequence)
+					continue;
+
+				const size_t length = MinMatch + MatchLength(source + candidate + MinMatch, source + position + MinMatch,
+					matchEnd - position - MinMatch);
+				if (length > bestLength)
+				{
+					bestLength = length;
+					bestOffset = position - candidate;
+				}
+			}
+
+			if (bestLength < MinMatch)
+			{
+				++position;
+				continue;
+			}
+
+			while (position > anchor && position > bestOffset && source[position - 1] == source[position - 1 - bestOffset])
+			{
+				--position;
+				++bestLength;
+			}
+
+			out = WriteSequence(out, source + anchor, position - anchor, bestOffset, bestLength);
+			position += bestLength;
+			anchor = position;
+		}
+	}
+
+	out = WriteSequence(out, source + anchor, size - anchor, 0, 0);
+	return size_t(out - destination);
+}
@@ -0,0 +1,27 @@
+//
+// Lz4Compressor.h - Compresses LZ4 blocks for the game's Lz4::Decompress
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Lz4
+{
+	// The most Compress can write for size bytes of input, when none of
+	// them match.
+	constexpr size_t GetMaxCompressedSize(size_t size) noexcept
+	{
+		return size + size / 255 + 16;
+	}
+
+	// Compresses a block of under 2 GB on its own, so it decodes without
+	// any other, and returns the bytes written to destination, which must
+	// hold GetMaxCompressedSize(size). Each position tries up to
+	// searchDepth earlier positions that hash the same, longest match
+	// wins: 1 is about LZ4's fast mode, and deeper searches find longer
+	// matches for smaller output at the cost of compression speed only;
+	// decoding speed doesn't change.
+	size_t Compress(const uint8_t* source, size_t size, uint8_t* destination, unsigned searchDepth);
+}
@@ -0,0 +1,110 @@
+//
+// Main.cpp - Entry point for ShooterTools
+//
+// Headless benchmarks and asset tools that share the platform independent
+// parts of the game. Builds as a console application on Windows and Linux.
+//
+
+#include "Tools.h"
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+namespace
+{
+	struct Command
+	{
+		const char* name;
+		const char* usage;
+		int (*run)(int argc, char** argv);
+	};
+
+	const Command c_commands[] =
+	{
+		{ "bench-sim", "bench-sim [players=4096] [ticks=600]", RunSimBenchmark },
+		{ "replay", "replay [recording=<self-check>]", RunReplay },
+		{ "bench", "bench [seconds=60] [report=benchmark.csv] [render-hz=144]", RunGameBenchmark },
+		{ "bench-profiler", "bench-profiler [scopes=1000000] [trace]", RunProfilerBenchmark },
+		{ "bench-queue", "bench-queue [objects=65536] [shaders=8] [materials=16]", RunRenderQueueBenchmark },
+		{ "frame-sequence", "frame-sequence [width=3840] [height=2160]", RunFrameSequence },
+		{ "bench-rtpool", "bench-rtpool [frames=600] [blur-levels=4]", RunRenderTargetPoolBenchmark },
+		{ "frame-graph", "frame-graph [compile-iterations=100000]", RunFrameGraph },
+		{ "dynres-sim", "dynres-sim [budget-us=16667] [gpu-latency=3]", RunDynamicResolutionSim },
+		{ "bench-cull", "bench-cull [objects=100000] [iterations=200]", RunCullBenchmark },
+		{ "bench-occlusion", "bench-occlusion [objects=20000] [frames=200] [occluders=32] [threads=hardware]", RunOcclusionBenchmark },
+		{ "bench-instancing", "bench-instancing [instances=50000] [meshes=16] [materials=8] [frames=100]", RunInstancingBenchmark },
+		{ "frame-ring", "frame-ring [frames=20000] [frames-in-flight=3]", RunFrameRingBenchmark },
+		{ "mesh-arena", "mesh-arena [operations=1000000] [capacity=1048576]", RunMeshArenaBenchmark },
+		{ "fuzz-cmo", "fuzz-cmo [mutants=20000] [model=Shooter/Assets/m16.cmo] [seed=1234]", RunCmoFuzz },
+		{ "bench-cmo", "bench-cmo [iterations=200] [model=Shooter/Assets/m16.cmo]", RunCmoBenchmark },
+		{ "cook-meshes", "cook-meshes [output-dir=Shooter/Assets] [model.cmo ...]", RunCookMeshes },
+		{ "cook-textures", "cook-textures [output-dir=Shooter/Assets] [threads=hardware] [format=auto|BC1|BC3|BC7]", RunCookTextures },
+		{ "asset-loader", "asset-loader [workers=hardware] [assets=256] [decode-us=2000]", RunAssetLoaderCheck },
+		{ "pack-assets", "pack-assets [dir=Shooter/Assets] [output=<dir>/Assets.pak] [compression=lz4|none] [block-kb=128]", RunPackAssets },
+		{ "archive-benchmark", "archive-benchmark [files=256] [total-mb=64] [dir=<temp>/shooter-archive-benchmark]", RunArchiveBenchmark },
+		{ "compression-benchmark", "compression-benchmark [threads=cores] [search-depth=64]", RunCompressionBenchmark },
+		{ "asset-cache", "asset-cache [archive=Shooter/Assets/Assets.pak] [restores=20]", RunAssetCacheCheck },
+		{ "step-timer", "step-timer", RunStepTimerCheck },
+	};
+
+	bool g_passed = true;
+
+	void PrintUsage()
+	{
+		std::printf("usage: ShooterTools <command> [args]\n\ncommands:\n");
+		for (auto const& command : c_commands)
+		{
+			std::printf("  %s\n", command.usage);
+		}
+	}
+}
+
+void Tools::Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		std::printf("  UNEXPECTED: %s\n", what);
+		g_passed = false;
+	}
+}
+
+bool Tools::Passed() noexcept
+{
+	return g_passed;
+}
+
+int Tools::Finish(const char* name)
+{
+	std::printf("\n%s: %s\n", name, g_passed ? "ok" : "UNEXPECTED");
+	return g_passed ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	for (auto const& command : c_commands)
+	{
+		if (std::strcmp(argv[1], command.name) == 0)
+		{
+			try
+			{
+				return command.run(argc - 2, argv + 2);
+			}
+			catch (std::exception const& e)
+			{
+				std::fprintf(stderr, "%s: %s\n", command.name, e.what());
+				return 1;
+			}
+		}
+	}
+
+	std::fprintf(stderr, "Unknown command '%s'\n\n", argv[1]);
+	PrintUsage();
+	return 1;
+}
@@ -0,0 +1,346 @@
+//
+// MeshArenaBenchmark.cpp - Stress tests the mesh arena's offset allocator and defragmentation, then times it
+//
+
+#include "Tools.h"
+
+#include "../Shooter/MeshArena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	template<typename Exception, typename Call>
+	bool Throws(Call call)
+	{
+		try
+		{
+			call();
+		}
+		catch (Exception const&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	void CheckBasics()
+	{
+		std::printf("basics:\n");
+
+		// Sizes that are bin sizes exactly, so every fit below is certain.
+		OffsetAllocator allocator(1000);
+		const uint32_t a = allocator.Allocate(128);
+		const uint32_t b = allocator.Allocate(128);
+		const uint32_t c = allocator.Allocate(256);
+		Tools::Check(allocator.GetOffset(a) == 0 && allocator.GetOffset(b) == 128 && allocator.GetOffset(c) == 256,
+			"allocations from an empty allocator should be packed");
+		Tools::Check(allocator.GetStats().freeRanges == 1, "the rest should be one free range");
+
+		// Freeing b leaves a hole; freeing a merges it with the hole.
+		allocator.Free(b);
+		Tools::Check(allocator.GetStats().freeRanges == 2, "a hole should be a range of its own");
+		Tools::Check(Tools::Throws<std::invalid_argument>([&] { allocator.Free(b); }), "freeing twice should throw");
+		allocator.Free(a);
+		auto stats = allocator.GetStats();
+		Tools::Check(stats.freeRanges == 2 && stats.freeUnits == 744, "neighbouring free ranges should merge");
+		Tools::Check(stats.largestFreeRange == 488, "the tail should be the largest range");
+
+		// The 256 unit hole at the front is the best fit.
+		const uint32_t d = allocator.Allocate(256);
+		Tools::Check(allocator.GetOffset(d) == 0, "an exact fit should reuse the hole");
+
+		allocator.Free(c);
+		allocator.Free(d);
+		stats = allocator.GetStats();
+		Tools::Check(stats.freeRanges == 1 && stats.largestFreeRange == 1000 && stats.allocations == 0,
+			"freeing everything should leave one range");
+
+		// 1000 isn't a bin size; the search falls back to the range's own bin.
+		Tools::Check(allocator.Allocate(1000) != OffsetAllocator::InvalidHandle, "the whole capacity should be allocatable");
+		Tools::Check(allocator.Allocate(1) == OffsetAllocator::InvalidHandle, "a full allocator should fail");
+
+		Tools::Check(Tools::Throws<std::invalid_argument>([&] { allocator.Allocate(0); }), "empty allocations should throw");
+		Tools::Check(Tools::Throws<std::invalid_argument>([&] { allocator.Free(12345); }), "unknown handles should throw");
+		Tools::Check(Tools::Throws<std::invalid_argument>([] { OffsetAllocator(0); }), "zero capacity should throw");
+
+		std::printf("  %s\n", Tools::Passed() ? "ok" : "failed");
+	}
+
+	void CheckDefragment()
+	{
+		std::printf("defragment:\n");
+
+		OffsetAllocator allocator(100);
+		uint32_t handles[10];
+		for (auto& handle : handles)
+		{
+			handle = allocator.Allocate(10);
+		}
+		for (int i = 0; i < 10; i += 2)
+		{
+			allocator.Free(handles[i]);
+		}
+
+		Tools::Check(allocator.Allocate(20) == OffsetAllocator::InvalidHandle, "scattered space shouldn't fit 20");
+		Tools::Check(std::abs(allocator.GetStats().GetFragmentation() - 0.8) < 1e-9, "five ranges of ten should be 80% fragmented");
+
+		std::vector<OffsetAllocator::Move> moves;
+		allocator.Defragment(moves);
+		Tools::Check(moves.size() == 5, "each kept allocation should move on its own");
+		Tools::Check(moves.front().from == 10 && moves.front().to == 0 && moves.front().size == 10, "the first move should slide 10 down");
+
+		for (int i = 1; i < 10; i += 2)
+		{
+			Tools::Check(allocator.GetOffset(handles[i]) == uint32_t(i / 2) * 10, "handles should follow their allocations");
+		}
+
+		auto const stats = allocator.GetStats();
+		Tools::Check(stats.freeRanges == 1 && stats.largestFreeRange == 50 && stats.GetFragmentation() == 0.0,
+			"packing should leave one free range");
+		Tools::Check(allocator.Allocate(50) != OffsetAllocator::InvalidHandle, "the packed space should fit 50");
+
+		// Allocations that slide together are copied together.
+		OffsetAllocator joined(100);
+		const uint32_t gap = joined.Allocate(10);
+		joined.Allocate(10);
+		joined.Allocate(10);
+		joined.Free(gap);
+		joined.Defragment(moves);
+		Tools::Check(moves.size() == 1 && moves[0].size == 20, "neighbours should share a move");
+
+		std::printf("  %s\n", Tools::Passed() ? "ok" : "failed");
+	}
+
+	struct Live
+	{
+		uint32_t handle;
+		uint32_t tag;
+	};
+
+	// Applies moves to a buffer as D3D11MeshArena does, straight across or
+	// through a scratch buffer when the range slides over itself, so overlap
+	// mistakes show up as clobbered tags.
+	void ApplyMoves(std::vector<uint32_t>& buffer, std::vector<uint32_t>& scratch, std::vector<OffsetAllocator::Move> const& moves)
+	{
+		for (auto const& move : moves)
+		{
+			auto const source = buffer.begin() + move.from;
+			if (move.from - move.to >= move.size)
+			{
+				std::copy_n(source, move.size, buffer.begin() + move.to);
+				continue;
+			}
+
+			scratch.assign(source, source + move.size);
+			std::copy(scratch.begin(), scratch.end(), buffer.begin() + move.to);
+		}
+	}
+
+	// Mesh sized allocations come and go at random. Every allocation is
+	// checked against a shadow buffer tagged with its owner, so overlaps,
+	// lost ranges and bad defragmentation copies are all caught.
+	void Stress(uint64_t operations, uint32_t capacity)
+	{
+		std::printf("stress:\n");
+
+		OffsetAllocator allocator(capacity);
+		std::vector<uint32_t> buffer(capacity, 0);
+		std::vector<uint32_t> scratch;
+		std::vector<Live> live;
+		std::vector<OffsetAllocator::Move> moves;
+
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<double> logSize(std::log(4.0), std::log(16384.0));
+		std::uniform_int_distribution<uint32_t> action(0, 99);
+
+		uint64_t failures = 0;
+		uint64_t fragmentationFailures = 0;
+		uint64_t defragmentations = 0;
+		uint64_t movedUnits = 0;
+		uint64_t copies = 0;
+		double fragmentationSum = 0.0;
+		double fragmentationPeak = 0.0;
+		uint64_t samples = 0;
+		uint32_t nextTag = 1;
+		bool overlap = false;
+		bool lost = false;
+
+		for (uint64_t op = 0; op < operations; ++op)
+		{
+			// Lean towards allocating until the arena is three quarters full.
+			const uint32_t used = capacity - allocator.GetFreeUnits();
+			const bool allocate = live.empty() || action(random) < (used < capacity / 4 * 3 ? 60u : 45u);
+
+			if (allocate)
+			{
+				const uint32_t size = uint32_t(std::exp(logSize(random)));
+				uint32_t handle = allocator.Allocate(size);
+				if (handle == OffsetAllocator::InvalidHandle && size <= allocator.GetFreeUnits())
+				{
+					// Free space enough, but not in one piece: pack and try again.
+					fragmentationFailures++;
+					allocator.Defragment(moves);
+					ApplyMoves(buffer, scratch, moves);
+					std::fill(buffer.begin() + (capacity - allocator.GetFreeUnits()), buffer.end(), 0u);
+					for (auto const& move : moves)
+					{
+						movedUnits += move.size;
+						copies += move.from - move.to >= move.size ? 1 : 2;
+					}
+					defragmentations++;
+					handle = allocator.Allocate(size);
+				}
+
+				if (handle == OffsetAllocator::InvalidHandle)
+				{
+					failures++;
+					continue;
+				}
+
+				const uint32_t offset = allocator.GetOffset(handle);
+				overlap = overlap || offset + size > capacity;
+				for (uint32_t i = offset; i < offset + size && i < capacity; ++i)
+				{
+					overlap = overlap || buffer[i] != 0;
+					buffer[i] = nextTag;
+				}
+				live.push_back({ handle, nextTag++ });
+			}
+			else
+			{
+				const size_t index = random() % live.size();
+				const uint32_t offset = allocator.GetOffset(live[index].handle);
+				const uint32_t size = allocator.GetSize(live[index].handle);
+				for (uint32_t i = offset; i < offset + size; ++i)
+				{
+					lost = lost || buffer[i] != live[index].tag;
+					buffer[i] = 0;
+				}
+				allocator.Free(live[index].handle);
+				live[index] = live.back();
+				live.pop_back();
+			}
+
+			if (op % 64 == 0)
+			{
+				auto const stats = allocator.GetStats();
+				fragmentationSum += stats.GetFragmentation();
+				fragmentationPeak = std::max(fragmentationPeak, stats.GetFragmentation());
+				samples++;
+			}
+		}
+
+		// Whatever is left must still hold its own tag everywhere.
+		uint64_t liveUnits = 0;
+		for (auto const& entry : live)
+		{
+			const uint32_t offset = allocator.GetOffset(entry.handle);
+			const uint32_t size = allocator.GetSize(entry.handle);
+			for (uint32_t i = offset; i < offset + size; ++i)
+			{
+				lost = lost || buffer[i] != entry.tag;
+			}
+			liveUnits += size;
+		}
+
+		auto const stats = allocator.GetStats();
+		std::printf("  %llu operations, %zu live, %.1f%% used, %u free ranges\n",
+			static_cast<unsigned long long>(operations), live.size(), 100.0 * double(stats.usedUnits) / double(capacity), stats.freeRanges);
+		std::printf("  fragmentation %.1f%% average, %.1f%% peak, %llu allocations blocked by it\n",
+			100.0 * fragmentationSum / double(std::max<uint64_t>(samples, 1)), 100.0 * fragmentationPeak,
+			static_cast<unsigned long long>(fragmentationFailures));
+		std::printf("  %llu defragmentations moved %.1f units each on average in %.1f copies, %llu allocations out of space\n",
+			static_cast<unsigned long long>(defragmentations),
+			double(movedUnits) / double(std::max<uint64_t>(defragmentations, 1)),
+			double(copies) / double(std::max<uint64_t>(defragmentations, 1)), static_cast<unsigned long long>(failures));
+
+		Tools::Check(!overlap, "an allocation overlapped another or ran past the end");
+		Tools::Check(!lost, "an allocation's contents didn't survive");
+		Tools::Check(liveUnits == stats.usedUnits && live.size() == stats.allocations, "the allocator's accounting should match");
+
+		// Freeing everything must coalesce back into the whole capacity.
+		for (auto const& entry : live)
+		{
+			allocator.Free(entry.handle);
+		}
+		auto const empty = allocator.GetStats();
+		Tools::Check(empty.freeRanges == 1 && empty.largestFreeRange == capacity, "freeing everything should coalesce");
+	}
+
+	void CheckArena()
+	{
+		std::printf("arena:\n");
+
+		MeshArena arena(1000, 3000);
+		const uint32_t a = arena.Add(100, 300);
+		const uint32_t b = arena.Add(200, 600);
+		const uint32_t c = arena.Add(300, 900);
+		Tools::Check(arena.GetRange(b).baseVertex == 100 && arena.GetRange(b).firstIndex == 300, "meshes should be packed");
+
+		arena.Remove(a);
+		Tools::Check(Tools::Throws<std::invalid_argument>([&] { arena.Remove(a); }), "removing twice should throw");
+		Tools::Check(arena.Add(500, 10) == MeshArena::InvalidMesh, "500 vertices shouldn't fit in one piece");
+		Tools::Check(arena.WouldFitDefragmented(500, 10), "500 vertices should fit packed");
+		Tools::Check(arena.Add(10, 2000) == MeshArena::InvalidMesh, "a failed index range shouldn't keep its vertices");
+		Tools::Check(arena.GetStats().vertices.usedUnits == 500, "vertices should be given back on failure");
+
+		std::vector<OffsetAllocator::Move> vertexMoves, indexMoves;
+		arena.Defragment(vertexMoves, indexMoves);
+		Tools::Check(arena.GetRange(b).baseVertex == 0 && arena.GetRange(c).baseVertex == 200, "meshes should slide to the front");
+		Tools::Check(arena.GetRange(c).firstIndex == 600 && arena.GetRange(c).indexCount == 900, "index ranges should slide too");
+		Tools::Check(arena.Add(500, 10) != MeshArena::InvalidMesh, "500 vertices should fit after packing");
+
+		Tools::Check(Tools::Throws<std::invalid_argument>([&] { arena.Add(0, 3); }), "empty meshes should throw");
+
+		std::printf("  %s\n", Tools::Passed() ? "ok" : "failed");
+	}
+
+	double MeasureAllocations(uint64_t count)
+	{
+		OffsetAllocator allocator(1u << 24);
+
+		std::mt19937 random(99);
+		std::uniform_int_distribution<uint32_t> size(16, 4096);
+		std::vector<uint32_t> handles(4096, OffsetAllocator::InvalidHandle);
+
+		auto const start = std::chrono::steady_clock::now();
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			// Replace a random slot, so the free ranges stay varied.
+			uint32_t& slot = handles[random() % handles.size()];
+			if (slot != OffsetAllocator::InvalidHandle)
+			{
+				allocator.Free(slot);
+			}
+			slot = allocator.Allocate(size(random));
+		}
+		auto const elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		Tools::Check(std::find(handles.begin(), handles.end(), OffsetAllocator::InvalidHandle) == handles.end(),
+			"a mostly empty allocator should never fail");
+		return elapsed / double(count);
+	}
+}
+
+int RunMeshArenaBenchmark(int argc, char** argv)
+{
+	const uint64_t operations = std::max<uint64_t>(1, Tools::GetArgument(argc, argv, 0, 1000000));
+	const uint32_t capacity = static_cast<uint32_t>(std::max<uint64_t>(16384, Tools::GetArgument(argc, argv, 1, 1 << 20)));
+
+	CheckBasics();
+	CheckDefragment();
+	CheckArena();
+	Stress(operations, capacity);
+
+	const double ns = MeasureAllocations(10000000);
+	std::printf("\nfree and allocate: %.2f ns per pair\n", ns);
+
+	return Tools::Finish("mesh arena");
+}
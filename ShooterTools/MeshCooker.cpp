@@ -0,0 +1,589 @@
+//
+// MeshCooker.cpp
+//
+
+#include "MeshCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+using namespace MeshCooker;
+
+namespace
+{
+	// What DirectXTK draws a CMO mesh without materials with.
+	Model::Material MakeDefaultMaterial()
+	{
+		Model::Material material = {};
+		material.name = "Default";
+		for (int i = 0; i < 3; ++i)
+		{
+			material.constants.ambient[i] = 0.2f;
+			material.constants.diffuse[i] = 0.8f;
+		}
+		material.constants.alpha = 1.0f;
+		material.constants.specularPower = 1.0f;
+		return material;
+	}
+
+	bool IsIdentity(float const (&matrix)[16]) noexcept
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			if (matrix[i] != (i % 5 == 0 ? 1.0f : 0.0f))
+				return false;
+		}
+		return true;
+	}
+
+	uint32_t Align(uint64_t offset)
+	{
+		const uint64_t aligned = (offset + CookedMesh::SectionAlignment - 1) & ~uint64_t(CookedMesh::SectionAlignment - 1);
+		if (aligned > std::numeric_limits<uint32_t>::max())
+			throw std::length_error("Model is too big for a cooked mesh file");
+		return uint32_t(aligned);
+	}
+
+	// The vertex buffers the parts draw from: each starts at a part's base
+	// vertex and runs to the next one's, or the end of the stream.
+	struct VertexRange
+	{
+		uint32_t baseVertex;
+		uint32_t vertexCount;
+	};
+
+	std::vector<VertexRange> GetVertexRanges(Model const& model)
+	{
+		std::vector<uint32_t> bases;
+		for (auto const& part : model.parts)
+		{
+			bases.push_back(part.baseVertex);
+		}
+		std::sort(bases.begin(), bases.end());
+		bases.erase(std::unique(bases.begin(), bases.end()), bases.end());
+
+		std::vector<VertexRange> ranges;
+		for (size_t i = 0; i < bases.size(); ++i)
+		{
+			const uint32_t end = i + 1 < bases.size() ? bases[i + 1] : uint32_t(model.vertices.size());
+			ranges.push_back({ bases[i], end - bases[i] });
+		}
+		return ranges;
+	}
+
+	uint32_t GetVertexCount(std::vector<VertexRange> const& ranges, uint32_t baseVertex)
+	{
+		auto const range = std::lower_bound(ranges.begin(), ranges.end(), baseVertex,
+			[](VertexRange const& r, uint32_t base) { return r.baseVertex < base; });
+		return range->vertexCount;
+	}
+
+	int16_t QuantizeSnorm(double value) noexcept
+	{
+		return int16_t(std::lround(std::clamp(value, -1.0, 1.0) * 32767.0));
+	}
+
+	double DecodeSnorm(int16_t value) noexcept
+	{
+		return std::max(double(value) / 32767.0, -1.0);
+	}
+
+	void DecodeOctahedral(int16_t const (&encoded)[2], double (&vector)[3]) noexcept
+	{
+		double x = DecodeSnorm(encoded[0]);
+		double y = DecodeSnorm(encoded[1]);
+		const double z = 1.0 - std::abs(x) - std::abs(y);
+		const double t = std::max(-z, 0.0);
+		x += x >= 0.0 ? -t : t;
+		y += y >= 0.0 ? -t : t;
+
+		const double length = std::sqrt(x * x + y * y + z * z);
+		vector[0] = x / length;
+		vector[1] = y / length;
+		vector[2] = z / length;
+	}
+
+	// Projects onto the octahedron, unfolds the lower half over the upper,
+	// then picks whichever of the four surrounding SNORM16 pairs decodes
+	// closest to the vector. A zero vector encodes as +Z.
+	void EncodeOctahedral(const float* vector, int16_t (&encoded)[2]) noexcept
+	{
+		double x = vector[0];
+		double y = vector[1];
+		double z = vector[2];
+		const double l1 = std::abs(x) + std::abs(y) + std::abs(z);
+		if (l1 == 0.0)
+		{
+			encoded[0] = 0;
+			encoded[1] = 0;
+			return;
+		}
+
+		x /= l1;
+		y /= l1;
+		z /= l1;
+		if (z < 0.0)
+		{
+			const double foldedX = (1.0 - std::abs(y)) * (x >= 0.0 ? 1.0 : -1.0);
+			const double foldedY = (1.0 - std::abs(x)) * (y >= 0.0 ? 1.0 : -1.0);
+			x = foldedX;
+			y = foldedY;
+		}
+
+		const double length = std::sqrt(double(vector[0]) * vector[0] + double(vector[1]) * vector[1] + double(vector[2]) * vector[2]);
+		double best = -2.0;
+		for (int i = 0; i < 4; ++i)
+		{
+			const int16_t candidate[2] =
+			{
+				int16_t(std::clamp((i & 1) ? std::ceil(x * 32767.0) : std::floor(x * 32767.0), -32767.0, 32767.0)),
+				int16_t(std::clamp((i & 2) ? std::ceil(y * 32767.0) : std::floor(y * 32767.0), -32767.0, 32767.0)),
+			};
+
+			double decoded[3];
+			DecodeOctahedral(candidate, decoded);
+			const double cosine = (decoded[0] * vector[0] + decoded[1] * vector[1] + decoded[2] * vector[2]) / length;
+			if (cosine > best)
+			{
+				best = cosine;
+				encoded[0] = candidate[0];
+				encoded[1] = candidate[1];
+			}
+		}
+	}
+
+	// Rounds to the nearest half, ties to even; out of range becomes infinity.
+	uint16_t FloatToHalf(float value) noexcept
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const uint32_t magnitude = bits & 0x7FFFFFFF;
+
+		if (magnitude >= 0x7F800000)
+			return uint16_t(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+		if (magnitude >= 0x477FF000)
+			return uint16_t(sign | 0x7C00);
+
+		uint32_t half;
+		uint32_t remainder;
+		uint32_t halfway;
+		if (magnitude < 0x38800000)
+		{
+			// Below the smallest normal half: count units of 2^-24.
+			const uint32_t shift = 126 - (magnitude >> 23);
+			if (shift > 24)
+				return uint16_t(sign);
+
+			const uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+			half = mantissa >> shift;
+			remainder = mantissa & ((1u << shift) - 1);
+			halfway = 1u << (shift - 1);
+		}
+		else
+		{
+			half = (magnitude - 0x38000000) >> 13;
+			remainder = magnitude & 0x1FFF;
+			halfway = 0x1000;
+		}
+
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+		{
+			half++;
+		}
+		return uint16_t(sign | half);
+	}
+
+	// Names share one NUL-terminated copy each.
+	class StringTable
+	{
+	public:
+		CookedMesh::String Add(std::string const& string)
+		{
+			auto const found = m_offsets.find(string);
+			if (found != m_offsets.end())
+				return found->second;
+
+			const auto offset = CookedMesh::String(m_bytes.size());
+			m_bytes.insert(m_bytes.end(), string.begin(), string.end());
+			m_bytes.push_back('\0');
+			m_offsets.emplace(string, offset);
+			return offset;
+		}
+
+		CookedMesh::String AddOptional(std::string const& string)
+		{
+			return string.empty() ? CookedMesh::NoString : Add(string);
+		}
+
+		std::vector<char> const& GetBytes() const noexcept { return m_bytes; }
+
+	private:
+		std::vector<char> m_bytes;
+		std::map<std::string, CookedMesh::String> m_offsets;
+	};
+}
+
+// The transform is a row-major matrix applied to (u, v, 0, 1). The
+// identity leaves coordinates bit for bit as they were, negative zeros too.
+void MeshCooker::TransformTextureCoordinate(float const (&uvTransform)[16], float (&textureCoordinate)[2]) noexcept
+{
+	if (IsIdentity(uvTransform))
+		return;
+
+	const float u = textureCoordinate[0];
+	const float v = textureCoordinate[1];
+	textureCoordinate[0] = u * uvTransform[0] + v * uvTransform[4] + uvTransform[12];
+	textureCoordinate[1] = u * uvTransform[1] + v * uvTransform[5] + uvTransform[13];
+}
+
+Model MeshCooker::ImportCmo(Cmo::File const& file)
+{
+	Model model;
+
+	for (auto const& mesh : file.GetMeshes())
+	{
+		if (mesh.hasSkeleton || !mesh.skinningVertexBuffers.empty())
+			throw std::runtime_error("Skinned meshes can't be cooked yet: " + mesh.name.ToUtf8());
+
+		const auto firstMaterial = uint32_t(model.materials.size());
+		if (mesh.materials.empty())
+		{
+			model.materials.push_back(MakeDefaultMaterial());
+		}
+
+		for (auto const& material : mesh.materials)
+		{
+			const Cmo::MaterialConstants constants = material.constants[0];
+
+			Model::Material cooked = {};
+			cooked.name = material.name.ToUtf8();
+			for (uint32_t slot = 0; slot < CookedMesh::TextureSlotCount; ++slot)
+			{
+				cooked.textures[slot] = material.textures[slot].ToUtf8();
+			}
+
+			for (int i = 0; i < 3; ++i)
+			{
+				cooked.constants.ambient[i] = constants.ambient[i];
+				cooked.constants.diffuse[i] = constants.diffuse[i];
+				cooked.constants.specular[i] = constants.specular[i];
+				cooked.constants.emissive[i] = constants.emissive[i];
+			}
+			cooked.constants.alpha = constants.diffuse[3];
+			cooked.constants.specularPower = constants.specularPower;
+			model.materials.push_back(std::move(cooked));
+		}
+
+		// A vertex buffer shared by several materials gets the UV transform
+		// of the first submesh drawing from it, as with DirectXTK.
+		std::vector<uint32_t> baseVertices;
+		for (size_t buffer = 0; buffer < mesh.vertexBuffers.size(); ++buffer)
+		{
+			auto const& source = mesh.vertexBuffers[buffer];
+
+			const size_t baseVertex = model.vertices.size();
+			if (baseVertex + source.GetCount() > std::numeric_limits<uint32_t>::max())
+				throw std::length_error("Model is too big for a cooked mesh file");
+
+			baseVertices.push_back(uint32_t(baseVertex));
+			model.vertices.resize(baseVertex + source.GetCount());
+			if (!source.IsEmpty())
+			{
+				std::memcpy(&model.vertices[baseVertex], source.GetBytes(), source.GetByteSize());
+			}
+
+			for (size_t i = 0; i < mesh.submeshes.GetCount(); ++i)
+			{
+				const Cmo::SubMesh submesh = mesh.submeshes[i];
+				if (submesh.vertexBufferIndex != buffer)
+					continue;
+
+				if (!mesh.materials.empty())
+				{
+					const Cmo::MaterialConstants constants = mesh.materials[submesh.materialIndex].constants[0];
+					if (!IsIdentity(constants.uvTransform))
+					{
+						for (size_t vertex = baseVertex; vertex < model.vertices.size(); ++vertex)
+						{
+							TransformTextureCoordinate(constants.uvTransform, model.vertices[vertex].textureCoordinate);
+						}
+					}
+				}
+				break;
+			}
+		}
+
+		Model::Mesh cooked;
+		cooked.name = mesh.name.ToUtf8();
+		cooked.firstPart = uint32_t(model.parts.size());
+		cooked.partCount = uint32_t(mesh.submeshes.GetCount());
+		cooked.extents = mesh.extents;
+
+		for (size_t i = 0; i < mesh.submeshes.GetCount(); ++i)
+		{
+			const Cmo::SubMesh submesh = mesh.submeshes[i];
+			auto const& indices = mesh.indexBuffers[submesh.indexBufferIndex];
+
+			CookedMesh::Part part;
+			part.material = firstMaterial + submesh.materialIndex;
+			part.startIndex = uint32_t(model.indices.size());
+			part.indexCount = submesh.primCount * 3;
+			part.baseVertex = baseVertices[submesh.vertexBufferIndex];
+
+			if (uint64_t(part.startIndex) + part.indexCount > std::numeric_limits<uint32_t>::max())
+				throw std::length_error("Model is too big for a cooked mesh file");
+
+			model.indices.resize(size_t(part.startIndex) + part.indexCount);
+			if (part.indexCount > 0)
+			{
+				std::memcpy(&model.indices[part.startIndex], indices.GetBytes() + size_t(submesh.startIndex) * sizeof(uint16_t),
+					size_t(part.indexCount) * sizeof(uint16_t));
+			}
+			model.parts.push_back(part);
+		}
+
+		model.meshes.push_back(std::move(cooked));
+	}
+
+	return model;
+}
+
+Analysis MeshCooker::Analyze(Model const& model)
+{
+	Analysis analysis = {};
+
+	auto const ranges = GetVertexRanges(model);
+	for (auto const& part : model.parts)
+	{
+		const uint16_t* indices = model.indices.data() + part.startIndex;
+		const uint32_t vertexCount = GetVertexCount(ranges, part.baseVertex);
+
+		analysis.vertexCache += MeshOptimizer::AnalyzeVertexCache(indices, part.indexCount, vertexCount);
+		analysis.vertexFetch += MeshOptimizer::AnalyzeVertexFetch(indices, part.indexCount, vertexCount, sizeof(Cmo::Vertex));
+	}
+	return analysis;
+}
+
+void MeshCooker::Optimize(Model& model)
+{
+	auto const ranges = GetVertexRanges(model);
+
+	for (auto const& part : model.parts)
+	{
+		uint16_t* indices = model.indices.data() + part.startIndex;
+		const uint32_t vertexCount = GetVertexCount(ranges, part.baseVertex);
+
+		auto const clusters = MeshOptimizer::OptimizeVertexCache(indices, part.indexCount, vertexCount);
+		MeshOptimizer::OptimizeOverdraw(indices, part.indexCount, clusters,
+			reinterpret_cast<const uint8_t*>(model.vertices.data() + part.baseVertex), vertexCount, sizeof(Cmo::Vertex));
+	}
+
+	// Vertices in order of first use, buffer by buffer, with the parts
+	// drawing from each visited in draw order.
+	std::vector<Cmo::Vertex> vertices;
+	vertices.reserve(model.vertices.size());
+
+	std::vector<uint32_t> remap;
+	std::vector<uint32_t> baseVertices(model.parts.size());
+	for (auto const& range : ranges)
+	{
+		const auto baseVertex = uint32_t(vertices.size());
+		remap.assign(range.vertexCount, ~0u);
+
+		for (size_t p = 0; p < model.parts.size(); ++p)
+		{
+			auto const& part = model.parts[p];
+			if (part.baseVertex != range.baseVertex)
+				continue;
+
+			baseVertices[p] = baseVertex;
+
+			for (uint32_t i = part.startIndex; i < part.startIndex + part.indexCount; ++i)
+			{
+				uint32_t& vertex = remap[model.indices[i]];
+				if (vertex == ~0u)
+				{
+					vertex = uint32_t(vertices.size()) - baseVertex;
+					vertices.push_back(model.vertices[range.baseVertex + model.indices[i]]);
+				}
+				model.indices[i] = uint16_t(vertex);
+			}
+		}
+	}
+
+	for (size_t p = 0; p < model.parts.size(); ++p)
+	{
+		model.parts[p].baseVertex = baseVertices[p];
+	}
+	model.vertices = std::move(vertices);
+}
+
+Quantization MeshCooker::Quantize(Model const& model)
+{
+	Quantization quantization;
+	quantization.vertices.resize(model.vertices.size(), CookedMesh::QuantizedVertex{});
+
+	// Each vertex buffer belongs to the mesh whose parts draw from it.
+	auto const ranges = GetVertexRanges(model);
+	std::vector<uint32_t> owners(ranges.size(), ~0u);
+	for (uint32_t mesh = 0; mesh < model.meshes.size(); ++mesh)
+	{
+		auto const& source = model.meshes[mesh];
+		for (uint32_t part = source.firstPart; part < source.firstPart + source.partCount; ++part)
+		{
+			auto const range = std::lower_bound(ranges.begin(), ranges.end(), model.parts[part].baseVertex,
+				[](VertexRange const& r, uint32_t base) { return r.baseVertex < base; });
+			uint32_t& owner = owners[range - ranges.begin()];
+			if (owner != ~0u && owner != mesh)
+				throw std::runtime_error("Meshes share vertices, so they can't be quantized within their own bounds");
+			owner = mesh;
+		}
+	}
+
+	for (uint32_t mesh = 0; mesh < model.meshes.size(); ++mesh)
+	{
+		float min[3] = { 0.0f, 0.0f, 0.0f };
+		float max[3] = { 0.0f, 0.0f, 0.0f };
+		bool empty = true;
+		for (size_t range = 0; range < ranges.size(); ++range)
+		{
+			if (owners[range] != mesh)
+				continue;
+
+			for (uint32_t vertex = ranges[range].baseVertex; vertex < ranges[range].baseVertex + ranges[range].vertexCount; ++vertex)
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					const float value = model.vertices[vertex].position[i];
+					min[i] = empty ? value : std::min(min[i], value);
+					max[i] = empty ? value : std::max(max[i], value);
+				}
+				empty = false;
+			}
+		}
+
+		Quantization::PositionDecode decode;
+		for (int i = 0; i < 3; ++i)
+		{
+			decode.offset[i] = (min[i] + max[i]) * 0.5f;
+			decode.scale[i] = (max[i] - min[i]) * 0.5f;
+		}
+		quantization.meshes.push_back(decode);
+
+		for (size_t range = 0; range < ranges.size(); ++range)
+		{
+			if (owners[range] != mesh)
+				continue;
+
+			for (uint32_t vertex = ranges[range].baseVertex; vertex < ranges[range].baseVertex + ranges[range].vertexCount; ++vertex)
+			{
+				auto const& source = model.vertices[vertex];
+				auto& quantized = quantization.vertices[vertex];
+
+				for (int i = 0; i < 3; ++i)
+				{
+					quantized.position[i] = decode.scale[i] > 0.0f
+						? QuantizeSnorm((double(source.position[i]) - decode.offset[i]) / decode.scale[i]) : 0;
+				}
+				quantized.position[3] = source.tangent[3] < 0.0f ? -32767 : 32767;
+
+				EncodeOctahedral(source.normal, quantized.normal);
+				EncodeOctahedral(source.tangent, quantized.tangent);
+				quantized.color = source.color;
+				quantized.textureCoordinate[0] = FloatToHalf(source.textureCoordinate[0]);
+				quantized.textureCoordinate[1] = FloatToHalf(source.textureCoordinate[1]);
+			}
+		}
+	}
+
+	return quantization;
+}
+
+std::vector<uint8_t> MeshCooker::Write(Model const& model, Quantization const* quantization)
+{
+	const auto format = quantization ? CookedMesh::VertexFormat::Quantized : CookedMesh::VertexFormat::PositionNormalTangentColorTexture;
+	const uint32_t stride = CookedMesh::GetVertexStride(format);
+	const void* vertices = quantization ? static_cast<const void*>(quantization->vertices.data()) : model.vertices.data();
+	static_assert(sizeof(Cmo::Vertex) == 52, "Imported vertices are written as they are");
+
+	StringTable strings;
+
+	std::vector<CookedMesh::Mesh> meshes;
+	for (auto const& mesh : model.meshes)
+	{
+		CookedMesh::Mesh cooked;
+		cooked.name = strings.Add(mesh.name);
+		cooked.firstPart = mesh.firstPart;
+		cooked.partCount = mesh.partCount;
+		std::memcpy(cooked.center, mesh.extents.center, sizeof(cooked.center));
+		cooked.radius = mesh.extents.radius;
+		std::memcpy(cooked.min, mesh.extents.min, sizeof(cooked.min));
+		std::memcpy(cooked.max, mesh.extents.max, sizeof(cooked.max));
+		for (int i = 0; i < 3; ++i)
+		{
+			cooked.positionOffset[i] = quantization ? quantization->meshes[meshes.size()].offset[i] : 0.0f;
+			cooked.positionScale[i] = quantization ? quantization->meshes[meshes.size()].scale[i] : 1.0f;
+		}
+		meshes.push_back(cooked);
+	}
+
+	std::vector<CookedMesh::Material> materials;
+	for (auto const& material : model.materials)
+	{
+		CookedMesh::Material cooked = material.constants;
+		cooked.name = strings.Add(material.name);
+		for (uint32_t slot = 0; slot < CookedMesh::TextureSlotCount; ++slot)
+		{
+			cooked.textures[slot] = strings.AddOptional(material.textures[slot]);
+		}
+		materials.push_back(cooked);
+	}
+
+	CookedMesh::Header header = {};
+	header.magic = CookedMesh::Magic;
+	header.version = CookedMesh::Version;
+	header.vertexFormat = format;
+	header.vertexStride = stride;
+	header.vertexCount = uint32_t(model.vertices.size());
+	header.indexCount = uint32_t(model.indices.size());
+	header.meshCount = uint32_t(meshes.size());
+	header.partCount = uint32_t(model.parts.size());
+	header.materialCount = uint32_t(materials.size());
+
+	header.meshOffset = Align(sizeof(header));
+	header.partOffset = Align(header.meshOffset + uint64_t(meshes.size()) * sizeof(CookedMesh::Mesh));
+	header.materialOffset = Align(header.partOffset + uint64_t(model.parts.size()) * sizeof(CookedMesh::Part));
+	header.stringOffset = Align(header.materialOffset + uint64_t(materials.size()) * sizeof(CookedMesh::Material));
+	header.vertexOffset = Align(header.stringOffset + uint64_t(strings.GetBytes().size()));
+	header.indexOffset = Align(header.vertexOffset + uint64_t(model.vertices.size()) * stride);
+
+	const uint64_t fileSize = header.indexOffset + uint64_t(model.indices.size()) * sizeof(uint16_t);
+	if (fileSize > std::numeric_limits<uint32_t>::max())
+		throw std::length_error("Model is too big for a cooked mesh file");
+	header.fileSize = uint32_t(fileSize);
+
+	// Padding between sections stays zero.
+	std::vector<uint8_t> bytes(header.fileSize);
+	auto const put = [&](uint32_t offset, const void* data, size_t size)
+	{
+		if (size > 0)
+		{
+			std::memcpy(bytes.data() + offset, data, size);
+		}
+	};
+
+	put(0, &header, sizeof(header));
+	put(header.meshOffset, meshes.data(), meshes.size() * sizeof(CookedMesh::Mesh));
+	put(header.partOffset, model.parts.data(), model.parts.size() * sizeof(CookedMesh::Part));
+	put(header.materialOffset, materials.data(), materials.size() * sizeof(CookedMesh::Material));
+	put(header.stringOffset, strings.GetBytes().data(), strings.GetBytes().size());
+	put(header.vertexOffset, vertices, model.vertices.size() * stride);
+	put(header.indexOffset, model.indices.data(), model.indices.size() * sizeof(uint16_t));
+	return bytes;
+}
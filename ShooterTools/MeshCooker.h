@@ -0,0 +1,98 @@
+//
+// MeshCooker.h - Turns source models into cooked mesh files
+//
+
+#pragma once
+
+#include "../Shooter/CmoReader.h"
+#include "../Shooter/CookedMesh.h"
+#include "MeshOptimizer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cooking runs in stages over a Model: importing gathers a source file into
+// one vertex stream and one index stream with the parts drawing from them,
+// optimizing reorders them for the GPU, quantizing packs the vertices
+// smaller, and writing lays the result out as a cooked mesh file. Anything
+// the game would otherwise do per vertex at load time belongs in a stage
+// here.
+namespace MeshCooker
+{
+	struct Model
+	{
+		struct Mesh
+		{
+			std::string name;
+			uint32_t firstPart;
+			uint32_t partCount;
+			Cmo::MeshExtents extents;
+		};
+
+		// The numbers go to the file as they are; its string fields are
+		// filled in from the names when it's written.
+		struct Material
+		{
+			std::string name;
+			std::string textures[CookedMesh::TextureSlotCount];
+			CookedMesh::Material constants;
+		};
+
+		std::vector<Mesh> meshes;
+		std::vector<CookedMesh::Part> parts;
+		std::vector<Material> materials;
+		std::vector<Cmo::Vertex> vertices;
+		std::vector<uint16_t> indices;
+	};
+
+	// Gathers every mesh of a CMO file, with the vertex buffers one after
+	// another and each submesh's indices copied out as one part. Texture
+	// coordinates get their material's UV transform applied, as DirectXTK's
+	// loader does. Throws std::runtime_error for skinned meshes, which
+	// cooked files can't hold yet.
+	Model ImportCmo(Cmo::File const& file);
+
+	struct Analysis
+	{
+		MeshOptimizer::VertexCacheStats vertexCache;
+		MeshOptimizer::VertexFetchStats vertexFetch;
+	};
+
+	// Sums the analyses of every part, each drawn from a cold cache.
+	Analysis Analyze(Model const& model);
+
+	// Reorders each part's triangles for the vertex cache and then for
+	// overdraw, then each vertex buffer's vertices into the order the parts
+	// first use them, dropping vertices no part uses. Deterministic.
+	void Optimize(Model& model);
+
+	// The model's vertices as CookedMesh::QuantizedVertex, one for one.
+	struct Quantization
+	{
+		struct PositionDecode
+		{
+			float offset[3];
+			float scale[3];
+		};
+
+		std::vector<CookedMesh::QuantizedVertex> vertices;
+		std::vector<PositionDecode> meshes;		// One per mesh
+	};
+
+	// Quantizes positions within the bounds of their mesh's vertices,
+	// normals and tangents to the octahedral encoding that decodes closest
+	// to them, and texture coordinates to the nearest half floats. Throws
+	// std::runtime_error if meshes share vertices, as each has its own
+	// bounds.
+	Quantization Quantize(Model const& model);
+
+	// Applies a CMO UV transform to a texture coordinate; the identity
+	// leaves it untouched.
+	void TransformTextureCoordinate(float const (&uvTransform)[16], float (&textureCoordinate)[2]) noexcept;
+
+	// Lays the model out as a cooked mesh file, with float vertices or the
+	// quantized ones. Throws std::length_error if it's too big for the
+	// format's 32-bit offsets.
+	std::vector<uint8_t> Write(Model const& model, Quantization const* quantization = nullptr);
+}
@@ -0,0 +1,378 @@
+//
+// MeshOptimizer.cpp
+//
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace MeshOptimizer;
+
+namespace
+{
+	// A FIFO cache kept as the time each vertex last went in: a vertex is
+	// a hit while fewer than cacheSize others have gone in since.
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount, uint32_t cacheSize) :
+			m_entered(vertexCount, 0),
+			m_cacheSize(cacheSize),
+			m_time(cacheSize + 1)
+		{
+		}
+
+		// Returns true for a miss.
+		bool Access(uint32_t vertex) noexcept
+		{
+			if (m_time - m_entered[vertex] <= m_cacheSize)
+				return false;
+
+			m_entered[vertex] = m_time++;
+			return true;
+		}
+
+		void Flush() noexcept
+		{
+			m_time += m_cacheSize + 1;
+		}
+
+	private:
+		std::vector<uint64_t> m_entered;
+		uint32_t m_cacheSize;
+		uint64_t m_time;
+	};
+
+	// Triangles using each vertex, as offsets into one list.
+	struct Adjacency
+	{
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+
+		Adjacency(const uint16_t* indices, size_t indexCount, size_t vertexCount) :
+			counts(vertexCount, 0),
+			offsets(vertexCount, 0),
+			triangles(indexCount)
+		{
+			for (size_t i = 0; i < indexCount; ++i)
+			{
+				counts[indices[i]]++;
+			}
+
+			uint32_t offset = 0;
+			for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+			{
+				offsets[vertex] = offset;
+				offset += counts[vertex];
+			}
+
+			std::vector<uint32_t> fill(offsets);
+			for (size_t i = 0; i < indexCount; ++i)
+			{
+				triangles[fill[indices[i]]++] = uint32_t(i / 3);
+			}
+		}
+	};
+
+	struct Float3
+	{
+		double x, y, z;
+	};
+
+	Float3 GetPosition(const uint8_t* vertices, size_t vertexStride, uint32_t vertex) noexcept
+	{
+		float position[3];
+		std::memcpy(position, vertices + vertex * vertexStride, sizeof(position));
+		return { position[0], position[1], position[2] };
+	}
+
+	// Splits each hard cluster wherever the triangles since the last split
+	// already shade no more vertices per triangle than the threshold allows
+	// the cluster as a whole, starting each piece with a cold cache.
+	std::vector<uint32_t> GetSoftClusters(const uint16_t* indices, size_t indexCount, size_t vertexCount,
+		std::vector<uint32_t> const& hardClusters, float threshold, uint32_t cacheSize)
+	{
+		std::vector<uint32_t> clusters;
+		FifoCache cache(vertexCount, cacheSize);
+
+		for (size_t cluster = 0; cluster < hardClusters.size(); ++cluster)
+		{
+			const uint32_t start = hardClusters[cluster];
+			const uint32_t end = cluster + 1 < hardClusters.size() ? hardClusters[cluster + 1] : uint32_t(indexCount);
+
+			cache.Flush();
+			uint64_t clusterMisses = 0;
+			for (uint32_t i = start; i < end; ++i)
+			{
+				clusterMisses += cache.Access(indices[i]);
+			}
+			const double target = threshold * double(clusterMisses) / double((end - start) / 3);
+
+			clusters.push_back(start);
+			cache.Flush();
+
+			uint64_t misses = 0;
+			uint64_t triangles = 0;
+			for (uint32_t i = start; i < end; i += 3)
+			{
+				misses += cache.Access(indices[i]) + cache.Access(indices[i + 1]) + cache.Access(indices[i + 2]);
+				triangles++;
+
+				if (double(misses) / double(triangles) <= target && i + 3 < end)
+				{
+					clusters.push_back(i + 3);
+					cache.Flush();
+					misses = 0;
+					triangles = 0;
+				}
+			}
+		}
+		return clusters;
+	}
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const uint16_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStats stats = {};
+	stats.triangles = indexCount / 3;
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> seen(vertexCount, false);
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		stats.misses += cache.Access(indices[i]);
+		if (!seen[indices[i]])
+		{
+			seen[indices[i]] = true;
+			stats.vertices++;
+		}
+	}
+	return stats;
+}
+
+VertexFetchStats MeshOptimizer::AnalyzeVertexFetch(const uint16_t* indices, size_t indexCount, size_t vertexCount, size_t vertexStride)
+{
+	constexpr size_t LineSize = 64;
+	constexpr size_t LineCount = 256;
+
+	VertexFetchStats stats = {};
+
+	std::vector<uint64_t> lines(LineCount, ~uint64_t(0));
+	std::vector<bool> seen(vertexCount, false);
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		const uint32_t vertex = indices[i];
+		if (!seen[vertex])
+		{
+			seen[vertex] = true;
+			stats.bytesUsed += vertexStride;
+		}
+
+		const uint64_t first = vertex * vertexStride / LineSize;
+		const uint64_t last = (vertex * vertexStride + vertexStride - 1) / LineSize;
+		for (uint64_t line = first; line <= last; ++line)
+		{
+			uint64_t& slot = lines[line % LineCount];
+			if (slot != line)
+			{
+				slot = line;
+				stats.bytesFetched += LineSize;
+			}
+		}
+	}
+	return stats;
+}
+
+// Tipsify: fan around one vertex at a time, emitting all its remaining
+// triangles, then move on to the vertex among those just touched that's
+// still in the cache and will stay there for its own remaining triangles.
+// When none is, fall back to the most recent vertex with triangles left,
+// and then to the next one in index order.
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexCache(uint16_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	const size_t triangleCount = indexCount / 3;
+	std::vector<uint32_t> hardClusters;
+	if (triangleCount == 0)
+		return hardClusters;
+
+	const Adjacency adjacency(indices, indexCount, vertexCount);
+	std::vector<uint32_t> live(adjacency.counts);
+	std::vector<int64_t> entered(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint16_t> output;
+	output.reserve(indexCount);
+
+	int64_t time = cacheSize + 1;
+	size_t cursor = 0;
+
+	auto const skipDeadEnd = [&]() -> int64_t
+	{
+		while (!deadEnds.empty())
+		{
+			const uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[vertex] > 0)
+				return vertex;
+		}
+
+		for (; cursor < vertexCount; ++cursor)
+		{
+			if (live[cursor] > 0)
+				return int64_t(cursor);
+		}
+		return -1;
+	};
+
+	int64_t fan = skipDeadEnd();
+	hardClusters.push_back(0);
+
+	while (fan >= 0)
+	{
+		candidates.clear();
+
+		const uint32_t begin = adjacency.offsets[fan];
+		for (uint32_t t = begin; t < begin + adjacency.counts[fan]; ++t)
+		{
+			const uint32_t triangle = adjacency.triangles[t];
+			if (emitted[triangle])
+				continue;
+
+			emitted[triangle] = true;
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				const uint16_t vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				live[vertex]--;
+
+				if (time - entered[vertex] > int64_t(cacheSize))
+				{
+					entered[vertex] = time++;
+				}
+			}
+		}
+
+		// The candidate that's been in the cache longest without leaving it
+		// before its remaining triangles are done; the first one wins ties.
+		int64_t next = -1;
+		int64_t best = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (live[vertex] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (time - entered[vertex] + 2 * int64_t(live[vertex]) <= int64_t(cacheSize))
+			{
+				priority = time - entered[vertex];
+			}
+			if (priority > best)
+			{
+				best = priority;
+				next = vertex;
+			}
+		}
+
+		if (next < 0)
+		{
+			next = skipDeadEnd();
+			if (next >= 0 && output.size() < indexCount)
+			{
+				hardClusters.push_back(uint32_t(output.size()));
+			}
+		}
+		fan = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+	return hardClusters;
+}
+
+// Sander et al.: a cluster whose triangles face away from the mesh's
+// centre is on the outside and likely to cover others, so clusters are
+// drawn in decreasing order of how far their centroid lies along their
+// average normal, measured from the mesh's centroid.
+void MeshOptimizer::OptimizeOverdraw(uint16_t* indices, size_t indexCount, std::vector<uint32_t> const& hardClusters,
+	const uint8_t* vertices, size_t vertexCount, size_t vertexStride, float threshold, uint32_t cacheSize)
+{
+	if (indexCount == 0)
+		return;
+
+	const auto clusters = GetSoftClusters(indices, indexCount, vertexCount, hardClusters, threshold, cacheSize);
+
+	Float3 meshCentroid = {};
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		const Float3 position = GetPosition(vertices, vertexStride, indices[i]);
+		meshCentroid.x += position.x;
+		meshCentroid.y += position.y;
+		meshCentroid.z += position.z;
+	}
+	meshCentroid.x /= double(indexCount);
+	meshCentroid.y /= double(indexCount);
+	meshCentroid.z /= double(indexCount);
+
+	std::vector<double> keys(clusters.size());
+	for (size_t cluster = 0; cluster < clusters.size(); ++cluster)
+	{
+		const uint32_t start = clusters[cluster];
+		const uint32_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : uint32_t(indexCount);
+
+		// Area-weighted: the cross products are twice each triangle's area
+		// along its normal.
+		Float3 centroid = {};
+		Float3 normal = {};
+		double area = 0.0;
+		for (uint32_t i = start; i < end; i += 3)
+		{
+			const Float3 a = GetPosition(vertices, vertexStride, indices[i]);
+			const Float3 b = GetPosition(vertices, vertexStride, indices[i + 1]);
+			const Float3 c = GetPosition(vertices, vertexStride, indices[i + 2]);
+
+			const Float3 ab = { b.x - a.x, b.y - a.y, b.z - a.z };
+			const Float3 ac = { c.x - a.x, c.y - a.y, c.z - a.z };
+			const Float3 cross = { ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x };
+			const double weight = std::sqrt(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+
+			centroid.x += (a.x + b.x + c.x) / 3.0 * weight;
+			centroid.y += (a.y + b.y + c.y) / 3.0 * weight;
+			centroid.z += (a.z + b.z + c.z) / 3.0 * weight;
+			normal.x += cross.x;
+			normal.y += cross.y;
+			normal.z += cross.z;
+			area += weight;
+		}
+
+		const double length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		if (area > 0.0 && length > 0.0)
+		{
+			keys[cluster] = ((centroid.x / area - meshCentroid.x) * normal.x
+				+ (centroid.y / area - meshCentroid.y) * normal.y
+				+ (centroid.z / area - meshCentroid.z) * normal.z) / length;
+		}
+	}
+
+	std::vector<uint32_t> order(clusters.size());
+	for (uint32_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+	std::vector<uint16_t> output;
+	output.reserve(indexCount);
+	for (uint32_t cluster : order)
+	{
+		const uint32_t start = clusters[cluster];
+		const uint32_t end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : uint32_t(indexCount);
+		output.insert(output.end(), indices + start, indices + end);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
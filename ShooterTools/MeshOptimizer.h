@@ -0,0 +1,82 @@
+//
+// MeshOptimizer.h - Triangle and vertex orderings that make indexed meshes cheaper to draw
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Orderings for one draw's 16-bit triangle list, for the cooker. None of
+// them change what's drawn, only the order it's drawn in:
+// - OptimizeVertexCache reorders triangles so vertices are reused while
+//   they're still in the post-transform cache (Tipsify, Sander et al. 2007)
+// - OptimizeOverdraw then reorders clusters of those triangles so the ones
+//   facing out from the mesh come first and hide the rest, breaking
+//   clusters up only where that keeps the cache hit rate close
+// Both are deterministic: ties are broken by position, and the same input
+// gives the same output on every run.
+//
+// The analyses use a FIFO cache of the given size, the model the
+// optimization targets; the numbers compare orderings, not GPUs.
+namespace MeshOptimizer
+{
+	constexpr uint32_t CacheSize = 16;
+
+	// Clusters may cost up to this much more ACMR than their whole run.
+	constexpr float OverdrawThreshold = 1.05f;
+
+	struct VertexCacheStats
+	{
+		uint64_t triangles;
+		uint64_t vertices;			// Distinct vertices referenced
+		uint64_t misses;			// Vertex shader invocations
+
+		// Average cache miss ratio: shaded vertices per triangle, 0.5 at best
+		double GetAcmr() const noexcept { return triangles ? double(misses) / double(triangles) : 0.0; }
+
+		// Average transformed vertex ratio: shaded vertices per vertex, 1 at best
+		double GetAtvr() const noexcept { return vertices ? double(misses) / double(vertices) : 0.0; }
+
+		VertexCacheStats& operator+= (VertexCacheStats const& other) noexcept
+		{
+			triangles += other.triangles;
+			vertices += other.vertices;
+			misses += other.misses;
+			return *this;
+		}
+	};
+
+	struct VertexFetchStats
+	{
+		uint64_t bytesFetched;		// In cache lines brought in
+		uint64_t bytesUsed;			// Of the distinct vertices referenced
+
+		// Bytes read per byte used, 1 at best
+		double GetOverfetch() const noexcept { return bytesUsed ? double(bytesFetched) / double(bytesUsed) : 0.0; }
+
+		VertexFetchStats& operator+= (VertexFetchStats const& other) noexcept
+		{
+			bytesFetched += other.bytesFetched;
+			bytesUsed += other.bytesUsed;
+			return *this;
+		}
+	};
+
+	// Every index must be below vertexCount.
+	VertexCacheStats AnalyzeVertexCache(const uint16_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = CacheSize);
+
+	// Fetches through a small direct-mapped cache of 64-byte lines.
+	VertexFetchStats AnalyzeVertexFetch(const uint16_t* indices, size_t indexCount, size_t vertexCount, size_t vertexStride);
+
+	// Reorders the triangles in place and returns where each run between
+	// dead ends starts, the hard cluster boundaries OptimizeOverdraw takes.
+	std::vector<uint32_t> OptimizeVertexCache(uint16_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = CacheSize);
+
+	// Reorders clusters of triangles in place, outward-facing first.
+	// Positions are three floats at the start of each vertex.
+	void OptimizeOverdraw(uint16_t* indices, size_t indexCount, std::vector<uint32_t> const& hardClusters,
+		const uint8_t* vertices, size_t vertexCount, size_t vertexStride,
+		float threshold = OverdrawThreshold, uint32_t cacheSize = CacheSize);
+}
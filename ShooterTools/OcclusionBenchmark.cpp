@@ -0,0 +1,387 @@
+//
+// OcclusionBenchmark.cpp - Times software occlusion culling through a city of buildings and checks it is conservative
+//
+
+#include "Tools.h"
+
+#include "../Shooter/OcclusionCuller.h"
+#include "../Shooter/SceneRegistry.h"
+#include "../Shooter/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	constexpr uint32_t BufferWidth = 320;
+	constexpr uint32_t BufferHeight = 180;
+
+	// A grid of blocks with a building on each, streets in between.
+	constexpr int32_t Blocks = 24;
+	constexpr float BlockSize = 20.0f;
+	constexpr float BuildingSize = 14.0f;
+
+	constexpr float FieldOfView = 70.0f;
+	constexpr float Aspect = 16.0f / 9.0f;
+	constexpr float NearPlane = 0.1f;
+	constexpr float FarPlane = 1000.0f;
+
+	struct Camera
+	{
+		XMFLOAT3 position;
+		float yaw;
+
+		XMMATRIX GetViewProjection() const
+		{
+			const XMVECTOR eye = XMLoadFloat3(&position);
+			const XMVECTOR direction = XMVectorSet(std::sin(yaw), 0.0f, std::cos(yaw), 0.0f);
+
+			return XMMatrixMultiply(
+				XMMatrixLookAtRH(eye, XMVectorAdd(eye, direction), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)),
+				XMMatrixPerspectiveFovRH(XMConvertToRadians(FieldOfView), Aspect, NearPlane, FarPlane));
+		}
+	};
+
+	// Walks down a street, looking around.
+	Camera GetCamera(uint32_t frame, uint32_t frames)
+	{
+		const float t = float(frame) / float(std::max(frames, 1u));
+		const float extent = Blocks * BlockSize * 0.4f;
+
+		return { { BlockSize * 0.5f, 1.8f, -extent + 2.0f * extent * t }, 0.6f * std::sin(t * XM_2PI * 3.0f) };
+	}
+
+	struct City
+	{
+		SceneRegistry buildings;
+		SceneRegistry objects;
+	};
+
+	void BuildCity(City& city, size_t objectCount)
+	{
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> height(3.0f, 20.0f);
+
+		const float origin = -Blocks * BlockSize * 0.5f;
+		for (int32_t z = 0; z < Blocks; ++z)
+		{
+			for (int32_t x = 0; x < Blocks; ++x)
+			{
+				const float halfHeight = height(random);
+				city.buildings.Add({ origin + x * BlockSize, halfHeight, origin + z * BlockSize },
+					{ BuildingSize * 0.5f, halfHeight, BuildingSize * 0.5f });
+			}
+		}
+
+		// Props, cars and crates anywhere, some of them inside buildings.
+		std::uniform_real_distribution<float> position(origin - BlockSize * 0.5f, -origin - BlockSize * 0.5f);
+		std::uniform_real_distribution<float> extent(0.3f, 1.5f);
+
+		city.objects.Reserve(objectCount);
+		for (size_t i = 0; i < objectCount; ++i)
+		{
+			const XMFLOAT3 extents = { extent(random), extent(random), extent(random) };
+			city.objects.Add({ position(random), extents.y, position(random) }, extents);
+		}
+	}
+
+	// One frame: frustum cull both sets, rasterize the nearest visible
+	// buildings, and test the visible objects against them.
+	struct Frame
+	{
+		std::vector<uint32_t> buildings;
+		std::vector<uint32_t> objects;
+		size_t inFrustum;
+		double rasterizeMs;
+		double testMs;
+	};
+
+	void RunFrame(City const& city, OcclusionCuller& culler, ThreadPool* pool, Camera const& camera,
+		uint32_t occluders, Frame& frame)
+	{
+		const XMMATRIX viewProjection = camera.GetViewProjection();
+		const Frustum frustum = Frustum::FromViewProjection(viewProjection);
+
+		city.buildings.Cull(frustum, frame.buildings);
+		city.objects.Cull(frustum, frame.objects);
+		frame.inFrustum = frame.objects.size();
+
+		const XMVECTOR eye = XMLoadFloat3(&camera.position);
+		auto const distance = [&](uint32_t index)
+		{
+			const XMFLOAT3 center = city.buildings.GetCenter(index);
+			const XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&center), eye);
+			return XMVectorGetX(XMVector3LengthSq(offset));
+		};
+
+		const size_t count = std::min<size_t>(occluders, frame.buildings.size());
+		std::partial_sort(frame.buildings.begin(), frame.buildings.begin() + count, frame.buildings.end(),
+			[&](uint32_t a, uint32_t b) { return distance(a) < distance(b); });
+		frame.buildings.resize(count);
+
+		auto const start = std::chrono::steady_clock::now();
+
+		culler.Clear();
+		for (const uint32_t building : frame.buildings)
+		{
+			culler.AddOccluderBox(viewProjection, city.buildings.GetCenter(building), city.buildings.GetExtents(building));
+		}
+		culler.Rasterize(pool);
+
+		auto const rasterized = std::chrono::steady_clock::now();
+
+		culler.Cull(viewProjection, city.objects, frame.objects);
+
+		auto const tested = std::chrono::steady_clock::now();
+
+		frame.rasterizeMs = std::chrono::duration<double, std::milli>(rasterized - start).count();
+		frame.testMs = std::chrono::duration<double, std::milli>(tested - rasterized).count();
+	}
+
+	// Exact depth of the occluders at every pixel center, by casting a ray
+	// per pixel against the boxes.
+	std::vector<float> TraceDepth(City const& city, std::vector<uint32_t> const& occluders, Camera const& camera)
+	{
+		const XMMATRIX viewProjection = camera.GetViewProjection();
+		const float tanY = std::tan(XMConvertToRadians(FieldOfView) * 0.5f);
+		const float tanX = tanY * Aspect;
+
+		const XMVECTOR forward = XMVectorSet(std::sin(camera.yaw), 0.0f, std::cos(camera.yaw), 0.0f);
+		const XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		const XMVECTOR right = XMVector3Normalize(XMVector3Cross(forward, up));
+		const XMVECTOR eye = XMLoadFloat3(&camera.position);
+
+		std::vector<float> depth(size_t(BufferWidth) * BufferHeight, 1.0f);
+		for (uint32_t y = 0; y < BufferHeight; ++y)
+		{
+			for (uint32_t x = 0; x < BufferWidth; ++x)
+			{
+				const float ndcX = (float(x) + 0.5f) / BufferWidth * 2.0f - 1.0f;
+				const float ndcY = 1.0f - (float(y) + 0.5f) / BufferHeight * 2.0f;
+
+				XMFLOAT3 direction;
+				XMStoreFloat3(&direction, XMVectorAdd(forward,
+					XMVectorAdd(XMVectorScale(right, ndcX * tanX), XMVectorScale(up, ndcY * tanY))));
+
+				float nearest = FarPlane * 2.0f;
+				for (const uint32_t building : occluders)
+				{
+					const XMFLOAT3 center = city.buildings.GetCenter(building);
+					const XMFLOAT3 extents = city.buildings.GetExtents(building);
+
+					const float origin[3] = { camera.position.x, camera.position.y, camera.position.z };
+					const float dir[3] = { direction.x, direction.y, direction.z };
+					const float low[3] = { center.x - extents.x, center.y - extents.y, center.z - extents.z };
+					const float high[3] = { center.x + extents.x, center.y + extents.y, center.z + extents.z };
+
+					float enter = 0.0f;
+					float exit = nearest;
+					for (int axis = 0; axis < 3 && enter <= exit; ++axis)
+					{
+						if (dir[axis] == 0.0f)
+						{
+							if (origin[axis] < low[axis] || origin[axis] > high[axis])
+								exit = -1.0f;
+							continue;
+						}
+
+						float t0 = (low[axis] - origin[axis]) / dir[axis];
+						float t1 = (high[axis] - origin[axis]) / dir[axis];
+						if (t0 > t1)
+							std::swap(t0, t1);
+
+						enter = std::max(enter, t0);
+						exit = std::min(exit, t1);
+					}
+
+					if (enter <= exit)
+					{
+						nearest = enter;
+					}
+				}
+
+				if (nearest < FarPlane * 2.0f)
+				{
+					const XMVECTOR hit = XMVectorAdd(eye, XMVectorScale(XMLoadFloat3(&direction), nearest));
+					XMFLOAT4 clip;
+					XMStoreFloat4(&clip, XMVector3Transform(hit, viewProjection));
+					depth[size_t(y) * BufferWidth + x] = std::min(clip.z / clip.w, 1.0f);
+				}
+			}
+		}
+		return depth;
+	}
+
+	// The same screen rectangle test as the culler, against exact depth.
+	bool IsHiddenExactly(std::vector<float> const& depth, XMMATRIX viewProjection, XMFLOAT3 const& center, XMFLOAT3 const& extents)
+	{
+		float minX = 1e30f, minY = 1e30f, minZ = 1e30f, maxX = -1e30f, maxY = -1e30f;
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			const XMVECTOR corner = XMVectorSet(
+				center.x + ((i & 1) ? extents.x : -extents.x),
+				center.y + ((i & 2) ? extents.y : -extents.y),
+				center.z + ((i & 4) ? extents.z : -extents.z), 1.0f);
+
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector3Transform(corner, viewProjection));
+			if (clip.z < 0.0f || clip.w <= 0.0f)
+				return false;
+
+			minX = std::min(minX, (clip.x / clip.w * 0.5f + 0.5f) * BufferWidth);
+			maxX = std::max(maxX, (clip.x / clip.w * 0.5f + 0.5f) * BufferWidth);
+			minY = std::min(minY, (0.5f - clip.y / clip.w * 0.5f) * BufferHeight);
+			maxY = std::max(maxY, (0.5f - clip.y / clip.w * 0.5f) * BufferHeight);
+			minZ = std::min(minZ, clip.z / clip.w);
+		}
+
+		const int32_t left = int32_t(std::max(minX, 0.0f));
+		const int32_t top = int32_t(std::max(minY, 0.0f));
+		const int32_t right = int32_t(std::min(maxX, float(BufferWidth - 1)));
+		const int32_t bottom = int32_t(std::min(maxY, float(BufferHeight - 1)));
+
+		for (int32_t y = top; y <= bottom; ++y)
+		{
+			for (int32_t x = left; x <= right; ++x)
+			{
+				if (minZ <= depth[size_t(y) * BufferWidth + x])
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Anything the culler hides must be hidden by the exact depth too.
+	void CheckConservative(City const& city, uint32_t occluders, uint32_t frames)
+	{
+		std::printf("conservative:\n");
+
+		OcclusionCuller culler(BufferWidth, BufferHeight);
+		Frame frame;
+
+		uint64_t tested = 0, culled = 0, hidden = 0, wrong = 0;
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			auto const camera = GetCamera(i * frames / 4 + frames / 8, frames);
+			const XMMATRIX viewProjection = camera.GetViewProjection();
+
+			RunFrame(city, culler, nullptr, camera, occluders, frame);
+			auto const depth = TraceDepth(city, frame.buildings, camera);
+
+			// RunFrame kept the visible ones; test everything in the frustum again.
+			std::vector<uint32_t> candidates;
+			city.objects.Cull(Frustum::FromViewProjection(viewProjection), candidates);
+
+			for (const uint32_t object : candidates)
+			{
+				const XMFLOAT3 center = city.objects.GetCenter(object);
+				const XMFLOAT3 extents = city.objects.GetExtents(object);
+
+				const bool culledHere = !culler.IsVisible(viewProjection, center, extents);
+				const bool hiddenExactly = IsHiddenExactly(depth, viewProjection, center, extents);
+
+				tested++;
+				culled += culledHere ? 1 : 0;
+				hidden += hiddenExactly ? 1 : 0;
+				wrong += culledHere && !hiddenExactly ? 1 : 0;
+			}
+		}
+
+		std::printf("  %llu tested, %llu culled, %llu hidden by exact depth (%.1f%% of those found)\n",
+			static_cast<unsigned long long>(tested), static_cast<unsigned long long>(culled),
+			static_cast<unsigned long long>(hidden), hidden ? 100.0 * double(culled) / double(hidden) : 100.0);
+		Tools::Check(wrong == 0, "culled an object that is visible");
+		Tools::Check(culled > 0, "nothing was culled");
+	}
+
+	// Any number of threads must give the same buffer.
+	void CheckThreads(City const& city, uint32_t occluders, uint32_t frames)
+	{
+		std::printf("threads:\n");
+
+		ThreadPool pool(3);
+
+		OcclusionCuller serial(BufferWidth, BufferHeight);
+		OcclusionCuller parallel(BufferWidth, BufferHeight);
+		Frame serialFrame, parallelFrame;
+
+		bool same = true;
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			auto const camera = GetCamera(i * frames / 8, frames);
+			RunFrame(city, serial, nullptr, camera, occluders, serialFrame);
+			RunFrame(city, parallel, &pool, camera, occluders, parallelFrame);
+
+			same &= serialFrame.objects == parallelFrame.objects;
+			for (uint32_t y = 0; y < BufferHeight; ++y)
+			{
+				for (uint32_t x = 0; x < BufferWidth; ++x)
+				{
+					same &= serial.GetDepthBound(x, y) == parallel.GetDepthBound(x, y);
+				}
+			}
+		}
+
+		std::printf("  1 and %u threads %s\n", pool.GetWorkerCount() + 1, same ? "match" : "DIFFER");
+		Tools::Check(same, "threaded rasterization differs");
+	}
+
+	void Measure(City const& city, ThreadPool* pool, uint32_t occluders, uint32_t frames)
+	{
+		OcclusionCuller culler(BufferWidth, BufferHeight);
+		Frame frame;
+
+		double rasterizeMs = 0.0, testMs = 0.0, worstMs = 0.0;
+		uint64_t inFrustum = 0;
+		for (uint32_t i = 0; i < frames; ++i)
+		{
+			RunFrame(city, culler, pool, GetCamera(i, frames), occluders, frame);
+			rasterizeMs += frame.rasterizeMs;
+			testMs += frame.testMs;
+			worstMs = std::max(worstMs, frame.rasterizeMs + frame.testMs);
+			inFrustum += frame.inFrustum;
+		}
+
+		auto const& stats = culler.GetStats();
+		std::printf("%u thread%s:\n", pool ? pool->GetWorkerCount() + 1 : 1, pool && pool->GetWorkerCount() ? "s" : "");
+		std::printf("  rasterize %.3f ms, test %.3f ms, %.3f ms per frame (worst %.3f)\n",
+			rasterizeMs / frames, testMs / frames, (rasterizeMs + testMs) / frames, worstMs);
+		std::printf("  %.0f occluder triangles, %.0f objects in the frustum, %.1f%% culled per frame\n",
+			double(stats.triangles) / frames, double(inFrustum) / frames,
+			stats.tests ? 100.0 * double(stats.occluded) / double(stats.tests) : 0.0);
+	}
+}
+
+int RunOcclusionBenchmark(int argc, char** argv)
+{
+	const size_t objects = static_cast<size_t>(Tools::GetArgument(argc, argv, 0, 20000));
+	const uint32_t frames = std::max(1u, static_cast<uint32_t>(Tools::GetArgument(argc, argv, 1, 200)));
+	const uint32_t occluders = static_cast<uint32_t>(Tools::GetArgument(argc, argv, 2, 32));
+	const uint32_t threads = std::max(1u, static_cast<uint32_t>(Tools::GetArgument(argc, argv, 3, ThreadPool::GetDefaultWorkerCount() + 1)));
+
+	City city;
+	BuildCity(city, objects);
+
+	ThreadPool pool(threads - 1);
+
+	std::printf("%ux%u buffer, %zu buildings, %zu objects, nearest %u buildings occlude\n\n",
+		BufferWidth, BufferHeight, city.buildings.GetSize(), city.objects.GetSize(), occluders);
+
+	CheckConservative(city, occluders, frames);
+	CheckThreads(city, occluders, frames);
+
+	std::printf("\n");
+	Measure(city, nullptr, occluders, frames);
+	if (pool.GetWorkerCount() > 0)
+	{
+		Measure(city, &pool, occluders, frames);
+	}
+
+	return Tools::Finish("occlusion");
+}
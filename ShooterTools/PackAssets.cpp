@@ -0,0 +1,147 @@
+//
+// PackAssets.cpp - Packs the game's cooked assets into one compressed archive and checks it against the loose files
+//
+// Shooter/Assets/Assets.pak is this command's output over the files in
+// GameAssets.h, and is committed along with them. The build's assets target
+// cooks them and packs them again; the cooked-current and assets-current
+// tests fail until it has run after a change to the cookers, their sources
+// or the list.
+//
+
+#include "Tools.h"
+#include "ArchivePacker.h"
+
+#include "../Shooter/AssetArchive.h"
+#include "../Shooter/CookedMesh.h"
+#include "../Shooter/GameAssets.h"
+#include "../Shooter/MappedFile.h"
+#include "../Shooter/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Every source must come back byte for byte from both backends, under
+	// its name however it's spelled, and cooked meshes must parse from
+	// what the game would hand them.
+	void Verify(std::vector<ArchivePacker::Source> const& sources, std::filesystem::path const& archivePath)
+	{
+		const AssetArchive::Reader mapped(archivePath, AssetArchive::Reader::Backend::Mapped);
+		const AssetArchive::Reader read(archivePath, AssetArchive::Reader::Backend::Read);
+		Tools::Check(mapped.GetEntryCount() == sources.size() && read.GetEntryCount() == sources.size(), "entry count");
+
+		std::vector<uint8_t> buffer;
+		std::vector<uint8_t> decoded;
+		for (auto const& source : sources)
+		{
+			const MappedFile loose(source.path);
+
+			auto const entry = mapped.Find(source.name);
+			Tools::Check(entry != nullptr && entry->size == loose.GetSize(), "mapped entry found");
+			if (!entry)
+				continue;
+
+			// Compressed entries are decoded; the rest are used in place.
+			const uint8_t* data;
+			if (AssetArchive::Reader::IsCompressed(*entry))
+			{
+				decoded.resize(size_t(entry->size));
+				mapped.ReadEntry(*entry, decoded.data());
+				data = decoded.data();
+			}
+			else
+			{
+				data = mapped.GetData(*entry);
+				Tools::Check(reinterpret_cast<uintptr_t>(data) % AssetArchive::EntryAlignment == 0, "entry alignment");
+			}
+			Tools::Check(entry->size == 0 || std::memcmp(data, loose.GetData(), loose.GetSize()) == 0, "mapped entry bytes");
+
+			auto const readEntry = read.Find(source.name);
+			Tools::Check(readEntry != nullptr, "read entry found");
+			if (readEntry)
+			{
+				buffer.resize(size_t(readEntry->size));
+				read.ReadEntry(*readEntry, buffer.data());
+				Tools::Check(buffer.empty() || std::memcmp(buffer.data(), loose.GetData(), loose.GetSize()) == 0, "read entry bytes");
+			}
+
+			std::string respelled = "./" + source.name;
+			std::transform(respelled.begin(), respelled.end(), respelled.begin(),
+				[](char c) { return (c >= 'a' && c <= 'z') ? char(c - 'a' + 'A') : c; });
+			Tools::Check(mapped.Find(respelled) == entry, "lookup ignores case and dot components");
+
+			if (source.path.extension() == ".cmesh")
+			{
+				const CookedMesh::File mesh(data, size_t(entry->size));
+				Tools::Check(mesh.GetMeshCount() > 0, "cooked mesh parses in place");
+			}
+		}
+
+		Tools::Check(mapped.Find("no-such-asset") == nullptr, "missing entry");
+	}
+
+	// Only what the game loads, in the order it loads them.
+	std::vector<ArchivePacker::Source> ListGameAssets(std::filesystem::path const& directory)
+	{
+		std::vector<ArchivePacker::Source> sources;
+		for (auto const name : GameAssets::All)
+		{
+			sources.push_back({ name, directory / name });
+		}
+		return sources;
+	}
+}
+
+int RunPackAssets(int argc, char** argv)
+{
+	const std::filesystem::path directory = argc > 0 ? argv[0] : "Shooter/Assets";
+	const std::filesystem::path output = argc > 1 ? std::filesystem::path(argv[1]) : directory / GameAssets::Archive;
+	const std::string compression = argc > 2 ? argv[2] : "lz4";
+
+	ArchivePacker::Options options;
+	options.compression = compression == "none" ? AssetArchive::Compression::None : AssetArchive::Compression::Lz4;
+	options.blockSize = uint32_t(Tools::GetArgument(argc, argv, 3, options.blockSize / 1024) * 1024);
+
+	try
+	{
+		if (compression != "none" && compression != "lz4")
+			throw std::invalid_argument("Unknown compression " + compression);
+
+		const auto sources = ListGameAssets(directory);
+
+		ThreadPool pool(ThreadPool::GetDefaultWorkerCount());
+		auto const start = std::chrono::steady_clock::now();
+		const auto stats = ArchivePacker::Pack(sources, output, options, &pool);
+		const double packTime = Tools::Seconds(start);
+
+		const AssetArchive::Reader archive(output);
+		std::printf("%s:\n", output.string().c_str());
+		for (uint32_t i = 0; i < archive.GetEntryCount(); ++i)
+		{
+			auto const& entry = archive.GetEntry(i);
+			std::printf("  %016llx  %8llu bytes, %8llu stored at %8llu  %s\n", (unsigned long long)entry.hash,
+				(unsigned long long)entry.size, (unsigned long long)entry.storedSize, (unsigned long long)entry.offset,
+				archive.GetName(entry));
+		}
+
+		std::printf("\n%u files (%u compressed), %llu bytes stored in %llu (%.2fx) and packed into %llu in %.2f ms\n",
+			stats.entryCount, stats.compressedCount, (unsigned long long)stats.contentBytes, (unsigned long long)stats.storedBytes,
+			stats.storedBytes ? double(stats.contentBytes) / double(stats.storedBytes) : 0.0,
+			(unsigned long long)stats.fileSize, packTime * 1000.0);
+
+		Verify(sources, output);
+	}
+	catch (std::exception const& e)
+	{
+		Tools::Check(false, e.what());
+	}
+
+	return Tools::Finish("pack-assets");
+}
@@ -0,0 +1,532 @@
+//
+// PngReader.cpp
+//
+
+#include "PngReader.h"
+#include "../Shooter/MappedFile.h"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace Png;
+
+namespace
+{
+	// The largest texture Direct3D 11 can create on a side.
+	constexpr uint32_t MaxDimension = 16384;
+
+	[[noreturn]] void Fail(const char* what)
+	{
+		throw std::runtime_error(std::string("Invalid PNG: ") + what);
+	}
+
+	uint32_t ReadBigEndian(const uint8_t* bytes) noexcept
+	{
+		return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | bytes[3];
+	}
+
+	uint32_t Crc32(const uint8_t* data, size_t size) noexcept
+	{
+		static const auto table = []()
+		{
+			std::array<uint32_t, 256> result = {};
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t c = i;
+				for (int bit = 0; bit < 8; ++bit)
+				{
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				}
+				result[i] = c;
+			}
+			return result;
+		}();
+
+		uint32_t crc = ~0u;
+		for (size_t i = 0; i < size; ++i)
+		{
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	uint32_t Adler32(const uint8_t* data, size_t size) noexcept
+	{
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			a = (a + data[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	// Deflate's bits come least significant first.
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* data, size_t size) noexcept : m_data(data), m_size(size), m_position(0), m_buffer(0), m_count(0) {}
+
+		uint32_t Bits(int count)
+		{
+			while (m_count < count)
+			{
+				if (m_position == m_size)
+					Fail("truncated image data");
+				m_buffer |= uint32_t(m_data[m_position++]) << m_count;
+				m_count += 8;
+			}
+
+			const uint32_t value = m_buffer & ((1u << count) - 1);
+			m_buffer >>= count;
+			m_count -= count;
+			return value;
+		}
+
+		// Stored blocks start on a byte boundary.
+		void AlignToByte() noexcept
+		{
+			m_buffer = 0;
+			m_count = 0;
+		}
+
+		const uint8_t* TakeBytes(size_t count)
+		{
+			if (count > m_size - m_position)
+				Fail("truncated image data");
+			const uint8_t* bytes = m_data + m_position;
+			m_position += count;
+			return bytes;
+		}
+
+	private:
+		const uint8_t* m_data;
+		size_t m_size;
+		size_t m_position;
+		uint32_t m_buffer;
+		int m_count;
+	};
+
+	// A canonical Huffman code as the number of codes of each length and the
+	// symbols in code order, decoded a bit at a time.
+	class Huffman
+	{
+	public:
+		Huffman(const uint8_t* lengths, int symbolCount)
+		{
+			m_counts.fill(0);
+			for (int symbol = 0; symbol < symbolCount; ++symbol)
+			{
+				m_counts[lengths[symbol]]++;
+			}
+
+			int left = 1;
+			for (int length = 1; length <= MaxBits; ++length)
+			{
+				left = left * 2 - m_counts[length];
+				if (left < 0)
+					Fail("over-subscribed Huffman code");
+			}
+
+			std::array<uint16_t, MaxBits + 1> offsets = {};
+			for (int length = 1; length < MaxBits; ++length)
+			{
+				offsets[length + 1] = uint16_t(offsets[length] + m_counts[length]);
+			}
+			for (int symbol = 0; symbol < symbolCount; ++symbol)
+			{
+				if (lengths[symbol] != 0)
+				{
+					m_symbols[offsets[lengths[symbol]]++] = uint16_t(symbol);
+				}
+			}
+		}
+
+		int Decode(BitReader& bits) const
+		{
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (int length = 1; length <= MaxBits; ++length)
+			{
+				code |= int(bits.Bits(1));
+				const int count = m_counts[length];
+				if (code - count < first)
+					return m_symbols[index + (code - first)];
+
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+			Fail("bad Huffman code");
+		}
+
+	private:
+		static constexpr int MaxBits = 15;
+
+		std::array<uint16_t, MaxBits + 1> m_counts;
+		std::array<uint16_t, 288> m_symbols = {};
+	};
+
+	const uint16_t c_lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t c_lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t c_distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t c_distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	void InflateBlock(BitReader& bits, Huffman const& literals, Huffman const& distances, std::vector<uint8_t>& output, size_t limit)
+	{
+		for (;;)
+		{
+			const int symbol = literals.Decode(bits);
+			if (symbol < 256)
+			{
+				if (output.size() == limit)
+					Fail("more image data than the image holds");
+				output.push_back(uint8_t(symbol));
+				continue;
+			}
+			if (symbol == 256)
+				return;
+
+			if (symbol > 285)
+				Fail("bad length code");
+			const size_t length = c_lengthBase[symbol - 257] + bits.Bits(c_lengthExtra[symbol - 257]);
+
+			const int distanceSymbol = distances.Decode(bits);
+			if (distanceSymbol > 29)
+				Fail("bad distance code");
+			const size_t distance = c_distanceBase[distanceSymbol] + bits.Bits(c_distanceExtra[distanceSymbol]);
+
+			if (distance > output.size())
+				Fail("distance before the start of the data");
+			if (length > limit - output.size())
+				Fail("more image data than the image holds");
+
+			// Byte by byte: a copy may overlap the bytes it's producing.
+			const size_t from = output.size() - distance;
+			for (size_t i = 0; i < length; ++i)
+			{
+				output.push_back(output[from + i]);
+			}
+		}
+	}
+
+	// A zlib stream of deflate blocks, inflating to at most limit bytes.
+	std::vector<uint8_t> Inflate(const uint8_t* data, size_t size, size_t limit)
+	{
+		if (size < 6)
+			Fail("truncated image data");
+		if ((data[0] & 0x0F) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+			Fail("zlib header");
+
+		std::vector<uint8_t> output;
+		output.reserve(limit);
+
+		BitReader bits(data + 2, size - 6);
+		bool last = false;
+		while (!last)
+		{
+			last = bits.Bits(1) != 0;
+			const uint32_t type = bits.Bits(2);
+
+			if (type == 0)
+			{
+				bits.AlignToByte();
+				const uint8_t* header = bits.TakeBytes(4);
+				const uint32_t length = header[0] | (header[1] << 8);
+				if ((length ^ 0xFFFF) != uint32_t(header[2] | (header[3] << 8)))
+					Fail("stored block length");
+				if (length > limit - output.size())
+					Fail("more image data than the image holds");
+				const uint8_t* bytes = bits.TakeBytes(length);
+				output.insert(output.end(), bytes, bytes + length);
+			}
+			else if (type == 1)
+			{
+				static const auto fixed = []()
+				{
+					uint8_t lengths[288 + 30];
+					std::memset(lengths, 8, 144);
+					std::memset(lengths + 144, 9, 112);
+					std::memset(lengths + 256, 7, 24);
+					std::memset(lengths + 280, 8, 8);
+					std::memset(lengths + 288, 5, 30);
+					return std::make_pair(Huffman(lengths, 288), Huffman(lengths + 288, 30));
+				}();
+				InflateBlock(bits, fixed.first, fixed.second, output, limit);
+			}
+			else if (type == 2)
+			{
+				static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+				const uint32_t literalCount = bits.Bits(5) + 257;
+				const uint32_t distanceCount = bits.Bits(5) + 1;
+				const uint32_t codeLengthCount = bits.Bits(4) + 4;
+				if (literalCount > 286 || distanceCount > 30)
+					Fail("bad code counts");
+
+				uint8_t lengths[288 + 32] = {};
+				for (uint32_t i = 0; i < codeLengthCount; ++i)
+				{
+					lengths[order[i]] = uint8_t(bits.Bits(3));
+				}
+				const Huffman codeLengths(lengths, 19);
+
+				uint32_t count = 0;
+				while (count < literalCount + distanceCount)
+				{
+					const int symbol = codeLengths.Decode(bits);
+					if (symbol < 16)
+					{
+						lengths[count++] = uint8_t(symbol);
+						continue;
+					}
+
+					uint8_t repeated = 0;
+					uint32_t repeat = 0;
+					if (symbol == 16)
+					{
+						if (count == 0)
+							Fail("repeat with no code length before it");
+						repeated = lengths[count - 1];
+						repeat = 3 + bits.Bits(2);
+					}
+					else if (symbol == 17)
+					{
+						repeat = 3 + bits.Bits(3);
+					}
+					else
+					{
+						repeat = 11 + bits.Bits(7);
+					}
+
+					if (count + repeat > literalCount + distanceCount)
+						Fail("too many code lengths");
+					while (repeat-- > 0)
+					{
+						lengths[count++] = repeated;
+					}
+				}
+
+				if (lengths[256] == 0)
+					Fail("no end of block code");
+
+				const Huffman literals(lengths, int(literalCount));
+				const Huffman distances(lengths + literalCount, int(distanceCount));
+				InflateBlock(bits, literals, distances, output, limit);
+			}
+			else
+			{
+				Fail("bad block type");
+			}
+		}
+
+		if (Adler32(output.data(), output.size()) != ReadBigEndian(data + size - 4))
+			Fail("image data checksum");
+		return output;
+	}
+
+	uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c) noexcept
+	{
+		const int p = int(a) + int(b) - int(c);
+		const int pa = std::abs(p - int(a));
+		const int pb = std::abs(p - int(b));
+		const int pc = std::abs(p - int(c));
+		return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+	}
+
+	// Undoes each row's filter in place, leaving the filter bytes behind.
+	void Unfilter(std::vector<uint8_t>& data, uint32_t height, size_t rowBytes, size_t pixelBytes)
+	{
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			uint8_t* row = data.data() + y * (rowBytes + 1);
+			const uint8_t filter = row[0];
+			++row;
+			const uint8_t* above = y > 0 ? row - (rowBytes + 1) : nullptr;
+
+			for (size_t x = 0; x < rowBytes; ++x)
+			{
+				const uint8_t left = x >= pixelBytes ? row[x - pixelBytes] : 0;
+				const uint8_t up = above ? above[x] : 0;
+				const uint8_t upLeft = above && x >= pixelBytes ? above[x - pixelBytes] : 0;
+
+				switch (filter)
+				{
+				case 0: break;
+				case 1: row[x] = uint8_t(row[x] + left); break;
+				case 2: row[x] = uint8_t(row[x] + up); break;
+				case 3: row[x] = uint8_t(row[x] + ((left + up) >> 1)); break;
+				case 4: row[x] = uint8_t(row[x] + Paeth(left, up, upLeft)); break;
+				default: Fail("bad row filter");
+				}
+			}
+		}
+	}
+}
+
+Image Png::Read(std::filesystem::path const& path)
+{
+	const MappedFile file(path);
+	return Decode(file.GetData(), file.GetSize());
+}
+
+Image Png::Decode(const uint8_t* data, size_t size)
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (size < sizeof(signature) || std::memcmp(data, signature, sizeof(signature)) != 0)
+		Fail("not a PNG file");
+
+	Image image = {};
+	uint32_t colorType = 0;
+	uint32_t bitDepth = 0;
+	std::vector<uint8_t> compressed;
+	std::vector<uint8_t> palette;
+	std::vector<uint8_t> transparency;
+	bool ended = false;
+
+	size_t position = sizeof(signature);
+	while (!ended)
+	{
+		if (size - position < 12)
+			Fail("truncated chunk");
+
+		const uint32_t length = ReadBigEndian(data + position);
+		if (length > size - position - 12)
+			Fail("truncated chunk");
+
+		const uint8_t* type = data + position + 4;
+		const uint8_t* body = type + 4;
+		if (Crc32(type, length + 4) != ReadBigEndian(body + length))
+			Fail("chunk checksum");
+		position += 12 + size_t(length);
+
+		const bool first = compressed.empty() && image.width == 0;
+		if (std::memcmp(type, "IHDR", 4) == 0)
+		{
+			if (!first || length != 13)
+				Fail("header");
+
+			image.width = ReadBigEndian(body);
+			image.height = ReadBigEndian(body + 4);
+			bitDepth = body[8];
+			colorType = body[9];
+			if (image.width == 0 || image.height == 0 || image.width > MaxDimension || image.height > MaxDimension)
+				Fail("image size");
+			if (colorType != 0 && colorType != 2 && colorType != 3 && colorType != 4 && colorType != 6)
+				Fail("color type");
+
+			// Grayscale and palette images may pack samples smaller than a byte.
+			const bool packed = colorType == 0 || colorType == 3;
+			if (bitDepth != 8 && !(packed && (bitDepth == 1 || bitDepth == 2 || bitDepth == 4)))
+				Fail("only 8-bit samples, or fewer for grayscale and palette images, are supported");
+			if (body[10] != 0 || body[11] != 0)
+				Fail("compression or filter method");
+			if (body[12] != 0)
+				Fail("interlaced images are not supported");
+		}
+		else if (image.width == 0)
+		{
+			Fail("first chunk isn't the header");
+		}
+		else if (std::memcmp(type, "PLTE", 4) == 0)
+		{
+			if (length % 3 != 0 || length > 256 * 3)
+				Fail("palette");
+			palette.assign(body, body + length);
+		}
+		else if (std::memcmp(type, "tRNS", 4) == 0)
+		{
+			transparency.assign(body, body + length);
+		}
+		else if (std::memcmp(type, "sRGB", 4) == 0)
+		{
+			image.srgb = true;
+		}
+		else if (std::memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), body, body + length);
+		}
+		else if (std::memcmp(type, "IEND", 4) == 0)
+		{
+			ended = true;
+		}
+		else if (!(type[0] & 0x20))
+		{
+			// Lower case first letters mark chunks that are safe to skip.
+			Fail("unknown critical chunk");
+		}
+	}
+
+	if (colorType == 3 && palette.empty())
+		Fail("palette image without a palette");
+
+	// Filters work on whole bytes, a pixel's or one for packed samples.
+	static const uint32_t channelCounts[7] = { 1, 0, 3, 1, 2, 0, 4 };
+	const size_t pixelBits = size_t(channelCounts[colorType]) * bitDepth;
+	const size_t pixelBytes = (pixelBits + 7) / 8;
+	const size_t rowBytes = (image.width * pixelBits + 7) / 8;
+	const uint32_t sampleMask = (1u << bitDepth) - 1;
+
+	auto pixels = Inflate(compressed.data(), compressed.size(), (rowBytes + 1) * image.height);
+	if (pixels.size() != (rowBytes + 1) * image.height)
+		Fail("less image data than the image holds");
+	Unfilter(pixels, image.height, rowBytes, pixelBytes);
+
+	// tRNS holds a 16-bit key color for grayscale and RGB images and an
+	// alpha per palette entry for palette images.
+	const bool keyed = (colorType == 0 && transparency.size() >= 2) || (colorType == 2 && transparency.size() >= 6);
+
+	image.rgba.resize(size_t(image.width) * image.height * 4);
+	for (uint32_t y = 0; y < image.height; ++y)
+	{
+		const uint8_t* row = pixels.data() + y * (rowBytes + 1) + 1;
+		uint8_t* out = image.rgba.data() + size_t(y) * image.width * 4;
+
+		for (uint32_t x = 0; x < image.width; ++x, out += 4)
+		{
+			const uint8_t* in = row + x * pixelBits / 8;
+
+			// Packed samples fill each byte from the top bit down.
+			uint32_t sample = in[0];
+			if (bitDepth < 8)
+			{
+				sample = (in[0] >> (8 - bitDepth - x * bitDepth % 8)) & sampleMask;
+			}
+
+			switch (colorType)
+			{
+			case 0:
+				out[0] = out[1] = out[2] = uint8_t(sample * 255 / sampleMask);
+				out[3] = keyed && sample == ((uint32_t(transparency[0]) << 8) | transparency[1]) ? 0 : 255;
+				break;
+			case 2:
+				out[0] = in[0];
+				out[1] = in[1];
+				out[2] = in[2];
+				out[3] = keyed && transparency[0] == 0 && in[0] == transparency[1] && transparency[2] == 0 && in[1] == transparency[3]
+					&& transparency[4] == 0 && in[2] == transparency[5] ? 0 : 255;
+				break;
+			case 3:
+				if (sample * 3 >= palette.size())
+					Fail("palette index");
+				std::memcpy(out, &palette[sample * 3], 3);
+				out[3] = sample < transparency.size() ? transparency[sample] : 255;
+				break;
+			case 4:
+				out[0] = out[1] = out[2] = in[0];
+				out[3] = in[1];
+				break;
+			default:
+				std::memcpy(out, in, 4);
+				break;
+			}
+		}
+	}
+
+	return image;
+}
@@ -0,0 +1,35 @@
+//
+// PngReader.h - Decodes PNG images for the texture cooker without platform codecs
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Enough of PNG for the game's source art: non-interlaced images of 8-bit
+// grayscale, RGB or palette samples with or without alpha, as every paint
+// program writes by default, or of 1, 2 or 4-bit grayscale and palette
+// samples. Everything is expanded to RGBA8. The zlib stream is inflated
+// here and every chunk's CRC and the stream's Adler-32 are checked, so a
+// damaged file fails rather than cooking into garbage.
+//
+// The color space is taken from the sRGB chunk, as DirectXTK's WIC loader
+// does; without one the samples are treated as linear.
+namespace Png
+{
+	struct Image
+	{
+		uint32_t width;
+		uint32_t height;
+		bool srgb;
+		std::vector<uint8_t> rgba;		// Rows top to bottom, 4 bytes per pixel
+	};
+
+	// Throws std::runtime_error if the file can't be read, isn't a PNG or
+	// uses a feature listed above as unsupported.
+	Image Read(std::filesystem::path const& path);
+	Image Decode(const uint8_t* data, size_t size);
+}
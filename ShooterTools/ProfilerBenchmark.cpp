@@ -0,0 +1,164 @@
+//
+// ProfilerBenchmark.cpp - Measures the cost of profiler scopes
+//
+
+#include "Tools.h"
+
+#include "../Shooter/Profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Keeps the loop body from being folded away around the markers.
+	thread_local volatile uint64_t t_sink;
+
+	double TimeScopes(uint64_t scopes)
+	{
+		auto const start = std::chrono::steady_clock::now();
+
+		for (uint64_t i = 0; i < scopes; ++i)
+		{
+			PROFILE_SCOPE("Scope");
+			t_sink = i;
+		}
+
+		auto const elapsed = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration<double, std::nano>(elapsed).count() / double(scopes);
+	}
+
+	void RecordNested(uint64_t frames)
+	{
+		for (uint64_t i = 0; i < frames; ++i)
+		{
+			PROFILE_SCOPE("Frame");
+			{
+				PROFILE_SCOPE("Update");
+				t_sink = i;
+			}
+			{
+				PROFILE_SCOPE("Render");
+				t_sink = i;
+			}
+		}
+	}
+
+	// A scope outlived by a whole ring of newer ones on its thread mustn't end
+	// the one that took its slot. Returns whether the sequential inner scopes
+	// all came back in order, none stretched to the outer scope's end.
+	bool CheckWrap()
+	{
+		constexpr uint64_t Inner = Profiler::EventsPerThread + 16;
+
+		bool ordered = true;
+		std::thread thread([&]()
+			{
+				{
+					PROFILE_SCOPE("Outer");
+					for (uint64_t i = 0; i < Inner; ++i)
+					{
+						PROFILE_SCOPE("Inner");
+						t_sink = i;
+					}
+				}
+
+				// Collect lists threads' events in the order they were begun.
+				auto const threads = Profiler::Collect();
+				auto const& events = threads.back().events;
+				ordered = events.size() == Profiler::EventsPerThread;
+				for (size_t i = 1; i < events.size(); ++i)
+				{
+					ordered = ordered && events[i - 1].end <= events[i].start;
+				}
+			});
+		thread.join();
+		return ordered;
+	}
+}
+
+int RunProfilerBenchmark(int argc, char** argv)
+{
+	const uint64_t scopes = Tools::GetArgument(argc, argv, 0, 1000000);
+	const char* tracePath = argc > 1 ? argv[1] : nullptr;
+
+	if (scopes == 0)
+	{
+		std::fprintf(stderr, "bench-profiler: scopes must be non-zero\n");
+		return 1;
+	}
+
+	Profiler::SetThreadName("Main");
+
+	Profiler::SetEnabled(false);
+	const double disabled = TimeScopes(scopes);
+
+	Profiler::SetEnabled(true);
+	const double enabled = TimeScopes(scopes);
+
+	// Several threads recording at once, each into its own ring.
+	Profiler::Clear();
+
+	const unsigned threadCount = 4;
+	const uint64_t frames = 1000;
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < threadCount; ++t)
+	{
+		threads.emplace_back([frames]()
+			{
+				Profiler::SetThreadName("Worker");
+				RecordNested(frames);
+			});
+	}
+	RecordNested(frames);
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	Profiler::SetEnabled(false);
+
+	// Every thread should hand back all of its scopes, each inside its frame.
+	size_t recordingThreads = 0;
+	bool complete = true;
+	for (auto const& thread : Profiler::Collect())
+	{
+		if (thread.events.empty())
+			continue;
+
+		recordingThreads++;
+		complete = complete && thread.events.size() == frames * 3;
+
+		for (size_t i = 0; i + 2 < thread.events.size(); i += 3)
+		{
+			auto const& frame = thread.events[i];
+			for (size_t child = i + 1; child <= i + 2; ++child)
+			{
+				complete = complete && thread.events[child].start >= frame.start
+					&& thread.events[child].end <= frame.end;
+			}
+		}
+	}
+
+	if (tracePath)
+	{
+		Profiler::WriteChromeTrace(tracePath);
+	}
+
+	Profiler::SetEnabled(true);
+	const bool wrapped = CheckWrap();
+	Profiler::SetEnabled(false);
+
+	std::printf("scopes:          %llu\n", static_cast<unsigned long long>(scopes));
+	std::printf("disabled:        %.2f ns/scope\n", disabled);
+	std::printf("enabled:         %.2f ns/scope\n", enabled);
+	std::printf("threads:         %zu of %u recorded\n", recordingThreads, threadCount + 1);
+	std::printf("nesting:         %s\n", complete ? "ok" : "MISMATCH");
+	std::printf("wrapped scope:   %s\n", wrapped ? "dropped" : "MISMATCH");
+
+	return complete && wrapped && recordingThreads == threadCount + 1 ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+//
+// RenderQueueBenchmark.cpp - State changes and sort cost of the render queue
+//
+
+#include "Tools.h"
+
+#include "../Shooter/RenderQueue.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+	struct Random
+	{
+		uint32_t state;
+
+		uint32_t Next() noexcept
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+	};
+
+	// A scene in submission order: objects arrive as the game walks them,
+	// with no regard for the state they need.
+	void FillQueue(RenderQueue& queue, size_t objects, uint32_t shaders, uint32_t materials, Random& random)
+	{
+		queue.Clear();
+
+		for (size_t i = 0; i < objects; ++i)
+		{
+			const uint32_t pass = random.Next() % 2;
+			const uint32_t target = pass;
+			const uint32_t shader = random.Next() % shaders;
+			const uint32_t material = shader * materials + random.Next() % materials;
+			const uint32_t depth = random.Next();
+
+			queue.Add(SortKey::Make(pass, target, shader, material, depth), nullptr, nullptr, uint32_t(i));
+		}
+	}
+
+	bool IsSorted(RenderQueue const& queue) noexcept
+	{
+		for (size_t i = 1; i < queue.GetSize(); ++i)
+		{
+			auto const& previous = queue.GetPacket(i - 1);
+			auto const& current = queue.GetPacket(i);
+
+			// Stable: equal keys keep submission order.
+			if (previous.key > current.key || (previous.key == current.key && previous.param > current.param))
+				return false;
+		}
+		return true;
+	}
+}
+
+int RunRenderQueueBenchmark(int argc, char** argv)
+{
+	const size_t maxObjects = size_t(Tools::GetArgument(argc, argv, 0, 65536));
+	const uint32_t shaders = uint32_t(Tools::GetArgument(argc, argv, 1, 8));
+	const uint32_t materials = uint32_t(Tools::GetArgument(argc, argv, 2, 16));
+
+	if (maxObjects == 0 || shaders == 0 || materials == 0)
+	{
+		std::fprintf(stderr, "bench-queue: objects, shaders and materials must be non-zero\n");
+		return 1;
+	}
+
+	RenderQueue queue;
+	queue.Reserve(maxObjects);
+
+	Random random = { 0x9E3779B9u };
+	bool sorted = true;
+
+	std::printf("%10s %14s %14s %12s\n", "objects", "unsorted/draw", "sorted/draw", "sort ns/obj");
+
+	for (size_t objects = 16; ; objects *= 4)
+	{
+		objects = objects < maxObjects ? objects : maxObjects;
+
+		FillQueue(queue, objects, shaders, materials, random);
+
+		NullRenderBackend unsortedBackend;
+		queue.Submit(unsortedBackend);
+
+		// Best of a few runs, refilling so every sort starts unsorted.
+		double sortTime = 0.0;
+		for (int run = 0; run < 5; ++run)
+		{
+			FillQueue(queue, objects, shaders, materials, random);
+
+			auto const start = std::chrono::steady_clock::now();
+			queue.Sort();
+			const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+			sortTime = run == 0 || elapsed < sortTime ? elapsed : sortTime;
+		}
+
+		sorted = sorted && IsSorted(queue);
+
+		NullRenderBackend sortedBackend;
+		queue.Submit(sortedBackend);
+
+		auto const& before = unsortedBackend.GetStats();
+		auto const& after = sortedBackend.GetStats();
+
+		std::printf("%10zu %14.3f %14.3f %12.2f\n", objects,
+			double(before.GetStateChanges()) / double(before.draws),
+			double(after.GetStateChanges()) / double(after.draws),
+			sortTime / double(objects));
+
+		if (objects == maxObjects)
+			break;
+	}
+
+	std::printf("order:     %s\n", sorted ? "ok" : "NOT SORTED");
+
+	return sorted ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+//
+// RenderTargetPoolBenchmark.cpp - Drives a render target pool through frames and resizes
+//
+
+#include "Tools.h"
+
+#include "../Shooter/RenderTargetPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t FormatColor = 28;	// DXGI_FORMAT_R8G8B8A8_UNORM
+	constexpr uint32_t FormatHdr = 10;		// DXGI_FORMAT_R16G16B16A16_FLOAT
+
+	// One frame's worth of transient targets: a full-size HDR target, a
+	// full-size color target and a chain of half-size blur targets.
+	void RenderFrame(RenderTargetPool& pool, uint32_t width, uint32_t height, uint32_t blurLevels)
+	{
+		std::vector<IRenderTarget*> targets;
+
+		targets.push_back(pool.Acquire({ width, height, FormatHdr, 1 }));
+		targets.push_back(pool.Acquire({ width, height, FormatColor, 1 }));
+
+		uint32_t w = width, h = height;
+		for (uint32_t level = 0; level < blurLevels; ++level)
+		{
+			w = std::max(w / 2, 1u);
+			h = std::max(h / 2, 1u);
+
+			// Ping-pong between two targets; only the last result is kept to the end.
+			auto first = pool.Acquire({ w, h, FormatColor, 1 });
+			auto second = pool.Acquire({ w, h, FormatColor, 1 });
+			pool.Release(first);
+			targets.push_back(second);
+		}
+
+		for (auto target : targets)
+		{
+			pool.Release(target);
+		}
+
+		pool.EndFrame();
+	}
+
+	void PrintStats(const char* title, RenderTargetPool::Stats const& stats)
+	{
+		std::printf("%s:\n", title);
+		std::printf("  created %llu, reused %llu, destroyed %llu, resident %zu\n",
+			static_cast<unsigned long long>(stats.created), static_cast<unsigned long long>(stats.reused),
+			static_cast<unsigned long long>(stats.destroyed), stats.residentTargets);
+		std::printf("  resident %.1f MB (peak %.1f MB), in use peak %.1f MB\n",
+			double(stats.residentBytes) / (1024.0 * 1024.0), double(stats.peakResidentBytes) / (1024.0 * 1024.0),
+			double(stats.peakInUseBytes) / (1024.0 * 1024.0));
+	}
+}
+
+int RunRenderTargetPoolBenchmark(int argc, char** argv)
+{
+	const uint32_t frames = static_cast<uint32_t>(Tools::GetArgument(argc, argv, 0, 600));
+	const uint32_t blurLevels = static_cast<uint32_t>(Tools::GetArgument(argc, argv, 1, 4));
+
+	const uint32_t maxIdleFrames = 4;
+
+	NullRenderTargetDevice device;
+	bool ok = true;
+
+	{
+		RenderTargetPool pool(device, maxIdleFrames);
+
+		// Steady state: after the first frame everything should be reused.
+		for (uint32_t i = 0; i < frames; ++i)
+		{
+			RenderFrame(pool, 1920, 1080, blurLevels);
+		}
+
+		auto const steady = pool.GetStats();
+		PrintStats("steady state", steady);
+
+		// Two full-size targets and a ping-pong pair per blur level.
+		const uint64_t perFrame = 2 + 2 * uint64_t(blurLevels);
+		if (steady.created != perFrame || steady.destroyed != 0)
+		{
+			std::printf("  UNEXPECTED: %llu targets per frame should be created once\n", static_cast<unsigned long long>(perFrame));
+			ok = false;
+		}
+
+		// A window dragged back and forth between two sizes: each size's
+		// targets survive the other's frames as long as the flips come
+		// faster than the idle limit.
+		const uint64_t createdBefore = steady.created;
+		for (uint32_t i = 0; i < frames; ++i)
+		{
+			const bool small = (i / 2) % 2 == 0;
+			RenderFrame(pool, small ? 1280 : 1920, small ? 720 : 1080, blurLevels);
+		}
+
+		auto const flipping = pool.GetStats();
+		PrintStats("resize flip-flop", flipping);
+
+		if (flipping.created - createdBefore != perFrame)
+		{
+			std::printf("  UNEXPECTED: only the new size's targets should be created\n");
+			ok = false;
+		}
+
+		// Settle on one size: the other size's targets go after the idle limit.
+		for (uint32_t i = 0; i <= maxIdleFrames; ++i)
+		{
+			RenderFrame(pool, 2560, 1440, blurLevels);
+		}
+
+		auto const settled = pool.GetStats();
+		PrintStats("after resize", settled);
+
+		if (settled.residentTargets != perFrame)
+		{
+			std::printf("  UNEXPECTED: stale targets still resident\n");
+			ok = false;
+		}
+
+		pool.Trim();
+		if (pool.GetStats().residentTargets != 0 || pool.GetStats().residentBytes != 0)
+		{
+			std::printf("  UNEXPECTED: trim left targets resident\n");
+			ok = false;
+		}
+
+		// Releasing a target twice is a caller bug the pool must catch.
+		auto target = pool.Acquire({ 64, 64, FormatColor, 1 });
+		pool.Release(target);
+		try
+		{
+			pool.Release(target);
+			std::printf("  UNEXPECTED: double release accepted\n");
+			ok = false;
+		}
+		catch (std::invalid_argument const&)
+		{
+		}
+	}
+
+	if (device.GetLiveCount() != 0)
+	{
+		std::printf("UNEXPECTED: %llu targets leaked\n", static_cast<unsigned long long>(device.GetLiveCount()));
+		ok = false;
+	}
+
+	std::printf("\nrender target pool: %s\n", ok ? "ok" : "UNEXPECTED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+//
+// Replay.cpp - Runs an input recording through the player simulation
+//
+
+#include "Tools.h"
+
+#include "../Shooter/Benchmark.h"
+#include "../Shooter/InputRecording.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+
+namespace
+{
+	constexpr uint64_t SelfCheckTicks = 5000;
+
+	// Records the benchmark script as the game would, at uneven tick lengths
+	// with mouse movement on top, noting a checkpoint halfway and at the end.
+	// Returns the checksum of the live run's final state.
+	uint64_t RecordScriptedRun(std::filesystem::path const& path, uint64_t checksumMask)
+	{
+		InputRecording::Recorder recorder(path);
+		PlayerSimulation sim;
+		std::mt19937 random(3);
+
+		double time = 0.0;
+		for (uint64_t tick = 0; tick < SelfCheckTicks; ++tick)
+		{
+			const uint64_t elapsedTicks = InputRecording::TicksPerSecond / 60 + random() % 20000 - 10000;
+			const double seconds = static_cast<double>(elapsedTicks) / InputRecording::TicksPerSecond;
+
+			PlayerInput input = Benchmark::ScriptedInput(time);
+			if (tick % 3 == 0)
+			{
+				input.mouseX = int32_t(random() % 9) - 4;
+				input.mouseY = int32_t(random() % 5) - 2;
+			}
+
+			recorder.Record(elapsedTicks, input);
+			sim.Step(input, float(seconds));
+			time += seconds;
+
+			if (tick == SelfCheckTicks / 2)
+			{
+				recorder.Checkpoint(PlayerSimulation::Checksum(sim.GetState()));
+			}
+		}
+
+		const uint64_t checksum = PlayerSimulation::Checksum(sim.GetState());
+		recorder.Checkpoint(checksum ^ checksumMask);
+		return checksum;
+	}
+
+	// Records a run, reads it back and checks the replay lands on the live
+	// run's state, and that a recording it doesn't match is caught.
+	int SelfCheck()
+	{
+		const std::filesystem::path path = std::filesystem::temp_directory_path() / "shooter-replay-check.shir";
+		std::printf("self-check: recording %llu ticks to %s\n", static_cast<unsigned long long>(SelfCheckTicks), path.string().c_str());
+
+		try
+		{
+			const uint64_t live = RecordScriptedRun(path, 0);
+
+			InputRecording::Replay replay{ path };
+			uint64_t ticks = 0;
+			const uint64_t replayed = PlayerSimulation::Checksum(InputRecording::Simulate(replay, &ticks));
+			std::printf("  live %016llx, replayed %016llx\n", static_cast<unsigned long long>(live), static_cast<unsigned long long>(replayed));
+
+			Tools::Check(ticks == SelfCheckTicks, "every tick replayed");
+			Tools::Check(replayed == live, "replay matches the live run");
+			Tools::Check(replay.GetCheckpointCount() == 2 && replay.GetLastCheckpoint().position == SelfCheckTicks, "both checkpoints read");
+
+			// Rewound, it lands in the same place again.
+			replay.Rewind();
+			Tools::Check(PlayerSimulation::Checksum(InputRecording::Simulate(replay)) == live, "rewound replay matches");
+
+			// A final checksum the replay doesn't reach.
+			RecordScriptedRun(path, 1);
+			InputRecording::Replay diverged{ path };
+			Tools::Check(Tools::Throws<std::runtime_error>([&]() { InputRecording::Simulate(diverged); }), "divergence from the recording detected");
+		}
+		catch (std::exception const& e)
+		{
+			Tools::Check(false, e.what());
+		}
+
+		std::error_code error;
+		std::filesystem::remove(path, error);
+
+		return Tools::Finish("replay");
+	}
+}
+
+int RunReplay(int argc, char** argv)
+{
+	if (argc < 1)
+		return SelfCheck();
+
+	InputRecording::Replay replay{ std::filesystem::path(argv[0]) };
+
+	uint64_t ticks = 0;
+	PlayerState state;
+	try
+	{
+		state = InputRecording::Simulate(replay, &ticks);
+	}
+	catch (std::runtime_error const& e)
+	{
+		std::fprintf(stderr, "replay: %s after %llu ticks\n", e.what(), static_cast<unsigned long long>(replay.GetLastCheckpoint().position));
+		return 1;
+	}
+
+	// The checksum matches the one the game logs when the same replay finishes.
+	std::printf("ticks:    %llu\n", static_cast<unsigned long long>(ticks));
+	std::printf("position: %f %f %f\n", state.position.x, state.position.y, state.position.z);
+	std::printf("yaw:      %f\n", state.yaw);
+	std::printf("pitch:    %f\n", state.pitch);
+	std::printf("checksum: %016llx\n", static_cast<unsigned long long>(PlayerSimulation::Checksum(state)));
+
+	if (replay.GetCheckpointCount() == 0)
+	{
+		std::printf("verified: no, the recording holds no checkpoints\n");
+	}
+	else
+	{
+		std::printf("verified: %u checkpoints, the last after %llu ticks\n", replay.GetCheckpointCount(),
+			static_cast<unsigned long long>(replay.GetLastCheckpoint().position));
+	}
+
+	return 0;
+}
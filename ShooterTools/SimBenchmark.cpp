@@ -0,0 +1,122 @@
+//
+// SimBenchmark.cpp - Steps many simulated players without a window
+//
+
+#include "Tools.h"
+
+#include "../Shooter/PlayerSimulation.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+	// Small deterministic generator so every run sees the same workload.
+	struct Random
+	{
+		uint32_t state;
+
+		uint32_t Next() noexcept
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		float NextFloat() noexcept { return float(Next() & 0xFFFF) / 32767.5f - 1.0f; }
+		bool NextBool() noexcept { return (Next() & 1) != 0; }
+	};
+
+	// Picks a new input for a player, mixing gamepad and mouse/keyboard play.
+	PlayerInput RandomInput(Random& random) noexcept
+	{
+		PlayerInput input;
+
+		if (random.NextBool())
+		{
+			input.padConnected = true;
+			input.leftTrigger = random.NextFloat() * 0.5f + 0.5f;
+			input.leftStickX = random.NextFloat();
+			input.leftStickY = random.NextFloat();
+			input.rightStickX = random.NextFloat();
+			input.rightStickY = random.NextFloat();
+			input.leftStickPressed = random.NextBool();
+		}
+		else
+		{
+			input.mouseRelative = true;
+			input.mouseRight = random.NextBool();
+			input.mouseX = int32_t(random.Next() % 41) - 20;
+			input.mouseY = int32_t(random.Next() % 41) - 20;
+			input.keyForward = random.NextBool();
+			input.keyLeft = random.NextBool();
+			input.keySprint = random.NextBool();
+		}
+
+		return input;
+	}
+}
+
+int RunSimBenchmark(int argc, char** argv)
+{
+	const size_t players = size_t(Tools::GetArgument(argc, argv, 0, 4096));
+	const uint64_t ticks = Tools::GetArgument(argc, argv, 1, 600);
+	const float elapsedTime = 1.0f / 60.0f;
+
+	if (players == 0 || ticks == 0)
+	{
+		std::fprintf(stderr, "bench-sim: players and ticks must be non-zero\n");
+		return 1;
+	}
+
+	std::vector<PlayerSimulation> sims(players);
+	std::vector<PlayerInput> inputs(players);
+
+	Random random = { 0x2545F491u };
+
+	std::chrono::steady_clock::duration busy{};
+
+	for (uint64_t tick = 0; tick < ticks; ++tick)
+	{
+		// Players change what they are doing about twice a second.
+		if (tick % 30 == 0)
+		{
+			for (auto& input : inputs)
+			{
+				input = RandomInput(random);
+			}
+		}
+
+		auto const start = std::chrono::steady_clock::now();
+
+		for (size_t i = 0; i < players; ++i)
+		{
+			sims[i].Step(inputs[i], elapsedTime);
+		}
+
+		busy += std::chrono::steady_clock::now() - start;
+	}
+
+	// Fold the final state into a checksum so the work can't be optimized away.
+	float checksum = 0.0f;
+	for (auto const& sim : sims)
+	{
+		auto const& state = sim.GetState();
+		checksum += state.position.x + state.position.z + state.yaw;
+	}
+
+	const double seconds = std::chrono::duration<double>(busy).count();
+	const double steps = double(players) * double(ticks);
+
+	std::printf("players:        %zu\n", players);
+	std::printf("ticks:          %llu\n", static_cast<unsigned long long>(ticks));
+	std::printf("total time:     %.3f ms\n", seconds * 1000.0);
+	std::printf("per step:       %.1f ns\n", seconds * 1e9 / steps);
+	std::printf("player steps/s: %.0f\n", steps / seconds);
+	std::printf("players @60Hz:  %.0f\n", steps / seconds / 60.0);
+	std::printf("checksum:       %f\n", checksum);
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+//
+// StepTimerCheck.cpp - Checks the step timer's updates, interpolation alpha and delta clamp on a virtual clock
+//
+
+#include "Tools.h"
+
+#include "../Shooter/StepTimer.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+	using Timer = DX::BasicStepTimer<DX::VirtualClock>;
+
+	constexpr uint64_t TicksPerSecond = Timer::TicksPerSecond;
+	constexpr uint64_t Step = TicksPerSecond / 60;
+
+	// Advances the clock, ticks once and returns how many updates ran.
+	uint32_t Advance(Timer& timer, uint64_t counts)
+	{
+		timer.GetClock().Advance(counts);
+
+		uint32_t updates = 0;
+		timer.Tick([&]() { updates++; });
+		return updates;
+	}
+
+	bool AlphaIs(Timer const& timer, uint64_t leftOverTicks)
+	{
+		return std::abs(timer.GetInterpolationAlpha() - double(leftOverTicks) / double(Step)) < 1e-12;
+	}
+
+	// One update per tick, each as long as the clock moved, up to a tenth
+	// of a second.
+	void CheckVariable()
+	{
+		std::printf("variable timestep:\n");
+
+		Timer timer;
+		Tools::Check(Advance(timer, 70000) == 1 && timer.GetElapsedTicks() == 70000, "one update as long as the delta");
+		Tools::Check(timer.GetInterpolationAlpha() == 1.0, "alpha is 1");
+		Tools::Check(Advance(timer, 230000) == 1 && timer.GetElapsedTicks() == 230000, "uneven delta");
+		Tools::Check(Advance(timer, 0) == 1 && timer.GetElapsedTicks() == 0, "no time passed still updates");
+
+		Tools::Check(Advance(timer, 5 * TicksPerSecond) == 1 && timer.GetElapsedTicks() == TicksPerSecond / 10, "long delta clamped to a tenth of a second");
+		Tools::Check(timer.GetTotalTicks() == 70000 + 230000 + TicksPerSecond / 10 && timer.GetFrameCount() == 4, "total ticks and frames");
+
+		// A clock counting milliseconds converts to ticks and clamps at its own tenth.
+		Timer coarse(DX::VirtualClock(1000));
+		coarse.GetClock().Advance(25);
+		coarse.Tick([]() {});
+		Tools::Check(coarse.GetElapsedTicks() == 250000, "counts converted to ticks");
+		coarse.GetClock().Advance(1000);
+		coarse.Tick([]() {});
+		Tools::Check(coarse.GetElapsedTicks() == TicksPerSecond / 10, "clamped at the clock's own frequency");
+
+		std::printf("  %u frames, %.4f s\n", timer.GetFrameCount(), timer.GetTotalSeconds());
+	}
+
+	// Whole steps only, the remainder carried into alpha, deltas near a step
+	// snapped to it, and no more than a tenth of a second caught up at once.
+	void CheckFixed()
+	{
+		std::printf("fixed timestep at 60 Hz:\n");
+
+		Timer timer;
+		timer.SetFixedTimeStep(true);
+		timer.SetTargetElapsedTicks(Step);
+
+		Tools::Check(Advance(timer, 100000) == 0 && AlphaIs(timer, 100000), "less than a step: no update, alpha carries it");
+		Tools::Check(timer.GetFrameCount() == 0 && timer.GetTotalTicks() == 0, "no time simulated yet");
+
+		// 100000 + 300000 = 2 steps and 66668 over.
+		Tools::Check(Advance(timer, 300000) == 2 && AlphaIs(timer, 400000 - 2 * Step), "two steps, remainder in alpha");
+		Tools::Check(timer.GetElapsedTicks() == Step && timer.GetTotalTicks() == 2 * Step, "each update one step long");
+
+		// Within a quarter millisecond of a step counts as exactly one.
+		Tools::Check(Advance(timer, Step + 2000) == 1 && AlphaIs(timer, 400000 - 2 * Step), "near step snapped, alpha unchanged");
+		Tools::Check(Advance(timer, Step - 2000) == 1 && AlphaIs(timer, 400000 - 2 * Step), "short step snapped too");
+		Tools::Check(Advance(timer, Step + 3000) == 1 && AlphaIs(timer, 400000 - 2 * Step + 3000), "further off isn't snapped");
+
+		// A five second stall only catches up a tenth of a second.
+		const uint64_t leftOver = 400000 - 2 * Step + 3000 + TicksPerSecond / 10;
+		const uint32_t frames = timer.GetFrameCount();
+		Tools::Check(Advance(timer, 5 * TicksPerSecond) == leftOver / Step && AlphaIs(timer, leftOver % Step), "stall clamped to a tenth of a second");
+		Tools::Check(timer.GetFrameCount() == frames + leftOver / Step, "frame count follows the updates");
+
+		// After a reset the stall is forgotten, and so is the remainder.
+		timer.GetClock().Advance(2 * TicksPerSecond);
+		timer.ResetElapsedTime();
+		Tools::Check(AlphaIs(timer, 0), "reset clears the remainder");
+		Tools::Check(Advance(timer, Step) == 1 && AlphaIs(timer, 0), "one step after a reset");
+
+		// A slower target steps accordingly.
+		timer.SetTargetElapsedSeconds(0.05);
+		Tools::Check(Advance(timer, 700000) == 1 && std::abs(timer.GetInterpolationAlpha() - 0.4) < 1e-12, "20 Hz target");
+
+		timer.SetFixedTimeStep(false);
+		Tools::Check(timer.GetInterpolationAlpha() == 1.0, "alpha is 1 once variable again");
+
+		std::printf("  %u frames, %.4f s\n", timer.GetFrameCount(), timer.GetTotalSeconds());
+	}
+}
+
+int RunStepTimerCheck(int, char**)
+{
+	CheckVariable();
+	CheckFixed();
+
+	return Tools::Finish("step timer");
+}
@@ -0,0 +1,397 @@
+//
+// TextureCooker.cpp
+//
+
+#include "TextureCooker.h"
+#include "../Shooter/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURE_COOKER_SSE2 1
+#endif
+
+using namespace TextureCooker;
+
+namespace
+{
+	constexpr uint32_t BlockSize = 4;
+
+	// RGBA floats in linear light.
+	struct LinearImage
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> rgba;
+	};
+
+	float SrgbToLinear(float value) noexcept
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float LinearToSrgb(float value) noexcept
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	uint8_t ToByte(float value) noexcept
+	{
+		return uint8_t(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	LinearImage ToLinear(Surface const& surface, bool srgb)
+	{
+		static const auto table = []()
+		{
+			std::vector<float> result(256);
+			for (int i = 0; i < 256; ++i)
+			{
+				result[i] = SrgbToLinear(i / 255.0f);
+			}
+			return result;
+		}();
+
+		LinearImage image = { surface.width, surface.height, std::vector<float>(surface.rgba.size()) };
+		for (size_t i = 0; i < surface.rgba.size(); ++i)
+		{
+			image.rgba[i] = srgb && i % 4 != 3 ? table[surface.rgba[i]] : surface.rgba[i] / 255.0f;
+		}
+		return image;
+	}
+
+	Surface ToSurface(LinearImage const& image, bool srgb)
+	{
+		Surface surface = { image.width, image.height, std::vector<uint8_t>(image.rgba.size()) };
+		for (size_t i = 0; i < image.rgba.size(); ++i)
+		{
+			const float value = std::min(std::max(image.rgba[i], 0.0f), 1.0f);
+			surface.rgba[i] = ToByte(srgb && i % 4 != 3 ? LinearToSrgb(value) : value);
+		}
+		return surface;
+	}
+
+	// Mitchell-Netravali with B = C = 1/3: sharper than a box or tent, with
+	// little ringing.
+	float Mitchell(float x) noexcept
+	{
+		x = std::abs(x);
+		if (x < 1.0f)
+			return (7.0f * x * x * x - 12.0f * x * x + 16.0f / 3.0f) / 6.0f;
+		if (x < 2.0f)
+			return (-7.0f / 3.0f * x * x * x + 12.0f * x * x - 20.0f * x + 32.0f / 3.0f) / 6.0f;
+		return 0.0f;
+	}
+
+	struct Tap
+	{
+		uint32_t source;
+		float weight;
+	};
+
+	// For each destination pixel along one axis, the source pixels it reads
+	// and their normalized weights. Shrinking widens the filter to cover
+	// every source pixel.
+	struct Taps
+	{
+		uint32_t perPixel;
+		std::vector<Tap> taps;
+
+		Taps(uint32_t sourceSize, uint32_t destinationSize, AddressMode addressMode)
+		{
+			const float scale = float(sourceSize) / float(destinationSize);
+			const float width = std::max(scale, 1.0f);
+			const float radius = 2.0f * width;
+			perPixel = uint32_t(std::ceil(radius)) * 2 + 1;
+			taps.resize(size_t(destinationSize) * perPixel);
+
+			for (uint32_t i = 0; i < destinationSize; ++i)
+			{
+				const float center = (i + 0.5f) * scale - 0.5f;
+				const int first = int(std::floor(center - radius)) + 1;
+
+				float total = 0.0f;
+				for (uint32_t k = 0; k < perPixel; ++k)
+				{
+					const int position = first + int(k);
+					const float weight = Mitchell((position - center) / width);
+
+					int source = position;
+					if (addressMode == AddressMode::Wrap)
+					{
+						source = ((position % int(sourceSize)) + int(sourceSize)) % int(sourceSize);
+					}
+					else
+					{
+						source = std::min(std::max(position, 0), int(sourceSize) - 1);
+					}
+
+					taps[i * perPixel + k] = { uint32_t(source), weight };
+					total += weight;
+				}
+
+				for (uint32_t k = 0; k < perPixel; ++k)
+				{
+					taps[i * perPixel + k].weight /= total;
+				}
+			}
+		}
+	};
+
+	// Separable: across each row into a temporary, then down each column.
+	// A pixel's four channels are one vector in the horizontal pass and a
+	// row's floats run four at a time in the vertical one.
+	LinearImage Resample(LinearImage const& source, uint32_t width, uint32_t height, AddressMode addressMode)
+	{
+		const Taps horizontal(source.width, width, addressMode);
+		const Taps vertical(source.height, height, addressMode);
+
+		std::vector<float> rows(size_t(width) * source.height * 4);
+		for (uint32_t y = 0; y < source.height; ++y)
+		{
+			const float* in = source.rgba.data() + size_t(y) * source.width * 4;
+			float* out = rows.data() + size_t(y) * width * 4;
+
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const Tap* taps = horizontal.taps.data() + size_t(x) * horizontal.perPixel;
+#if defined(TEXTURE_COOKER_SSE2)
+				__m128 sum = _mm_setzero_ps();
+				for (uint32_t k = 0; k < horizontal.perPixel; ++k)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + taps[k].source * 4), _mm_set1_ps(taps[k].weight)));
+				}
+				_mm_storeu_ps(out + x * 4, sum);
+#else
+				float sum[4] = {};
+				for (uint32_t k = 0; k < horizontal.perPixel; ++k)
+				{
+					for (int c = 0; c < 4; ++c)
+					{
+						sum[c] += in[taps[k].source * 4 + c] * taps[k].weight;
+					}
+				}
+				std::memcpy(out + x * 4, sum, sizeof(sum));
+#endif
+			}
+		}
+
+		LinearImage result = { width, height, std::vector<float>(size_t(width) * height * 4, 0.0f) };
+		const size_t rowFloats = size_t(width) * 4;
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			float* out = result.rgba.data() + y * rowFloats;
+			const Tap* taps = vertical.taps.data() + size_t(y) * vertical.perPixel;
+
+			for (uint32_t k = 0; k < vertical.perPixel; ++k)
+			{
+				const float* in = rows.data() + taps[k].source * rowFloats;
+#if defined(TEXTURE_COOKER_SSE2)
+				const __m128 weight = _mm_set1_ps(taps[k].weight);
+				for (size_t i = 0; i < rowFloats; i += 4)
+				{
+					_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), weight)));
+				}
+#else
+				for (size_t i = 0; i < rowFloats; ++i)
+				{
+					out[i] += in[i] * taps[k].weight;
+				}
+#endif
+			}
+		}
+		return result;
+	}
+
+	uint32_t NearestPowerOfTwo(uint32_t value) noexcept
+	{
+		uint32_t power = 1;
+		while (power * 2 <= value)
+		{
+			power *= 2;
+		}
+		return value - power <= power * 2 - value ? power : power * 2;
+	}
+
+	uint32_t GetBlockCount(uint32_t pixels) noexcept
+	{
+		return std::max(1u, (pixels + BlockSize - 1) / BlockSize);
+	}
+
+	struct CompressJob
+	{
+		Surface const* surface;
+		BlockCompression::Format format;
+		uint8_t* output;
+	};
+
+	void CompressRow(void* context, uint32_t blockY)
+	{
+		auto const& job = *static_cast<CompressJob*>(context);
+		auto const& surface = *job.surface;
+		const uint32_t blocksWide = GetBlockCount(surface.width);
+		const size_t blockBytes = BlockCompression::GetBlockBytes(job.format);
+
+		for (uint32_t blockX = 0; blockX < blocksWide; ++blockX)
+		{
+			uint8_t pixels[64];
+			for (uint32_t y = 0; y < BlockSize; ++y)
+			{
+				const uint32_t sourceY = std::min(blockY * BlockSize + y, surface.height - 1);
+				for (uint32_t x = 0; x < BlockSize; ++x)
+				{
+					const uint32_t sourceX = std::min(blockX * BlockSize + x, surface.width - 1);
+					std::memcpy(pixels + (y * BlockSize + x) * 4, &surface.rgba[(size_t(sourceY) * surface.width + sourceX) * 4], 4);
+				}
+			}
+
+			BlockCompression::Encode(job.format, pixels, job.output + (size_t(blockY) * blocksWide + blockX) * blockBytes);
+		}
+	}
+
+	// DXGI_FORMAT values.
+	uint32_t GetDxgiFormat(BlockCompression::Format format, bool srgb) noexcept
+	{
+		switch (format)
+		{
+		case BlockCompression::Format::BC1: return srgb ? 72 : 71;
+		case BlockCompression::Format::BC3: return srgb ? 78 : 77;
+		default: return srgb ? 99 : 98;
+		}
+	}
+
+	void Append(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			bytes.push_back(uint8_t(value >> (i * 8)));
+		}
+	}
+}
+
+bool TextureCooker::IsOpaque(Surface const& surface) noexcept
+{
+	for (size_t i = 3; i < surface.rgba.size(); i += 4)
+	{
+		if (surface.rgba[i] != 255)
+			return false;
+	}
+	return true;
+}
+
+std::vector<Surface> TextureCooker::BuildMipChain(Surface const& source, bool srgb, bool mips, AddressMode addressMode)
+{
+	std::vector<Surface> levels;
+	if (!mips)
+	{
+		if (source.width % BlockSize != 0 || source.height % BlockSize != 0)
+			throw std::invalid_argument("Textures without mips must be a multiple of 4 pixels on each side");
+		levels.push_back(source);
+		return levels;
+	}
+
+	LinearImage image = ToLinear(source, srgb);
+
+	const uint32_t width = NearestPowerOfTwo(source.width);
+	const uint32_t height = NearestPowerOfTwo(source.height);
+	if (width != source.width || height != source.height)
+	{
+		image = Resample(image, width, height, addressMode);
+		levels.push_back(ToSurface(image, srgb));
+	}
+	else
+	{
+		levels.push_back(source);
+	}
+
+	while (image.width > 1 || image.height > 1)
+	{
+		image = Resample(image, std::max(1u, image.width / 2), std::max(1u, image.height / 2), addressMode);
+		levels.push_back(ToSurface(image, srgb));
+	}
+	return levels;
+}
+
+std::vector<uint8_t> TextureCooker::Compress(Surface const& surface, BlockCompression::Format format, ThreadPool& pool)
+{
+	const uint32_t blocksHigh = GetBlockCount(surface.height);
+	std::vector<uint8_t> blocks(size_t(GetBlockCount(surface.width)) * blocksHigh * BlockCompression::GetBlockBytes(format));
+
+	CompressJob job = { &surface, format, blocks.data() };
+	pool.ParallelFor(blocksHigh, CompressRow, &job);
+	return blocks;
+}
+
+Surface TextureCooker::Decompress(const uint8_t* blocks, uint32_t width, uint32_t height, BlockCompression::Format format)
+{
+	Surface surface = { width, height, std::vector<uint8_t>(size_t(width) * height * 4) };
+
+	const uint32_t blocksWide = GetBlockCount(width);
+	const size_t blockBytes = BlockCompression::GetBlockBytes(format);
+	for (uint32_t blockY = 0; blockY < GetBlockCount(height); ++blockY)
+	{
+		for (uint32_t blockX = 0; blockX < blocksWide; ++blockX)
+		{
+			uint8_t pixels[64];
+			BlockCompression::Decode(format, blocks + (size_t(blockY) * blocksWide + blockX) * blockBytes, pixels);
+
+			for (uint32_t y = 0; y < BlockSize && blockY * BlockSize + y < height; ++y)
+			{
+				for (uint32_t x = 0; x < BlockSize && blockX * BlockSize + x < width; ++x)
+				{
+					std::memcpy(&surface.rgba[((size_t(blockY) * BlockSize + y) * width + blockX * BlockSize + x) * 4],
+						pixels + (y * BlockSize + x) * 4, 4);
+				}
+			}
+		}
+	}
+	return surface;
+}
+
+std::vector<uint8_t> TextureCooker::WriteDds(uint32_t width, uint32_t height, BlockCompression::Format format, bool srgb,
+	std::vector<std::vector<uint8_t>> const& levels)
+{
+	constexpr uint32_t FlagsCaps = 0x1, FlagsHeight = 0x2, FlagsWidth = 0x4, FlagsPixelFormat = 0x1000;
+	constexpr uint32_t FlagsMipCount = 0x20000, FlagsLinearSize = 0x80000;
+	constexpr uint32_t PixelFormatFourCC = 0x4;
+	constexpr uint32_t CapsComplex = 0x8, CapsTexture = 0x1000, CapsMipmap = 0x400000;
+	constexpr uint32_t ResourceDimensionTexture2D = 3;
+
+	const bool mipmapped = levels.size() > 1;
+
+	std::vector<uint8_t> bytes;
+	Append(bytes, 0x20534444);		// "DDS "
+
+	Append(bytes, 124);
+	Append(bytes, FlagsCaps | FlagsHeight | FlagsWidth | FlagsPixelFormat | FlagsLinearSize | (mipmapped ? FlagsMipCount : 0));
+	Append(bytes, height);
+	Append(bytes, width);
+	Append(bytes, uint32_t(levels.front().size()));
+	Append(bytes, 0);				// Depth
+	Append(bytes, uint32_t(levels.size()));
+	bytes.resize(bytes.size() + 11 * 4, 0);
+
+	Append(bytes, 32);
+	Append(bytes, PixelFormatFourCC);
+	Append(bytes, 0x30315844);		// "DX10"
+	bytes.resize(bytes.size() + 5 * 4, 0);
+
+	Append(bytes, CapsTexture | (mipmapped ? CapsComplex | CapsMipmap : 0));
+	bytes.resize(bytes.size() + 4 * 4, 0);
+
+	Append(bytes, GetDxgiFormat(format, srgb));
+	Append(bytes, ResourceDimensionTexture2D);
+	Append(bytes, 0);
+	Append(bytes, 1);				// Array size
+	Append(bytes, 0);
+
+	for (auto const& level : levels)
+	{
+		bytes.insert(bytes.end(), level.begin(), level.end());
+	}
+	return bytes;
+}
@@ -0,0 +1,63 @@
+//
+// TextureCooker.h - Turns source images into mipmapped, block compressed DDS textures
+//
+
+#pragma once
+
+#include "BlockCompression.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Cooking a texture builds its mip chain from the source image, compresses
+// every level into blocks and lays them out as a DDS file that DirectXTK's
+// CreateDDSTextureFromFile uploads as it is. Filtering happens in linear
+// light: sRGB images are converted to linear floats first and back after
+// each level, so mips keep the brightness of the level above instead of
+// darkening as averaged sRGB values do. The resampling loops run four
+// floats at a time with SSE2 where the compiler targets it.
+namespace TextureCooker
+{
+	// How filters read past the image's edges: wrapping for textures that
+	// tile, clamping for ones that don't.
+	enum class AddressMode
+	{
+		Wrap,
+		Clamp,
+	};
+
+	// RGBA8, rows top to bottom.
+	struct Surface
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> rgba;
+	};
+
+	bool IsOpaque(Surface const& surface) noexcept;
+
+	// The source alone, or resized to the nearest power of two on each side
+	// and followed by every mip down to 1x1, each filtered from the one
+	// above with a Mitchell filter. Feature level 9_x can only mipmap
+	// textures with power of two sides. Throws std::invalid_argument for a
+	// source without mips whose sides aren't multiples of the block size,
+	// which block compressed textures need.
+	std::vector<Surface> BuildMipChain(Surface const& source, bool srgb, bool mips, AddressMode addressMode);
+
+	// Encodes rows of blocks on the pool's threads; the output doesn't
+	// depend on how many there are. Blocks past the surface's edge repeat
+	// its last row and column.
+	std::vector<uint8_t> Compress(Surface const& surface, BlockCompression::Format format, ThreadPool& pool);
+
+	Surface Decompress(const uint8_t* blocks, uint32_t width, uint32_t height, BlockCompression::Format format);
+
+	// A DDS file with a DX10 header, which sRGB block formats need, holding
+	// one compressed surface per mip level, largest first.
+	constexpr size_t DdsHeaderSize = 4 + 124 + 20;
+
+	std::vector<uint8_t> WriteDds(uint32_t width, uint32_t height, BlockCompression::Format format, bool srgb,
+		std::vector<std::vector<uint8_t>> const& levels);
+}
@@ -0,0 +1,73 @@
+//
+// Tools.h - Commands hosted by the ShooterTools console application
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+
+// Each command receives the arguments following its name.
+int RunSimBenchmark(int argc, char** argv);
+int RunReplay(int argc, char** argv);
+int RunGameBenchmark(int argc, char** argv);
+int RunProfilerBenchmark(int argc, char** argv);
+int RunRenderQueueBenchmark(int argc, char** argv);
+int RunFrameSequence(int argc, char** argv);
+int RunRenderTargetPoolBenchmark(int argc, char** argv);
+int RunFrameGraph(int argc, char** argv);
+int RunDynamicResolutionSim(int argc, char** argv);
+int RunCullBenchmark(int argc, char** argv);
+int RunOcclusionBenchmark(int argc, char** argv);
+int RunInstancingBenchmark(int argc, char** argv);
+int RunFrameRingBenchmark(int argc, char** argv);
+int RunMeshArenaBenchmark(int argc, char** argv);
+int RunCmoFuzz(int argc, char** argv);
+int RunCmoBenchmark(int argc, char** argv);
+int RunCookMeshes(int argc, char** argv);
+int RunCookTextures(int argc, char** argv);
+int RunAssetLoaderCheck(int argc, char** argv);
+int RunPackAssets(int argc, char** argv);
+int RunArchiveBenchmark(int argc, char** argv);
+int RunCompressionBenchmark(int argc, char** argv);
+int RunAssetCacheCheck(int argc, char** argv);
+int RunStepTimerCheck(int argc, char** argv);
+
+namespace Tools
+{
+	// Reads an optional positional argument, falling back to a default.
+	inline uint64_t GetArgument(int argc, char** argv, int index, uint64_t defaultValue) noexcept
+	{
+		if (index >= argc)
+			return defaultValue;
+
+		return std::strtoull(argv[index], nullptr, 10);
+	}
+
+	// Commands that check what they measure report each failed check and
+	// end with Finish, which prints whether they all passed and returns
+	// the command's exit code.
+	void Check(bool condition, const char* what);
+	bool Passed() noexcept;
+	int Finish(const char* name);
+
+	template<typename Exception, typename Action>
+	bool Throws(Action action)
+	{
+		try
+		{
+			action();
+		}
+		catch (Exception const&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	inline double Seconds(std::chrono::steady_clock::time_point start) noexcept
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}